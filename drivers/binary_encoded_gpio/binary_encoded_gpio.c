@@ -9,7 +9,10 @@
 
 #include <zephyr/device.h>
 #include <zephyr/drivers/gpio.h>
+#include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/math_extras.h>
 
 #include <ardep/drivers/binary_encoded_gpio.h>
 
@@ -18,23 +21,65 @@
 
 LOG_MODULE_REGISTER(binary_encoded_gpio, CONFIG_BINARY_ENCODED_GPIO_LOG_LEVEL);
 
+// All input pins on the same underlying port
+struct binary_encoded_gpio_port_group {
+  const struct device *port;
+  // bits of the value read from this port
+  uint32_t value_bits;
+
+#ifdef CONFIG_BINARY_ENCODED_GPIO_CACHED
+  struct gpio_callback callback;
+  // back reference for the callback handler
+  const struct device *dev;
+#endif
+};
+
 struct binary_encoded_gpio_config {
   const struct gpio_dt_spec *input_pins;
   size_t pin_count;
+
+  // one entry per input pin to fit the worst case, filled at init
+  struct binary_encoded_gpio_port_group *port_groups;
 };
 
-static int get_value(const struct device *device) {
+struct binary_encoded_gpio_data {
+  size_t port_group_count;
+
+#ifdef CONFIG_BINARY_ENCODED_GPIO_CACHED
+  // last sampled value or negative error code
+  atomic_t value;
+  struct k_work_delayable sample_work;
+  const struct device *dev;
+
+  binary_encoded_gpio_change_cb_t change_cb;
+  void *change_user_data;
+#endif
+};
+
+// Reads all pins with a single access per port
+static int sample_value(const struct device *device) {
   const struct binary_encoded_gpio_config *config = device->config;
+  struct binary_encoded_gpio_data *data = device->data;
   int value = 0;
 
-  for (int i = 0; i < config->pin_count; i++) {
-    int ret = gpio_pin_get_dt(&config->input_pins[i]);
+  for (size_t g = 0; g < data->port_group_count; g++) {
+    const struct binary_encoded_gpio_port_group *group =
+        &config->port_groups[g];
+
+    // applies the flags of the pins just like gpio_pin_get_dt
+    gpio_port_value_t port_value;
+    int ret = gpio_port_get(group->port, &port_value);
     if (ret < 0) {
-      LOG_ERR("Failed to read input pin %d: %d", i, ret);
+      LOG_ERR("Failed to read port %s: %d", group->port->name, ret);
       return ret;
     }
 
-    value |= (ret << i);
+    uint32_t bits = group->value_bits;
+    while (bits) {
+      const int i = u32_count_trailing_zeros(bits);
+      bits &= bits - 1;
+      value |= ((port_value >> config->input_pins[i].pin) & 1) << i;
+    }
   }
 
   LOG_DBG("Current binary encoded GPIO value: %d", value);
@@ -42,13 +87,122 @@ static int get_value(const struct device *device) {
   return value;
 }
 
+#ifdef CONFIG_BINARY_ENCODED_GPIO_CACHED
+
+static void sample_work_handler(struct k_work *work) {
+  struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+  struct binary_encoded_gpio_data *data =
+      CONTAINER_OF(dwork, struct binary_encoded_gpio_data, sample_work);
+
+  int value = sample_value(data->dev);
+  int old_value = atomic_set(&data->value, value);
+
+  if (value != old_value && data->change_cb != NULL) {
+    data->change_cb(data->dev, value, data->change_user_data);
+  }
+}
+
+static void pin_change_handler(const struct device *port,
+                               struct gpio_callback *cb,
+                               gpio_port_pins_t pins) {
+  ARG_UNUSED(port);
+  ARG_UNUSED(pins);
+
+  struct binary_encoded_gpio_port_group *group =
+      CONTAINER_OF(cb, struct binary_encoded_gpio_port_group, callback);
+  struct binary_encoded_gpio_data *data = group->dev->data;
+
+  // every edge restarts the debounce time
+  k_work_reschedule(&data->sample_work,
+                    K_MSEC(CONFIG_BINARY_ENCODED_GPIO_DEBOUNCE_MS));
+}
+
+static int get_value(const struct device *device) {
+  struct binary_encoded_gpio_data *data = device->data;
+
+  return atomic_get(&data->value);
+}
+
+static int set_change_callback(const struct device *device,
+                               binary_encoded_gpio_change_cb_t cb,
+                               void *user_data) {
+  struct binary_encoded_gpio_data *data = device->data;
+  struct k_work_sync sync;
+
+  // keeps the sampling work from seeing a callback without its user data
+  k_work_cancel_delayable_sync(&data->sample_work, &sync);
+  data->change_cb = cb;
+  data->change_user_data = user_data;
+
+  // samples again in case a change was pending
+  k_work_reschedule(&data->sample_work, K_NO_WAIT);
+
+  return 0;
+}
+
+static int init_cache(const struct device *dev) {
+  const struct binary_encoded_gpio_config *config = dev->config;
+  struct binary_encoded_gpio_data *data = dev->data;
+
+  data->dev = dev;
+  k_work_init_delayable(&data->sample_work, sample_work_handler);
+
+  for (int i = 0; i < config->pin_count; i++) {
+    int ret = gpio_pin_interrupt_configure_dt(&config->input_pins[i],
+                                              GPIO_INT_EDGE_BOTH);
+    if (ret < 0) {
+      LOG_ERR("Failed to enable interrupts of input pin %d: %d", i, ret);
+      return ret;
+    }
+  }
+
+  for (size_t g = 0; g < data->port_group_count; g++) {
+    struct binary_encoded_gpio_port_group *group = &config->port_groups[g];
+
+    gpio_port_pins_t port_pins = 0;
+    uint32_t bits = group->value_bits;
+    while (bits) {
+      const int i = u32_count_trailing_zeros(bits);
+      bits &= bits - 1;
+      port_pins |= BIT(config->input_pins[i].pin);
+    }
+
+    group->dev = dev;
+    gpio_init_callback(&group->callback, pin_change_handler, port_pins);
+    int ret = gpio_add_callback(group->port, &group->callback);
+    if (ret < 0) {
+      LOG_ERR("Failed to add callback to port %s: %d", group->port->name,
+              ret);
+      return ret;
+    }
+  }
+
+  // the value is valid before the first pin change
+  atomic_set(&data->value, sample_value(dev));
+
+  return 0;
+}
+
+#else
+
+static int get_value(const struct device *device) {
+  return sample_value(device);
+}
+
+#endif  // CONFIG_BINARY_ENCODED_GPIO_CACHED
+
 static int binary_encoded_gpio_init(const struct device *dev) {
   const struct binary_encoded_gpio_config *config = dev->config;
+  struct binary_encoded_gpio_data *data = dev->data;
 
   LOG_DBG("Initializing binary encoded GPIO driver");
 
+  data->port_group_count = 0;
+
   for (int i = 0; i < config->pin_count; i++) {
-    if (!device_is_ready(config->input_pins[i].port)) {
+    const struct device *port = config->input_pins[i].port;
+
+    if (!device_is_ready(port)) {
       return -ENODEV;
     }
 
@@ -56,7 +210,29 @@ static int binary_encoded_gpio_init(const struct device *dev) {
     if (ret < 0) {
       return ret;
     }
+
+    // group the pins by port, so a value is read with one access per port
+    size_t group = 0;
+    while (group < data->port_group_count &&
+           config->port_groups[group].port != port) {
+      group++;
+    }
+
+    if (group == data->port_group_count) {
+      config->port_groups[group].port = port;
+      config->port_groups[group].value_bits = 0;
+      data->port_group_count++;
+    }
+
+    config->port_groups[group].value_bits |= BIT(i);
+  }
+
+#ifdef CONFIG_BINARY_ENCODED_GPIO_CACHED
+  int ret = init_cache(dev);
+  if (ret < 0) {
+    return ret;
   }
+#endif
 
   LOG_DBG("Binary encoded GPIO driver initialized successfully");
 
@@ -65,6 +241,9 @@ static int binary_encoded_gpio_init(const struct device *dev) {
 
 DEVICE_API(binary_encoded_gpio, binary_encoded_gpio_api) = {
   .get_value = get_value,
+#ifdef CONFIG_BINARY_ENCODED_GPIO_CACHED
+  .set_change_callback = set_change_callback,
+#endif
 };
 
 BUILD_ASSERT(
@@ -76,16 +255,21 @@ BUILD_ASSERT(
     DT_INST_FOREACH_PROP_ELEM_SEP(inst, input_gpios, GPIO_DT_SPEC_GET_BY_IDX, \
                                   (, )),                                      \
   };                                                                          \
+  static struct binary_encoded_gpio_port_group                                \
+      port_groups_##inst[ARRAY_SIZE(input_pins_##inst)];                      \
   static const struct binary_encoded_gpio_config                              \
       binary_encoded_gpio_config_##inst = {                                   \
         .input_pins = input_pins_##inst,                                      \
         .pin_count = DT_INST_PROP_LEN(inst, input_gpios),                     \
+        .port_groups = port_groups_##inst,                                    \
   };                                                                          \
+  static struct binary_encoded_gpio_data binary_encoded_gpio_data_##inst;     \
   BUILD_ASSERT(                                                               \
       DT_INST_PROP_LEN(inst, input_gpios) <= MAXIMUM_SUPPORTED_PIN_COUNT,     \
       "Binary encoded GPIO driver can use at "                                \
       "most " STRINGIFY(MAXIMUM_SUPPORTED_PIN_COUNT) " input_gpios");         \
-  DEVICE_DT_INST_DEFINE(inst, binary_encoded_gpio_init, NULL, NULL,           \
+  DEVICE_DT_INST_DEFINE(inst, binary_encoded_gpio_init, NULL,                 \
+                        &binary_encoded_gpio_data_##inst,                     \
                         &binary_encoded_gpio_config_##inst, POST_KERNEL,      \
                         CONFIG_BINARY_ENCODED_GPIO_INIT_PRIORITY,             \
                         &binary_encoded_gpio_api);
@@ -15,18 +15,7 @@ LOG_MODULE_REGISTER(hv_shield_dac, CONFIG_HV_SHIELD_LOG_LEVEL);
 
 #include <ardep/drivers/hv_shield.h>
 
-struct hv_shield_dac_config_t {
-  const struct device* hv_shield;
-
-  uint8_t channel_count;
-
-  struct {
-    const struct device** dac_devs;
-    const int* dac_channels;
-  } mapping;
-
-  const uint8_t* gains;
-};
+#include "hv_shield_dac.h"
 
 static int hvs_dac_channel_setup(const struct device* dev,
                                  const struct dac_channel_cfg* channel_cfg) {
@@ -117,6 +106,10 @@ static int hv_shield_dac_init(const struct device* dev) {  //
     }
   }
 
+#ifdef CONFIG_HV_SHIELD_DAC_WAVEFORM
+  hv_shield_dac_waveform_init(dev);
+#endif
+
   return 0;
 }
 
@@ -128,7 +121,32 @@ static struct dac_driver_api hv_shield_dac_api = {
 #define DACS_GET_DEVICE(n, prop, index) \
   DEVICE_DT_GET(DT_PHANDLE_BY_IDX(n, prop, index))
 
+#ifdef CONFIG_HV_SHIELD_DAC_WAVEFORM
+#ifdef CONFIG_COUNTER
+#define HV_SHIELD_DAC_WAVEFORM_COUNTER(n)                            \
+  COND_CODE_1(DT_INST_NODE_HAS_PROP(n, waveform_counter),            \
+              (DEVICE_DT_GET(DT_INST_PHANDLE(n, waveform_counter))), \
+              (NULL))
+#else
+#define HV_SHIELD_DAC_WAVEFORM_COUNTER(n) NULL
+#endif
+
+#define HV_SHIELD_DAC_DATA_DEFINE(n) \
+  static struct hv_shield_dac_data_t hv_shield_dac_data_##n;
+#define HV_SHIELD_DAC_DATA(n) &hv_shield_dac_data_##n
+#define HV_SHIELD_DAC_WAVEFORM_CONFIG(n) \
+  .waveform_counter = HV_SHIELD_DAC_WAVEFORM_COUNTER(n),
+#else
+#define HV_SHIELD_DAC_DATA_DEFINE(n)
+#define HV_SHIELD_DAC_DATA(n) NULL
+#define HV_SHIELD_DAC_WAVEFORM_CONFIG(n)
+#endif
+
 #define HV_SHIELD_DAC_INIT(n)                                              \
+  BUILD_ASSERT(DT_INST_PROP_LEN(n, io_channels) <=                         \
+                   HV_SHIELD_DAC_MAX_CHANNELS,                             \
+               "Too many channels for the hv shield dac");                 \
+                                                                           \
   static const struct device* hv_shield_mapped_dacs_##n[] = {              \
     DT_INST_FOREACH_PROP_ELEM_SEP(n, io_channels, DACS_GET_DEVICE, (, )),  \
   };                                                                       \
@@ -143,10 +161,14 @@ static struct dac_driver_api hv_shield_dac_api = {
     .mapping.dac_devs = hv_shield_mapped_dacs_##n,                         \
     .mapping.dac_channels = hv_shield_mapped_dac_channels_##n,             \
     .gains = hv_shield_dac_gains_##n,                                      \
+    HV_SHIELD_DAC_WAVEFORM_CONFIG(n)                                       \
   };                                                                       \
                                                                            \
-  DEVICE_DT_INST_DEFINE(                                                   \
-      n, hv_shield_dac_init, NULL, NULL, &hv_shield_dac_config_##n,        \
-      POST_KERNEL, CONFIG_HV_SHIELD_DAC_INIT_PRIORITY, &hv_shield_dac_api);
+  HV_SHIELD_DAC_DATA_DEFINE(n)                                             \
+                                                                           \
+  DEVICE_DT_INST_DEFINE(n, hv_shield_dac_init, NULL, HV_SHIELD_DAC_DATA(n), \
+                        &hv_shield_dac_config_##n, POST_KERNEL,            \
+                        CONFIG_HV_SHIELD_DAC_INIT_PRIORITY,                \
+                        &hv_shield_dac_api);
 
 DT_INST_FOREACH_STATUS_OKAY(HV_SHIELD_DAC_INIT);
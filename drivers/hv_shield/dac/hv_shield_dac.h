@@ -0,0 +1,68 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (C) Frickly Systems GmbH
+ * SPDX-FileCopyrightText: Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef ARDEP_DRIVERS_HV_SHIELD_DAC_H_
+#define ARDEP_DRIVERS_HV_SHIELD_DAC_H_
+
+#include <zephyr/device.h>
+#include <zephyr/kernel.h>
+#include <zephyr/spinlock.h>
+
+#include <ardep/drivers/hv_shield.h>
+
+// The shield has two DACs with a gain each
+#define HV_SHIELD_DAC_MAX_CHANNELS 2
+
+struct hv_shield_dac_config_t {
+  const struct device* hv_shield;
+
+  uint8_t channel_count;
+
+  struct {
+    const struct device** dac_devs;
+    const int* dac_channels;
+  } mapping;
+
+  const uint8_t* gains;
+
+#ifdef CONFIG_HV_SHIELD_DAC_WAVEFORM
+  // counter paces the samples if set, a k_timer otherwise
+  const struct device* waveform_counter;
+#endif
+};
+
+#ifdef CONFIG_HV_SHIELD_DAC_WAVEFORM
+struct hv_shield_dac_waveform_state_t {
+  const uint16_t* samples;
+  size_t sample_count;
+  uint32_t cycles;  // 0 to play until stopped
+  enum hv_shield_dac_gains_t gain;
+
+  size_t index;
+  uint32_t played_cycles;
+  bool active;
+};
+
+struct hv_shield_dac_data_t {
+  const struct device* dev;  // back reference for the timer handlers
+
+  struct k_spinlock lock;
+  struct hv_shield_dac_waveform_state_t channels[HV_SHIELD_DAC_MAX_CHANNELS];
+  uint32_t sample_rate;
+  bool running;
+  bool starting;  // the gains are written, the waveforms must not change
+
+  struct k_timer timer;
+};
+
+/**
+ * @brief Internal: sets up the waveform playback of a dac device
+ */
+void hv_shield_dac_waveform_init(const struct device* dev);
+#endif
+
+#endif  // ARDEP_DRIVERS_HV_SHIELD_DAC_H_
@@ -0,0 +1,345 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (C) Frickly Systems GmbH
+ * SPDX-FileCopyrightText: Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "hv_shield_dac.h"
+
+#include <errno.h>
+#include <math.h>
+
+#include <zephyr/device.h>
+#include <zephyr/drivers/counter.h>
+#include <zephyr/drivers/dac.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+LOG_MODULE_DECLARE(hv_shield_dac, CONFIG_HV_SHIELD_LOG_LEVEL);
+
+#include <ardep/drivers/hv_shield.h>
+#include <ardep/drivers/hv_shield_dac_waveform.h>
+
+#define TWO_PI 6.28318530717958647692f
+
+/**
+ * @brief Internal: writes a sample to the dac a channel is mapped to
+ */
+static inline int _hvs_dac_write_sample(const struct device* dev,
+                                        uint8_t channel,
+                                        uint16_t value) {
+  const struct hv_shield_dac_config_t* config = dev->config;
+
+  return dac_write_value(config->mapping.dac_devs[channel],
+                         config->mapping.dac_channels[channel], value);
+}
+
+static void _hvs_dac_stop_timer(const struct device* dev) {
+  const struct hv_shield_dac_config_t* config = dev->config;
+  struct hv_shield_dac_data_t* data = dev->data;
+
+#ifdef CONFIG_COUNTER
+  if (config->waveform_counter != NULL) {
+    counter_stop(config->waveform_counter);
+    return;
+  }
+#else
+  ARG_UNUSED(config);
+#endif
+
+  k_timer_stop(&data->timer);
+}
+
+/**
+ * @brief Internal: advances all playing channels by one sample, called from
+ * the timer or counter isr
+ */
+static void _hvs_dac_play_next_samples(const struct device* dev) {
+  const struct hv_shield_dac_config_t* config = dev->config;
+  struct hv_shield_dac_data_t* data = dev->data;
+
+  k_spinlock_key_t key = k_spin_lock(&data->lock);
+
+  if (!data->running) {
+    k_spin_unlock(&data->lock, key);
+    return;
+  }
+
+  bool playing = false;
+  int err = 0;
+
+  for (uint8_t i = 0; i < config->channel_count && err == 0; i++) {
+    struct hv_shield_dac_waveform_state_t* state = &data->channels[i];
+    if (!state->active) {
+      continue;
+    }
+
+    if (++state->index == state->sample_count) {
+      state->index = 0;
+
+      if (state->cycles != 0 && ++state->played_cycles == state->cycles) {
+        // the channel keeps its last sample
+        state->active = false;
+        continue;
+      }
+    }
+
+    err = _hvs_dac_write_sample(dev, i, state->samples[state->index]);
+    playing = true;
+  }
+
+  if (err) {
+    LOG_ERR("Error writing waveform sample (%d), stopping", err);
+  }
+  const bool stop = err || !playing;
+  if (stop) {
+    data->running = false;
+  }
+
+  k_spin_unlock(&data->lock, key);
+
+  if (stop) {
+    _hvs_dac_stop_timer(dev);
+  }
+}
+
+static void hvs_dac_waveform_timer_handler(struct k_timer* timer) {
+  struct hv_shield_dac_data_t* data =
+      CONTAINER_OF(timer, struct hv_shield_dac_data_t, timer);
+
+  _hvs_dac_play_next_samples(data->dev);
+}
+
+#ifdef CONFIG_COUNTER
+static void hvs_dac_waveform_counter_handler(const struct device* counter,
+                                             void* user_data) {
+  ARG_UNUSED(counter);
+
+  _hvs_dac_play_next_samples(user_data);
+}
+
+/**
+ * @brief Internal: starts the counter with a top interrupt every sample period
+ */
+static int _hvs_dac_start_counter(const struct device* dev,
+                                  uint32_t sample_rate) {
+  const struct hv_shield_dac_config_t* config = dev->config;
+  const struct device* counter = config->waveform_counter;
+
+  // the counter wraps after top value + 1 ticks
+  uint32_t ticks = counter_get_frequency(counter) / sample_rate;
+  if (ticks < 2 || ticks - 1 > counter_get_max_top_value(counter)) {
+    LOG_ERR("Sample rate %u not supported by counter %s", sample_rate,
+            counter->name);
+    return -EINVAL;
+  }
+
+  struct counter_top_cfg top_cfg = {
+    .ticks = ticks - 1,
+    .callback = hvs_dac_waveform_counter_handler,
+    .user_data = (void*)dev,
+    .flags = 0,
+  };
+
+  int err = counter_set_top_value(counter, &top_cfg);
+  if (err) {
+    LOG_ERR("Error setting counter top value (%d)", err);
+    return err;
+  }
+
+  return counter_start(counter);
+}
+#endif
+
+int hv_shield_dac_waveform_set(const struct device* dev,
+                               uint8_t channel,
+                               const struct hv_shield_dac_waveform* waveform) {
+  const struct hv_shield_dac_config_t* config = dev->config;
+  struct hv_shield_dac_data_t* data = dev->data;
+
+  if (channel >= config->channel_count) {
+    LOG_ERR("Invalid channel id %d for waveform (%d known)", channel,
+            config->channel_count);
+    return -EINVAL;
+  }
+
+  if (waveform != NULL &&
+      (waveform->samples == NULL || waveform->sample_count == 0)) {
+    return -EINVAL;
+  }
+
+  int err = 0;
+  k_spinlock_key_t key = k_spin_lock(&data->lock);
+
+  if (data->running || data->starting) {
+    err = -EBUSY;
+  } else if (waveform == NULL) {
+    data->channels[channel].samples = NULL;
+  } else {
+    struct hv_shield_dac_waveform_state_t* state = &data->channels[channel];
+    state->samples = waveform->samples;
+    state->sample_count = waveform->sample_count;
+    state->cycles = waveform->cycles;
+    state->gain = waveform->gain;
+  }
+
+  k_spin_unlock(&data->lock, key);
+  return err;
+}
+
+int hv_shield_dac_waveform_start(const struct device* dev,
+                                 uint32_t sample_rate) {
+  const struct hv_shield_dac_config_t* config = dev->config;
+  struct hv_shield_dac_data_t* data = dev->data;
+
+  // the k_timer needs at least one tick per sample
+  if (sample_rate == 0 || (config->waveform_counter == NULL &&
+                           sample_rate > CONFIG_SYS_CLOCK_TICKS_PER_SEC)) {
+    LOG_ERR("Sample rate %u not supported", sample_rate);
+    return -EINVAL;
+  }
+
+  k_spinlock_key_t key = k_spin_lock(&data->lock);
+
+  if (data->running || data->starting) {
+    k_spin_unlock(&data->lock, key);
+    return -EALREADY;
+  }
+
+  bool has_waveform = false;
+  for (uint8_t i = 0; i < config->channel_count; i++) {
+    has_waveform |= data->channels[i].samples != NULL;
+  }
+  if (!has_waveform) {
+    k_spin_unlock(&data->lock, key);
+    return -ENODATA;
+  }
+
+  // the gains are written without the lock, as the shift register update
+  // may sleep
+  data->starting = true;
+
+  k_spin_unlock(&data->lock, key);
+
+  // all gains share the shift registers, so they are written at once
+  int err = hv_shield_begin_update(config->hv_shield);
+  if (err == 0) {
+    for (uint8_t i = 0; i < config->channel_count && err == 0; i++) {
+      const struct hv_shield_dac_waveform_state_t* state = &data->channels[i];
+
+      if (state->samples != NULL) {
+        err = hv_shield_set_dac_gain(config->hv_shield, i, state->gain);
+      }
+    }
+    int commit_err = hv_shield_commit_update(config->hv_shield);
+    err = err ? err : commit_err;
+  }
+
+  key = k_spin_lock(&data->lock);
+
+  if (err) {
+    data->starting = false;
+    k_spin_unlock(&data->lock, key);
+    LOG_ERR("Error setting waveform gains (%d)", err);
+    return err;
+  }
+
+  // the first samples of all channels are written together
+  for (uint8_t i = 0; i < config->channel_count && err == 0; i++) {
+    struct hv_shield_dac_waveform_state_t* state = &data->channels[i];
+
+    state->index = 0;
+    state->played_cycles = 0;
+    state->active = state->samples != NULL;
+
+    if (state->active) {
+      err = _hvs_dac_write_sample(dev, i, state->samples[0]);
+    }
+  }
+
+  data->running = err == 0;
+  data->starting = false;
+  data->sample_rate = sample_rate;
+
+  k_spin_unlock(&data->lock, key);
+
+  if (err) {
+    LOG_ERR("Error writing first waveform sample (%d)", err);
+    return err;
+  }
+
+#ifdef CONFIG_COUNTER
+  if (config->waveform_counter != NULL) {
+    err = _hvs_dac_start_counter(dev, sample_rate);
+    if (err) {
+      key = k_spin_lock(&data->lock);
+      data->running = false;
+      k_spin_unlock(&data->lock, key);
+    }
+    return err;
+  }
+#endif
+
+  k_timeout_t period = K_NSEC(NSEC_PER_SEC / sample_rate);
+  k_timer_start(&data->timer, period, period);
+
+  return 0;
+}
+
+int hv_shield_dac_waveform_stop(const struct device* dev) {
+  struct hv_shield_dac_data_t* data = dev->data;
+
+  k_spinlock_key_t key = k_spin_lock(&data->lock);
+
+  bool was_running = data->running;
+  data->running = false;
+
+  k_spin_unlock(&data->lock, key);
+
+  if (!was_running) {
+    return -EALREADY;
+  }
+
+  _hvs_dac_stop_timer(dev);
+  return 0;
+}
+
+bool hv_shield_dac_waveform_is_running(const struct device* dev) {
+  struct hv_shield_dac_data_t* data = dev->data;
+
+  return data->running;
+}
+
+void hv_shield_dac_waveform_sine(uint16_t* samples,
+                                 size_t count,
+                                 uint16_t offset,
+                                 uint16_t amplitude) {
+  for (size_t i = 0; i < count; i++) {
+    float value = offset + amplitude * sinf(TWO_PI * i / count);
+
+    samples[i] = (uint16_t)CLAMP(lroundf(value), 0, UINT16_MAX);
+  }
+}
+
+void hv_shield_dac_waveform_ramp(uint16_t* samples,
+                                 size_t count,
+                                 uint16_t from,
+                                 uint16_t to) {
+  if (count == 1) {
+    samples[0] = from;
+    return;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    int64_t step = ((int64_t)to - from) * (int64_t)i / (int64_t)(count - 1);
+    samples[i] = from + step;
+  }
+}
+
+void hv_shield_dac_waveform_init(const struct device* dev) {
+  struct hv_shield_dac_data_t* data = dev->data;
+
+  data->dev = dev;
+  k_timer_init(&data->timer, hvs_dac_waveform_timer_handler, NULL);
+}
@@ -0,0 +1,82 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (C) Frickly Systems GmbH
+ * SPDX-FileCopyrightText: Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+
+#include <zephyr/device.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
+
+LOG_MODULE_DECLARE(hv_shield_dac, CONFIG_HV_SHIELD_LOG_LEVEL);
+
+#include "hv_shield_dac.h"
+
+#include <ardep/drivers/hv_shield_dac_waveform.h>
+#include <ardep/uds.h>
+
+UDSErr_t hv_shield_dac_waveform_uds_check(
+    const struct uds_context* const context, bool* apply_action) {
+  ARG_UNUSED(context);
+
+  *apply_action = true;
+  return UDS_OK;
+}
+
+static UDSErr_t _hvs_dac_waveform_uds_start(const struct device* dev,
+                                            const UDSRoutineCtrlArgs_t* args) {
+  if (args->len != sizeof(uint32_t)) {
+    return UDS_NRC_IncorrectMessageLengthOrInvalidFormat;
+  }
+
+  int err = hv_shield_dac_waveform_start(dev,
+                                         sys_get_be32(args->optionRecord));
+  switch (err) {
+    case 0:
+      return UDS_OK;
+    case -EALREADY:
+      return UDS_NRC_RequestSequenceError;
+    case -ENODATA:
+      return UDS_NRC_ConditionsNotCorrect;
+    case -EINVAL:
+      return UDS_NRC_RequestOutOfRange;
+    default:
+      LOG_ERR("Error starting waveforms (%d)", err);
+      return UDS_NRC_GeneralReject;
+  }
+}
+
+UDSErr_t hv_shield_dac_waveform_uds_action(struct uds_context* const context,
+                                           bool* consume_event) {
+  UDSRoutineCtrlArgs_t* args = (UDSRoutineCtrlArgs_t*)context->arg;
+  const struct device* dev =
+      context->registration->routine_control.user_context;
+  struct hv_shield_dac_data_t* data = dev->data;
+
+  *consume_event = true;
+
+  switch (args->ctrlType) {
+    case UDS_ROUTINE_CONTROL__START_ROUTINE:
+      return _hvs_dac_waveform_uds_start(dev, args);
+    case UDS_ROUTINE_CONTROL__STOP_ROUTINE:
+      if (hv_shield_dac_waveform_stop(dev) != 0) {
+        return UDS_NRC_RequestSequenceError;
+      }
+      return UDS_OK;
+    case UDS_ROUTINE_CONTROL__REQUEST_ROUTINE_RESULTS: {
+      // running state followed by the sample rate
+      uint8_t record[1 + sizeof(uint32_t)];
+      record[0] = hv_shield_dac_waveform_is_running(dev) ? 1 : 0;
+      sys_put_be32(data->sample_rate, &record[1]);
+
+      return args->copyStatusRecord(context->server, record, sizeof(record));
+    }
+    default:
+      LOG_WRN("Unsupported control type: 0x%02x", args->ctrlType);
+      *consume_event = false;
+      return UDS_NRC_SubFunctionNotSupported;
+  }
+}
@@ -9,12 +9,36 @@
 
 #include <zephyr/devicetree.h>
 #include <zephyr/drivers/gpio.h>
+#include <zephyr/init.h>
 #include <zephyr/logging/log.h>
+#include <zephyr/sys/math_extras.h>
 
 #include <ardep/drivers/hv_shield.h>
 
+#ifdef CONFIG_HV_SHIELD_GPIO_STATS
+#include <zephyr/stats/stats.h>
+#endif
+
 LOG_MODULE_DECLARE(hv_shield);
 
+#ifdef CONFIG_HV_SHIELD_GPIO_STATS
+STATS_SECT_START(hv_shield_gpio_stats)
+STATS_SECT_ENTRY32(port_reads)
+STATS_SECT_ENTRY32(port_writes)
+STATS_SECT_END;
+
+STATS_NAME_START(hv_shield_gpio_stats)
+STATS_NAME(hv_shield_gpio_stats, port_reads)
+STATS_NAME(hv_shield_gpio_stats, port_writes)
+STATS_NAME_END(hv_shield_gpio_stats);
+
+static STATS_SECT_DECL(hv_shield_gpio_stats) hv_shield_gpio_stats;
+
+#define HV_SHIELD_GPIO_STATS_INC(_name) STATS_INC(hv_shield_gpio_stats, _name)
+#else
+#define HV_SHIELD_GPIO_STATS_INC(_name)
+#endif
+
 #define PIN_IN_RANGE_CHECK(pin, config)                                     \
   if (pin >= config->lv_gpios_count) {                                      \
     LOG_ERR("Pin outside the range of given gpios (pin %d, known %d)", pin, \
@@ -22,6 +46,12 @@ LOG_MODULE_DECLARE(hv_shield);
     return -EINVAL;                                                         \
   }
 
+// All hv pins whose low voltage gpio is on the same underlying port
+struct hv_shield_gpio_port_group_t {
+  const struct device* port;
+  gpio_port_pins_t hv_pins;
+};
+
 struct hv_shield_gpio_config_t {
   // needed by gpio api:
   struct gpio_driver_config gpio_driver;
@@ -29,6 +59,9 @@ struct hv_shield_gpio_config_t {
   const struct device* main_dev;
   const struct gpio_dt_spec* lv_gpios;
   size_t lv_gpios_count;
+
+  // one entry per low voltage gpio to fit the worst case, filled at init
+  struct hv_shield_gpio_port_group_t* port_groups;
 };
 
 struct hv_shield_gpio_data_t {
@@ -37,8 +70,44 @@ struct hv_shield_gpio_data_t {
 
   uint32_t input_map;
   uint32_t output_map;
+
+  size_t port_group_count;
 };
 
+/**
+ * @brief Internal: moves the bits of the given hv pins to the positions of
+ * their low voltage gpios on the underlying port
+ */
+static inline gpio_port_value_t _hvs_gpio_scatter(
+    const struct hv_shield_gpio_config_t* config,
+    gpio_port_pins_t hv_pins,
+    uint32_t hv_bits) {
+  gpio_port_value_t port_bits = 0;
+  while (hv_pins) {
+    const int i = u32_count_trailing_zeros(hv_pins);
+    hv_pins &= hv_pins - 1;
+    port_bits |= ((hv_bits >> i) & 1) << config->lv_gpios[i].pin;
+  }
+  return port_bits;
+}
+
+/**
+ * @brief Internal: inverse of _hvs_gpio_scatter, moves the bits of the low
+ * voltage gpios on the underlying port to the positions of the given hv pins
+ */
+static inline uint32_t _hvs_gpio_gather(
+    const struct hv_shield_gpio_config_t* config,
+    gpio_port_pins_t hv_pins,
+    gpio_port_value_t port_bits) {
+  uint32_t hv_bits = 0;
+  while (hv_pins) {
+    const int i = u32_count_trailing_zeros(hv_pins);
+    hv_pins &= hv_pins - 1;
+    hv_bits |= ((port_bits >> config->lv_gpios[i].pin) & 1) << i;
+  }
+  return hv_bits;
+}
+
 static int hvs_gpio_pin_configure(const struct device* dev,
                                   gpio_pin_t pin,
                                   gpio_flags_t flags) {
@@ -78,8 +147,34 @@ static int hvs_gpio_pin_configure(const struct device* dev,
 }
 
 static int hvs_gpio_init(const struct device* dev) {
+  const struct hv_shield_gpio_config_t* config = dev->config;
   struct hv_shield_gpio_data_t* data = dev->data;
   data->input_map = 0;
+
+  // group the hv pins by underlying port, so port operations need a single
+  // access per port
+  data->port_group_count = 0;
+  for (int i = 0; i < config->lv_gpios_count; i++) {
+    const struct device* port = config->lv_gpios[i].port;
+
+    size_t group = 0;
+    while (group < data->port_group_count &&
+           config->port_groups[group].port != port) {
+      group++;
+    }
+
+    if (group == data->port_group_count) {
+      config->port_groups[group].port = port;
+      config->port_groups[group].hv_pins = 0;
+      data->port_group_count++;
+    }
+
+    config->port_groups[group].hv_pins |= BIT(i);
+  }
+
+  LOG_DBG("%d hv pins on %d ports", config->lv_gpios_count,
+          data->port_group_count);
+
   return 0;
 }
 
@@ -119,20 +214,24 @@ static int hvs_gpio_port_get_raw(const struct device* port,
   }
   *value = 0;
 
-  for (int i = 0; i < config->lv_gpios_count; i++) {
-    // if not set as input skip
-    if (!(data->input_map & BIT(i))) continue;
+  for (size_t g = 0; g < data->port_group_count; g++) {
+    const struct hv_shield_gpio_port_group_t* group = &config->port_groups[g];
+
+    // only read pins set as input
+    const gpio_port_pins_t hv_pins = group->hv_pins & data->input_map;
+    if (!hv_pins) continue;
 
-    // read gpio value
-    int ret = gpio_pin_get_dt(&config->lv_gpios[i]);
+    // read the whole port, this applies the flags of the low voltage gpios
+    // just like gpio_pin_get_dt
+    gpio_port_value_t port_value;
+    int ret = gpio_port_get(group->port, &port_value);
+    HV_SHIELD_GPIO_STATS_INC(port_reads);
     if (ret < 0) {
-      LOG_ERR("Error reading gpio %d (error %d)", i, ret);
+      LOG_ERR("Error reading port %s (error %d)", group->port->name, ret);
       return ret;
     }
 
-    if (ret == 1) {
-      *value |= BIT(i);
-    }
+    *value |= _hvs_gpio_gather(config, hv_pins, port_value);
   }
 
   return 0;
@@ -142,15 +241,22 @@ static int hvs_set_masked_raw(const struct device* port,
                               gpio_port_pins_t mask,
                               gpio_port_value_t value) {
   const struct hv_shield_gpio_config_t* config = port->config;
+  const struct hv_shield_gpio_data_t* data = port->data;
 
-  for (int i = 0; i < config->lv_gpios_count; i++) {
-    // if not enabled in mask, skip
-    if (!(mask & BIT(i))) continue;
+  for (size_t g = 0; g < data->port_group_count; g++) {
+    const struct hv_shield_gpio_port_group_t* group = &config->port_groups[g];
+
+    const gpio_port_pins_t hv_pins = group->hv_pins & mask;
+    if (!hv_pins) continue;
 
-    int ret = gpio_pin_set(config->lv_gpios[i].port, config->lv_gpios[i].pin,
-                           !!(value & BIT(i)));
+    // logical set, applies the flags of the low voltage gpios just like
+    // gpio_pin_set
+    int ret = gpio_port_set_masked(
+        group->port, _hvs_gpio_scatter(config, hv_pins, UINT32_MAX),
+        _hvs_gpio_scatter(config, hv_pins, value));
+    HV_SHIELD_GPIO_STATS_INC(port_writes);
     if (ret < 0) {
-      LOG_ERR("Error settings gpio %d (error %d)", i, ret);
+      LOG_ERR("Error setting port %s (error %d)", group->port->name, ret);
       return ret;
     }
   }
@@ -159,10 +265,11 @@ static int hvs_set_masked_raw(const struct device* port,
 }
 
 /**
- * @brief Internal helper macro to loop through all pins of the driver and run a
- * function with signature int(const struct device*,gpio_port_pins_t mask) for
- * all pins that have a bit set in given mask. Runs given function with
- * underlying port device and mask with single bit set for underlying port pin
+ * @brief Internal helper macro to loop through all underlying ports of the
+ * driver and run a function with signature int(const struct device*,
+ * gpio_port_pins_t mask) once per port that has pins set in the given mask.
+ * Runs given function with underlying port device and the mask of all
+ * corresponding underlying port pins
  * @param hv_shield_gpio_dev hv_shield_gpio device
  * @param pin_mask mask with bits set for all pins to be looped through
  * @param api_func_name name of the gpio_driver_api function that has to be
@@ -170,25 +277,31 @@ static int hvs_set_masked_raw(const struct device* port,
  * @param error_msg string that describes the function in error messages (e.g.
  * "setting dir")
  */
-#define _HVS_GPIO_RUN_LL_API_FOREACH_MASK(hv_shield_gpio_dev, pin_mask,        \
+#define _HVS_GPIO_RUN_LL_API_FOREACH_PORT(hv_shield_gpio_dev, pin_mask,        \
                                           api_func_name, error_msg)            \
   {                                                                            \
     const struct hv_shield_gpio_config_t* config = hv_shield_gpio_dev->config; \
-    for (int i = 0; i < config->lv_gpios_count; i++) {                         \
-      /* Skip if not in mask */                                                \
-      if (!(pin_mask & BIT(i))) continue;                                      \
-      const struct device* port = config->lv_gpios[i].port;                    \
-      const int port_pin = config->lv_gpios[i].pin;                            \
+    const struct hv_shield_gpio_data_t* data = hv_shield_gpio_dev->data;       \
+    for (size_t g = 0; g < data->port_group_count; g++) {                      \
+      const struct hv_shield_gpio_port_group_t* group =                        \
+          &config->port_groups[g];                                             \
+      const gpio_port_pins_t hv_pins = group->hv_pins & pin_mask;              \
+      /* Skip if no pin of this port is in mask */                             \
+      if (!hv_pins) continue;                                                  \
+      const struct device* port = group->port;                                 \
       struct gpio_driver_api* port_api = (struct gpio_driver_api*)port->api;   \
                                                                                \
       if (!port_api->api_func_name) {                                          \
         LOG_ERR("Port %s does not implement function " #api_func_name,         \
                 port->name);                                                   \
+        return -ENOSYS;                                                        \
       }                                                                        \
                                                                                \
-      int ret = port_api->api_func_name(port, BIT(port_pin));                  \
+      int ret = port_api->api_func_name(                                       \
+          port, _hvs_gpio_scatter(config, hv_pins, UINT32_MAX));               \
+      HV_SHIELD_GPIO_STATS_INC(port_writes);                                   \
       if (ret < 0) {                                                           \
-        LOG_ERR("Error " error_msg " %d (error %d)", i, ret);                  \
+        LOG_ERR("Error " error_msg " on port %s (error %d)", port->name, ret); \
         return ret;                                                            \
       }                                                                        \
     }                                                                          \
@@ -196,14 +309,14 @@ static int hvs_set_masked_raw(const struct device* port,
 
 static int hvs_gpio_clear_pins(const struct device* port,
                                gpio_port_pins_t pins) {
-  _HVS_GPIO_RUN_LL_API_FOREACH_MASK(port, pins, port_clear_bits_raw,
+  _HVS_GPIO_RUN_LL_API_FOREACH_PORT(port, pins, port_clear_bits_raw,
                                     "clearing gpio");
 
   return 0;
 }
 
 static int hvs_gpio_set_pins(const struct device* port, gpio_port_pins_t pins) {
-  _HVS_GPIO_RUN_LL_API_FOREACH_MASK(port, pins, port_set_bits_raw,
+  _HVS_GPIO_RUN_LL_API_FOREACH_PORT(port, pins, port_set_bits_raw,
                                     "settings gpio");
 
   return 0;
@@ -211,7 +324,7 @@ static int hvs_gpio_set_pins(const struct device* port, gpio_port_pins_t pins) {
 
 static int hvs_gpio_toggle_pins(const struct device* port,
                                 gpio_port_pins_t pins) {
-  _HVS_GPIO_RUN_LL_API_FOREACH_MASK(port, pins, port_toggle_bits,
+  _HVS_GPIO_RUN_LL_API_FOREACH_PORT(port, pins, port_toggle_bits,
                                     "toggling gpio");
 
   return 0;
@@ -240,8 +353,9 @@ static uint32_t hvs_gpio_get_pending_int(const struct device* port) {
   // a pending interrupt
 
   const struct hv_shield_gpio_config_t* config = port->config;
-  for (int i = 0; i < config->lv_gpios_count; i++) {
-    const struct device* port = config->lv_gpios[i].port;
+  const struct hv_shield_gpio_data_t* data = port->data;
+  for (size_t g = 0; g < data->port_group_count; g++) {
+    const struct device* port = config->port_groups[g].port;
     struct gpio_driver_api* port_api = (struct gpio_driver_api*)port->api;
 
     if (!port_api->get_pending_int) {
@@ -308,6 +422,8 @@ static struct gpio_driver_api hvs_gpio_api = {
   };                                                                    \
   BUILD_ASSERT(ARRAY_SIZE(hv_shield_lv_gpios_##n) <= 32,                \
                "HV Shield GPIO has too many low voltage gpios");        \
+  static struct hv_shield_gpio_port_group_t                             \
+      hv_shield_port_groups_##n[ARRAY_SIZE(hv_shield_lv_gpios_##n)];    \
                                                                         \
   static const struct hv_shield_gpio_config_t hv_shield_config_##n = {  \
     .gpio_driver.port_pin_mask = GPIO_DT_INST_PORT_PIN_MASK_NGPIOS_EXC( \
@@ -315,6 +431,7 @@ static struct gpio_driver_api hvs_gpio_api = {
     .main_dev = DEVICE_DT_GET(DT_INST_BUS(n)),                          \
     .lv_gpios = hv_shield_lv_gpios_##n,                                 \
     .lv_gpios_count = ARRAY_SIZE(hv_shield_lv_gpios_##n),               \
+    .port_groups = hv_shield_port_groups_##n,                           \
   };                                                                    \
                                                                         \
   static struct hv_shield_gpio_data_t hv_shield_data_##n = {            \
@@ -327,3 +444,17 @@ static struct gpio_driver_api hvs_gpio_api = {
                         &hvs_gpio_api);  // todo: config for init priority
 
 DT_INST_FOREACH_STATUS_OKAY(HV_SHIELD_GPIO_INIT)
+
+#ifdef CONFIG_HV_SHIELD_GPIO_STATS
+static int hvs_gpio_stats_init(void) {
+  int ret = STATS_INIT_AND_REG(hv_shield_gpio_stats, STATS_SIZE_32,
+                               "hv_shield_gpio");
+  if (ret < 0) {
+    LOG_ERR("Failed to register the gpio stats: %d", ret);
+  }
+
+  return ret;
+}
+
+SYS_INIT(hvs_gpio_stats_init, POST_KERNEL, CONFIG_HV_SHIELD_GPIO_INIT_PRIORITY);
+#endif
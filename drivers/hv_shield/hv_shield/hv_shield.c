@@ -33,7 +33,13 @@ BUILD_ASSERT(sizeof(struct hv_shield_registers_t) == 5,
              "Invalid registers size.");
 
 struct hv_shield_data_t {
+  const struct device* dev;  // back reference for the flush work handler
   struct hv_shield_registers_t registers;
+
+  struct k_mutex lock;
+  bool dirty;            // registers differ from the shift registers
+  uint8_t update_depth;  // number of open updates, see hv_shield_begin_update
+  struct k_work_delayable flush_work;
 };
 
 /**
@@ -77,10 +83,91 @@ static int _hv_shield_update(const struct device* dev) {
   return 0;
 }
 
+/**
+ * @brief Internal: writes registers if they were changed since the last write.
+ * Must hold data->lock
+ *
+ * @param dev hv_shield device
+ * @retval 0 on success
+ * @retval other from spi_write_dt on error
+ */
+static int _hv_shield_flush(const struct device* dev) {
+  struct hv_shield_data_t* data = dev->data;
+
+  if (!data->dirty) {
+    return 0;
+  }
+
+  int err = _hv_shield_update(dev);
+  if (err) {
+    return err;
+  }
+
+  data->dirty = false;
+  return 0;
+}
+
+/**
+ * @brief Internal: marks registers as changed and writes them, unless an update
+ * is open or the write is deferred. Must hold data->lock
+ *
+ * @param dev hv_shield device
+ * @retval 0 on success
+ * @retval other from spi_write_dt on error
+ */
+static int _hv_shield_request_update(const struct device* dev) {
+  struct hv_shield_data_t* data = dev->data;
+
+  data->dirty = true;
+
+  if (data->update_depth > 0) {
+    // written by hvs_commit_update
+    return 0;
+  }
+
+  if (CONFIG_HV_SHIELD_DEFERRED_FLUSH_US > 0) {
+    // does not reschedule if pending, so the delay starts with the first change
+    k_work_schedule(&data->flush_work,
+                    K_USEC(CONFIG_HV_SHIELD_DEFERRED_FLUSH_US));
+    return 0;
+  }
+
+  return _hv_shield_flush(dev);
+}
+
+static void hv_shield_flush_work_handler(struct k_work* work) {
+  struct k_work_delayable* dwork = k_work_delayable_from_work(work);
+  struct hv_shield_data_t* data =
+      CONTAINER_OF(dwork, struct hv_shield_data_t, flush_work);
+
+  k_mutex_lock(&data->lock, K_FOREVER);
+
+  if (data->update_depth == 0) {
+    int err = _hv_shield_flush(data->dev);
+    if (err) {
+      LOG_ERR("Error writing deferred register changes (%d)", err);
+    }
+  }
+
+  k_mutex_unlock(&data->lock);
+}
+
+/**
+ * @brief Internal: maps hv gpio indices to bits of the gpio_output register.
+ * The first 4 bits of each byte correspond to 4-7 and the next to 0-3
+ */
+static inline uint32_t _hv_shield_map_gpio_bits(uint32_t bits) {
+  return ((bits & 0x0F0F0F0F) << 4) | ((bits & 0xF0F0F0F0) >> 4);
+}
+
 static int hv_shield_init(const struct device* dev) {
   const struct hv_shield_config_t* config = dev->config;
   struct hv_shield_data_t* data = dev->data;
 
+  data->dev = dev;
+  k_mutex_init(&data->lock);
+  k_work_init_delayable(&data->flush_work, hv_shield_flush_work_handler);
+
   int err = gpio_pin_configure_dt(&config->oe_gpio_spec, GPIO_OUTPUT_INACTIVE);
   if (err) {
     LOG_ERR("Error setting up Output enable pin (%d)", err);
@@ -110,18 +197,55 @@ static int hvs_set_dac_gain(const struct device* dev,
   if (dac > 1) return -EINVAL;
 
   struct hv_shield_data_t* data = dev->data;
+
+  k_mutex_lock(&data->lock, K_FOREVER);
+
+  enum hv_shield_dac_gains_t old_gain;
   switch (dac) {
     case 0:
+      old_gain = data->registers.dac0;
       data->registers.dac0 = gain;
       break;
     case 1:
+      old_gain = data->registers.dac1;
       data->registers.dac1 = gain;
       break;
     default:
+      k_mutex_unlock(&data->lock);
       return -EINVAL;
   }
 
-  return _hv_shield_update(dev);
+  int err = 0;
+  if (old_gain != gain) {
+    err = _hv_shield_request_update(dev);
+  }
+
+  k_mutex_unlock(&data->lock);
+  return err;
+}
+
+static int hvs_set_gpio_output_enable_mask(const struct device* dev,
+                                           uint32_t mask,
+                                           uint32_t enable) {
+  struct hv_shield_data_t* data = dev->data;
+
+  const uint32_t mapped_mask = _hv_shield_map_gpio_bits(mask);
+  const uint32_t mapped_enable = _hv_shield_map_gpio_bits(enable);
+
+  k_mutex_lock(&data->lock, K_FOREVER);
+
+  const uint32_t old_output = data->registers.gpio_output;
+  const uint32_t new_output =
+      (old_output & ~mapped_mask) | (mapped_enable & mapped_mask);
+  data->registers.gpio_output = new_output;
+
+  int err = 0;
+  if (old_output != new_output) {
+    err = _hv_shield_request_update(dev);
+  }
+
+  k_mutex_unlock(&data->lock);
+  return err;
 }
 
 static int hvs_set_gpio_output_enable(const struct device* dev,
@@ -129,28 +253,51 @@ static int hvs_set_gpio_output_enable(const struct device* dev,
                                       bool enable) {
   if (index > 31) return -EINVAL;
 
+  return hvs_set_gpio_output_enable_mask(dev, BIT(index),
+                                         enable ? BIT(index) : 0);
+}
+
+static int hvs_begin_update(const struct device* dev) {
   struct hv_shield_data_t* data = dev->data;
 
-  // index has to be remapped a bit (first 4 bits correspond to 4-7 and next to
-  // 0-3 and that for each byte)
-  if (index % 8 < 4) {
-    index += 4;
-  } else {
-    index -= 4;
+  k_mutex_lock(&data->lock, K_FOREVER);
+
+  if (data->update_depth == UINT8_MAX) {
+    k_mutex_unlock(&data->lock);
+    return -EOVERFLOW;
   }
+  data->update_depth++;
 
-  if (enable) {
-    data->registers.gpio_output |= 1 << index;
-  } else {
-    data->registers.gpio_output &= ~(1 << index);
+  k_mutex_unlock(&data->lock);
+  return 0;
+}
+
+static int hvs_commit_update(const struct device* dev) {
+  struct hv_shield_data_t* data = dev->data;
+
+  k_mutex_lock(&data->lock, K_FOREVER);
+
+  if (data->update_depth == 0) {
+    k_mutex_unlock(&data->lock);
+    return -EINVAL;
+  }
+  data->update_depth--;
+
+  int err = 0;
+  if (data->update_depth == 0) {
+    err = _hv_shield_flush(dev);
   }
 
-  return _hv_shield_update(dev);
+  k_mutex_unlock(&data->lock);
+  return err;
 }
 
 struct hv_shield_api_t api = {
   .set_dac_gain = hvs_set_dac_gain,
   .set_gpio_output_enable = hvs_set_gpio_output_enable,
+  .set_gpio_output_enable_mask = hvs_set_gpio_output_enable_mask,
+  .begin_update = hvs_begin_update,
+  .commit_update = hvs_commit_update,
 };
 
 #define HV_SHIELD_EACH(n)                                               \
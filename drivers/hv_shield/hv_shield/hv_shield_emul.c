@@ -0,0 +1,117 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (C) Frickly Systems GmbH
+ * SPDX-FileCopyrightText: Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define DT_DRV_COMPAT hv_shield
+
+#include <string.h>
+
+#include <zephyr/device.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/drivers/spi.h>
+#include <zephyr/drivers/spi_emul.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
+
+#include <ardep/drivers/emul/hv_shield.h>
+
+LOG_MODULE_REGISTER(hv_shield_emul, CONFIG_HV_SHIELD_LOG_LEVEL);
+
+// length of the shift register chain in bytes
+#define CHAIN_LEN 5
+
+struct hv_shield_emul_data {
+  // bytes in the order they were shifted in, the first byte is the one
+  // furthest down the chain
+  uint8_t chain[CHAIN_LEN];
+  atomic_t transfer_count;
+};
+
+struct hv_shield_emul_cfg {};
+
+uint32_t hv_shield_emul_get_gpio_output_enable(const struct emul* target) {
+  struct hv_shield_emul_data* data = target->data;
+
+  // the driver sends the registers with the last byte first
+  const uint32_t raw =
+      data->chain[4] | (data->chain[3] << 8) | (data->chain[2] << 16) |
+      ((uint32_t)data->chain[1] << 24);
+
+  // undo the nibble swap of each byte to get hv gpio indices
+  return ((raw & 0x0F0F0F0F) << 4) | ((raw & 0xF0F0F0F0) >> 4);
+}
+
+uint8_t hv_shield_emul_get_dac_gain(const struct emul* target, uint8_t dac) {
+  struct hv_shield_emul_data* data = target->data;
+
+  __ASSERT_NO_MSG(dac <= 1);
+  return (data->chain[0] >> (dac * 4)) & 0x0F;
+}
+
+uint32_t hv_shield_emul_get_transfer_count(const struct emul* target) {
+  struct hv_shield_emul_data* data = target->data;
+
+  return (uint32_t)atomic_get(&data->transfer_count);
+}
+
+void hv_shield_emul_reset_transfer_count(const struct emul* target) {
+  struct hv_shield_emul_data* data = target->data;
+
+  atomic_clear(&data->transfer_count);
+}
+
+static int hv_shield_emul_io_spi(const struct emul* target,
+                                 const struct spi_config* config,
+                                 const struct spi_buf_set* tx_bufs,
+                                 const struct spi_buf_set* rx_bufs) {
+  ARG_UNUSED(config);
+  ARG_UNUSED(rx_bufs);
+
+  struct hv_shield_emul_data* data = target->data;
+
+  atomic_inc(&data->transfer_count);
+
+  if (tx_bufs == NULL) {
+    return 0;
+  }
+
+  // shift every byte into the chain, only the last CHAIN_LEN bytes remain
+  for (size_t i = 0; i < tx_bufs->count; i++) {
+    const struct spi_buf* buf = &tx_bufs->buffers[i];
+    const uint8_t* bytes = buf->buf;
+
+    for (size_t j = 0; j < buf->len; j++) {
+      memmove(&data->chain[0], &data->chain[1], CHAIN_LEN - 1);
+      data->chain[CHAIN_LEN - 1] = bytes ? bytes[j] : 0;
+    }
+  }
+
+  return 0;
+}
+
+static int hv_shield_emul_init(const struct emul* target,
+                               const struct device* parent) {
+  ARG_UNUSED(parent);
+
+  struct hv_shield_emul_data* data = target->data;
+
+  memset(data->chain, 0, CHAIN_LEN);
+  atomic_clear(&data->transfer_count);
+
+  return 0;
+}
+
+static const struct spi_emul_api hv_shield_emul_api_spi = {
+  .io = hv_shield_emul_io_spi,
+};
+
+#define HV_SHIELD_EMUL(n)                                                   \
+  const struct hv_shield_emul_cfg hv_shield_emul_cfg_##n;                   \
+  struct hv_shield_emul_data hv_shield_emul_data_##n;                       \
+  EMUL_DT_INST_DEFINE(n, hv_shield_emul_init, &hv_shield_emul_data_##n,     \
+                      &hv_shield_emul_cfg_##n, &hv_shield_emul_api_spi, NULL)
+
+DT_INST_FOREACH_STATUS_OKAY(HV_SHIELD_EMUL)
@@ -16,7 +16,9 @@
 #include <zephyr/drivers/i2c.h>
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
 
+#include <ardep/drivers/power_io_shield.h>
 #include <ardep/dt-bindings/power-io-shield.h>
 
 LOG_MODULE_REGISTER(power_io_shield, CONFIG_POWER_IO_SHIELD_LOG_LEVEL);
@@ -31,6 +33,12 @@ LOG_MODULE_REGISTER(power_io_shield, CONFIG_POWER_IO_SHIELD_LOG_LEVEL);
 #define REG_GPINTENA 0x04
 #define REG_GPIOA 0x12
 
+// INTF and INTCAP are adjacent and read in a single burst
+BUILD_ASSERT(REG_INTCAPA == REG_INTFA + 2);
+
+// set by the INT gpio ISR until the interrupt work took over the timestamp
+#define INTERRUPT_FLAG_TIMESTAMP_PENDING 0
+
 // pin mask for zephyr-side pin mapping
 // 6 pins each for IOs and 3 for faults
 #define ZEPHYR_PINS_PORT_MASK                           \
@@ -62,7 +70,24 @@ struct power_io_shield_data {
   uint16_t int_trigger_rising;
   uint16_t int_trigger_falling;
 
-  struct k_work on_interrupt_work;
+  // write combining for reg_cache.gpio, see power_io_shield_batch_begin()
+  bool gpio_dirty;      // reg_cache.gpio holds output changes not yet written
+  uint8_t batch_depth;  // number of open batches
+  uint32_t coalescing_window_us;
+  struct k_work_delayable flush_work;
+
+  // input cache, see power_io_shield_set_input_cache_max_age()
+  uint32_t input_cache_max_age_us;
+  bool input_cache_valid;
+  int64_t input_cache_timestamp;  // in ticks
+
+  // interrupt service, runs on power_io_shield_work_q
+  struct k_work_delayable on_interrupt_work;
+  uint32_t level_poll_period_us;  // 0 if no level interrupt is active
+  atomic_t interrupt_flags;
+  int64_t isr_timestamp;    // in ticks, taken in the INT gpio ISR
+  int64_t event_timestamp;  // in ticks, of the interrupt currently serviced
+
   struct k_work write_interrupt_config_work;  // to keep pin_interrupt_configure
                                               // ISR safe, we have to write the
                                               // config in a work queue item if
@@ -75,6 +100,12 @@ struct power_io_shield_data {
 static void power_io_shield_write_interrupt_config_work_handler(
     struct k_work* work);
 
+// shared by all instances, keeps interrupt service off the system work queue
+K_THREAD_STACK_DEFINE(power_io_shield_work_q_stack,
+                      CONFIG_POWER_IO_SHIELD_WORKQUEUE_STACK_SIZE);
+static struct k_work_q power_io_shield_work_q;
+static bool power_io_shield_work_q_started;
+
 // Write two adjacent 8-bit registers as one little-endian 16-bit value
 static int write_u16_reg(const struct power_io_shield_config* config,
                          uint8_t reg_addr,
@@ -102,6 +133,22 @@ static int read_u16_reg(const struct power_io_shield_config* config,
   return 0;
 }
 
+// Read INTFA/B and INTCAPA/B in one burst transfer
+static int read_intf_and_intcap(const struct power_io_shield_config* config,
+                                uint16_t* intf,
+                                uint16_t* intcap) {
+  uint8_t reg_addr = REG_INTFA;
+  uint8_t buf[4];
+  int ret = i2c_write_read_dt(&config->i2c, &reg_addr, 1, buf, sizeof(buf));
+  if (ret) {
+    LOG_ERR("Failed to read INTF and INTCAP registers: %d", ret);
+    return ret;
+  }
+  *intf = buf[0] | (buf[1] << 8);
+  *intcap = buf[2] | (buf[3] << 8);
+  return 0;
+}
+
 static int write_iocon(const struct power_io_shield_config* config,
                        uint8_t value) {
   return write_u16_reg(config, REG_IOCONA, (value << 8) | value);
@@ -167,21 +214,57 @@ static void power_io_shield_int_gpio_handler(const struct device* port,
   struct power_io_shield_data* data =
       CONTAINER_OF(cb, struct power_io_shield_data, interrupt_gpio_cb);
 
-  k_work_submit(&data->on_interrupt_work);
+  // keep the time of the first edge until the work handler picked it up
+  if (!atomic_test_bit(&data->interrupt_flags,
+                       INTERRUPT_FLAG_TIMESTAMP_PENDING)) {
+    data->isr_timestamp = k_uptime_ticks();
+    atomic_set_bit(&data->interrupt_flags, INTERRUPT_FLAG_TIMESTAMP_PENDING);
+  }
+
+  // also cuts short a pending level re-arm delay
+  k_work_reschedule_for_queue(&power_io_shield_work_q, &data->on_interrupt_work,
+                              K_NO_WAIT);
+}
+
+// Period until the next poll of an active level interrupt. Starts at the
+// configured poll period and doubles on every poll up to the maximum
+static uint32_t power_io_shield_next_level_poll_period(
+    const struct power_io_shield_data* data) {
+  if (data->level_poll_period_us == 0) {
+    return CONFIG_POWER_IO_SHIELD_LEVEL_POLL_PERIOD_US;
+  }
+
+  return MIN(data->level_poll_period_us * 2,
+             CONFIG_POWER_IO_SHIELD_LEVEL_POLL_MAX_PERIOD_US);
 }
 
 static void power_io_shield_interrupt_work_handler(struct k_work* work) {
+  struct k_work_delayable* dwork = k_work_delayable_from_work(work);
   struct power_io_shield_data* data =
-      CONTAINER_OF(work, struct power_io_shield_data, on_interrupt_work);
+      CONTAINER_OF(dwork, struct power_io_shield_data, on_interrupt_work);
   const struct device* dev = data->device;
   const struct power_io_shield_config* config = dev->config;
 
   k_sem_take(&data->lock, K_FOREVER);
 
+  if (atomic_test_bit(&data->interrupt_flags,
+                      INTERRUPT_FLAG_TIMESTAMP_PENDING)) {
+    // the ISR does not write the timestamp while the bit is set, so copy it
+    // before the bit is cleared
+    data->event_timestamp = data->isr_timestamp;
+    atomic_clear_bit(&data->interrupt_flags, INTERRUPT_FLAG_TIMESTAMP_PENDING);
+  } else {
+    // level interrupt poll without a new edge on the INT line
+    data->event_timestamp = k_uptime_ticks();
+  }
+
+  bool level_active = false;
+
   uint16_t intf = 0;
-  int err = read_u16_reg(config, REG_INTFA, &intf);
+  uint16_t intcap = 0;
+  int err = read_intf_and_intcap(config, &intf, &intcap);
   if (err) {
-    LOG_ERR("Error handling interrupt; could not read register: %d", err);
+    LOG_ERR("Error handling interrupt; could not read registers: %d", err);
     goto cleanup;
   }
 
@@ -190,13 +273,8 @@ static void power_io_shield_interrupt_work_handler(struct k_work* work) {
     goto cleanup;
   }
 
-  uint16_t intcap = 0;
-  err = read_u16_reg(config, REG_INTCAPA, &intcap);
-  if (err) {
-    LOG_ERR("Error handling interrupt; could not read INTCAP register: %d",
-            err);
-    goto cleanup;
-  }
+  // an input changed, so cached input values are outdated
+  data->input_cache_valid = false;
 
   // note that these are ANDed with intf and gpinten later
   const uint16_t level_interrupts = data->reg_cache.intcon;
@@ -211,44 +289,125 @@ static void power_io_shield_interrupt_work_handler(struct k_work* work) {
   gpio_fire_callbacks(&data->interrupt_callbacks, dev,
                       power_io_shield_gpio_bits_to_zephyr_bits(ints));
 
-  // If any level interrupt is active, resubmit work to check if the level is
-  // still active. If yes the callbacks are fired again, looping until the
-  // level goes inactive
+  // If any level interrupt is active, reschedule work to check if the level
+  // is still active. If yes the callbacks are fired again, polling with
+  // increasing period until the level goes inactive
   if (level_interrupts & ints) {
-    k_work_submit(&data->on_interrupt_work);
+    level_active = true;
+    data->level_poll_period_us = power_io_shield_next_level_poll_period(data);
+    k_work_schedule_for_queue(&power_io_shield_work_q,
+                              &data->on_interrupt_work,
+                              K_USEC(data->level_poll_period_us));
   }
 
 cleanup:
+  if (!level_active) {
+    data->level_poll_period_us = 0;
+  }
+
   k_sem_give(&data->lock);
 }
 
-static int power_io_shield_port_get_raw(const struct device* port,
-                                        gpio_port_value_t* value) {
-  const struct power_io_shield_config* config = port->config;
-  struct power_io_shield_data* data = port->data;
+// Write pending output changes from reg_cache.gpio. Must hold data->lock
+static int power_io_shield_flush_locked(const struct device* dev) {
+  const struct power_io_shield_config* config = dev->config;
+  struct power_io_shield_data* data = dev->data;
+
+  if (!data->gpio_dirty) {
+    return 0;
+  }
+
+  if (write_u16_reg(config, REG_GPIOA, data->reg_cache.gpio) != 0) {
+    return -EIO;
+  }
+
+  data->gpio_dirty = false;
+  return 0;
+}
+
+static void power_io_shield_flush_work_handler(struct k_work* work) {
+  struct k_work_delayable* dwork = k_work_delayable_from_work(work);
+  struct power_io_shield_data* data =
+      CONTAINER_OF(dwork, struct power_io_shield_data, flush_work);
 
   k_sem_take(&data->lock, K_FOREVER);
 
+  // an open batch is flushed by power_io_shield_batch_commit()
+  if (data->batch_depth == 0) {
+    int err = power_io_shield_flush_locked(data->device);
+    if (err != 0) {
+      LOG_ERR("Could not flush output changes: %d", err);
+    }
+  }
+
+  k_sem_give(&data->lock);
+}
+
+static bool power_io_shield_input_cache_is_fresh(
+    const struct power_io_shield_data* data) {
+  if (data->input_cache_max_age_us == 0 || !data->input_cache_valid) {
+    return false;
+  }
+
+  const int64_t age = k_uptime_ticks() - data->input_cache_timestamp;
+  return age < (int64_t)k_us_to_ticks_ceil64(data->input_cache_max_age_us);
+}
+
+// Read the GPIO register into reg_cache.gpio. Must hold data->lock
+static int power_io_shield_read_gpio_locked(const struct device* dev) {
+  const struct power_io_shield_config* config = dev->config;
+  struct power_io_shield_data* data = dev->data;
+
   uint16_t reg_value;
   if (read_u16_reg(config, REG_GPIOA, &reg_value) != 0) {
-    k_sem_give(&data->lock);
     return -EIO;
   }
 
-  data->reg_cache.gpio = reg_value;
-  *value = power_io_shield_gpio_bits_to_zephyr_bits(
-      reg_value ^ POWER_IO_SHIELD_HARD_INVERT_PINS);  // XOR hard-inverted pins
+  // keep output changes which are not written yet
+  if (data->gpio_dirty) {
+    reg_value = (reg_value & ~POWER_IO_SHIELD_OUTPUT_PINS_MASK) |
+                (data->reg_cache.gpio & POWER_IO_SHIELD_OUTPUT_PINS_MASK);
+  }
 
-  k_sem_give(&data->lock);
+  data->reg_cache.gpio = reg_value;
+  data->input_cache_timestamp = k_uptime_ticks();
+  data->input_cache_valid = true;
   return 0;
 }
 
-static int power_io_shield_gpio_set_masked_raw(const struct device* port,
-                                               gpio_port_pins_t mask,
-                                               gpio_port_value_t value) {
-  const struct power_io_shield_config* config = port->config;
+static inline gpio_port_value_t power_io_shield_cached_port_value(
+    const struct power_io_shield_data* data) {
+  return power_io_shield_gpio_bits_to_zephyr_bits(
+      data->reg_cache.gpio ^
+      POWER_IO_SHIELD_HARD_INVERT_PINS);  // XOR hard-inverted pins
+}
+
+static int power_io_shield_port_get_raw(const struct device* port,
+                                        gpio_port_value_t* value) {
   struct power_io_shield_data* data = port->data;
 
+  k_sem_take(&data->lock, K_FOREVER);
+
+  if (!power_io_shield_input_cache_is_fresh(data)) {
+    int ret = power_io_shield_read_gpio_locked(port);
+    if (ret != 0) {
+      k_sem_give(&data->lock);
+      return ret;
+    }
+  }
+
+  *value = power_io_shield_cached_port_value(data);
+
+  k_sem_give(&data->lock);
+  return 0;
+}
+
+// Apply output changes to reg_cache.gpio without writing them. Must hold
+// data->lock
+static void power_io_shield_update_outputs_locked(
+    struct power_io_shield_data* data,
+    gpio_port_pins_t mask,
+    gpio_port_value_t value) {
   // extract output bits from mask and value
   const uint8_t output_mask = mask >> POWER_IO_SHIELD_OUTPUT_BASE;
   const uint8_t output_value = value >> POWER_IO_SHIELD_OUTPUT_BASE;
@@ -260,21 +419,39 @@ static int power_io_shield_gpio_set_masked_raw(const struct device* port,
       (output_value << POWER_IO_SHIELD_OUTPUT_PINS_START) &
       POWER_IO_SHIELD_OUTPUT_PINS_MASK;
 
-  k_sem_take(&data->lock, K_FOREVER);
-
   // apply new values where mask is set
-  const uint16_t new_gpio =
+  const uint16_t gpio =
       (data->reg_cache.gpio & ~mapped_mask) | (mapped_value & mapped_mask);
 
-  if (write_u16_reg(config, REG_GPIOA, new_gpio) != 0) {
-    k_sem_give(&data->lock);
-    return -EIO;
+  // outputs that already have their value cost no transfer
+  if (gpio != data->reg_cache.gpio) {
+    data->reg_cache.gpio = gpio;
+    data->gpio_dirty = true;
   }
+}
+
+static int power_io_shield_gpio_set_masked_raw(const struct device* port,
+                                               gpio_port_pins_t mask,
+                                               gpio_port_value_t value) {
+  struct power_io_shield_data* data = port->data;
 
-  data->reg_cache.gpio = new_gpio;
+  k_sem_take(&data->lock, K_FOREVER);
+
+  power_io_shield_update_outputs_locked(data, mask, value);
+
+  int ret = 0;
+  if (data->batch_depth > 0) {
+    // written by power_io_shield_batch_commit()
+  } else if (data->coalescing_window_us > 0) {
+    // does not reschedule if already pending, so the window starts with the
+    // first change
+    k_work_schedule(&data->flush_work, K_USEC(data->coalescing_window_us));
+  } else {
+    ret = power_io_shield_flush_locked(port);
+  }
 
   k_sem_give(&data->lock);
-  return 0;
+  return ret;
 }
 
 static int power_io_shield_gpio_set_bits_raw(const struct device* port,
@@ -291,7 +468,6 @@ static int power_io_shield_gpio_clear_bits_raw(const struct device* port,
 static int power_io_shield_pin_configure(const struct device* dev,
                                          gpio_pin_t pin,
                                          gpio_flags_t flags) {
-  const struct power_io_shield_config* config = dev->config;
   struct power_io_shield_data* data = dev->data;
 
   uint8_t bit = power_io_shield_zephyr_pin_to_gpio_bit(pin);
@@ -336,8 +512,13 @@ static int power_io_shield_pin_configure(const struct device* dev,
       } else {
         data->reg_cache.gpio &= ~(1 << bit);
       }
+      data->gpio_dirty = true;
 
-      int ret = write_u16_reg(config, REG_GPIOA, data->reg_cache.gpio);
+      int ret = 0;
+      // an open batch is flushed by power_io_shield_batch_commit()
+      if (data->batch_depth == 0) {
+        ret = power_io_shield_flush_locked(dev);
+      }
 
       k_sem_give(&data->lock);
 
@@ -529,6 +710,18 @@ static int power_io_shield_init(const struct device* dev) {
 
   data->device = dev;
 
+  // init functions run sequentially, so the first instance starts the queue
+  if (!power_io_shield_work_q_started) {
+    static const struct k_work_queue_config work_q_config = {
+      .name = "power_io_shield_wq",
+    };
+    k_work_queue_start(&power_io_shield_work_q, power_io_shield_work_q_stack,
+                       K_THREAD_STACK_SIZEOF(power_io_shield_work_q_stack),
+                       CONFIG_POWER_IO_SHIELD_WORKQUEUE_PRIORITY,
+                       &work_q_config);
+    power_io_shield_work_q_started = true;
+  }
+
   if (!device_is_ready(config->i2c.bus)) {
     LOG_ERR("I2C bus %s not ready", config->i2c.bus->name);
     return -ENODEV;
@@ -590,9 +783,11 @@ static int power_io_shield_init(const struct device* dev) {
 
   LOG_INF("HV Shield v2 initialized on I2C address 0x%02x", config->i2c.addr);
 
-  k_work_init(&data->on_interrupt_work, power_io_shield_interrupt_work_handler);
+  k_work_init_delayable(&data->on_interrupt_work,
+                        power_io_shield_interrupt_work_handler);
   k_work_init(&data->write_interrupt_config_work,
               power_io_shield_write_interrupt_config_work_handler);
+  k_work_init_delayable(&data->flush_work, power_io_shield_flush_work_handler);
 
   int ret = k_sem_init(&data->lock, 1, 1);
   if (ret < 0) {
@@ -603,6 +798,205 @@ static int power_io_shield_init(const struct device* dev) {
   return 0;
 }
 
+int64_t power_io_shield_get_event_timestamp(const struct device* dev) {
+  const struct power_io_shield_data* data = dev->data;
+
+  // no locking, this is called from callbacks fired with the lock held
+  return data->event_timestamp;
+}
+
+int power_io_shield_batch_begin(const struct device* dev) {
+  struct power_io_shield_data* data = dev->data;
+
+  k_sem_take(&data->lock, K_FOREVER);
+
+  if (data->batch_depth == UINT8_MAX) {
+    k_sem_give(&data->lock);
+    return -EOVERFLOW;
+  }
+  data->batch_depth++;
+
+  k_sem_give(&data->lock);
+  return 0;
+}
+
+int power_io_shield_batch_commit(const struct device* dev) {
+  struct power_io_shield_data* data = dev->data;
+
+  k_sem_take(&data->lock, K_FOREVER);
+
+  if (data->batch_depth == 0) {
+    k_sem_give(&data->lock);
+    return -EINVAL;
+  }
+  data->batch_depth--;
+
+  int ret = 0;
+  if (data->batch_depth == 0) {
+    ret = power_io_shield_flush_locked(dev);
+  }
+
+  k_sem_give(&data->lock);
+  return ret;
+}
+
+int power_io_shield_flush(const struct device* dev) {
+  struct power_io_shield_data* data = dev->data;
+
+  k_work_cancel_delayable(&data->flush_work);
+
+  k_sem_take(&data->lock, K_FOREVER);
+  int ret = power_io_shield_flush_locked(dev);
+  k_sem_give(&data->lock);
+
+  return ret;
+}
+
+int power_io_shield_set_write_coalescing_window(const struct device* dev,
+                                                uint32_t window_us) {
+  struct power_io_shield_data* data = dev->data;
+
+  k_sem_take(&data->lock, K_FOREVER);
+  data->coalescing_window_us = window_us;
+  k_sem_give(&data->lock);
+
+  // write changes which are pending from the previous window
+  if (window_us == 0) {
+    return power_io_shield_flush(dev);
+  }
+
+  return 0;
+}
+
+int power_io_shield_set_input_cache_max_age(const struct device* dev,
+                                            uint32_t max_age_us) {
+  struct power_io_shield_data* data = dev->data;
+
+  k_sem_take(&data->lock, K_FOREVER);
+  data->input_cache_max_age_us = max_age_us;
+  data->input_cache_valid = false;
+  k_sem_give(&data->lock);
+
+  return 0;
+}
+
+// Take the locks of all shields in array order. Rejects duplicates, as the
+// lock of a shield can not be taken twice
+static int power_io_shield_bulk_lock(const struct device* const* devs,
+                                     size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    for (size_t j = 0; j < i; j++) {
+      if (devs[i] == devs[j]) {
+        LOG_ERR("Shield %s is listed more than once", devs[i]->name);
+        return -EINVAL;
+      }
+    }
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    struct power_io_shield_data* data = devs[i]->data;
+    k_sem_take(&data->lock, K_FOREVER);
+  }
+
+  return 0;
+}
+
+static void power_io_shield_bulk_unlock(const struct device* const* devs,
+                                        size_t count) {
+  for (size_t i = count; i > 0; i--) {
+    struct power_io_shield_data* data = devs[i - 1]->data;
+    k_sem_give(&data->lock);
+  }
+}
+
+static void power_io_shield_bulk_report_timing(
+    struct power_io_shield_bulk_timing* timing,
+    uint32_t start,
+    uint32_t first_transfer_done,
+    uint32_t last_transfer_done) {
+  if (timing == NULL) {
+    return;
+  }
+
+  timing->total_us = k_cyc_to_us_floor32(k_cycle_get_32() - start);
+  timing->spread_us =
+      k_cyc_to_us_floor32(last_transfer_done - first_transfer_done);
+}
+
+int power_io_shield_bulk_read(const struct device* const* devs,
+                              size_t count,
+                              gpio_port_value_t* values,
+                              struct power_io_shield_bulk_timing* timing) {
+  const uint32_t start = k_cycle_get_32();
+
+  int ret = power_io_shield_bulk_lock(devs, count);
+  if (ret != 0) {
+    return ret;
+  }
+
+  uint32_t first_transfer_done = 0;
+  uint32_t last_transfer_done = 0;
+  for (size_t i = 0; i < count; i++) {
+    ret = power_io_shield_read_gpio_locked(devs[i]);
+    if (ret != 0) {
+      LOG_ERR("Bulk read of shield %s failed: %d", devs[i]->name, ret);
+      break;
+    }
+
+    last_transfer_done = k_cycle_get_32();
+    if (i == 0) {
+      first_transfer_done = last_transfer_done;
+    }
+
+    values[i] = power_io_shield_cached_port_value(devs[i]->data);
+  }
+
+  power_io_shield_bulk_unlock(devs, count);
+
+  power_io_shield_bulk_report_timing(timing, start, first_transfer_done,
+                                     last_transfer_done);
+  return ret;
+}
+
+int power_io_shield_bulk_write(const struct device* const* devs,
+                               size_t count,
+                               const gpio_port_pins_t* masks,
+                               const gpio_port_value_t* values,
+                               struct power_io_shield_bulk_timing* timing) {
+  const uint32_t start = k_cycle_get_32();
+
+  int ret = power_io_shield_bulk_lock(devs, count);
+  if (ret != 0) {
+    return ret;
+  }
+
+  // prepare all shadow registers first, so the writes follow back to back
+  for (size_t i = 0; i < count; i++) {
+    power_io_shield_update_outputs_locked(devs[i]->data, masks[i], values[i]);
+  }
+
+  uint32_t first_transfer_done = 0;
+  uint32_t last_transfer_done = 0;
+  for (size_t i = 0; i < count; i++) {
+    ret = power_io_shield_flush_locked(devs[i]);
+    if (ret != 0) {
+      LOG_ERR("Bulk write of shield %s failed: %d", devs[i]->name, ret);
+      break;
+    }
+
+    last_transfer_done = k_cycle_get_32();
+    if (i == 0) {
+      first_transfer_done = last_transfer_done;
+    }
+  }
+
+  power_io_shield_bulk_unlock(devs, count);
+
+  power_io_shield_bulk_report_timing(timing, start, first_transfer_done,
+                                     last_transfer_done);
+  return ret;
+}
+
 DEVICE_API(gpio, power_io_shield_api) = {
   .pin_configure = power_io_shield_pin_configure,
   .port_get_raw = power_io_shield_port_get_raw,
@@ -634,6 +1028,9 @@ DEVICE_API(gpio, power_io_shield_api) = {
           .defval = 0,                                                        \
           .gpio = 0,                                                          \
         },                                                                    \
+    .coalescing_window_us =                                                   \
+        CONFIG_POWER_IO_SHIELD_WRITE_COALESCING_WINDOW_US,                    \
+    .input_cache_max_age_us = CONFIG_POWER_IO_SHIELD_INPUT_CACHE_MAX_AGE_US,  \
   };                                                                          \
   DEVICE_DT_INST_DEFINE(                                                      \
       x, power_io_shield_init, NULL, &power_io_shield_##x##_data,             \
@@ -13,6 +13,7 @@
 #include <zephyr/drivers/i2c.h>
 #include <zephyr/drivers/i2c_emul.h>
 #include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
 #include <zephyr/sys/util.h>
 
 #include <ardep/drivers/emul/power_io_shield.h>
@@ -23,6 +24,7 @@ LOG_MODULE_REGISTER(power_io_shield_emul, CONFIG_POWER_IO_SHIELD_LOG_LEVEL);
 
 struct power_io_shield_emul_data {
   uint8_t reg[NUM_REGS];
+  atomic_t transfer_count;
 };
 
 struct power_io_shield_emul_cfg {};
@@ -62,6 +64,18 @@ uint16_t power_io_shield_emul_get_u16_reg(const struct emul* target,
   return (data->reg[reg_addr + 1] << 8) | data->reg[reg_addr];
 }
 
+uint32_t power_io_shield_emul_get_transfer_count(const struct emul* target) {
+  struct power_io_shield_emul_data* data = target->data;
+
+  return (uint32_t)atomic_get(&data->transfer_count);
+}
+
+void power_io_shield_emul_reset_transfer_count(const struct emul* target) {
+  struct power_io_shield_emul_data* data = target->data;
+
+  atomic_clear(&data->transfer_count);
+}
+
 static int power_io_shield_emul_transfer_i2c(const struct emul* target,
                                              struct i2c_msg* msgs,
                                              int num_msgs,
@@ -70,6 +84,8 @@ static int power_io_shield_emul_transfer_i2c(const struct emul* target,
 
   i2c_dump_msgs_rw(target->dev, msgs, num_msgs, addr, false);
 
+  atomic_inc(&data->transfer_count);
+
   if (num_msgs < 1) {
     LOG_ERR("Invalid number of messages: %d", num_msgs);
     return -EIO;
@@ -124,6 +140,7 @@ static int power_io_shield_emul_init(const struct emul* target,
   struct power_io_shield_emul_data* data = target->data;
 
   memset(data->reg, 0, NUM_REGS);
+  atomic_clear(&data->transfer_count);
 
   return 0;
 }
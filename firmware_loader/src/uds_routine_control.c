@@ -19,6 +19,10 @@ LOG_MODULE_DECLARE(firmware_loader, CONFIG_APP_LOG_LEVEL);
 
 #include <ardep/uds.h>
 
+#define FLASH_BASE_ADDRESS DT_REG_ADDR(DT_CHOSEN(zephyr_flash))
+#define SLOT0_OFFSET FIXED_PARTITION_OFFSET(slot0_partition)
+#define SLOT0_SIZE FIXED_PARTITION_SIZE(slot0_partition)
+
 enum uds_memory_erasure_routine_state {
   UDS_MEMORY_ERASURE_STATE__NOT_STARTED = 0,
   UDS_MEMORY_ERASURE_STATE__IN_PROGRESS = 1,
@@ -30,8 +34,20 @@ struct uds_memory_erasure_routine_status {
   struct k_mutex *mutex;
   int32_t result;
   struct k_work_delayable work;
+  struct uds_flash_erase_job job;
 };
 
+/*
+ * Status record returned by RequestRoutineResults, all fields big endian.
+ * While the erase is in progress, result is
+ * UDS_NRC_RequestCorrectlyReceived_ResponsePending.
+ */
+struct uds_memory_erasure_routine_status_record {
+  int32_t result;
+  uint32_t erased_bytes;
+  uint32_t total_bytes;
+} __packed;
+
 K_MUTEX_DEFINE(memory_erasure_routine_mutex);
 
 static void erase_slot0_work_handler(struct k_work *work);
@@ -51,32 +67,32 @@ SYS_INIT(erase_memory_routine_init,
          APPLICATION,
          CONFIG_APPLICATION_INIT_PRIORITY);
 
+// Erases one sector per invocation, so other work items and threads can run
+// between the sectors
 static void erase_slot0_work_handler(struct k_work *work) {
   struct k_work_delayable *dwork = k_work_delayable_from_work(work);
   struct uds_memory_erasure_routine_status *status =
       CONTAINER_OF(dwork, struct uds_memory_erasure_routine_status, work);
 
-  const struct flash_area *fa;
-  int rc = flash_area_open(FIXED_PARTITION_ID(slot0_partition), &fa);
+  k_mutex_lock(status->mutex, K_FOREVER);
+  int rc = uds_flash_erase_job_step(&status->job);
+  k_mutex_unlock(status->mutex);
+
+  if (rc > 0) {
+    k_work_schedule(dwork, K_NO_WAIT);
+    return;
+  }
 
   int32_t result = UDS_OK;
 
   if (rc < 0) {
-    LOG_ERR("Failed to open slot0 partition: %d", rc);
+    LOG_ERR("Failed to erase slot0 partition: %d", rc);
     result = UDS_NRC_GeneralProgrammingFailure;
   } else {
-    LOG_INF("Erasing slot0 partition at 0x%08x, size: %zu bytes",
-            (uint32_t)fa->fa_off, fa->fa_size);
-
-    rc = flash_area_erase(fa, 0, fa->fa_size);
-
-    if (rc < 0) {
-      LOG_ERR("Failed to erase slot0 partition: %d", rc);
-    } else {
-      LOG_INF("Successfully erased slot0 partition");
-    }
-
-    flash_area_close(fa);
+    LOG_INF("Successfully erased 0x%08lx to 0x%08lx",
+            status->job.start, status->job.end);
+    // the following download does not erase these sectors again
+    uds_download_use_erase_job(&status->job);
   }
 
   k_mutex_lock(status->mutex, K_FOREVER);
@@ -85,6 +101,57 @@ static void erase_slot0_work_handler(struct k_work *work) {
   k_mutex_unlock(status->mutex);
 }
 
+/*
+ * Reads the range to erase from the option record. The record is formatted
+ * like the memory location of RequestDownload: one addressAndLengthFormat byte
+ * followed by the address and the size. Without an option record the whole
+ * slot0 is erased.
+ */
+static UDSErr_t parse_erase_range(const UDSRoutineCtrlArgs_t *args,
+                                  uintptr_t *offset,
+                                  size_t *size) {
+  if (args->len == 0) {
+    *offset = SLOT0_OFFSET;
+    *size = SLOT0_SIZE;
+    return UDS_OK;
+  }
+
+  const uint8_t address_len = args->optionRecord[0] & 0x0F;
+  const uint8_t size_len = args->optionRecord[0] >> 4;
+
+  if (address_len == 0 || address_len > sizeof(uint32_t) || size_len == 0 ||
+      size_len > sizeof(uint32_t) || args->len != 1 + address_len + size_len) {
+    LOG_WRN("Invalid erase option record");
+    return UDS_NRC_IncorrectMessageLengthOrInvalidFormat;
+  }
+
+  uintptr_t address = 0;
+  for (uint8_t i = 0; i < address_len; i++) {
+    address = (address << 8) | args->optionRecord[1 + i];
+  }
+
+  size_t length = 0;
+  for (uint8_t i = 0; i < size_len; i++) {
+    length = (length << 8) | args->optionRecord[1 + address_len + i];
+  }
+
+  // normalize address to start at 0, not at the flash base address
+  if (address >= FLASH_BASE_ADDRESS) {
+    address -= FLASH_BASE_ADDRESS;
+  }
+
+  if (length == 0 || address < SLOT0_OFFSET ||
+      address + length > SLOT0_OFFSET + SLOT0_SIZE) {
+    LOG_WRN("Erase range 0x%08lx, size %zu is outside of slot0", address,
+            length);
+    return UDS_NRC_RequestOutOfRange;
+  }
+
+  *offset = address;
+  *size = length;
+  return UDS_OK;
+}
+
 UDSErr_t erase_memory_routine_check(const struct uds_context *const context,
                                     bool *apply_action) {
   UDSRoutineCtrlArgs_t *args = (UDSRoutineCtrlArgs_t *)context->arg;
@@ -101,8 +168,8 @@ UDSErr_t erase_memory_routine_check(const struct uds_context *const context,
   }
 
   if (args->ctrlType == UDS_ROUTINE_CONTROL__REQUEST_ROUTINE_RESULTS &&
-      status->state != UDS_MEMORY_ERASURE_STATE__COMPLETED) {
-    LOG_WRN("Memory erasure routine not completed yet");
+      status->state == UDS_MEMORY_ERASURE_STATE__NOT_STARTED) {
+    LOG_WRN("Memory erasure routine not started yet");
     *apply_action = false;
     return UDS_NRC_RequestSequenceError;
   }
@@ -136,11 +203,29 @@ UDSErr_t erase_memory_routine_action(struct uds_context *const context,
 
   switch (args->ctrlType) {
     case UDS_ROUTINE_CONTROL__START_ROUTINE: {
+      uintptr_t offset;
+      size_t size;
+      UDSErr_t err = parse_erase_range(args, &offset, &size);
+      if (err != UDS_OK) {
+        return err;
+      }
+
       k_mutex_lock(status->mutex, K_FOREVER);
-      status->state = UDS_MEMORY_ERASURE_STATE__IN_PROGRESS;
-      status->result = UDS_OK;
+      int rc = uds_flash_erase_job_init(&status->job, offset, size);
+      if (rc == 0) {
+        status->state = UDS_MEMORY_ERASURE_STATE__IN_PROGRESS;
+        status->result = UDS_OK;
+      }
       k_mutex_unlock(status->mutex);
 
+      if (rc != 0) {
+        LOG_ERR("Failed to prepare erase: %d", rc);
+        return UDS_NRC_ConditionsNotCorrect;
+      }
+
+      LOG_INF("Erasing 0x%08lx to 0x%08lx", status->job.start,
+              status->job.end);
+
 #ifdef CONFIG_DISABLE_WAIT_BEFORE_ERASE
       k_work_schedule(&status->work, K_NO_WAIT);
 #else
@@ -156,17 +241,27 @@ UDSErr_t erase_memory_routine_action(struct uds_context *const context,
       k_mutex_lock(status->mutex, K_FOREVER);
       enum uds_memory_erasure_routine_state current_state = status->state;
       int32_t result = status->result;
+      uint32_t erased_bytes = status->job.next - status->job.start;
+      uint32_t total_bytes = status->job.end - status->job.start;
       k_mutex_unlock(status->mutex);
 
-      if (current_state != UDS_MEMORY_ERASURE_STATE__COMPLETED) {
-        LOG_WRN("Memory erasure routine not completed yet");
+      if (current_state == UDS_MEMORY_ERASURE_STATE__NOT_STARTED) {
+        LOG_WRN("Memory erasure routine not started yet");
         return UDS_NRC_RequestSequenceError;
       }
-      LOG_INF("Memory erasure routine requested result: 0x%02x", result);
 
-      int32_t be_result = sys_cpu_to_be32(result);
-      return args->copyStatusRecord(context->server, &be_result,
-                                    sizeof(be_result));
+      if (current_state == UDS_MEMORY_ERASURE_STATE__IN_PROGRESS) {
+        result = UDS_NRC_RequestCorrectlyReceived_ResponsePending;
+      }
+      LOG_INF("Memory erasure routine requested result: 0x%02x (%u/%u bytes)",
+              result, erased_bytes, total_bytes);
+
+      struct uds_memory_erasure_routine_status_record record = {
+        .result = sys_cpu_to_be32(result),
+        .erased_bytes = sys_cpu_to_be32(erased_bytes),
+        .total_bytes = sys_cpu_to_be32(total_bytes),
+      };
+      return args->copyStatusRecord(context->server, &record, sizeof(record));
     }
     default:
       LOG_WRN("Unsupported control type: 0x%02x", args->ctrlType);
@@ -180,3 +275,6 @@ UDS_REGISTER_ROUTINE_CONTROL_HANDLER(&uds_default_instance,
                                      erase_memory_routine_check,
                                      erase_memory_routine_action,
                                      &erasure_status);
+
+UDS_REGISTER_CHECK_PROGRAMMING_DEPENDENCIES_DEFAULT_HANDLER(
+    &uds_default_instance)
@@ -0,0 +1,250 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (C) Frickly Systems GmbH
+ * SPDX-FileCopyrightText: Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef ARDEP_INCLUDE_ADC_STREAM_H_
+#define ARDEP_INCLUDE_ADC_STREAM_H_
+
+#include <stdint.h>
+
+#include <zephyr/drivers/adc.h>
+#include <zephyr/kernel.h>
+#include <zephyr/spinlock.h>
+#include <zephyr/sys/atomic.h>
+
+#ifdef CONFIG_ADC_STREAM_FILE
+#include <zephyr/fs/fs.h>
+#endif
+
+/**
+ * @brief Filter applied to the scans before they are decimated
+ */
+enum adc_stream_filter {
+  /** Every scan is stored, the decimation has to be 1 */
+  ADC_STREAM_FILTER_NONE,
+  /** Stores the average of `decimation` consecutive scans */
+  ADC_STREAM_FILTER_MOVING_AVERAGE,
+  /** Cascaded integrator-comb filter of order `cic_order` */
+  ADC_STREAM_FILTER_CIC,
+};
+
+/**
+ * @brief Configuration of an ADC stream
+ */
+struct adc_stream_config {
+  /** Channels of the scan, all on the same ADC with the same resolution */
+  const struct adc_dt_spec *channels;
+  uint8_t channel_count;
+  /** Time between the start of two scans */
+  uint32_t interval_us;
+  enum adc_stream_filter filter;
+  /** Number of scans per stored scan */
+  uint16_t decimation;
+  /** Order of the CIC filter, ignored by the other filters */
+  uint8_t cic_order;
+};
+
+/**
+ * @brief Block of scans handed out to a consumer
+ *
+ * The samples are stored scan after scan. Within a scan, they are ordered by
+ * channel ID like the ADC driver stores them, in the raw format of the
+ * driver.
+ */
+struct adc_stream_block {
+  const uint16_t *data;
+  /** Number of scans in the block */
+  uint16_t scans;
+  /** Number of samples per scan */
+  uint8_t channels;
+  /** Counts all completed blocks, gaps are dropped blocks */
+  uint32_t sequence;
+  /** Index of the block in the ring */
+  uint16_t index;
+};
+
+/**
+ * @brief Statistics of an ADC stream since it was started
+ */
+struct adc_stream_stats {
+  /** Scans read from the ADC */
+  uint32_t scans;
+  /** Completed blocks, including dropped blocks */
+  uint32_t blocks;
+  /** Blocks overwritten because no block of the ring was free */
+  uint32_t dropped_blocks;
+};
+
+/**
+ * @brief An ADC stream, define it with ADC_STREAM_DEFINE()
+ *
+ * All members are internal.
+ */
+struct adc_stream {
+  uint16_t *const buffer;
+  uint32_t *const block_sequence;
+  const uint16_t block_count;
+  const uint16_t block_scans;
+  const uint8_t max_channels;
+
+  struct adc_stream_config config;
+  struct adc_sequence sequence;
+  struct adc_sequence_options options;
+  struct k_poll_signal done;
+  atomic_t stopping;
+  bool running;
+
+  // Samples of the scan the ADC driver writes to
+  uint16_t scan[CONFIG_ADC_STREAM_MAX_CHANNELS];
+  // Decimation filter state
+  int32_t integrator[CONFIG_ADC_STREAM_MAX_CHANNELS]
+                    [CONFIG_ADC_STREAM_MAX_CIC_ORDER];
+  int32_t comb[CONFIG_ADC_STREAM_MAX_CHANNELS][CONFIG_ADC_STREAM_MAX_CIC_ORDER];
+  uint32_t differential;
+  uint16_t phase;
+  uint8_t order;
+  uint8_t gain_shift;
+  uint32_t gain;
+
+  // Ring of blocks, protected by the lock
+  struct k_spinlock lock;
+  struct k_sem filled;
+  uint16_t write_block;
+  uint16_t write_scan;
+  // Oldest block not released by the consumer
+  uint16_t read_block;
+  // Completed blocks not released by the consumer
+  uint16_t filled_count;
+  // Completed blocks handed out to the consumer
+  uint16_t handed_out;
+  uint32_t next_sequence;
+  struct adc_stream_stats stats;
+};
+
+/**
+ * @brief Define an ADC stream with a ring of blocks
+ *
+ * With two blocks, the stream is double buffered: the ADC writes one block
+ * while the consumer holds the other one.
+ *
+ * @param _name Name of the stream variable
+ * @param _max_channels Maximum number of channels per scan
+ * @param _block_scans Number of (decimated) scans per block
+ * @param _block_count Number of blocks in the ring, at least 2
+ */
+#define ADC_STREAM_DEFINE(_name, _max_channels, _block_scans, _block_count) \
+  BUILD_ASSERT((_block_count) >= 2, "An ADC stream needs at least 2 blocks"); \
+  BUILD_ASSERT((_max_channels) <= CONFIG_ADC_STREAM_MAX_CHANNELS,            \
+               "Too many channels for CONFIG_ADC_STREAM_MAX_CHANNELS");     \
+  static uint16_t                                                           \
+      _name##_buffer[(_block_count) * (_block_scans) * (_max_channels)];    \
+  static uint32_t _name##_block_sequence[_block_count];                     \
+  static struct adc_stream _name = {                                        \
+    .buffer = _name##_buffer,                                               \
+    .block_sequence = _name##_block_sequence,                               \
+    .block_count = (_block_count),                                          \
+    .block_scans = (_block_scans),                                          \
+    .max_channels = (_max_channels),                                        \
+  }
+
+/**
+ * @brief Set up the channels and start scanning continuously
+ *
+ * @param stream The stream
+ * @param config The configuration, copied by the stream
+ * @retval 0 if successful
+ * @retval -EALREADY if the stream is already running
+ * @retval -EINVAL if the configuration is invalid, e.g. the CIC filter would
+ * overflow
+ * @retval <0 error code of the ADC driver
+ */
+int adc_stream_start(struct adc_stream *stream,
+                     const struct adc_stream_config *config);
+
+/**
+ * @brief Stop scanning
+ *
+ * Completed blocks can still be taken from the stream afterwards.
+ *
+ * @param stream The stream
+ * @retval 0 if successful
+ * @retval -EALREADY if the stream is not running
+ * @retval -ETIMEDOUT if the ADC did not complete the sequence
+ */
+int adc_stream_stop(struct adc_stream *stream);
+
+/**
+ * @brief Take the oldest completed block from the ring
+ *
+ * The block points into the ring and stays valid until it is released.
+ *
+ * @param stream The stream
+ * @param block Set to the block
+ * @param timeout Time to wait for a completed block
+ * @retval 0 if successful
+ * @retval -EAGAIN if no block was completed in time
+ */
+int adc_stream_get_block(struct adc_stream *stream,
+                         struct adc_stream_block *block,
+                         k_timeout_t timeout);
+
+/**
+ * @brief Return a block to the ring
+ *
+ * Blocks have to be released in the order they were taken.
+ *
+ * @param stream The stream
+ * @param block The block taken with adc_stream_get_block()
+ * @retval 0 if successful
+ * @retval -EINVAL if the block is not the oldest one taken
+ */
+int adc_stream_release_block(struct adc_stream *stream,
+                             const struct adc_stream_block *block);
+
+/**
+ * @brief Get the statistics of the stream
+ */
+void adc_stream_get_stats(struct adc_stream *stream,
+                          struct adc_stream_stats *stats);
+
+#ifdef CONFIG_ADC_STREAM_CAN
+/**
+ * @brief Send a block as CAN frames
+ *
+ * The first frame holds the block header: the sequence (32 bit), the number
+ * of scans (16 bit) and the number of channels (8 bit). The following frames
+ * hold the samples. All values are little endian.
+ *
+ * @param can_dev The CAN device
+ * @param can_id The CAN ID of all frames
+ * @param block The block
+ * @param timeout Time to wait for a free TX mailbox per frame
+ * @retval 0 if successful
+ * @retval <0 error code of can_send()
+ */
+int adc_stream_publish_can(const struct device *can_dev,
+                           uint32_t can_id,
+                           const struct adc_stream_block *block,
+                           k_timeout_t timeout);
+#endif  // CONFIG_ADC_STREAM_CAN
+
+#ifdef CONFIG_ADC_STREAM_FILE
+/**
+ * @brief Append a block to a file
+ *
+ * The block is written with the header of adc_stream_publish_can(). The file
+ * can be read by a tester with UDS RequestFileTransfer (0x38).
+ *
+ * @param file The file, opened for writing
+ * @param block The block
+ * @retval 0 if successful
+ * @retval <0 error code of fs_write()
+ */
+int adc_stream_publish_file(struct fs_file_t *file,
+                            const struct adc_stream_block *block);
+#endif  // CONFIG_ADC_STREAM_FILE
+
+#endif  // ARDEP_INCLUDE_ADC_STREAM_H_
@@ -0,0 +1,193 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (C) Frickly Systems GmbH
+ * SPDX-FileCopyrightText: Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef ARDEP_INCLUDE_CAN_GATE_H_
+#define ARDEP_INCLUDE_CAN_GATE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <zephyr/device.h>
+#include <zephyr/drivers/can.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/iterable_sections.h>
+#include <zephyr/sys/util.h>
+
+/**
+ * @brief Message classes of the application traffic
+ *
+ * The values are bits, matching the lower bits of the communicationType of
+ * UDS CommunicationControl (0x28).
+ */
+enum can_gate_class {
+  CAN_GATE_CLASS_NORMAL = BIT(0),
+  CAN_GATE_CLASS_NETWORK_MANAGEMENT = BIT(1),
+};
+
+#define CAN_GATE_CLASS_ALL \
+  (CAN_GATE_CLASS_NORMAL | CAN_GATE_CLASS_NETWORK_MANAGEMENT)
+
+// Bits of the disabled classes in `struct can_gate::disabled`
+#define CAN_GATE_RX_DISABLED(_classes) ((atomic_val_t)(_classes))
+#define CAN_GATE_TX_DISABLED(_classes) ((atomic_val_t)(_classes) << 2)
+
+/**
+ * @brief Gate between the applications and a CAN controller
+ *
+ * Applications send and receive through the gate instead of the CAN driver.
+ * Frames matching the network management filter belong to the network
+ * management class, all other frames to the normal class. Each class can be
+ * disabled per direction, e.g. by UDS CommunicationControl.
+ *
+ * Only frames passing the gate are affected, frames sent and received with
+ * the CAN driver directly are not. Diagnostic traffic must not pass the gate.
+ */
+struct can_gate {
+  const struct device *can_dev;
+  /** Subnet number 0x1 - 0xE used by CommunicationControl, 0 for none */
+  uint8_t subnet;
+  /** Frames of the network management class, NULL if there are none */
+  const struct can_filter *nm_filter;
+  /** Disabled directions and classes, see CAN_GATE_RX/TX_DISABLED */
+  atomic_t disabled;
+};
+
+/**
+ * @brief Receive filter added through a gate
+ *
+ * Holds the callback of the application while the filter is installed.
+ */
+struct can_gate_rx {
+  struct can_gate *gate;
+  can_rx_callback_t callback;
+  void *user_data;
+};
+
+/**
+ * @brief Define a gate for a CAN device
+ *
+ * @param _name Name of the gate
+ * @param _can_dev The CAN device, e.g. DEVICE_DT_GET(DT_CHOSEN(zephyr_canbus))
+ * @param _subnet Subnet number of the device, 0 for none
+ * @param _nm_filter Pointer to the filter of network management frames or
+ *                   NULL
+ */
+#define CAN_GATE_DEFINE(_name, _can_dev, _subnet, _nm_filter) \
+  STRUCT_SECTION_ITERABLE(can_gate, _name) = {                \
+    .can_dev = (_can_dev),                                    \
+    .subnet = (_subnet),                                      \
+    .nm_filter = (_nm_filter),                                \
+    .disabled = ATOMIC_INIT(0),                               \
+  }
+
+// note: the gates use iterable sections (see zephyr docs)
+
+/**
+ * @brief Get the class of a frame
+ */
+static inline enum can_gate_class can_gate_classify(
+    const struct can_gate *gate, const struct can_frame *frame) {
+  const struct can_filter *filter = gate->nm_filter;
+
+  if (filter != NULL &&
+      ((frame->flags & CAN_FRAME_IDE) != 0) ==
+          ((filter->flags & CAN_FILTER_IDE) != 0) &&
+      ((frame->id ^ filter->id) & filter->mask) == 0) {
+    return CAN_GATE_CLASS_NETWORK_MANAGEMENT;
+  }
+
+  return CAN_GATE_CLASS_NORMAL;
+}
+
+/**
+ * @brief Check whether a frame may be received by the applications
+ */
+static inline bool can_gate_rx_enabled(const struct can_gate *gate,
+                                       const struct can_frame *frame) {
+  const atomic_val_t disabled = atomic_get(&gate->disabled);
+
+  // fast path while all communication is enabled
+  if (disabled == 0) {
+    return true;
+  }
+
+  return (disabled & CAN_GATE_RX_DISABLED(can_gate_classify(gate, frame))) ==
+         0;
+}
+
+/**
+ * @brief Check whether a frame may be sent by the applications
+ */
+static inline bool can_gate_tx_enabled(const struct can_gate *gate,
+                                       const struct can_frame *frame) {
+  const atomic_val_t disabled = atomic_get(&gate->disabled);
+
+  if (disabled == 0) {
+    return true;
+  }
+
+  return (disabled & CAN_GATE_TX_DISABLED(can_gate_classify(gate, frame))) ==
+         0;
+}
+
+/**
+ * @brief Send a frame through the gate
+ *
+ * Same as can_send() while the class of the frame may be sent.
+ *
+ * @returns -ENETDOWN if transmission of the class is disabled, the callback
+ *          is not called
+ * @returns the result of can_send() otherwise
+ */
+int can_gate_send(struct can_gate *gate,
+                  const struct can_frame *frame,
+                  k_timeout_t timeout,
+                  can_tx_callback_t callback,
+                  void *user_data);
+
+/**
+ * @brief Add a receive filter through the gate
+ *
+ * Same as can_add_rx_filter(), but frames of disabled classes are dropped
+ * before the callback is called. @p rx has to stay valid until the filter is
+ * removed with can_remove_rx_filter().
+ *
+ * @returns the filter ID on success
+ * @returns a negative error code of can_add_rx_filter() on failure
+ */
+int can_gate_add_rx_filter(struct can_gate *gate,
+                           struct can_gate_rx *rx,
+                           can_rx_callback_t callback,
+                           void *user_data,
+                           const struct can_filter *filter);
+
+/**
+ * @brief Enable or disable the reception and transmission of classes
+ *
+ * @param gate The gate
+ * @param classes Bitmask of `enum can_gate_class`
+ * @param rx_enabled Whether frames of the classes may be received
+ * @param tx_enabled Whether frames of the classes may be sent
+ */
+void can_gate_set(struct can_gate *gate,
+                  uint8_t classes,
+                  bool rx_enabled,
+                  bool tx_enabled);
+
+/**
+ * @brief Get the gate of a CAN device
+ *
+ * @returns the first gate defined for @p can_dev, NULL if there is none
+ */
+struct can_gate *can_gate_get(const struct device *can_dev);
+
+/**
+ * @brief Enable the reception and transmission of all classes on all gates
+ */
+void can_gate_enable_all(void);
+
+#endif
@@ -8,8 +8,21 @@
 #ifndef ARDEP_INCLUDE_DRIVERS_BINARY_ENCODED_GPIO_H_
 #define ARDEP_INCLUDE_DRIVERS_BINARY_ENCODED_GPIO_H_
 
+#include <errno.h>
+
 #include <zephyr/device.h>
 
+/**
+ * @brief Called when the cached value changed
+ *
+ * @param device Pointer to the binary encoded GPIO device
+ * @param value New value or negative error code
+ * @param user_data User data given to binary_encoded_gpios_set_change_callback
+ */
+typedef void (*binary_encoded_gpio_change_cb_t)(const struct device *device,
+                                                int value,
+                                                void *user_data);
+
 __subsystem struct binary_encoded_gpio_driver_api {
   /**
    * @brief Get the current binary encoded GPIO value
@@ -18,11 +31,23 @@ __subsystem struct binary_encoded_gpio_driver_api {
    * @return int Current value or negative error code
    */
   int (*get_value)(const struct device *device);
+
+  /**
+   * @brief Set the callback for changes of the cached value
+   *
+   * Only available with CONFIG_BINARY_ENCODED_GPIO_CACHED
+   */
+  int (*set_change_callback)(const struct device *device,
+                             binary_encoded_gpio_change_cb_t cb,
+                             void *user_data);
 };
 
 /**
  * @brief Get the current binary encoded GPIO value
  *
+ * With CONFIG_BINARY_ENCODED_GPIO_CACHED, this returns the value sampled
+ * after the pins settled, without accessing the pins.
+ *
  * @param device Pointer to the binary encoded GPIO device
  * @return int Current value or negative error code
  */
@@ -34,6 +59,31 @@ static inline int z_impl_binary_encoded_gpios_get_value(
   return api->get_value(device);
 }
 
+/**
+ * @brief Set a callback for changes of the binary encoded GPIO value
+ *
+ * The callback is called from the system work queue once the pins settled on
+ * a new value. Replaces the previous callback, NULL removes it.
+ *
+ * @param device Pointer to the binary encoded GPIO device
+ * @param cb The callback
+ * @param user_data Passed to the callback
+ * @retval 0 if successful
+ * @retval -ENOSYS if CONFIG_BINARY_ENCODED_GPIO_CACHED is disabled
+ */
+static inline int binary_encoded_gpios_set_change_callback(
+    const struct device *device,
+    binary_encoded_gpio_change_cb_t cb,
+    void *user_data) {
+  const struct binary_encoded_gpio_driver_api *api = device->api;
+
+  if (api->set_change_callback == NULL) {
+    return -ENOSYS;
+  }
+
+  return api->set_change_callback(device, cb, user_data);
+}
+
 #include <syscalls/binary_encoded_gpio.h>
 
 #endif  // ARDEP_INCLUDE_DRIVERS_BINARY_ENCODED_GPIO_H_
@@ -0,0 +1,22 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (C) Frickly Systems GmbH
+ * SPDX-FileCopyrightText: Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdint.h>
+
+#include <zephyr/drivers/emul.h>
+
+// Get the output enable bits of the shift registers, bit n is hv gpio n
+uint32_t hv_shield_emul_get_gpio_output_enable(const struct emul* target);
+
+// Get the gain bits of DAC 0 or 1 from the shift registers
+uint8_t hv_shield_emul_get_dac_gain(const struct emul* target, uint8_t dac);
+
+// Get the number of SPI transfers handled since init or the last reset
+uint32_t hv_shield_emul_get_transfer_count(const struct emul* target);
+
+// Reset the SPI transfer counter
+void hv_shield_emul_reset_transfer_count(const struct emul* target);
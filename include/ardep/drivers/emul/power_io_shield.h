@@ -26,3 +26,9 @@ uint8_t power_io_shield_emul_get_reg(const struct emul* target,
 // Get 2 adjacent 8-Bit registers in little endian format
 uint16_t power_io_shield_emul_get_u16_reg(const struct emul* target,
                                           uint8_t reg_addr);
+
+// Get the number of I2C transfers handled since init or the last reset
+uint32_t power_io_shield_emul_get_transfer_count(const struct emul* target);
+
+// Reset the I2C transfer counter
+void power_io_shield_emul_reset_transfer_count(const struct emul* target);
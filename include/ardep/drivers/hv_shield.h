@@ -25,6 +25,11 @@ struct hv_shield_api_t {
   int (*set_gpio_output_enable)(const struct device* dev,
                                 uint8_t index,
                                 bool enable);
+  int (*set_gpio_output_enable_mask)(const struct device* dev,
+                                     uint32_t mask,
+                                     uint32_t enable);
+  int (*begin_update)(const struct device* dev);
+  int (*commit_update)(const struct device* dev);
 };
 
 /**
@@ -70,6 +75,59 @@ static int z_impl_hv_shield_set_gpio_output_enable(const struct device* dev,
   return api->set_gpio_output_enable(dev, index, enable);
 }
 
+/**
+ * @brief Set multiple hv gpios to either be inputs or outputs at once
+ *
+ * @param dev hv-shield device
+ * @param mask bit mask of the gpios to change
+ * @param enable bit mask with bits set for gpios that should be outputs and
+ * cleared for gpios that should be inputs, only bits in @p mask are used
+ * @retval 0 if successful
+ * @retval other if spi write failed
+ */
+__syscall int hv_shield_set_gpio_output_enable_mask(const struct device* dev,
+                                                    uint32_t mask,
+                                                    uint32_t enable);
+
+static int z_impl_hv_shield_set_gpio_output_enable_mask(
+    const struct device* dev, uint32_t mask, uint32_t enable) {
+  const struct hv_shield_api_t* api = dev->api;
+  return api->set_gpio_output_enable_mask(dev, mask, enable);
+}
+
+/**
+ * @brief Start an update of the shield registers
+ *
+ * Changes made after this call are only written to the shield by
+ * hv_shield_commit_update(), in a single spi transfer. Updates can be nested,
+ * only the outermost commit writes the registers.
+ *
+ * @param dev hv-shield device
+ * @retval 0 if successful
+ * @retval -EOVERFLOW if too many updates are open
+ */
+__syscall int hv_shield_begin_update(const struct device* dev);
+
+static int z_impl_hv_shield_begin_update(const struct device* dev) {
+  const struct hv_shield_api_t* api = dev->api;
+  return api->begin_update(dev);
+}
+
+/**
+ * @brief Close an update started with hv_shield_begin_update()
+ *
+ * @param dev hv-shield device
+ * @retval 0 if successful
+ * @retval -EINVAL if no update is open
+ * @retval other if spi write failed
+ */
+__syscall int hv_shield_commit_update(const struct device* dev);
+
+static int z_impl_hv_shield_commit_update(const struct device* dev) {
+  const struct hv_shield_api_t* api = dev->api;
+  return api->commit_update(dev);
+}
+
 #include <syscalls/hv_shield.h>
 
 #endif
@@ -0,0 +1,161 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (C) Frickly Systems GmbH
+ * SPDX-FileCopyrightText: Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef ARDEP_INCLUDE_DRIVERS_HV_SHIELD_DAC_WAVEFORM_H_
+#define ARDEP_INCLUDE_DRIVERS_HV_SHIELD_DAC_WAVEFORM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zephyr/device.h>
+
+#include <ardep/drivers/hv_shield.h>
+
+#ifdef CONFIG_HV_SHIELD_DAC_WAVEFORM_UDS
+#include <ardep/uds.h>
+#endif
+
+/**
+ * @brief Precomputed samples played on one channel of the hv-shield-dac
+ */
+struct hv_shield_dac_waveform {
+  /** Raw DAC values, one per sample period */
+  const uint16_t* samples;
+  size_t sample_count;
+  /** Number of times the samples are played, 0 to play until stopped */
+  uint32_t cycles;
+  /** Gain of the channel while the waveform plays */
+  enum hv_shield_dac_gains_t gain;
+};
+
+/**
+ * @brief Set the waveform of a channel
+ *
+ * The samples are not copied and have to stay valid while they are played.
+ *
+ * @param dev hv-shield-dac device
+ * @param channel channel of the hv-shield-dac
+ * @param waveform the waveform, NULL to leave the channel untouched on start
+ * @retval 0 if successful
+ * @retval -EINVAL if the channel or waveform is invalid
+ * @retval -EBUSY if waveforms are playing
+ */
+int hv_shield_dac_waveform_set(const struct device* dev,
+                               uint8_t channel,
+                               const struct hv_shield_dac_waveform* waveform);
+
+/**
+ * @brief Start playing the waveforms of all channels at once
+ *
+ * The gains of all channels are written in a single shield update, then the
+ * first sample of every channel is written. Every following sample period,
+ * all channels advance by one sample. A counter given by the
+ * `waveform-counter` property paces the samples, a k_timer otherwise.
+ *
+ * Playback stops by itself once every channel played its cycles.
+ *
+ * @param dev hv-shield-dac device
+ * @param sample_rate samples per second and channel
+ * @retval 0 if successful
+ * @retval -EALREADY if waveforms are playing
+ * @retval -ENODATA if no channel has a waveform
+ * @retval -EINVAL if the sample rate is not supported by the timer or counter
+ * @retval other if setting the gain or writing the first sample failed
+ */
+int hv_shield_dac_waveform_start(const struct device* dev,
+                                 uint32_t sample_rate);
+
+/**
+ * @brief Stop playing the waveforms
+ *
+ * The channels keep the last written value and the gain of the waveform.
+ *
+ * @param dev hv-shield-dac device
+ * @retval 0 if successful
+ * @retval -EALREADY if no waveforms are playing
+ */
+int hv_shield_dac_waveform_stop(const struct device* dev);
+
+/**
+ * @brief Check if waveforms are playing
+ *
+ * @param dev hv-shield-dac device
+ */
+bool hv_shield_dac_waveform_is_running(const struct device* dev);
+
+/**
+ * @brief Fill a table with one period of a sine
+ *
+ * @param samples the table
+ * @param count number of samples in the table
+ * @param offset value of the zero crossings
+ * @param amplitude distance of the peaks from @p offset
+ */
+void hv_shield_dac_waveform_sine(uint16_t* samples,
+                                 size_t count,
+                                 uint16_t offset,
+                                 uint16_t amplitude);
+
+/**
+ * @brief Fill a table with a linear ramp
+ *
+ * @param samples the table
+ * @param count number of samples in the table
+ * @param from value of the first sample
+ * @param to value of the last sample
+ */
+void hv_shield_dac_waveform_ramp(uint16_t* samples,
+                                 size_t count,
+                                 uint16_t from,
+                                 uint16_t to);
+
+#ifdef CONFIG_HV_SHIELD_DAC_WAVEFORM_UDS
+/**
+ * @brief Check function of the waveform routine handler
+ */
+UDSErr_t hv_shield_dac_waveform_uds_check(
+    const struct uds_context* const context, bool* apply_action);
+
+/**
+ * @brief Action function of the waveform routine handler
+ *
+ * Start takes the sample rate (32 bit big endian) as option record. Stop ends
+ * the playback. The routine results are the running state (1 byte) followed
+ * by the sample rate (32 bit big endian).
+ */
+UDSErr_t hv_shield_dac_waveform_uds_action(struct uds_context* const context,
+                                           bool* consume_event);
+
+// clang-format off
+
+/**
+ * @brief Register a routine that controls the waveforms of a hv-shield-dac
+ *
+ * The waveforms of the channels are set by the application with
+ * hv_shield_dac_waveform_set().
+ *
+ * @param _instance Pointer to associated the UDS server instance
+ * @param _routine_id The routine ID
+ * @param _dac The hv-shield-dac device
+ */
+#define UDS_REGISTER_HV_SHIELD_DAC_WAVEFORM_HANDLER(                           \
+  _instance,                                                                   \
+  _routine_id,                                                                 \
+  _dac                                                                         \
+)                                                                              \
+  UDS_REGISTER_ROUTINE_CONTROL_HANDLER(                                        \
+    _instance,                                                                 \
+    _routine_id,                                                               \
+    hv_shield_dac_waveform_uds_check,                                          \
+    hv_shield_dac_waveform_uds_action,                                         \
+    (void*)(_dac)                                                              \
+  )
+
+// clang-format on
+#endif  // CONFIG_HV_SHIELD_DAC_WAVEFORM_UDS
+
+#endif  // ARDEP_INCLUDE_DRIVERS_HV_SHIELD_DAC_WAVEFORM_H_
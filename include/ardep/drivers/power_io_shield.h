@@ -0,0 +1,146 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (C) Frickly Systems GmbH
+ * SPDX-FileCopyrightText: Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef ARDEP_INCLUDE_DRIVERS_POWER_IO_SHIELD_H_
+#define ARDEP_INCLUDE_DRIVERS_POWER_IO_SHIELD_H_
+
+#include <stdint.h>
+
+#include <zephyr/device.h>
+#include <zephyr/drivers/gpio.h>
+
+/**
+ * @brief Timing of a bulk access to multiple shields
+ */
+struct power_io_shield_bulk_timing {
+  /** Duration of the whole call including waiting for the shields */
+  uint32_t total_us;
+  /** Time between the transfers of the first and the last shield */
+  uint32_t spread_us;
+};
+
+/**
+ * @brief Get the time of the interrupt whose callbacks are currently fired
+ *
+ * For edge interrupts this is the time the INT line of the shield was
+ * asserted, taken in the ISR. For repeated callbacks of an active level
+ * interrupt it is the time of the poll. Only meaningful when called from a
+ * gpio callback of the shield.
+ *
+ * @param dev power-io-shield device
+ * @return timestamp in ticks, see k_uptime_ticks()
+ */
+int64_t power_io_shield_get_event_timestamp(const struct device* dev);
+
+/**
+ * @brief Start a batch of output changes
+ *
+ * Output changes and output configurations made through the gpio api after
+ * this call are only applied to the shadow register of the shield. They are written in a single I2C
+ * transaction by power_io_shield_batch_commit(). Batches can be nested, only
+ * the outermost commit writes the outputs. Outputs set to the value they
+ * already have are not written at all.
+ *
+ * @param dev power-io-shield device
+ * @retval 0 if successful
+ * @retval -EOVERFLOW if too many batches are open
+ */
+int power_io_shield_batch_begin(const struct device* dev);
+
+/**
+ * @brief Close a batch started by power_io_shield_batch_begin()
+ *
+ * @param dev power-io-shield device
+ * @retval 0 if successful
+ * @retval -EINVAL if no batch is open
+ * @retval -EIO if writing the outputs failed
+ */
+int power_io_shield_batch_commit(const struct device* dev);
+
+/**
+ * @brief Write all pending output changes immediately
+ *
+ * @param dev power-io-shield device
+ * @retval 0 if successful
+ * @retval -EIO if writing the outputs failed
+ */
+int power_io_shield_flush(const struct device* dev);
+
+/**
+ * @brief Set the window in which output changes are combined into one write
+ *
+ * The first output change outside of a batch schedules a write of the outputs
+ * after @p window_us. All further changes within this window are written
+ * together. Defaults to CONFIG_POWER_IO_SHIELD_WRITE_COALESCING_WINDOW_US.
+ *
+ * @param dev power-io-shield device
+ * @param window_us coalescing window in microseconds, 0 writes every change
+ * immediately
+ * @retval 0 if successful
+ * @retval -EIO if writing pending outputs failed when disabling the window
+ */
+int power_io_shield_set_write_coalescing_window(const struct device* dev,
+                                                uint32_t window_us);
+
+/**
+ * @brief Set the maximum age of cached input values
+ *
+ * Reading the port within @p max_age_us after the last read returns the cached
+ * values without an I2C transaction. The cache is dropped on every interrupt
+ * of the shield. Defaults to CONFIG_POWER_IO_SHIELD_INPUT_CACHE_MAX_AGE_US.
+ *
+ * @param dev power-io-shield device
+ * @param max_age_us maximum age in microseconds, 0 disables the cache
+ * @retval 0 if successful
+ */
+int power_io_shield_set_input_cache_max_age(const struct device* dev,
+                                            uint32_t max_age_us);
+
+/**
+ * @brief Read the inputs and faults of multiple shields in one sequence
+ *
+ * All shields are locked first, then their GPIO registers are read back to
+ * back, so the snapshot is as consistent as the bus allows.
+ *
+ * @param devs power-io-shield devices, each listed at most once
+ * @param count number of devices
+ * @param values receives the raw port value of each device, as returned by
+ * gpio_port_get_raw()
+ * @param timing optional, receives the timing of the call
+ * @retval 0 if successful
+ * @retval -EINVAL if a device is listed more than once
+ * @retval -EIO if reading a shield failed
+ */
+int power_io_shield_bulk_read(const struct device* const* devs,
+                              size_t count,
+                              gpio_port_value_t* values,
+                              struct power_io_shield_bulk_timing* timing);
+
+/**
+ * @brief Set the outputs of multiple shields in one sequence
+ *
+ * All shields are locked and their shadow registers updated first, then the
+ * outputs are written back to back. Pending changes of open batches of these
+ * shields are written as well.
+ *
+ * @param devs power-io-shield devices, each listed at most once
+ * @param count number of devices
+ * @param masks raw port pins to change on each device
+ * @param values raw port values of each device, as for
+ * gpio_port_set_masked_raw()
+ * @param timing optional, receives the timing of the call
+ * @retval 0 if successful
+ * @retval -EINVAL if a device is listed more than once
+ * @retval -EIO if writing a shield failed
+ */
+int power_io_shield_bulk_write(const struct device* const* devs,
+                               size_t count,
+                               const gpio_port_pins_t* masks,
+                               const gpio_port_value_t* values,
+                               struct power_io_shield_bulk_timing* timing);
+
+#endif  // ARDEP_INCLUDE_DRIVERS_POWER_IO_SHIELD_H_
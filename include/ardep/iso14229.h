@@ -49,6 +49,17 @@ struct iso14229_zephyr_instance {
   char can_phys_buffer[sizeof(struct can_frame) * 25];
   char can_func_buffer[sizeof(struct can_frame) * 25];
 
+#ifdef CONFIG_ISO14229_FUNCTIONAL_FAST_PATH
+  /**
+   * @brief Set when a functional TesterPresent without response was received
+   */
+  atomic_t tester_present_pending;
+  /**
+   * @brief Reception time of the last functional TesterPresent in ms
+   */
+  atomic_t tester_present_ms;
+#endif  // CONFIG_ISO14229_FUNCTIONAL_FAST_PATH
+
   struct k_mutex event_callback_mutex;
   uds_callback event_callback;
 
@@ -14,6 +14,7 @@
 #include <wchar.h>
 
 #include <zephyr/sys/slist.h>
+#include <zephyr/sys/util.h>
 
 struct uds_instance_t;
 struct uds_registration_t;
@@ -101,6 +102,15 @@ enum uds_dynamically_define_data_ids_subfunc {
   UDS_DYNAMICALLY_DEFINED_DATA_IDS__CLEAR = 0x03,
 };
 
+enum uds_communication_control_subfunc {
+  UDS_COMMUNICATION_CONTROL__ENABLE_RX_AND_TX = 0x00,
+  UDS_COMMUNICATION_CONTROL__ENABLE_RX_AND_DISABLE_TX = 0x01,
+  UDS_COMMUNICATION_CONTROL__DISABLE_RX_AND_ENABLE_TX = 0x02,
+  UDS_COMMUNICATION_CONTROL__DISABLE_RX_AND_TX = 0x03,
+  UDS_COMMUNICATION_CONTROL__ENABLE_RX_AND_DISABLE_TX_ENHANCED_ADDRESS = 0x04,
+  UDS_COMMUNICATION_CONTROL__ENABLE_RX_AND_TX_ENHANCED_ADDRESS = 0x05,
+};
+
 enum uds_link_control_subfunc {
   UDS_LINK_CONTROL__VERIFY_MODE_TRANSITION_WITH_FIXED_PARAMETER = 0x01,
   UDS_LINK_CONTROL__VERIFY_MODE_TRANSITION_WITH_SPECIFIC_PARAMETER = 0x02,
@@ -340,6 +350,10 @@ struct uds_dynamically_defined_data {
     struct {
       void *memAddr;
       size_t memSize;
+      // map containing the memory, checked against the current session and
+      // security level on every read. NULL if the memory is read through the
+      // read memory by address handlers
+      const struct uds_memory_map *map;
     } memory;
   };
 };
@@ -437,6 +451,14 @@ struct uds_registration_t {
        * @brief Actor for *UDS_EVT_IOControl* events
        */
       struct uds_actor io_control;
+#ifdef CONFIG_UDS_DATA_ID_CACHE
+      /**
+       * @brief Maximum age of a cached read response in milliseconds
+       *
+       * 0 reads the data identifier with the read action on every request
+       */
+      uint32_t cache_max_age_ms;
+#endif  // CONFIG_UDS_DATA_ID_CACHE
     } data_identifier;
     /**
      * @brief Data for the Read/Write Memory by Address event handler
@@ -699,7 +721,7 @@ UDSErr_t uds_action_execute_scheduled_reset(struct uds_context *const context,
 /**
  * @brief Default check function for the default memory read handler
  *
- * Checks RAM and Flash memory for read access
+ * Checks the access against the memory map of `uds_memory_map_get_default()`
  */
 UDSErr_t uds_check_default_memory_by_addr_read(
     const struct uds_context *const context, bool *apply_action);
@@ -707,7 +729,8 @@ UDSErr_t uds_check_default_memory_by_addr_read(
 /**
  * @brief Default action function for the default memory read handler
  *
- * Reads from RAM and Flash
+ * Copies RAM and Flash directly into the response, peripheral registers of
+ * MMIO regions word by word
  */
 UDSErr_t uds_action_default_memory_by_addr_read(
     struct uds_context *const context, bool *consume_event);
@@ -715,7 +738,7 @@ UDSErr_t uds_action_default_memory_by_addr_read(
 /**
  * @brief Default check function for the default memory write handler
  *
- * Checks RAM and Flash memory for write access
+ * Checks the access against the memory map of `uds_memory_map_get_default()`
  */
 UDSErr_t uds_check_default_memory_by_addr_write(
     const struct uds_context *const context, bool *apply_action);
@@ -723,11 +746,112 @@ UDSErr_t uds_check_default_memory_by_addr_write(
 /**
  * @brief Default action function for the default memory write handler
  *
- * Writes to RAM and Flash
+ * Writes to RAM, peripheral registers of MMIO regions word by word
  */
 UDSErr_t uds_action_default_memory_by_addr_write(
     struct uds_context *const context, bool *consume_event);
 
+/** Memory of the region may be read */
+#define UDS_MEMORY_ACCESS_READ BIT(0)
+/** Memory of the region may be written */
+#define UDS_MEMORY_ACCESS_WRITE BIT(1)
+/** Peripheral registers, only accessed with aligned 32 bit words */
+#define UDS_MEMORY_ACCESS_MMIO BIT(2)
+
+/**
+ * @brief Address range with the access rights of the default memory handlers
+ */
+struct uds_memory_region {
+  uintptr_t start;
+  /** Last address of the region, so a region may end at the address limit */
+  uintptr_t end;
+  /** UDS_MEMORY_ACCESS_* flags, 0 for a region that can not be accessed */
+  uint8_t access;
+  /** Minimum security level to access the region */
+  uint8_t security_level;
+  /** Diagnostic sessions the region can be accessed in, any if empty */
+  const uint8_t *sessions;
+  size_t session_count;
+};
+
+/**
+ * @brief Sorted, non-overlapping regions that are searched with a binary
+ * search
+ */
+struct uds_memory_map {
+  struct uds_memory_region *regions;
+  size_t count;
+  size_t capacity;
+};
+
+/**
+ * @brief Build a memory map from possibly overlapping regions
+ *
+ * Where regions overlap, the smaller region takes precedence, so holes and
+ * peripheral windows can be declared within larger memories. Of regions with
+ * the same size, the later one takes precedence.
+ *
+ * @param map the map to initialize
+ * @param buffer storage of the map, @p count regions need at most
+ *               `2 * count` entries
+ * @param capacity number of entries in @p buffer
+ * @param regions the regions of the map
+ * @param count number of regions
+ * @retval 0 if successful
+ * @retval -EINVAL if a region ends before it starts
+ * @retval -ENOMEM if the buffer is too small
+ */
+int uds_memory_map_init(struct uds_memory_map *map,
+                        struct uds_memory_region *buffer,
+                        size_t capacity,
+                        const struct uds_memory_region *regions,
+                        size_t count);
+
+/**
+ * @brief Find the region that contains an address
+ *
+ * @returns the region or NULL if no region contains the address
+ */
+const struct uds_memory_region *uds_memory_map_find(
+    const struct uds_memory_map *map, uintptr_t addr);
+
+/**
+ * @brief Check an access to an address range against a memory map
+ *
+ * The range may span multiple adjacent regions, all of them must allow the
+ * access in the current session and security level of the server.
+ *
+ * @param map the memory map
+ * @param server the server with the current session and security level
+ * @param addr first address of the range
+ * @param size size of the range
+ * @param access UDS_MEMORY_ACCESS_READ or UDS_MEMORY_ACCESS_WRITE
+ * @param mmio set to `true` if a region of the range is an MMIO region, may be
+ *             NULL
+ * @retval UDS_OK if the access is allowed
+ * @retval UDS_NRC_RequestOutOfRange if the range is not covered by the map or
+ *         not accessible in the current session
+ * @retval UDS_NRC_SecurityAccessDenied if the security level is too low
+ */
+UDSErr_t uds_memory_map_check(const struct uds_memory_map *map,
+                              const UDSServer_t *server,
+                              uintptr_t addr,
+                              size_t size,
+                              uint8_t access,
+                              bool *mmio);
+
+/**
+ * @brief Get the memory map of the default memory handlers
+ *
+ * The map is generated from the devicetree: the chosen `zephyr,sram` and
+ * `zephyr,memory-region` nodes are read- and writeable, the chosen
+ * `zephyr,flash` is readable. `ardep,uds-memory-region` nodes add regions with
+ * their own access rights on top. On native_sim, the whole address space
+ * is read- and writeable before the `ardep,uds-memory-region` nodes are
+ * applied.
+ */
+const struct uds_memory_map *uds_memory_map_get_default(void);
+
 /**
  * @brief Default check function for the default dynamically define data IDs
  * handler
@@ -768,6 +892,745 @@ UDSErr_t uds_check_default_link_control_change_diag_session(
 UDSErr_t uds_action_default_link_control_change_diag_session(
     struct uds_context *const context, bool *consume_event);
 
+#ifdef CONFIG_CAN_GATE
+#include <ardep/can_gate.h>
+
+/**
+ * @brief Default check function for the default communication control handler
+ *
+ * Applies to the control types 0x00 - 0x03. Requests with enhanced address
+ * information are left to other handlers.
+ */
+UDSErr_t uds_check_default_communication_control(
+    const struct uds_context *const context, bool *apply_action);
+
+/**
+ * @brief Default action function for the default communication control
+ * handler
+ *
+ * Enables or disables the message classes of the communicationType on the
+ * CAN gates of the addressed subnets. Does not consume the event.
+ */
+UDSErr_t uds_action_default_communication_control(
+    struct uds_context *const context, bool *consume_event);
+
+/**
+ * @brief Default check function for diagnostic session events for the default
+ * communication control handler
+ */
+UDSErr_t uds_check_default_communication_control_change_diag_session(
+    const struct uds_context *const context, bool *apply_action);
+
+/**
+ * @brief Default action function for diagnostic session events for the default
+ * communication control handler
+ *
+ * Enables all communication when the default session is entered or the
+ * session times out.
+ */
+UDSErr_t uds_action_default_communication_control_change_diag_session(
+    struct uds_context *const context, bool *consume_event);
+#endif  // CONFIG_CAN_GATE
+
+/**
+ * @brief dataFormatIdentifier of RequestDownload for delta downloads
+ *
+ * The transferred data is a patch that turns the image currently stored at the
+ * download address into the new image. The memory size of the request is the
+ * size of the new image. All values of the patch are little endian:
+ *
+ * - header: UDS_DELTA_MAGIC, size and CRC32 of the old image, size of the new
+ *   image (4 bytes each)
+ * - followed by operations that produce the new image in order:
+ *   - UDS_DELTA_OP_COPY, length (4 bytes), offset in the old image (4 bytes)
+ *   - UDS_DELTA_OP_INSERT, length (4 bytes), followed by length bytes of data
+ *
+ * The patch is applied in place one flash sector at a time, so a copy must
+ * not read from sectors before the one currently being written.
+ */
+#define UDS_DATA_FORMAT_IDENTIFIER_DELTA 0x10
+#define UDS_DELTA_MAGIC 0x544C4441  // "ADLT"
+#define UDS_DELTA_OP_COPY 0x01
+#define UDS_DELTA_OP_INSERT 0x02
+
+#ifdef CONFIG_UDS_DOWNLOAD_DIGEST
+#ifdef CONFIG_UDS_DOWNLOAD_DIGEST_SHA256
+#define UDS_DOWNLOAD_DIGEST_SIZE 32
+#else
+#define UDS_DOWNLOAD_DIGEST_SIZE 4
+#endif
+
+/** Routine status record result if the expected digest matches */
+#define UDS_CHECK_PROGRAMMING_DEPENDENCIES_CORRECT 0x00
+/** Routine status record result if the expected digest does not match */
+#define UDS_CHECK_PROGRAMMING_DEPENDENCIES_INCORRECT 0x01
+
+/**
+ * @brief Get the digest over the data written by the last download
+ *
+ * The digest is computed while the data is transferred and is available after
+ * the download was exited with RequestTransferExit. A CRC32 digest is stored
+ * big endian.
+ *
+ * @param digest buffer for the digest
+ * @retval 0 if successful
+ * @retval -ENODATA if no download was finished since the last RequestDownload
+ */
+int uds_download_digest_get(uint8_t digest[UDS_DOWNLOAD_DIGEST_SIZE]);
+
+/**
+ * @brief Default check function for the default check programming dependencies
+ * routine handler
+ *
+ * The routine is only available in the programming session, otherwise
+ * UDS_NRC_RequestOutOfRange is returned.
+ */
+UDSErr_t uds_check_default_check_programming_dependencies(
+    const struct uds_context *const context, bool *apply_action);
+
+/**
+ * @brief Default action function for the default check programming
+ * dependencies routine handler
+ *
+ * Without an option record, the routine status record is the digest of the
+ * last download. With the expected digest as option record, it is one result
+ * byte (UDS_CHECK_PROGRAMMING_DEPENDENCIES_CORRECT or
+ * UDS_CHECK_PROGRAMMING_DEPENDENCIES_INCORRECT) followed by the digest.
+ */
+UDSErr_t uds_action_default_check_programming_dependencies(
+    struct uds_context *const context, bool *consume_event);
+#endif  // CONFIG_UDS_DOWNLOAD_DIGEST
+
+#ifdef CONFIG_UDS_SECURITY_ACCESS_SEED_POOL
+/**
+ * @brief Compute the key a tester has to send for a seed
+ *
+ * Called from the seed pool work queue, or while requestSeed is handled if
+ * the pool is empty.
+ *
+ * @param level the security level (requestSeed sub-function)
+ * @param seed the seed, CONFIG_UDS_SECURITY_ACCESS_SEED_SIZE bytes
+ * @param key the key, CONFIG_UDS_SECURITY_ACCESS_KEY_SIZE bytes
+ * @param user_data user data of the seed pool
+ * @retval 0 if successful
+ * @retval <0 if the key could not be computed, the seed is dropped
+ */
+typedef int (*uds_security_access_key_fn)(uint8_t level,
+                                          const uint8_t *seed,
+                                          uint8_t *key,
+                                          void *user_data);
+
+/**
+ * @brief Seed and the key expected for it
+ */
+struct uds_security_access_challenge {
+  uint8_t seed[CONFIG_UDS_SECURITY_ACCESS_SEED_SIZE];
+  uint8_t key[CONFIG_UDS_SECURITY_ACCESS_KEY_SIZE];
+};
+
+/**
+ * @brief Precomputed challenges and the attempt counter of a security level
+ *
+ * Defined by `UDS_REGISTER_SECURITY_ACCESS_SEED_POOL_HANDLER`.
+ */
+struct uds_security_access_pool {
+  uint8_t level;
+  uds_security_access_key_fn compute_key;
+  void *user_data;
+
+  struct k_spinlock lock;
+  struct uds_security_access_challenge
+      challenges[CONFIG_UDS_SECURITY_ACCESS_SEED_POOL_SIZE];
+  size_t head;
+  size_t count;
+
+  // challenge of the last requestSeed, until a key was sent
+  struct uds_security_access_challenge active;
+  bool seed_active;
+
+  uint8_t failed_attempts;
+  int64_t delay_end;
+};
+
+/**
+ * @brief Check function of the seed pool security access handler
+ */
+UDSErr_t uds_check_security_access_seed_pool_request_seed(
+    const struct uds_context *const context, bool *apply_action);
+
+/**
+ * @brief Action function of the seed pool security access handler
+ *
+ * Takes a precomputed seed from the pool. The pool is refilled in the
+ * background. Answers with a seed of zeros if the level is already unlocked.
+ */
+UDSErr_t uds_action_security_access_seed_pool_request_seed(
+    struct uds_context *const context, bool *consume_event);
+
+/**
+ * @brief Check function of the seed pool security access handler
+ */
+UDSErr_t uds_check_security_access_seed_pool_validate_key(
+    const struct uds_context *const context, bool *apply_action);
+
+/**
+ * @brief Action function of the seed pool security access handler
+ *
+ * Compares the key in constant time with the key precomputed for the last
+ * seed. After CONFIG_UDS_SECURITY_ACCESS_MAX_ATTEMPTS failed attempts, seeds
+ * are refused for CONFIG_UDS_SECURITY_ACCESS_DELAY_MS.
+ */
+UDSErr_t uds_action_security_access_seed_pool_validate_key(
+    struct uds_context *const context, bool *consume_event);
+
+/**
+ * @brief Key function that encrypts the seed with AES-128 in ECB mode
+ *
+ * Requires CONFIG_UDS_SECURITY_ACCESS_SEED_SIZE and
+ * CONFIG_UDS_SECURITY_ACCESS_KEY_SIZE to be 16.
+ *
+ * @param user_data the AES key, 16 bytes
+ */
+int uds_security_access_key_aes128(uint8_t level,
+                                   const uint8_t *seed,
+                                   uint8_t *key,
+                                   void *user_data);
+
+/**
+ * @brief Wait until all seed pools are full
+ *
+ * @param timeout maximum time to wait
+ * @retval 0 if all pools are full
+ * @retval -EAGAIN if the pools were not filled in time
+ */
+int uds_security_access_seed_pool_wait_full(k_timeout_t timeout);
+#endif  // CONFIG_UDS_SECURITY_ACCESS_SEED_POOL
+
+#ifdef CONFIG_UDS_AUTHENTICATION_ECDSA
+#include <psa/crypto.h>
+
+/** Size of the algorithm indicator of Authentication requests */
+#define UDS_AUTHENTICATION_ALGORITHM_INDICATOR_SIZE 16
+/** Size of an uncompressed P-256 public key */
+#define UDS_AUTHENTICATION_ECDSA_PUBLIC_KEY_SIZE 65
+/** Size of a raw P-256 signature (r and s) */
+#define UDS_AUTHENTICATION_ECDSA_SIGNATURE_SIZE 64
+#define UDS_AUTHENTICATION_ECDSA_CHALLENGE_SIZE 32
+#define UDS_AUTHENTICATION_ECDSA_SESSION_KEY_SIZE 32
+
+enum uds_authentication_ecdsa_state {
+  UDS_AUTHENTICATION_ECDSA_STATE__IDLE,
+  UDS_AUTHENTICATION_ECDSA_STATE__VERIFYING,
+  UDS_AUTHENTICATION_ECDSA_STATE__VERIFIED,
+};
+
+/**
+ * @brief Authentication with proof of ownership by an ECDSA P-256 signature
+ *
+ * Defined by `UDS_AUTHENTICATION_ECDSA_DEFINE`. The tester signs the challenge
+ * of requestChallengeForAuthentication with SHA-256 and sends the raw
+ * signature as proof of ownership with verifyProofOfOwnershipUnidirectional.
+ *
+ * The signature is verified in the authentication work queue, the UDS thread
+ * answers with responsePending meanwhile. The challenge and an ephemeral key
+ * pair for the next authentication are generated in the background. On
+ * success, the response carries the ephemeral public key as session key info
+ * and both sides derive `session_key` with ECDH from the ephemeral key and the
+ * tester key.
+ */
+struct uds_authentication_ecdsa {
+  /** Algorithm indicator the requests must carry */
+  const uint8_t *algorithm_indicator;
+  /** Uncompressed public key of the tester */
+  const uint8_t *tester_public_key;
+
+  /** Whether the tester is authenticated */
+  bool authenticated;
+  /** Shared secret of the authenticated tester */
+  uint8_t session_key[UDS_AUTHENTICATION_ECDSA_SESSION_KEY_SIZE];
+
+  struct k_work prepare_work;
+  struct k_work verify_work;
+  atomic_t state;
+
+  // Challenge and ephemeral key of the next authentication
+  atomic_t prepared;
+  atomic_t prepare_failed;
+  uint8_t next_challenge[UDS_AUTHENTICATION_ECDSA_CHALLENGE_SIZE];
+  psa_key_id_t next_ephemeral_key;
+  uint8_t next_ephemeral_public_key[UDS_AUTHENTICATION_ECDSA_PUBLIC_KEY_SIZE];
+
+  // Current authentication
+  bool challenge_active;
+  uint8_t challenge[UDS_AUTHENTICATION_ECDSA_CHALLENGE_SIZE];
+  psa_key_id_t ephemeral_key;
+  psa_key_id_t stale_ephemeral_key;
+  uint8_t ephemeral_public_key[UDS_AUTHENTICATION_ECDSA_PUBLIC_KEY_SIZE];
+  uint8_t signature[UDS_AUTHENTICATION_ECDSA_SIGNATURE_SIZE];
+  UDSErr_t result;
+};
+
+/**
+ * @brief Check function of the ECDSA authentication handler
+ *
+ * Applies to deAuthenticate, requestChallengeForAuthentication,
+ * verifyProofOfOwnershipUnidirectional and authentication timeouts.
+ */
+UDSErr_t uds_check_authentication_ecdsa(const struct uds_context *const context,
+                                        bool *apply_action);
+
+/**
+ * @brief Action function of the ECDSA authentication handler
+ */
+UDSErr_t uds_action_authentication_ecdsa(struct uds_context *const context,
+                                         bool *consume_event);
+#endif  // CONFIG_UDS_AUTHENTICATION_ECDSA
+
+#ifdef CONFIG_UDS_ASYNC_ROUTINES
+/**
+ * @brief State of an asynchronous routine, the first byte of its status
+ * record
+ */
+enum uds_async_routine_state {
+  UDS_ASYNC_ROUTINE_STATE__NOT_STARTED = 0x00,
+  /** Waiting for a worker or running, also while a stop is requested */
+  UDS_ASYNC_ROUTINE_STATE__RUNNING = 0x01,
+  UDS_ASYNC_ROUTINE_STATE__COMPLETED = 0x02,
+  UDS_ASYNC_ROUTINE_STATE__STOPPED = 0x03,
+  UDS_ASYNC_ROUTINE_STATE__FAILED = 0x04,
+};
+
+struct uds_async_routine;
+
+/**
+ * @brief Body of an asynchronous routine, runs on a routine worker
+ *
+ * Long running routines report their progress with
+ * `uds_async_routine_set_progress` and return early when
+ * `uds_async_routine_stop_requested` is true.
+ *
+ * @param routine The routine
+ * @param option_record Copy of the routineControlOptionRecord of the start
+ *                      request
+ * @param len Length of the option record
+ *
+ * @retval 0 if the routine completed or stopped on request
+ * @retval <0 if the routine failed
+ */
+typedef int (*uds_async_routine_start_fn)(struct uds_async_routine *routine,
+                                          const uint8_t *option_record,
+                                          size_t len);
+
+/**
+ * @brief Called on the UDS thread when a running routine is asked to stop
+ *
+ * `uds_async_routine_stop_requested` is already true. Wakes the routine if it
+ * waits, e.g. for a semaphore, so it can return early.
+ */
+typedef void (*uds_async_routine_stop_fn)(struct uds_async_routine *routine);
+
+/**
+ * @brief Writes the routine specific part of the status record
+ *
+ * Called on the UDS thread for RequestRoutineResults, also while the routine
+ * is running.
+ *
+ * @param routine The routine
+ * @param buf Buffer following the state and progress bytes
+ * @param size Size of the buffer
+ *
+ * @returns the number of bytes written
+ * @returns <0 on failure
+ */
+typedef int (*uds_async_routine_results_fn)(struct uds_async_routine *routine,
+                                            uint8_t *buf,
+                                            size_t size);
+
+/**
+ * @brief Routine that runs on the routine workers instead of the UDS thread
+ *
+ * Defined by `UDS_ASYNC_ROUTINE_DEFINE` and registered for a routine ID with
+ * `UDS_REGISTER_ASYNC_ROUTINE_HANDLER`. The framework owns the state machine:
+ *
+ * - startRoutine queues the routine for the next free worker, the response
+ *   carries the state
+ * - stopRoutine asks the routine to stop and calls the stop callback
+ * - requestRoutineResults answers with the state, the progress in percent and
+ *   the bytes of the results callback
+ *
+ * Up to CONFIG_UDS_ASYNC_ROUTINE_WORKERS routines run at the same time. Running
+ * routines are asked to stop when the session times out or the default
+ * session is entered.
+ */
+struct uds_async_routine {
+  /** Reserved for the queue of the workers */
+  void *fifo_reserved;
+
+  uds_async_routine_start_fn start;
+  uds_async_routine_stop_fn stop;
+  uds_async_routine_results_fn results;
+  void *user_data;
+
+  atomic_t state;
+  atomic_t progress;
+  atomic_t stop_requested;
+  /** Return value of the last run of the start callback */
+  int result;
+
+  uint8_t option_record[CONFIG_UDS_ASYNC_ROUTINE_OPTION_RECORD_SIZE];
+  size_t option_record_len;
+};
+
+/**
+ * @brief Report the progress of a running routine
+ *
+ * @param routine The routine
+ * @param percent Progress in percent, values above 100 are limited to 100
+ */
+void uds_async_routine_set_progress(struct uds_async_routine *routine,
+                                    uint8_t percent);
+
+/**
+ * @brief Whether stopRoutine was requested for the running routine
+ */
+bool uds_async_routine_stop_requested(const struct uds_async_routine *routine);
+
+/**
+ * @brief Check function of asynchronous routines that may be controlled in
+ * any session and security level
+ */
+UDSErr_t uds_check_async_routine(const struct uds_context *const context,
+                                 bool *apply_action);
+
+/**
+ * @brief Action function of the asynchronous routine handler
+ */
+UDSErr_t uds_action_async_routine(struct uds_context *const context,
+                                  bool *consume_event);
+#endif  // CONFIG_UDS_ASYNC_ROUTINES
+
+#ifdef CONFIG_UDS_DATA_ID_CACHE
+/**
+ * @brief Invalidate the cached read responses of a data identifier
+ *
+ * Writes and I/O controls of the data identifier invalidate its responses
+ * automatically, the owner calls this when the data changes otherwise.
+ *
+ * @param data_id The data identifier
+ */
+void uds_data_id_cache_invalidate(uint16_t data_id);
+
+/**
+ * @brief Invalidate all cached read responses
+ */
+void uds_data_id_cache_invalidate_all(void);
+#endif  // CONFIG_UDS_DATA_ID_CACHE
+
+/** DTC status bits as defined by ISO 14229-1 */
+#define UDS_DTC_STATUS_TEST_FAILED BIT(0)
+#define UDS_DTC_STATUS_TEST_FAILED_THIS_OPERATION_CYCLE BIT(1)
+#define UDS_DTC_STATUS_PENDING_DTC BIT(2)
+#define UDS_DTC_STATUS_CONFIRMED_DTC BIT(3)
+#define UDS_DTC_STATUS_TEST_NOT_COMPLETED_SINCE_LAST_CLEAR BIT(4)
+#define UDS_DTC_STATUS_TEST_FAILED_SINCE_LAST_CLEAR BIT(5)
+#define UDS_DTC_STATUS_TEST_NOT_COMPLETED_THIS_OPERATION_CYCLE BIT(6)
+#define UDS_DTC_STATUS_WARNING_INDICATOR_REQUESTED BIT(7)
+
+/** groupOfDTC of ClearDiagnosticInformation to clear all DTCs */
+#define UDS_DTC_GROUP_ALL 0xFFFFFF
+
+/** DTCSnapshotRecordNumber / DTCExtDataRecordNumber to read all records */
+#define UDS_DTC_RECORD_NUMBER_ALL 0xFF
+
+#ifdef CONFIG_UDS_DTC_MANAGER
+/**
+ * @brief Reset the DTC manager and load the DTCs from the persistent storage
+ *
+ * Called during system initialization. Calling it again discards all changes
+ * that were not yet written to the storage.
+ *
+ * @retval 0 if successful
+ * @retval <0 error code of the storage
+ */
+int uds_dtc_manager_init(void);
+
+/**
+ * @brief Register a DTC supported by the ECU
+ *
+ * A new DTC has not completed its tests since the last clear. Registering a
+ * DTC that is already known, e.g. because it was loaded from the storage, is
+ * not an error and keeps its state.
+ *
+ * @param dtc 3 byte DTC number
+ * @retval 0 if successful
+ * @retval -EINVAL if the DTC number exceeds 3 bytes
+ * @retval -ENOMEM if CONFIG_UDS_DTC_MANAGER_MAX_DTCS DTCs are registered
+ */
+int uds_dtc_register(uint32_t dtc);
+
+/**
+ * @brief Report the result of the test of a DTC
+ *
+ * A failed test sets the DTC pending and increments its occurrence counter if
+ * the test did not fail before. The DTC is confirmed once the occurrence
+ * counter reaches CONFIG_UDS_DTC_MANAGER_CONFIRMATION_THRESHOLD, by default at
+ * the first failure. A passed test clears testFailed.
+ *
+ * @param dtc the tested DTC
+ * @param failed whether the test failed
+ * @retval 0 if successful
+ * @retval -ENOENT if the DTC is not registered
+ */
+int uds_dtc_report(uint32_t dtc, bool failed);
+
+/**
+ * @brief Start a new operation cycle
+ *
+ * Clears pendingDTC of all DTCs whose tests completed without failure in the
+ * last operation cycle and resets the status bits of the operation cycle.
+ */
+void uds_dtc_start_operation_cycle(void);
+
+/**
+ * @brief Get the status and occurrence counter of a DTC
+ *
+ * @param dtc the DTC
+ * @param status the status byte, may be NULL
+ * @param occurrence_counter number of times the test started to fail since
+ *                           the last clear, may be NULL
+ * @retval 0 if successful
+ * @retval -ENOENT if the DTC is not registered
+ */
+int uds_dtc_get_status(uint32_t dtc,
+                       uint8_t *status,
+                       uint8_t *occurrence_counter);
+
+/**
+ * @brief Set the warningIndicatorRequested bit of a DTC
+ *
+ * @retval 0 if successful
+ * @retval -ENOENT if the DTC is not registered
+ */
+int uds_dtc_set_warning_indicator(uint32_t dtc, bool requested);
+
+/**
+ * @brief Count the DTCs with at least one of the status bits of a mask set
+ *
+ * @param status_mask mask of status bits, limited to the availability mask
+ */
+uint16_t uds_dtc_count_by_status_mask(uint8_t status_mask);
+
+/**
+ * @brief Store a snapshot record of a DTC
+ *
+ * A record with the same number of this DTC is replaced.
+ *
+ * @param dtc the DTC
+ * @param record_number DTCSnapshotRecordNumber, 0x01 to 0xFE
+ * @param data DTCSnapshotRecordNumberOfIdentifiers followed by the data
+ *             identifiers and their data
+ * @param len length of data
+ * @retval 0 if successful
+ * @retval -ENOENT if the DTC is not registered
+ * @retval -EINVAL if the record number or length is invalid
+ * @retval -ENOMEM if all snapshot records are used
+ */
+int uds_dtc_store_snapshot(uint32_t dtc,
+                           uint8_t record_number,
+                           const uint8_t *data,
+                           size_t len);
+
+/**
+ * @brief Store an extended data record of a DTC
+ *
+ * A record with the same number of this DTC is replaced.
+ *
+ * @param dtc the DTC
+ * @param record_number DTCExtDataRecordNumber, 0x01 to 0xFD
+ * @param data the record data
+ * @param len length of data
+ * @retval 0 if successful
+ * @retval -ENOENT if the DTC is not registered
+ * @retval -EINVAL if the record number or length is invalid
+ * @retval -ENOMEM if all extended data records are used
+ */
+int uds_dtc_store_extended_data(uint32_t dtc,
+                                uint8_t record_number,
+                                const uint8_t *data,
+                                size_t len);
+
+/**
+ * @brief Clear the status, counter and records of DTCs
+ *
+ * With CONFIG_UDS_DTC_MANAGER_PERSISTENCE, the clear is journaled before this
+ * returns and the cleared DTCs are stored in the background. A reset before
+ * they are stored applies the clear again when the DTCs are loaded.
+ *
+ * @param group UDS_DTC_GROUP_ALL or the number of a single DTC
+ * @retval 0 if successful
+ * @retval -ENOENT if the group is no registered DTC
+ * @retval -EBUSY if the journal is full, the previous clears are stored in the
+ * background and the clear can be tried again later
+ * @retval <0 error code of the storage if the journal could not be written
+ */
+int uds_dtc_clear(uint32_t group);
+
+/**
+ * @brief Write all pending changes to the storage now
+ *
+ * Call this before a reset. Without CONFIG_UDS_DTC_MANAGER_PERSISTENCE this
+ * does nothing.
+ *
+ * @retval 0 if successful
+ * @retval <0 error code of the storage
+ */
+int uds_dtc_manager_flush(void);
+
+/**
+ * @brief Default check function for the default read DTC information handler
+ */
+UDSErr_t uds_check_default_read_dtc_info(
+    const struct uds_context *const context, bool *apply_action);
+
+/**
+ * @brief Default action function for the default read DTC information handler
+ *
+ * Answers the sub-functions 0x01, 0x02, 0x04, 0x06 and 0x0A from the DTC
+ * manager
+ */
+UDSErr_t uds_action_default_read_dtc_info(struct uds_context *const context,
+                                          bool *consume_event);
+
+/**
+ * @brief Default check function for the default clear diagnostic information
+ * handler
+ */
+UDSErr_t uds_check_default_clear_diag_info(
+    const struct uds_context *const context, bool *apply_action);
+
+/**
+ * @brief Default action function for the default clear diagnostic information
+ * handler
+ *
+ * Clears all DTCs or a single DTC of the DTC manager
+ */
+UDSErr_t uds_action_default_clear_diag_info(struct uds_context *const context,
+                                            bool *consume_event);
+#endif  // CONFIG_UDS_DTC_MANAGER
+
+#if defined(CONFIG_UDS_UPLOAD_DOWNLOAD_MODULE) && defined(CONFIG_FLASH_PAGE_LAYOUT)
+/**
+ * @brief Erase of a flash range that is done one sector at a time
+ *
+ * All offsets are relative to the start of the flash, as for RequestDownload
+ */
+struct uds_flash_erase_job {
+  /** Start of the first sector to erase */
+  uintptr_t start;
+  /** Start of the next sector to erase */
+  uintptr_t next;
+  /** End of the last sector to erase */
+  uintptr_t end;
+};
+
+/**
+ * @brief Prepare erasing all sectors touched by a flash range
+ *
+ * @param job job to initialize
+ * @param offset start of the range, relative to the flash start
+ * @param size size of the range in bytes
+ * @retval 0 if successful
+ * @retval -ENODEV if the flash controller is not ready
+ * @retval -EINVAL if the range is empty or exceeds the flash
+ */
+int uds_flash_erase_job_init(struct uds_flash_erase_job *job,
+                             uintptr_t offset,
+                             size_t size);
+
+/**
+ * @brief Erase the next sector of an erase job
+ *
+ * @param job job initialized with uds_flash_erase_job_init()
+ * @retval 1 if a sector was erased and more sectors remain
+ * @retval 0 if the job is completed
+ * @retval <0 error code of the failed erase
+ */
+int uds_flash_erase_job_step(struct uds_flash_erase_job *job);
+
+/**
+ * @brief Let the next download skip the sectors erased by a job
+ *
+ * With `CONFIG_UDS_UPLOAD_DOWNLOAD_ERASE_AHEAD`, the next RequestDownload
+ * starting within the sectors erased so far by @p job does not erase them
+ * again. Call it after the job is done and before anything else writes into
+ * its range, the range is not checked again.
+ *
+ * @param job erase job, or NULL to forget a previously handed over job
+ */
+void uds_download_use_erase_job(const struct uds_flash_erase_job *job);
+#endif
+
+/** The response to the DiagnosticSessionControl request is still pending */
+#define UDS_FIRMWARE_LOADER_HANDOFF_RESPONSE_PENDING BIT(0)
+
+/**
+ * @brief Session state handed over from the application to the firmware loader
+ *
+ * Stored in the `zephyr,firmware-loader-args` retention area across the
+ * reboot, so the firmware loader can continue the session of the tester
+ * without a new request.
+ */
+struct uds_firmware_loader_handoff {
+  /** Diagnostic session to continue in */
+  uint8_t session_type;
+  /**
+   * Formerly the security level, which is not handed over. Security access is
+   * locked by the session change, and the retention area in RAM is no proof
+   * that the tester authenticated.
+   */
+  uint8_t reserved0;
+  /** UDS_FIRMWARE_LOADER_HANDOFF_* flags */
+  uint8_t flags;
+  uint8_t reserved;
+  /** P2 timing of the session, 0 to use the one of the firmware loader */
+  uint16_t p2_ms;
+  uint16_t reserved2;
+  /** P2* timing of the session */
+  uint32_t p2_star_ms;
+  /** CAN ID of the tester, 0 to use the one of the firmware loader */
+  uint32_t tester_address;
+};
+
+/**
+ * @brief Capture the session state of a DiagnosticSessionControl request
+ *
+ * @param context context of the `UDS_EVT_DiagSessCtrl` event
+ * @param handoff the captured state
+ * @retval 0 if successful
+ * @retval -EINVAL if the event is no DiagnosticSessionControl request
+ */
+int uds_firmware_loader_handoff_capture(
+    const struct uds_context *const context,
+    struct uds_firmware_loader_handoff *handoff);
+
+/**
+ * @brief Continue a session handed over by another firmware
+ *
+ * Restores the session and sends the pending positive response to the
+ * DiagnosticSessionControl request directly on the CAN bus. Security access
+ * stays locked, the tester unlocks it again in the new session.
+ * Should be called right after the CAN device was started and before the UDS
+ * thread is started, to answer the tester as early as possible.
+ *
+ * @param instance instance to continue the session on
+ * @param handoff session state captured by the other firmware
+ * @retval 0 if successful
+ * @retval <0 error code of sending the response
+ */
+int uds_firmware_loader_handoff_resume(
+    struct uds_instance_t *instance,
+    const struct uds_firmware_loader_handoff *handoff);
+
 #if DT_HAS_CHOSEN(zephyr_firmware_loader_args) && CONFIG_RETENTION_BOOT_MODE
 /**
  * @brief Switch into the firmware loader with an active programming session.
@@ -776,8 +1639,33 @@ UDSErr_t uds_action_default_link_control_change_diag_session(
  * @note This should only be used if firmware loading is enabled in the
  * bootloader and the uds firmware loader is flashed. Also note that this will
  * exit the main application and jump into the firmware loader
+ * @note Prefer `uds_switch_to_firmware_loader()`, which also hands over the
+ * timing and tester address of the session
  */
 UDSErr_t uds_switch_to_firmware_loader_with_programming_session();
+
+/**
+ * @brief Switch into the firmware loader and continue the requested session
+ * there
+ *
+ * Call this function in the diagnostic session control action. The session
+ * state is handed over to the firmware loader, which sends the response to the
+ * request right after it started.
+ *
+ * @param context context of the `UDS_EVT_DiagSessCtrl` event
+ * @note This will exit the main application and jump into the firmware loader
+ */
+UDSErr_t uds_switch_to_firmware_loader(const struct uds_context *const context);
+
+/**
+ * @brief Read and clear the session state handed over to the firmware loader
+ *
+ * @param handoff the handed over session state
+ * @retval 0 if a session was handed over
+ * @retval -ENODATA if no session was handed over
+ * @retval <0 other error code of the retention area
+ */
+int uds_firmware_loader_handoff_take(struct uds_firmware_loader_handoff *handoff);
 #endif
 
 // Include macro declarations after all types are defined
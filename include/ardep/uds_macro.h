@@ -24,6 +24,16 @@
   _UDS_CAT_4_EXP(__uds_registration##category##_, __COUNTER__, _l, __LINE__)
 #endif
 
+/*
+ * Defines a static registration in the ROM table of its registration type.
+ * lib/uds/iterables.ld places the tables one after another, so events only
+ * visit the registrations of their type. The name is expanded once, before it
+ * is used as variable and section name.
+ */
+#define _UDS_REGISTRATION(_table, _name) _UDS_REGISTRATION_NAMED(_table, _name)
+#define _UDS_REGISTRATION_NAMED(_table, _name) \
+  STRUCT_SECTION_ITERABLE_NAMED(uds_registration_t, _table##_##_name, _name)
+
 // #region READ_DTC_INFORMATION
 
 // clang-format off
@@ -44,7 +54,7 @@
   _subfunc_id,                                                                      \
   _user_context                                                                     \
 )                                                                                   \
-  STRUCT_SECTION_ITERABLE(uds_registration_t,                                       \
+  _UDS_REGISTRATION(read_dtc_info,                                                  \
       /* Use a counter to generate unique names for the iterable section */         \
         _UDS_CAT_EXPAND(__uds_registration_id_read_dtc_info, __COUNTER__)) = {      \
     .instance = _instance,                                                          \
@@ -289,6 +299,28 @@
       0x18, 0x19, 0x1A, 0x42, 0x55, 0x56                    \
 )
 
+/**
+ * @brief Register the default read dtc information event handler
+ *
+ * @details Answers the sub-functions supported by the DTC manager from its
+ *          DTCs, see `uds_action_default_read_dtc_info`.
+ *          Requires `CONFIG_UDS_DTC_MANAGER`
+ *
+ * @param _instance Pointer to associated the UDS server instance
+ */
+#define UDS_REGISTER_READ_DTC_INFO_DEFAULT_HANDLER(_instance)              \
+  UDS_REGISTER_READ_DTC_INFO_HANDLER_MANY(                                 \
+      _instance,                                                           \
+      uds_check_default_read_dtc_info,                                     \
+      uds_action_default_read_dtc_info,                                    \
+      NULL,                                                                \
+      UDS_READ_DTC_INFO_SUBFUNC__NUM_OF_DTC_BY_STATUS_MASK,                \
+      UDS_READ_DTC_INFO_SUBFUNC__DTC_BY_STATUS_MASK,                       \
+      UDS_READ_DTC_INFO_SUBFUNC__DTC_SNAPSHOT_RECORD_BY_DTC_NUM,           \
+      UDS_READ_DTC_INFO_SUBFUNC__DTC_EXT_DATA_RECORD_BY_DTC_NUM,           \
+      UDS_READ_DTC_INFO_SUBFUNC__SUPPORTED_DTC                             \
+  )
+
 // clang-format on
 
 // #endregion READ_DTC_INFORMATION
@@ -315,7 +347,7 @@
   _write,                                                                     \
   _user_context                                                               \
 )                                                                             \
-  STRUCT_SECTION_ITERABLE(uds_registration_t,                                 \
+  _UDS_REGISTRATION(memory,                                                   \
       /* Use a counter to generate unique names for the iterable section */   \
         _UDS_UNIQUE_REGISTRATION_NAME(memory)) = {                            \
     .instance = _instance,                                                    \
@@ -383,7 +415,7 @@
   _do_scheduled_reset,                                                        \
   _user_context                                                               \
 )                                                                             \
-  STRUCT_SECTION_ITERABLE(uds_registration_t,                                 \
+  _UDS_REGISTRATION(ecu_reset,                                                \
         _UDS_UNIQUE_REGISTRATION_NAME(ecu_reset)) = {                         \
     .instance = _instance,                                                    \
     .type = UDS_REGISTRATION_TYPE__ECU_RESET,                                 \
@@ -459,7 +491,7 @@
   _io_control,                                                        \
   _user_context                                                       \
 )                                                                     \
-  STRUCT_SECTION_ITERABLE(uds_registration_t,                         \
+  _UDS_REGISTRATION(data_identifier,                                  \
         _UDS_CAT_EXPAND(__uds_registration_id, _data_id)) = {         \
     .instance = _instance,                                            \
     .type = UDS_REGISTRATION_TYPE__DATA_IDENTIFIER,                   \
@@ -482,6 +514,59 @@
     },                                                                \
   };
 
+#ifdef CONFIG_UDS_DATA_ID_CACHE
+
+/**
+ * @brief Register a new static data identifier with cached read responses
+ * 
+ * Like `UDS_REGISTER_DATA_BY_IDENTIFIER_HANDLER`, but the response of `_read`
+ * is served from the cache for up to @p _max_age_ms milliseconds. `_read_check`
+ * is still called for every request.
+ *
+ * @param _max_age_ms Maximum age of a cached response in milliseconds
+ *
+ * @note: The cached response is invalidated by writes and I/O controls of the
+ *        data identifier, session changes and `uds_data_id_cache_invalidate`
+ */
+#define UDS_REGISTER_CACHED_DATA_BY_IDENTIFIER_HANDLER(               \
+  _instance,                                                          \
+  _data_id,                                                           \
+  _data_ptr,                                                          \
+  _read_check,                                                        \
+  _read,                                                              \
+  _write_check,                                                       \
+  _write,                                                             \
+  _io_control_check,                                                  \
+  _io_control,                                                        \
+  _user_context,                                                      \
+  _max_age_ms                                                         \
+)                                                                     \
+  _UDS_REGISTRATION(data_identifier,                                  \
+        _UDS_CAT_EXPAND(__uds_registration_id, _data_id)) = {         \
+    .instance = _instance,                                            \
+    .type = UDS_REGISTRATION_TYPE__DATA_IDENTIFIER,                   \
+    .data_identifier = {                                              \
+      .user_context = _user_context,                                  \
+      .data = _data_ptr,                                              \
+      .data_id = _data_id,                                            \
+      .read = {                                                       \
+        .check = _read_check,                                         \
+        .action = _read,                                              \
+      },                                                              \
+      .write = {                                                      \
+        .check = _write_check,                                        \
+        .action = _write,                                             \
+      },                                                              \
+      .io_control = {                                                 \
+        .check = _io_control_check,                                   \
+        .action = _io_control,                                        \
+      },                                                              \
+      .cache_max_age_ms = _max_age_ms,                                \
+    },                                                                \
+  };
+
+#endif  // CONFIG_UDS_DATA_ID_CACHE
+
 // clang-format on
 
 // #endregion READ_WRITE_BY_IDENTIFIER
@@ -509,7 +594,7 @@
   _session_timeout,                                                            \
   _user_context                                                                \
 )                                                                              \
-  STRUCT_SECTION_ITERABLE(uds_registration_t,                                  \
+  _UDS_REGISTRATION(diag_session_ctrl,                                         \
         _UDS_UNIQUE_REGISTRATION_NAME(diag_session)) = { \
     .instance = _instance,                                                     \
     .type = UDS_REGISTRATION_TYPE__DIAG_SESSION_CTRL,                          \
@@ -549,7 +634,7 @@
   _act,                                                                        \
   _user_context                                                                \
 )                                                                              \
-  STRUCT_SECTION_ITERABLE(uds_registration_t,                                  \
+  _UDS_REGISTRATION(clear_diag_info,                                           \
         _UDS_UNIQUE_REGISTRATION_NAME(clear_diag_info)) = {                    \
     .instance = _instance,                                                     \
     .type = UDS_REGISTRATION_TYPE__CLEAR_DIAG_INFO,                            \
@@ -562,6 +647,22 @@
     },                                                                         \
   };
 
+/**
+ * @brief Register the default clear diagnostic information event handler
+ *
+ * @details Clears the DTCs of the DTC manager.
+ *          Requires `CONFIG_UDS_DTC_MANAGER`
+ *
+ * @param _instance Pointer to associated the UDS server instance
+ */
+#define UDS_REGISTER_CLEAR_DIAG_INFO_DEFAULT_HANDLER(_instance)                \
+  UDS_REGISTER_CLEAR_DIAG_INFO_HANDLER(                                        \
+    _instance,                                                                 \
+    uds_check_default_clear_diag_info,                                         \
+    uds_action_default_clear_diag_info,                                        \
+    NULL                                                                       \
+  )
+
 // clang-format on
 
 // #endregion CLEAR_DIAGNOSTIC_INFORMATION
@@ -586,7 +687,7 @@
   _act,                                                                        \
   _user_context                                                                \
 )                                                                              \
-  STRUCT_SECTION_ITERABLE(uds_registration_t,                                  \
+  _UDS_REGISTRATION(routine_control,                                           \
         _UDS_UNIQUE_REGISTRATION_NAME(routine_control)) = {                    \
     .instance = _instance,                                                     \
     .type = UDS_REGISTRATION_TYPE__ROUTINE_CONTROL,                            \
@@ -600,6 +701,78 @@
     },                                                                         \
   };
 
+/**
+ * @brief Register the default CheckProgrammingDependencies routine (0xFF01)
+ *
+ * @details Reports or checks the digest over the data of the last download,
+ *          see `uds_action_default_check_programming_dependencies`.
+ *          Requires `CONFIG_UDS_DOWNLOAD_DIGEST`
+ *
+ * @param _instance Pointer to associated the UDS server instance
+ */
+#define UDS_REGISTER_CHECK_PROGRAMMING_DEPENDENCIES_DEFAULT_HANDLER(_instance) \
+  UDS_REGISTER_ROUTINE_CONTROL_HANDLER(                                        \
+    _instance,                                                                 \
+    UDS_IO_CONTROL__CHECK_PROGRAMMING_DEPENDENCIES,                            \
+    uds_check_default_check_programming_dependencies,                          \
+    uds_action_default_check_programming_dependencies,                         \
+    NULL                                                                       \
+  )
+
+#ifdef CONFIG_UDS_ASYNC_ROUTINES
+
+/**
+ * @brief Define an asynchronous routine
+ *
+ * @param _name Name of the `struct uds_async_routine`
+ * @param _start `uds_async_routine_start_fn` running the routine on a worker
+ * @param _stop Optional `uds_async_routine_stop_fn`, NULL if the routine only
+ *              polls `uds_async_routine_stop_requested`
+ * @param _results Optional `uds_async_routine_results_fn`
+ * @param _user_data User data of the callbacks
+ *
+ */
+#define UDS_ASYNC_ROUTINE_DEFINE(                                              \
+  _name,                                                                       \
+  _start,                                                                      \
+  _stop,                                                                       \
+  _results,                                                                    \
+  _user_data                                                                   \
+)                                                                              \
+  STRUCT_SECTION_ITERABLE(uds_async_routine, _name) = {                        \
+    .start = _start,                                                           \
+    .stop = _stop,                                                             \
+    .results = _results,                                                       \
+    .user_data = _user_data,                                                   \
+    .state = ATOMIC_INIT(UDS_ASYNC_ROUTINE_STATE__NOT_STARTED),                \
+  }
+
+/**
+ * @brief Register a routine control handler for an asynchronous routine
+ *
+ * @param _instance Pointer to associated the UDS server instance
+ * @param _routine_id The routine identifier
+ * @param _check Check if the routine may be controlled in the current session
+ *               and security level, `uds_check_async_routine` if it always may
+ * @param _routine Pointer to the routine defined by `UDS_ASYNC_ROUTINE_DEFINE`
+ *
+ */
+#define UDS_REGISTER_ASYNC_ROUTINE_HANDLER(                                    \
+  _instance,                                                                   \
+  _routine_id,                                                                 \
+  _check,                                                                      \
+  _routine                                                                     \
+)                                                                              \
+  UDS_REGISTER_ROUTINE_CONTROL_HANDLER(                                        \
+    _instance,                                                                 \
+    _routine_id,                                                               \
+    _check,                                                                    \
+    uds_action_async_routine,                                                  \
+    _routine                                                                   \
+  )
+
+#endif  // CONFIG_UDS_ASYNC_ROUTINES
+
 // clang-format on
 
 // #endregion ROUTINE_CONTROL
@@ -627,7 +800,7 @@
   _validate_key_act,                                                           \
   _user_context                                                                \
 )                                                                              \
-  STRUCT_SECTION_ITERABLE(uds_registration_t,                                  \
+  _UDS_REGISTRATION(security_access,                                           \
         _UDS_UNIQUE_REGISTRATION_NAME(security_access)) = {                    \
     .instance = _instance,                                                     \
     .type = UDS_REGISTRATION_TYPE__SECURITY_ACCESS,                            \
@@ -644,6 +817,60 @@
     },                                                                         \
   };
 
+#ifdef CONFIG_UDS_SECURITY_ACCESS_SEED_POOL
+
+/**
+ * @brief Register a security access handler with precomputed seeds
+ *
+ * Defines the seed pool of the security level. The seeds and keys are
+ * computed in the background, see `struct uds_security_access_pool`.
+ *
+ * @param _instance Pointer to associated the UDS server instance
+ * @param _level The security level, the requestSeed sub-function
+ * @param _compute_key `uds_security_access_key_fn` computing the expected keys
+ * @param _user_data User data passed to `_compute_key`
+ *
+ */
+#define UDS_REGISTER_SECURITY_ACCESS_SEED_POOL_HANDLER(                        \
+  _instance,                                                                   \
+  _level,                                                                      \
+  _compute_key,                                                                \
+  _user_data                                                                   \
+)                                                                              \
+  _UDS_SECURITY_ACCESS_SEED_POOL(                                              \
+    _instance,                                                                 \
+    _level,                                                                    \
+    _compute_key,                                                              \
+    _user_data,                                                                \
+    _UDS_UNIQUE_REGISTRATION_NAME(security_access_pool)                        \
+  )
+
+// The name is expanded once, before the pool is defined and referenced
+#define _UDS_SECURITY_ACCESS_SEED_POOL(...)                                    \
+  _UDS_SECURITY_ACCESS_SEED_POOL_NAMED(__VA_ARGS__)
+#define _UDS_SECURITY_ACCESS_SEED_POOL_NAMED(                                  \
+  _instance,                                                                   \
+  _level,                                                                      \
+  _compute_key,                                                                \
+  _user_data,                                                                  \
+  _name                                                                        \
+)                                                                              \
+  STRUCT_SECTION_ITERABLE(uds_security_access_pool, _name) = {                 \
+    .level = _level,                                                           \
+    .compute_key = _compute_key,                                               \
+    .user_data = _user_data,                                                   \
+  };                                                                           \
+  UDS_REGISTER_SECURITY_ACCESS_HANDLER(                                        \
+    _instance,                                                                 \
+    uds_check_security_access_seed_pool_request_seed,                          \
+    uds_action_security_access_seed_pool_request_seed,                         \
+    uds_check_security_access_seed_pool_validate_key,                          \
+    uds_action_security_access_seed_pool_validate_key,                         \
+    &_name                                                                     \
+  )
+
+#endif  // CONFIG_UDS_SECURITY_ACCESS_SEED_POOL
+
 // clang-format on
 
 // #endregion SECURITY_ACCESS
@@ -667,7 +894,7 @@
   _act,                                                                        \
   _user_context                                                                \
 )                                                                              \
-  STRUCT_SECTION_ITERABLE(uds_registration_t,                                  \
+  _UDS_REGISTRATION(communication_control,                                     \
         _UDS_UNIQUE_REGISTRATION_NAME(comm_ctrl)) = {                          \
     .instance = _instance,                                                     \
     .type = UDS_REGISTRATION_TYPE__COMMUNICATION_CONTROL,                      \
@@ -680,6 +907,40 @@
     },                                                                         \
   };
 
+#ifdef CONFIG_CAN_GATE
+
+/**
+ * @brief Register the default communication control event handler
+ *
+ * Enables and disables the application traffic on the CAN gates defined with
+ * CAN_GATE_DEFINE. All communication is enabled again when the default
+ * session is entered or the session times out.
+ *
+ * @param _instance Pointer to associated the UDS server instance
+ *
+ * @note The default handler requires handling of change diagnostic session
+ *       events so don't consume these events if you use this feature
+ */
+#define UDS_REGISTER_COMMUNICATION_CONTROL_DEFAULT_HANDLER(           \
+  _instance                                                           \
+)                                                                     \
+  UDS_REGISTER_COMMUNICATION_CONTROL_HANDLER(                         \
+    _instance,                                                        \
+    uds_check_default_communication_control,                          \
+    uds_action_default_communication_control,                         \
+    NULL                                                              \
+  )                                                                   \
+  UDS_REGISTER_DIAG_SESSION_CTRL_HANDLER(                             \
+    _instance,                                                        \
+    uds_check_default_communication_control_change_diag_session,      \
+    uds_action_default_communication_control_change_diag_session,     \
+    uds_check_default_communication_control_change_diag_session,      \
+    uds_action_default_communication_control_change_diag_session,     \
+    NULL                                                              \
+  )
+
+#endif  // CONFIG_CAN_GATE
+
 // clang-format on
 
 // #endregion COMMUNICATION_CONTROL
@@ -703,7 +964,7 @@
   _act,                                                                            \
   _user_context                                                                    \
 )                                                                                  \
-  STRUCT_SECTION_ITERABLE(uds_registration_t,                                      \
+  _UDS_REGISTRATION(control_dtc_setting,                                           \
         _UDS_UNIQUE_REGISTRATION_NAME(control_dtc_setting)) = {                    \
     .instance = _instance,                                                         \
     .type = UDS_REGISTRATION_TYPE__CONTROL_DTC_SETTING,                            \
@@ -739,7 +1000,7 @@
   _act,                                                                        \
   _user_context                                                                \
 )                                                                              \
-  STRUCT_SECTION_ITERABLE(uds_registration_t,                                  \
+  _UDS_REGISTRATION(dynamic_define_data_ids,                                   \
         _UDS_CAT_EXPAND(__uds_registration_dyn_data_ids_, __COUNTER__)) = {    \
     .instance = _instance,                                                     \
     .type = UDS_REGISTRATION_TYPE__DYNAMIC_DEFINE_DATA_IDS,                    \
@@ -798,7 +1059,7 @@
   _timeout_act,                                                                \
   _user_context                                                                \
 )                                                                              \
-  STRUCT_SECTION_ITERABLE(uds_registration_t,                                  \
+  _UDS_REGISTRATION(authentication,                                            \
         _UDS_UNIQUE_REGISTRATION_NAME(authentication)) = {                     \
     .instance = _instance,                                                     \
     .type = UDS_REGISTRATION_TYPE__AUTHENTICATION,                             \
@@ -815,6 +1076,45 @@
     },                                                                         \
   };
 
+#ifdef CONFIG_UDS_AUTHENTICATION_ECDSA
+
+/**
+ * @brief Define the state of an ECDSA authentication
+ *
+ * @param _name Name of the `struct uds_authentication_ecdsa`
+ * @param _algorithm_indicator The 16 byte algorithm indicator
+ * @param _tester_public_key The uncompressed P-256 public key of the tester
+ *
+ */
+#define UDS_AUTHENTICATION_ECDSA_DEFINE(                                       \
+  _name,                                                                       \
+  _algorithm_indicator,                                                        \
+  _tester_public_key                                                           \
+)                                                                              \
+  STRUCT_SECTION_ITERABLE(uds_authentication_ecdsa, _name) = {                 \
+    .algorithm_indicator = _algorithm_indicator,                               \
+    .tester_public_key = _tester_public_key,                                   \
+  }
+
+/**
+ * @brief Register an authentication handler with ECDSA proof of ownership
+ *
+ * @param _instance Pointer to associated the UDS server instance
+ * @param _auth Pointer to the state defined by `UDS_AUTHENTICATION_ECDSA_DEFINE`
+ *
+ */
+#define UDS_REGISTER_AUTHENTICATION_ECDSA_HANDLER(_instance, _auth)            \
+  UDS_REGISTER_AUTHENTICATION_HANDLER(                                         \
+    _instance,                                                                 \
+    uds_check_authentication_ecdsa,                                            \
+    uds_action_authentication_ecdsa,                                           \
+    uds_check_authentication_ecdsa,                                            \
+    uds_action_authentication_ecdsa,                                           \
+    _auth                                                                      \
+  )
+
+#endif  // CONFIG_UDS_AUTHENTICATION_ECDSA
+
 // clang-format on
 
 // #endregion Authentication
@@ -849,7 +1149,7 @@
   _act,                                                                        \
   _user_context                                                                \
 )                                                                              \
-  STRUCT_SECTION_ITERABLE(uds_registration_t,                                  \
+  _UDS_REGISTRATION(link_control,                                              \
         _UDS_CAT_EXPAND(__uds_registration_link_control_, __COUNTER__)) = {    \
     .instance = _instance,                                                     \
     .type = UDS_REGISTRATION_TYPE__LINK_CONTROL,                               \
@@ -0,0 +1,346 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (C) Frickly Systems GmbH
+ * SPDX-FileCopyrightText: Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(adc_stream, CONFIG_ADC_STREAM_LOG_LEVEL);
+
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/drivers/adc.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/util.h>
+
+#include <ardep/adc_stream.h>
+
+// Time the ADC gets to finish the running scan when the stream is stopped
+#define STOP_TIMEOUT_MS 100
+
+static uint16_t block_samples(const struct adc_stream *stream) {
+  return stream->block_scans * stream->config.channel_count;
+}
+
+static int configure_filter(struct adc_stream *stream,
+                            const struct adc_stream_config *config,
+                            uint8_t resolution) {
+  uint16_t decimation = config->decimation;
+
+  switch (config->filter) {
+    case ADC_STREAM_FILTER_NONE:
+      if (decimation != 1) {
+        LOG_ERR("Decimation without a filter");
+        return -EINVAL;
+      }
+      stream->order = 0;
+      break;
+    case ADC_STREAM_FILTER_MOVING_AVERAGE:
+      // An integrate-and-dump average is a CIC filter of order 1
+      stream->order = 1;
+      break;
+    case ADC_STREAM_FILTER_CIC:
+      stream->order = config->cic_order;
+      break;
+    default:
+      return -EINVAL;
+  }
+
+  if (decimation == 0 ||
+      stream->order > CONFIG_ADC_STREAM_MAX_CIC_ORDER ||
+      (config->filter == ADC_STREAM_FILTER_CIC && stream->order == 0)) {
+    return -EINVAL;
+  }
+
+  // The integrators wrap around, which the combs compensate as long as the
+  // output of the filter fits into them
+  if (resolution + stream->order * LOG2CEIL(decimation) > 31) {
+    LOG_ERR("CIC filter of order %u with decimation %u overflows",
+            stream->order, decimation);
+    return -EINVAL;
+  }
+
+  stream->gain = 1;
+  for (uint8_t i = 0; i < stream->order; i++) {
+    stream->gain *= decimation;
+  }
+  stream->gain_shift = LOG2CEIL(stream->gain);
+
+  return 0;
+}
+
+static void complete_block(struct adc_stream *stream) {
+  k_spinlock_key_t key = k_spin_lock(&stream->lock);
+
+  stream->block_sequence[stream->write_block] = stream->next_sequence++;
+  stream->stats.blocks++;
+
+  // One block is always written, so the ring is full with one block less
+  if (stream->filled_count < stream->block_count - 1) {
+    stream->filled_count++;
+    stream->write_block = (stream->write_block + 1) % stream->block_count;
+    k_sem_give(&stream->filled);
+  } else {
+    // The consumer is too slow, the block is written again
+    stream->stats.dropped_blocks++;
+  }
+  stream->write_scan = 0;
+
+  k_spin_unlock(&stream->lock, key);
+}
+
+static inline int32_t sample_value(const struct adc_stream *stream,
+                                   uint8_t channel) {
+  if ((stream->differential & BIT(channel)) != 0) {
+    return (int16_t)stream->scan[channel];
+  }
+
+  return stream->scan[channel];
+}
+
+// Runs the integrators at the scan rate and the combs at the output rate.
+// Returns whether an output scan was written.
+static bool decimate(struct adc_stream *stream, uint16_t *out) {
+  uint8_t channels = stream->config.channel_count;
+  uint8_t order = stream->order;
+
+  for (uint8_t ch = 0; ch < channels; ch++) {
+    int32_t *integrator = stream->integrator[ch];
+
+    // Wrap around on purpose, so the sums are unsigned
+    integrator[0] = (uint32_t)integrator[0] + sample_value(stream, ch);
+    for (uint8_t i = 1; i < order; i++) {
+      integrator[i] = (uint32_t)integrator[i] + integrator[i - 1];
+    }
+  }
+
+  if (++stream->phase < stream->config.decimation) {
+    return false;
+  }
+  stream->phase = 0;
+
+  for (uint8_t ch = 0; ch < channels; ch++) {
+    int32_t value = stream->integrator[ch][order - 1];
+    int32_t *comb = stream->comb[ch];
+
+    for (uint8_t i = 0; i < order; i++) {
+      int32_t delayed = comb[i];
+      comb[i] = value;
+      value = (uint32_t)value - delayed;
+    }
+
+    if (IS_POWER_OF_TWO(stream->gain)) {
+      value >>= stream->gain_shift;
+    } else {
+      value /= (int32_t)stream->gain;
+    }
+    out[ch] = (uint16_t)value;
+  }
+
+  return true;
+}
+
+// Called by the ADC driver after each scan, possibly from an ISR
+static enum adc_action on_scan(const struct device *dev,
+                               const struct adc_sequence *sequence,
+                               uint16_t sampling_index) {
+  struct adc_stream *stream = sequence->options->user_data;
+  ARG_UNUSED(dev);
+  ARG_UNUSED(sampling_index);
+
+  if (atomic_get(&stream->stopping)) {
+    return ADC_ACTION_FINISH;
+  }
+
+  stream->stats.scans++;
+
+  uint16_t *out = &stream->buffer[stream->write_block * block_samples(stream) +
+                                  stream->write_scan *
+                                      stream->config.channel_count];
+  if (stream->order == 0) {
+    memcpy(out, stream->scan,
+           stream->config.channel_count * sizeof(stream->scan[0]));
+  } else if (!decimate(stream, out)) {
+    return ADC_ACTION_REPEAT;
+  }
+
+  if (++stream->write_scan == stream->block_scans) {
+    complete_block(stream);
+  }
+
+  // Samples the next scan into the same buffer
+  return ADC_ACTION_REPEAT;
+}
+
+int adc_stream_start(struct adc_stream *stream,
+                     const struct adc_stream_config *config) {
+  if (stream->running) {
+    return -EALREADY;
+  }
+
+  if (config->channel_count == 0 ||
+      config->channel_count > stream->max_channels) {
+    LOG_ERR("Invalid number of channels: %u", config->channel_count);
+    return -EINVAL;
+  }
+
+  const struct adc_dt_spec *first = &config->channels[0];
+  uint32_t channels = 0;
+  stream->differential = 0;
+
+  for (uint8_t i = 0; i < config->channel_count; i++) {
+    const struct adc_dt_spec *spec = &config->channels[i];
+
+    if (spec->dev != first->dev || spec->resolution != first->resolution) {
+      LOG_ERR("All channels of a stream need the same ADC and resolution");
+      return -EINVAL;
+    }
+    if (!adc_is_ready_dt(spec)) {
+      LOG_ERR("ADC %s not ready", spec->dev->name);
+      return -ENODEV;
+    }
+
+    int ret = adc_channel_setup_dt(spec);
+    if (ret < 0) {
+      LOG_ERR("Could not set up channel %u: %d", spec->channel_id, ret);
+      return ret;
+    }
+
+    channels |= BIT(spec->channel_id);
+  }
+
+  // Samples are ordered by channel ID, the flags follow that order
+  for (uint8_t i = 0; i < config->channel_count; i++) {
+    const struct adc_dt_spec *spec = &config->channels[i];
+    uint8_t position =
+        __builtin_popcount(channels & BIT_MASK(spec->channel_id));
+
+    if (spec->channel_cfg.differential) {
+      stream->differential |= BIT(position);
+    }
+  }
+  if (__builtin_popcount(channels) != config->channel_count) {
+    LOG_ERR("Channels of a stream have to be distinct");
+    return -EINVAL;
+  }
+
+  int ret = configure_filter(stream, config, first->resolution);
+  if (ret < 0) {
+    return ret;
+  }
+
+  stream->config = *config;
+  memset(stream->integrator, 0, sizeof(stream->integrator));
+  memset(stream->comb, 0, sizeof(stream->comb));
+  stream->phase = 0;
+
+  stream->write_block = 0;
+  stream->write_scan = 0;
+  stream->read_block = 0;
+  stream->filled_count = 0;
+  stream->handed_out = 0;
+  stream->next_sequence = 0;
+  memset(&stream->stats, 0, sizeof(stream->stats));
+  k_sem_init(&stream->filled, 0, stream->block_count);
+
+  stream->options = (struct adc_sequence_options){
+    .interval_us = config->interval_us,
+    .callback = on_scan,
+    .user_data = stream,
+  };
+
+  stream->sequence = (struct adc_sequence){0};
+  ret = adc_sequence_init_dt(first, &stream->sequence);
+  if (ret < 0) {
+    return ret;
+  }
+  stream->sequence.options = &stream->options;
+  stream->sequence.channels = channels;
+  stream->sequence.buffer = stream->scan;
+  stream->sequence.buffer_size =
+      config->channel_count * sizeof(stream->scan[0]);
+
+  atomic_set(&stream->stopping, 0);
+  k_poll_signal_init(&stream->done);
+
+  ret = adc_read_async(first->dev, &stream->sequence, &stream->done);
+  if (ret < 0) {
+    LOG_ERR("Could not start the ADC sequence: %d", ret);
+    return ret;
+  }
+
+  stream->running = true;
+  return 0;
+}
+
+int adc_stream_stop(struct adc_stream *stream) {
+  if (!stream->running) {
+    return -EALREADY;
+  }
+
+  atomic_set(&stream->stopping, 1);
+
+  struct k_poll_event event = K_POLL_EVENT_INITIALIZER(
+      K_POLL_TYPE_SIGNAL, K_POLL_MODE_NOTIFY_ONLY, &stream->done);
+  int ret = k_poll(&event, 1,
+                   K_USEC(stream->config.interval_us +
+                          STOP_TIMEOUT_MS * USEC_PER_MSEC));
+  if (ret < 0) {
+    LOG_ERR("ADC sequence did not stop: %d", ret);
+    return -ETIMEDOUT;
+  }
+
+  stream->running = false;
+  return 0;
+}
+
+int adc_stream_get_block(struct adc_stream *stream,
+                         struct adc_stream_block *block,
+                         k_timeout_t timeout) {
+  if (k_sem_take(&stream->filled, timeout) < 0) {
+    return -EAGAIN;
+  }
+
+  k_spinlock_key_t key = k_spin_lock(&stream->lock);
+
+  uint16_t index =
+      (stream->read_block + stream->handed_out) % stream->block_count;
+  stream->handed_out++;
+
+  *block = (struct adc_stream_block){
+    .data = &stream->buffer[index * block_samples(stream)],
+    .scans = stream->block_scans,
+    .channels = stream->config.channel_count,
+    .sequence = stream->block_sequence[index],
+    .index = index,
+  };
+
+  k_spin_unlock(&stream->lock, key);
+  return 0;
+}
+
+int adc_stream_release_block(struct adc_stream *stream,
+                             const struct adc_stream_block *block) {
+  int ret = 0;
+  k_spinlock_key_t key = k_spin_lock(&stream->lock);
+
+  if (stream->handed_out == 0 || block->index != stream->read_block) {
+    ret = -EINVAL;
+  } else {
+    stream->read_block = (stream->read_block + 1) % stream->block_count;
+    stream->handed_out--;
+    stream->filled_count--;
+  }
+
+  k_spin_unlock(&stream->lock, key);
+  return ret;
+}
+
+void adc_stream_get_stats(struct adc_stream *stream,
+                          struct adc_stream_stats *stats) {
+  k_spinlock_key_t key = k_spin_lock(&stream->lock);
+  *stats = stream->stats;
+  k_spin_unlock(&stream->lock, key);
+}
@@ -0,0 +1,70 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (C) Frickly Systems GmbH
+ * SPDX-FileCopyrightText: Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_DECLARE(adc_stream, CONFIG_ADC_STREAM_LOG_LEVEL);
+
+#include "adc_stream_header.h"
+
+#include <string.h>
+
+#include <zephyr/drivers/can.h>
+#include <zephyr/sys/byteorder.h>
+
+#include <ardep/adc_stream.h>
+
+#ifdef CONFIG_ADC_STREAM_CAN_FD
+#define FRAME_FLAGS (CAN_FRAME_FDF | CAN_FRAME_BRS)
+#define FRAME_PAYLOAD CANFD_MAX_DLEN
+#else
+#define FRAME_FLAGS 0
+#define FRAME_PAYLOAD CAN_MAX_DLEN
+#endif
+
+static int send_frame(const struct device *can_dev,
+                      struct can_frame *frame,
+                      size_t len,
+                      k_timeout_t timeout) {
+  frame->dlc = can_bytes_to_dlc(len);
+
+  // CAN FD frames are padded to the next valid length
+  memset(&frame->data[len], 0, can_dlc_to_bytes(frame->dlc) - len);
+
+  int ret = can_send(can_dev, frame, timeout, NULL, NULL);
+  if (ret < 0) {
+    LOG_ERR("Could not send ADC stream frame: %d", ret);
+  }
+
+  return ret;
+}
+
+int adc_stream_publish_can(const struct device *can_dev,
+                           uint32_t can_id,
+                           const struct adc_stream_block *block,
+                           k_timeout_t timeout) {
+  struct can_frame frame = {
+    .id = can_id,
+    .flags = FRAME_FLAGS | (can_id > CAN_STD_ID_MASK ? CAN_FRAME_IDE : 0),
+  };
+
+  adc_stream_encode_header(block, frame.data);
+  int ret = send_frame(can_dev, &frame, ADC_STREAM_HEADER_SIZE, timeout);
+
+  size_t samples = adc_stream_block_samples(block);
+  size_t len = 0;
+  for (size_t i = 0; ret == 0 && i < samples; i++) {
+    sys_put_le16(block->data[i], &frame.data[len]);
+    len += sizeof(uint16_t);
+
+    if (len == FRAME_PAYLOAD || i == samples - 1) {
+      ret = send_frame(can_dev, &frame, len, timeout);
+      len = 0;
+    }
+  }
+
+  return ret;
+}
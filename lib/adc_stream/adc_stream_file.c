@@ -0,0 +1,51 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (C) Frickly Systems GmbH
+ * SPDX-FileCopyrightText: Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_DECLARE(adc_stream, CONFIG_ADC_STREAM_LOG_LEVEL);
+
+#include "adc_stream_header.h"
+
+#include <errno.h>
+
+#include <zephyr/fs/fs.h>
+#include <zephyr/sys/byteorder.h>
+
+#include <ardep/adc_stream.h>
+
+// Samples are converted to little endian in chunks of this size
+#define CHUNK_SAMPLES 32
+
+static int write_all(struct fs_file_t *file, const void *data, size_t len) {
+  ssize_t written = fs_write(file, data, len);
+  if (written < 0) {
+    LOG_ERR("Could not write ADC stream block: %d", (int)written);
+    return written;
+  }
+
+  return (size_t)written == len ? 0 : -ENOSPC;
+}
+
+int adc_stream_publish_file(struct fs_file_t *file,
+                            const struct adc_stream_block *block) {
+  uint8_t buf[MAX(ADC_STREAM_HEADER_SIZE, CHUNK_SAMPLES * sizeof(uint16_t))];
+
+  adc_stream_encode_header(block, buf);
+  int ret = write_all(file, buf, ADC_STREAM_HEADER_SIZE);
+
+  size_t samples = adc_stream_block_samples(block);
+  for (size_t i = 0; ret == 0 && i < samples; i += CHUNK_SAMPLES) {
+    size_t chunk = MIN(samples - i, CHUNK_SAMPLES);
+
+    for (size_t j = 0; j < chunk; j++) {
+      sys_put_le16(block->data[i + j], &buf[j * sizeof(uint16_t)]);
+    }
+    ret = write_all(file, buf, chunk * sizeof(uint16_t));
+  }
+
+  return ret;
+}
@@ -0,0 +1,32 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (C) Frickly Systems GmbH
+ * SPDX-FileCopyrightText: Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef ARDEP_LIB_ADC_STREAM_HEADER_H_
+#define ARDEP_LIB_ADC_STREAM_HEADER_H_
+
+#include <stdint.h>
+
+#include <zephyr/sys/byteorder.h>
+
+#include <ardep/adc_stream.h>
+
+// Header of a published block: sequence, scans and channels
+#define ADC_STREAM_HEADER_SIZE 7
+
+static inline void adc_stream_encode_header(
+    const struct adc_stream_block *block, uint8_t *header) {
+  sys_put_le32(block->sequence, &header[0]);
+  sys_put_le16(block->scans, &header[4]);
+  header[6] = block->channels;
+}
+
+static inline size_t adc_stream_block_samples(
+    const struct adc_stream_block *block) {
+  return (size_t)block->scans * block->channels;
+}
+
+#endif  // ARDEP_LIB_ADC_STREAM_HEADER_H_
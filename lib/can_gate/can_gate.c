@@ -0,0 +1,88 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (C) Frickly Systems GmbH
+ * SPDX-FileCopyrightText: Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+
+#include <zephyr/drivers/can.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#include <ardep/can_gate.h>
+
+LOG_MODULE_REGISTER(can_gate, CONFIG_CAN_GATE_LOG_LEVEL);
+
+int can_gate_send(struct can_gate *gate,
+                  const struct can_frame *frame,
+                  k_timeout_t timeout,
+                  can_tx_callback_t callback,
+                  void *user_data) {
+  if (!can_gate_tx_enabled(gate, frame)) {
+    return -ENETDOWN;
+  }
+
+  return can_send(gate->can_dev, frame, timeout, callback, user_data);
+}
+
+static void can_gate_rx_cb(const struct device *dev,
+                           struct can_frame *frame,
+                           void *user_data) {
+  struct can_gate_rx *rx = user_data;
+
+  if (!can_gate_rx_enabled(rx->gate, frame)) {
+    return;
+  }
+
+  rx->callback(dev, frame, rx->user_data);
+}
+
+int can_gate_add_rx_filter(struct can_gate *gate,
+                           struct can_gate_rx *rx,
+                           can_rx_callback_t callback,
+                           void *user_data,
+                           const struct can_filter *filter) {
+  rx->gate = gate;
+  rx->callback = callback;
+  rx->user_data = user_data;
+
+  return can_add_rx_filter(gate->can_dev, can_gate_rx_cb, rx, filter);
+}
+
+void can_gate_set(struct can_gate *gate,
+                  uint8_t classes,
+                  bool rx_enabled,
+                  bool tx_enabled) {
+  const atomic_val_t bits =
+      CAN_GATE_RX_DISABLED(classes) | CAN_GATE_TX_DISABLED(classes);
+  const atomic_val_t disable =
+      (rx_enabled ? 0 : CAN_GATE_RX_DISABLED(classes)) |
+      (tx_enabled ? 0 : CAN_GATE_TX_DISABLED(classes));
+  atomic_val_t old;
+
+  // RX and TX of the classes change at once
+  do {
+    old = atomic_get(&gate->disabled);
+  } while (!atomic_cas(&gate->disabled, old, (old & ~bits) | disable));
+
+  LOG_DBG("Gate of %s: disabled 0x%02lx", gate->can_dev->name,
+          (unsigned long)((old & ~bits) | disable));
+}
+
+struct can_gate *can_gate_get(const struct device *can_dev) {
+  STRUCT_SECTION_FOREACH (can_gate, gate) {
+    if (gate->can_dev == can_dev) {
+      return gate;
+    }
+  }
+
+  return NULL;
+}
+
+void can_gate_enable_all(void) {
+  STRUCT_SECTION_FOREACH (can_gate, gate) {
+    atomic_clear(&gate->disabled);
+  }
+}
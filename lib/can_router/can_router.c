@@ -5,25 +5,55 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
+#include <errno.h>
+
 #include <zephyr/drivers/can.h>
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
 
 #include <ardep/can_router.h>
 
+#ifdef CONFIG_CAN_ROUTER_CAN_GATE
+#include <ardep/can_gate.h>
+#endif
+
 LOG_MODULE_REGISTER(can_router, CONFIG_CAN_ROUTER_LOG_LEVEL);
 
 static void can_router_tx_cb(const struct device *dev,
                              int error,
                              void *user_data) {}
 
+static int can_router_send(const struct device *to,
+                           const struct can_frame *frame) {
+#ifdef CONFIG_CAN_ROUTER_CAN_GATE
+  struct can_gate *gate = can_gate_get(to);
+  if (gate != NULL) {
+    return can_gate_send(gate, frame, K_NO_WAIT, can_router_tx_cb, NULL);
+  }
+#endif
+
+  // Note: we use a tx callback to make use can_send non-blocking
+  return can_send(to, frame, K_NO_WAIT, can_router_tx_cb, NULL);
+}
+
 static void can_router_frame_cb(const struct device *dev,
                                 struct can_frame *frame,
                                 void *user_data) {
   const struct device *to = user_data;
 
-  // Note: we use a tx callback to make use can_send non-blocking
-  const int err = can_send(to, frame, K_NO_WAIT, can_router_tx_cb, NULL);
+#ifdef CONFIG_CAN_ROUTER_CAN_GATE
+  // Routed frames are application traffic on both devices
+  struct can_gate *gate = can_gate_get(dev);
+  if (gate != NULL && !can_gate_rx_enabled(gate, frame)) {
+    return;
+  }
+#endif
+
+  const int err = can_router_send(to, frame);
+  if (err == -ENETDOWN) {
+    LOG_DBG("Gate of %s dropped routed frame", to->name);
+    return;
+  }
   if (err) {
     LOG_WRN("Can send failed (%d)", err);
     return;
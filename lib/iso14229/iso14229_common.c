@@ -37,6 +37,32 @@ static void can_rx_cb(const struct device *dev,
   }
 }
 
+#ifdef CONFIG_ISO14229_FUNCTIONAL_FAST_PATH
+// Single frame TesterPresent with suppressPosRspMsgIndicationBit set
+static bool is_suppressed_tester_present(const struct can_frame *frame) {
+  return frame->dlc >= 3 && frame->data[0] == 0x02 && frame->data[1] == 0x3E &&
+         frame->data[2] == 0x80;
+}
+#endif  // CONFIG_ISO14229_FUNCTIONAL_FAST_PATH
+
+static void can_func_rx_cb(const struct device *dev,
+                           struct can_frame *frame,
+                           void *user_data) {
+  struct iso14229_zephyr_instance *inst = user_data;
+
+#ifdef CONFIG_ISO14229_FUNCTIONAL_FAST_PATH
+  // The tester keeps the sessions of all ECUs alive with it, it has no
+  // response and only restarts the S3 timer in the next tick
+  if (is_suppressed_tester_present(frame)) {
+    atomic_set(&inst->tester_present_ms, UDSMillis());
+    atomic_set(&inst->tester_present_pending, 1);
+    return;
+  }
+#endif  // CONFIG_ISO14229_FUNCTIONAL_FAST_PATH
+
+  can_rx_cb(dev, frame, &inst->can_func_msgq);
+}
+
 void iso14229_inject_can_frame_rx(struct iso14229_zephyr_instance *inst,
                                   struct can_frame *frame,
                                   bool functional_address) {
@@ -62,14 +88,23 @@ static void iso14229_zephyr_event_loop_tick(
   struct can_frame frame_phys;
   struct can_frame frame_func;
 
-  while (k_msgq_get(&inst->can_phys_msgq, &frame_phys, K_NO_WAIT) == 0) {
-    isotp_on_can_message(&inst->tp.phys_link, frame_phys.data, frame_phys.dlc);
+#ifdef CONFIG_ISO14229_FUNCTIONAL_FAST_PATH
+  if (atomic_clear(&inst->tester_present_pending)) {
+    inst->server.s3_session_timeout_timer =
+        (uint32_t)atomic_get(&inst->tester_present_ms) + inst->server.s3_ms;
   }
+#endif  // CONFIG_ISO14229_FUNCTIONAL_FAST_PATH
 
+  // Functional requests first, they do not wait for the frames of a long
+  // physical transfer
   while (k_msgq_get(&inst->can_func_msgq, &frame_func, K_NO_WAIT) == 0) {
     isotp_on_can_message(&inst->tp.func_link, frame_func.data, frame_func.dlc);
   }
 
+  while (k_msgq_get(&inst->can_phys_msgq, &frame_phys, K_NO_WAIT) == 0) {
+    isotp_on_can_message(&inst->tp.phys_link, frame_phys.data, frame_phys.dlc);
+  }
+
   UDSServerPoll(&inst->server);
 }
 
@@ -160,6 +195,10 @@ int iso14229_zephyr_init(struct iso14229_zephyr_instance *inst,
               sizeof(struct can_frame),
               ARRAY_SIZE(inst->can_func_buffer) / sizeof(struct can_frame));
 
+#ifdef CONFIG_ISO14229_FUNCTIONAL_FAST_PATH
+  atomic_clear(&inst->tester_present_pending);
+#endif  // CONFIG_ISO14229_FUNCTIONAL_FAST_PATH
+
   UDSServerInit(&inst->server);
   UDSISOTpCInit(&inst->tp, iso_tp_config);
 
@@ -187,8 +226,7 @@ int iso14229_zephyr_init(struct iso14229_zephyr_instance *inst,
   }
 
   if (inst->tp.func_sa != UDS_TP_NOOP_ADDR) {
-    err = can_add_rx_filter(can_dev, can_rx_cb, &inst->can_func_msgq,
-                            &func_filter);
+    err = can_add_rx_filter(can_dev, can_func_rx_cb, inst, &func_filter);
     if (err < 0) {
       printk("Failed to add RX filter for functional address: %d\n", err);
       return err;
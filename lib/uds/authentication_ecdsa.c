@@ -0,0 +1,347 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (C) Frickly Systems GmbH
+ * SPDX-FileCopyrightText: Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_DECLARE(uds, CONFIG_UDS_LOG_LEVEL);
+
+#include "uds.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/util.h>
+
+#include <psa/crypto.h>
+
+#include <ardep/uds.h>
+#include <iso14229.h>
+
+#define ECDSA_ALGORITHM PSA_ALG_ECDSA(PSA_ALG_SHA_256)
+
+// All PSA calls are made from this work queue, below the priority of the UDS
+// thread
+K_THREAD_STACK_DEFINE(auth_work_q_stack,
+                      CONFIG_UDS_AUTHENTICATION_WORKQUEUE_STACK_SIZE);
+static struct k_work_q auth_work_q;
+
+static void auth_destroy_key(psa_key_id_t* key) {
+  if (*key != PSA_KEY_ID_NULL) {
+    psa_destroy_key(*key);
+    *key = PSA_KEY_ID_NULL;
+  }
+}
+
+static void auth_prepare_handler(struct k_work* work) {
+  struct uds_authentication_ecdsa* auth =
+      CONTAINER_OF(work, struct uds_authentication_ecdsa, prepare_work);
+
+  if (atomic_get(&auth->prepared)) {
+    return;
+  }
+
+  // ephemeral key of a challenge that was replaced before it was verified
+  auth_destroy_key(&auth->stale_ephemeral_key);
+
+  psa_status_t status = psa_generate_random(auth->next_challenge,
+                                            sizeof(auth->next_challenge));
+  if (status != PSA_SUCCESS) {
+    LOG_ERR("Failed to generate a challenge: %d", status);
+    atomic_set(&auth->prepare_failed, 1);
+    return;
+  }
+
+  psa_key_attributes_t attributes = PSA_KEY_ATTRIBUTES_INIT;
+  psa_set_key_type(&attributes,
+                   PSA_KEY_TYPE_ECC_KEY_PAIR(PSA_ECC_FAMILY_SECP_R1));
+  psa_set_key_bits(&attributes, 256);
+  psa_set_key_usage_flags(&attributes, PSA_KEY_USAGE_DERIVE);
+  psa_set_key_algorithm(&attributes, PSA_ALG_ECDH);
+
+  status = psa_generate_key(&attributes, &auth->next_ephemeral_key);
+  if (status != PSA_SUCCESS) {
+    LOG_ERR("Failed to generate an ephemeral key: %d", status);
+    atomic_set(&auth->prepare_failed, 1);
+    return;
+  }
+
+  size_t len;
+  status = psa_export_public_key(auth->next_ephemeral_key,
+                                 auth->next_ephemeral_public_key,
+                                 sizeof(auth->next_ephemeral_public_key), &len);
+  if (status != PSA_SUCCESS) {
+    LOG_ERR("Failed to export the ephemeral key: %d", status);
+    auth_destroy_key(&auth->next_ephemeral_key);
+    atomic_set(&auth->prepare_failed, 1);
+    return;
+  }
+
+  atomic_set(&auth->prepared, 1);
+}
+
+static psa_status_t auth_import_tester_key(
+    const struct uds_authentication_ecdsa* auth, psa_key_id_t* key) {
+  psa_key_attributes_t attributes = PSA_KEY_ATTRIBUTES_INIT;
+  psa_set_key_type(&attributes,
+                   PSA_KEY_TYPE_ECC_PUBLIC_KEY(PSA_ECC_FAMILY_SECP_R1));
+  psa_set_key_bits(&attributes, 256);
+  psa_set_key_usage_flags(&attributes, PSA_KEY_USAGE_VERIFY_MESSAGE);
+  psa_set_key_algorithm(&attributes, ECDSA_ALGORITHM);
+
+  return psa_import_key(&attributes, auth->tester_public_key,
+                        UDS_AUTHENTICATION_ECDSA_PUBLIC_KEY_SIZE, key);
+}
+
+static UDSErr_t auth_verify(struct uds_authentication_ecdsa* auth) {
+  psa_key_id_t tester_key = PSA_KEY_ID_NULL;
+  psa_status_t status = auth_import_tester_key(auth, &tester_key);
+  if (status != PSA_SUCCESS) {
+    LOG_ERR("Failed to import the tester key: %d", status);
+    return UDS_NRC_ConditionsNotCorrect;
+  }
+
+  status = psa_verify_message(tester_key, ECDSA_ALGORITHM, auth->challenge,
+                              sizeof(auth->challenge), auth->signature,
+                              sizeof(auth->signature));
+  auth_destroy_key(&tester_key);
+  if (status == PSA_ERROR_INVALID_SIGNATURE) {
+    LOG_WRN("Invalid proof of ownership");
+    return UDS_NRC_InvalidKey;
+  }
+  if (status != PSA_SUCCESS) {
+    LOG_ERR("Failed to verify the proof of ownership: %d", status);
+    return UDS_NRC_ConditionsNotCorrect;
+  }
+
+  size_t len;
+  status = psa_raw_key_agreement(
+      PSA_ALG_ECDH, auth->ephemeral_key, auth->tester_public_key,
+      UDS_AUTHENTICATION_ECDSA_PUBLIC_KEY_SIZE, auth->session_key,
+      sizeof(auth->session_key), &len);
+  if (status != PSA_SUCCESS) {
+    LOG_ERR("Failed to derive the session key: %d", status);
+    return UDS_NRC_ConditionsNotCorrect;
+  }
+
+  return UDS_PositiveResponse;
+}
+
+static void auth_verify_handler(struct k_work* work) {
+  struct uds_authentication_ecdsa* auth =
+      CONTAINER_OF(work, struct uds_authentication_ecdsa, verify_work);
+
+  auth->result = auth_verify(auth);
+  // every ephemeral key is used once
+  auth_destroy_key(&auth->ephemeral_key);
+
+  atomic_set(&auth->state, UDS_AUTHENTICATION_ECDSA_STATE__VERIFIED);
+}
+
+static UDSErr_t auth_copy_with_length(struct uds_context* const context,
+                                      const uint8_t* data,
+                                      uint16_t len) {
+  UDSAuthArgs_t* args = context->arg;
+  uint8_t len_be[2];
+
+  sys_put_be16(len, len_be);
+  UDSErr_t ret = args->copy(context->server, len_be, sizeof(len_be));
+  if (ret != UDS_PositiveResponse || len == 0) {
+    return ret;
+  }
+  return args->copy(context->server, data, len);
+}
+
+static bool auth_algorithm_matches(const struct uds_authentication_ecdsa* auth,
+                                   const uint8_t* algorithm_indicator) {
+  return memcmp(algorithm_indicator, auth->algorithm_indicator,
+                UDS_AUTHENTICATION_ALGORITHM_INDICATOR_SIZE) == 0;
+}
+
+static UDSErr_t auth_request_challenge(struct uds_context* const context,
+                                       struct uds_authentication_ecdsa* auth) {
+  UDSAuthArgs_t* args = context->arg;
+
+  if (atomic_get(&auth->state) == UDS_AUTHENTICATION_ECDSA_STATE__VERIFYING) {
+    return UDS_NRC_BusyRepeatRequest;
+  }
+  if (!auth_algorithm_matches(auth,
+                              args->subFuncArgs.reqChallengeArgs.algoInd)) {
+    LOG_WRN("Unsupported algorithm indicator");
+    return UDS_NRC_ConditionsNotCorrect;
+  }
+
+  if (!atomic_get(&auth->prepared)) {
+    // A failed prepare is answered once and retried for the next request
+    bool failed = atomic_cas(&auth->prepare_failed, 1, 0);
+    k_work_submit_to_queue(&auth_work_q, &auth->prepare_work);
+    if (failed) {
+      return UDS_NRC_ConditionsNotCorrect;
+    }
+    return UDS_NRC_RequestCorrectlyReceived_ResponsePending;
+  }
+
+  // A verification result that was not picked up is discarded
+  atomic_set(&auth->state, UDS_AUTHENTICATION_ECDSA_STATE__IDLE);
+
+  // Destroyed by the prepare work, so PSA is only used from its work queue
+  auth->stale_ephemeral_key = auth->ephemeral_key;
+  auth->ephemeral_key = auth->next_ephemeral_key;
+  auth->next_ephemeral_key = PSA_KEY_ID_NULL;
+  memcpy(auth->challenge, auth->next_challenge, sizeof(auth->challenge));
+  memcpy(auth->ephemeral_public_key, auth->next_ephemeral_public_key,
+         sizeof(auth->ephemeral_public_key));
+  auth->challenge_active = true;
+
+  atomic_set(&auth->prepared, 0);
+  k_work_submit_to_queue(&auth_work_q, &auth->prepare_work);
+
+  UDSErr_t ret =
+      auth_copy_with_length(context, auth->challenge, sizeof(auth->challenge));
+  if (ret == UDS_PositiveResponse) {
+    // no additional parameters
+    ret = auth_copy_with_length(context, NULL, 0);
+  }
+  if (ret != UDS_PositiveResponse) {
+    return ret;
+  }
+
+  return args->set_auth_state(context->server, UDS_AT_RA);
+}
+
+static UDSErr_t auth_verify_proof_of_ownership(
+    struct uds_context* const context, struct uds_authentication_ecdsa* auth) {
+  UDSAuthArgs_t* args = context->arg;
+
+  // The request is handled again until a final response is sent
+  switch (atomic_get(&auth->state)) {
+    case UDS_AUTHENTICATION_ECDSA_STATE__VERIFYING:
+      return UDS_NRC_RequestCorrectlyReceived_ResponsePending;
+    case UDS_AUTHENTICATION_ECDSA_STATE__VERIFIED: {
+      atomic_set(&auth->state, UDS_AUTHENTICATION_ECDSA_STATE__IDLE);
+      if (auth->result != UDS_PositiveResponse) {
+        return auth->result;
+      }
+
+      auth->authenticated = true;
+      UDSErr_t ret = auth_copy_with_length(context, auth->ephemeral_public_key,
+                                           sizeof(auth->ephemeral_public_key));
+      if (ret != UDS_PositiveResponse) {
+        return ret;
+      }
+      return args->set_auth_state(context->server, UDS_AT_OVAC);
+    }
+    default:
+      break;
+  }
+
+  if (!auth_algorithm_matches(auth,
+                              args->subFuncArgs.verifyPownArgs.algoInd)) {
+    LOG_WRN("Unsupported algorithm indicator");
+    return UDS_NRC_ConditionsNotCorrect;
+  }
+  if (!auth->challenge_active) {
+    return UDS_NRC_RequestSequenceError;
+  }
+  if (args->subFuncArgs.verifyPownArgs.pownLen != sizeof(auth->signature)) {
+    return UDS_NRC_IncorrectMessageLengthOrInvalidFormat;
+  }
+
+  // Every challenge allows one attempt
+  auth->challenge_active = false;
+  auth->authenticated = false;
+  memcpy(auth->signature, args->subFuncArgs.verifyPownArgs.pown,
+         sizeof(auth->signature));
+
+  atomic_set(&auth->state, UDS_AUTHENTICATION_ECDSA_STATE__VERIFYING);
+  k_work_submit_to_queue(&auth_work_q, &auth->verify_work);
+
+  return UDS_NRC_RequestCorrectlyReceived_ResponsePending;
+}
+
+static void auth_deauthenticate(struct uds_authentication_ecdsa* auth) {
+  auth->authenticated = false;
+  auth->challenge_active = false;
+  memset(auth->session_key, 0, sizeof(auth->session_key));
+}
+
+UDSErr_t uds_check_authentication_ecdsa(const struct uds_context* const context,
+                                        bool* apply_action) {
+  if (context->event == UDS_EVT_AuthTimeout) {
+    *apply_action = true;
+    return UDS_OK;
+  }
+
+  const UDSAuthArgs_t* args = context->arg;
+  switch (args->type) {
+    case UDS_LEV_AT_DA:
+    case UDS_LEV_AT_RCFA:
+    case UDS_LEV_AT_VPOWNU:
+      *apply_action = true;
+      break;
+    default:
+      break;
+  }
+  return UDS_OK;
+}
+
+UDSErr_t uds_action_authentication_ecdsa(struct uds_context* const context,
+                                         bool* consume_event) {
+  struct uds_authentication_ecdsa* auth =
+      context->registration->auth.user_context;
+
+  if (context->event == UDS_EVT_AuthTimeout) {
+    if (atomic_get(&auth->state) !=
+        UDS_AUTHENTICATION_ECDSA_STATE__VERIFYING) {
+      auth_deauthenticate(auth);
+    }
+    // other handlers may track the timeout as well
+    *consume_event = false;
+    return UDS_PositiveResponse;
+  }
+
+  UDSAuthArgs_t* args = context->arg;
+  *consume_event = true;
+
+  switch (args->type) {
+    case UDS_LEV_AT_RCFA:
+      return auth_request_challenge(context, auth);
+    case UDS_LEV_AT_VPOWNU:
+      return auth_verify_proof_of_ownership(context, auth);
+    default:
+      if (atomic_get(&auth->state) ==
+          UDS_AUTHENTICATION_ECDSA_STATE__VERIFYING) {
+        return UDS_NRC_BusyRepeatRequest;
+      }
+      auth_deauthenticate(auth);
+      return args->set_auth_state(context->server, UDS_AT_DAS);
+  }
+}
+
+static int auth_sys_init(void) {
+  psa_status_t status = psa_crypto_init();
+  if (status != PSA_SUCCESS) {
+    LOG_ERR("Failed to initialize PSA crypto: %d", status);
+    return -EIO;
+  }
+
+  k_work_queue_start(&auth_work_q, auth_work_q_stack,
+                     K_THREAD_STACK_SIZEOF(auth_work_q_stack),
+                     CONFIG_UDS_AUTHENTICATION_WORKQUEUE_PRIORITY, NULL);
+  k_thread_name_set(&auth_work_q.thread, "uds_auth");
+
+  STRUCT_SECTION_FOREACH (uds_authentication_ecdsa, auth) {
+    k_work_init(&auth->prepare_work, auth_prepare_handler);
+    k_work_init(&auth->verify_work, auth_verify_handler);
+    k_work_submit_to_queue(&auth_work_q, &auth->prepare_work);
+  }
+
+  return 0;
+}
+
+SYS_INIT(auth_sys_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
@@ -35,3 +35,94 @@ STRUCT_SECTION_ITERABLE(uds_event_handler_data,
   .default_nrc = UDS_NRC_RequestOutOfRange,
   .registration_type = UDS_REGISTRATION_TYPE__COMMUNICATION_CONTROL,
 };
+
+#ifdef CONFIG_CAN_GATE
+
+// Bits 7-4 of the communicationType select the subnet, 0x0 addresses all
+// subnets and 0xF the subnet the request was received on
+static bool uds_comm_ctrl_gate_addressed(const struct uds_context* context,
+                                         const struct can_gate* gate,
+                                         uint8_t subnet) {
+  switch (subnet) {
+    case 0x0:
+      return true;
+    case 0xF:
+      return gate->can_dev == context->instance->can_dev;
+    default:
+      return gate->subnet == subnet;
+  }
+}
+
+UDSErr_t uds_check_default_communication_control(
+    const struct uds_context* const context, bool* apply_action) {
+  const UDSCommCtrlArgs_t* args = context->arg;
+  const uint8_t classes = args->commType & CAN_GATE_CLASS_ALL;
+  const uint8_t subnet = args->commType >> 4;
+
+  if (args->ctrlType > UDS_COMMUNICATION_CONTROL__DISABLE_RX_AND_TX) {
+    return UDS_OK;
+  }
+
+  if (classes == 0) {
+    LOG_WRN("Communication control: Unsupported communication type 0x%02X",
+            args->commType);
+    return UDS_NRC_RequestOutOfRange;
+  }
+
+  STRUCT_SECTION_FOREACH (can_gate, gate) {
+    if (uds_comm_ctrl_gate_addressed(context, gate, subnet)) {
+      *apply_action = true;
+      return UDS_OK;
+    }
+  }
+
+  LOG_WRN("Communication control: No CAN gate for subnet 0x%X", subnet);
+  return UDS_NRC_RequestOutOfRange;
+}
+
+UDSErr_t uds_action_default_communication_control(
+    struct uds_context* const context, bool* consume_event) {
+  const UDSCommCtrlArgs_t* args = context->arg;
+  const uint8_t classes = args->commType & CAN_GATE_CLASS_ALL;
+  const uint8_t subnet = args->commType >> 4;
+  const bool rx_enabled =
+      args->ctrlType == UDS_COMMUNICATION_CONTROL__ENABLE_RX_AND_TX ||
+      args->ctrlType == UDS_COMMUNICATION_CONTROL__ENABLE_RX_AND_DISABLE_TX;
+  const bool tx_enabled =
+      args->ctrlType == UDS_COMMUNICATION_CONTROL__ENABLE_RX_AND_TX ||
+      args->ctrlType == UDS_COMMUNICATION_CONTROL__DISABLE_RX_AND_ENABLE_TX;
+
+  STRUCT_SECTION_FOREACH (can_gate, gate) {
+    if (uds_comm_ctrl_gate_addressed(context, gate, subnet)) {
+      can_gate_set(gate, classes, rx_enabled, tx_enabled);
+    }
+  }
+
+  // Application handlers are informed as well
+  *consume_event = false;
+  return UDS_OK;
+}
+
+UDSErr_t uds_check_default_communication_control_change_diag_session(
+    const struct uds_context* const context, bool* apply_action) {
+  if (context->event == UDS_EVT_DiagSessCtrl) {
+    UDSDiagSessCtrlArgs_t* args = context->arg;
+    if (args->type == UDS_DIAG_SESSION__DEFAULT) {
+      *apply_action = true;
+    }
+  } else if (context->event == UDS_EVT_SessionTimeout) {
+    *apply_action = true;
+  }
+
+  return UDS_OK;
+}
+
+UDSErr_t uds_action_default_communication_control_change_diag_session(
+    struct uds_context* const context, bool* consume_event) {
+  can_gate_enable_all();
+
+  *consume_event = false;
+  return UDS_OK;
+}
+
+#endif  // CONFIG_CAN_GATE
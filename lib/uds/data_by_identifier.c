@@ -9,9 +9,233 @@
 #include "iso14229.h"
 #include "uds.h"
 
+#include <string.h>
+
+#include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
 LOG_MODULE_DECLARE(uds, CONFIG_UDS_LOG_LEVEL);
 
+#ifdef CONFIG_UDS_DATA_ID_CACHE
+
+struct uds_data_id_cache_entry {
+  const struct uds_instance_t* instance;
+  int64_t stored_at;
+  uint32_t last_used;
+  uint16_t data_id;
+  uint16_t len;
+  uint8_t session_type;
+  bool valid;
+};
+
+static struct uds_data_id_cache_entry
+    cache_entries[CONFIG_UDS_DATA_ID_CACHE_ENTRIES];
+// Arena of the cached responses, entry i owns slot i
+static uint8_t cache_arena[CONFIG_UDS_DATA_ID_CACHE_ENTRIES]
+                          [CONFIG_UDS_DATA_ID_CACHE_ENTRY_SIZE];
+static uint32_t cache_use_counter;
+static K_MUTEX_DEFINE(cache_mutex);
+
+// Response of the read action being copied into the arena
+static struct {
+  uint8_t (*copy)(UDSServer_t*, const void*, uint16_t);
+  uint8_t* buf;
+  uint16_t len;
+  bool too_long;
+} capture;
+
+void uds_data_id_cache_invalidate(uint16_t data_id) {
+  k_mutex_lock(&cache_mutex, K_FOREVER);
+  for (size_t i = 0; i < ARRAY_SIZE(cache_entries); i++) {
+    if (cache_entries[i].data_id == data_id) {
+      cache_entries[i].valid = false;
+    }
+  }
+  k_mutex_unlock(&cache_mutex);
+}
+
+void uds_data_id_cache_invalidate_all(void) {
+  k_mutex_lock(&cache_mutex, K_FOREVER);
+  for (size_t i = 0; i < ARRAY_SIZE(cache_entries); i++) {
+    cache_entries[i].valid = false;
+  }
+  k_mutex_unlock(&cache_mutex);
+}
+
+// Returns the entry of the data identifier, or the entry to evict for it
+static size_t uds_data_id_cache_slot(const struct uds_instance_t* instance,
+                                     uint16_t data_id) {
+  size_t victim = 0;
+
+  for (size_t i = 0; i < ARRAY_SIZE(cache_entries); i++) {
+    const struct uds_data_id_cache_entry* entry = &cache_entries[i];
+
+    if (entry->valid && entry->instance == instance &&
+        entry->data_id == data_id) {
+      return i;
+    }
+
+    if (!cache_entries[victim].valid) {
+      continue;
+    }
+    if (!entry->valid || entry->last_used < cache_entries[victim].last_used) {
+      victim = i;
+    }
+  }
+
+  return victim;
+}
+
+static bool uds_data_id_cache_hit(const struct uds_data_id_cache_entry* entry,
+                                  const struct uds_context* const context) {
+  const struct uds_registration_t* const reg = context->registration;
+
+  return entry->valid && entry->instance == context->instance &&
+         entry->data_id == reg->data_identifier.data_id &&
+         entry->session_type == context->server->sessionType &&
+         k_uptime_get() - entry->stored_at <
+             reg->data_identifier.cache_max_age_ms;
+}
+
+static uint8_t uds_data_id_cache_capture(UDSServer_t* srv,
+                                         const void* src,
+                                         uint16_t count) {
+  uint8_t ret = capture.copy(srv, src, count);
+  if (ret != UDS_PositiveResponse) {
+    return ret;
+  }
+
+  if (count > CONFIG_UDS_DATA_ID_CACHE_ENTRY_SIZE - capture.len) {
+    capture.too_long = true;
+  } else {
+    memcpy(capture.buf + capture.len, src, count);
+    capture.len += count;
+  }
+
+  return ret;
+}
+
+// Serves the response from the cache or records the response of the read
+// action in it
+static UDSErr_t uds_action_read_cached(struct uds_context* const context,
+                                       bool* consume_event) {
+  const struct uds_registration_t* const reg = context->registration;
+  UDSRDBIArgs_t* args = context->arg;
+  UDSErr_t ret;
+
+  k_mutex_lock(&cache_mutex, K_FOREVER);
+
+  // a read action reading another cached data identifier is not cached
+  if (capture.copy != NULL) {
+    ret = reg->data_identifier.read.action(context, consume_event);
+    k_mutex_unlock(&cache_mutex);
+    return ret;
+  }
+
+  const size_t i =
+      uds_data_id_cache_slot(context->instance, reg->data_identifier.data_id);
+  struct uds_data_id_cache_entry* entry = &cache_entries[i];
+
+  if (uds_data_id_cache_hit(entry, context)) {
+    entry->last_used = ++cache_use_counter;
+    *consume_event = true;
+    ret = args->copy(context->server, cache_arena[i], entry->len);
+    k_mutex_unlock(&cache_mutex);
+    return ret;
+  }
+
+  entry->valid = false;
+  capture.copy = args->copy;
+  capture.buf = cache_arena[i];
+  capture.len = 0;
+  capture.too_long = false;
+
+  args->copy = uds_data_id_cache_capture;
+  ret = reg->data_identifier.read.action(context, consume_event);
+  args->copy = capture.copy;
+  capture.copy = NULL;
+
+  if (ret == UDS_OK && !capture.too_long) {
+    *entry = (struct uds_data_id_cache_entry){
+      .instance = context->instance,
+      .stored_at = k_uptime_get(),
+      .last_used = ++cache_use_counter,
+      .data_id = reg->data_identifier.data_id,
+      .len = capture.len,
+      .session_type = context->server->sessionType,
+      .valid = true,
+    };
+  }
+
+  k_mutex_unlock(&cache_mutex);
+  return ret;
+}
+
+static UDSErr_t uds_action_write_cached(struct uds_context* const context,
+                                        bool* consume_event) {
+  const struct uds_registration_t* const reg = context->registration;
+
+  UDSErr_t ret = reg->data_identifier.write.action(context, consume_event);
+  uds_data_id_cache_invalidate(reg->data_identifier.data_id);
+
+  return ret;
+}
+
+static UDSErr_t uds_action_io_control_cached(struct uds_context* const context,
+                                             bool* consume_event) {
+  const struct uds_registration_t* const reg = context->registration;
+
+  UDSErr_t ret = reg->data_identifier.io_control.action(context, consume_event);
+  uds_data_id_cache_invalidate(reg->data_identifier.data_id);
+
+  return ret;
+}
+
+static UDSErr_t uds_check_data_id_cache_session(
+    const struct uds_context* const context, bool* apply_action) {
+  *apply_action = true;
+  return UDS_OK;
+}
+
+// Cached responses may depend on the session, e.g. by their read check
+static UDSErr_t uds_action_data_id_cache_session(
+    struct uds_context* const context, bool* consume_event) {
+  uds_data_id_cache_invalidate_all();
+
+  *consume_event = false;
+  return UDS_OK;
+}
+
+// Registered for all instances
+_UDS_REGISTRATION(diag_session_ctrl, __uds_registration_data_id_cache) = {
+  .type = UDS_REGISTRATION_TYPE__DIAG_SESSION_CTRL,
+  .diag_session_ctrl = {
+    .diag_sess_ctrl = {
+      .check = uds_check_data_id_cache_session,
+      .action = uds_action_data_id_cache_session,
+    },
+    .session_timeout = {
+      .check = uds_check_data_id_cache_session,
+      .action = uds_action_data_id_cache_session,
+    },
+  },
+};
+
+#endif  // CONFIG_UDS_DATA_ID_CACHE
+
+#ifdef CONFIG_UDS_REGISTRATION_INDEX
+static uint16_t uds_get_data_id_of_read(const void* arg) {
+  return ((const UDSRDBIArgs_t*)arg)->dataId;
+}
+
+static uint16_t uds_get_data_id_of_write(const void* arg) {
+  return ((const UDSWDBIArgs_t*)arg)->dataId;
+}
+
+static uint16_t uds_get_data_id_of_io_control(const void* arg) {
+  return ((const UDSIOCtrlArgs_t*)arg)->dataId;
+}
+#endif  // CONFIG_UDS_REGISTRATION_INDEX
+
 static UDSErr_t uds_check_read_with_data_id(
     const struct uds_context* const context, bool* apply_action) {
   const struct uds_registration_t* const reg = context->registration;
@@ -36,6 +260,12 @@ uds_check_fn uds_get_check_for_read_data_by_identifier(
 }
 uds_action_fn uds_get_action_for_read_data_by_identifier(
     const struct uds_registration_t* const reg) {
+#ifdef CONFIG_UDS_DATA_ID_CACHE
+  if (reg->data_identifier.cache_max_age_ms != 0 &&
+      reg->data_identifier.read.action != NULL) {
+    return uds_action_read_cached;
+  }
+#endif  // CONFIG_UDS_DATA_ID_CACHE
   return reg->data_identifier.read.action;
 }
 
@@ -46,6 +276,9 @@ STRUCT_SECTION_ITERABLE(uds_event_handler_data,
   .get_action = uds_get_action_for_read_data_by_identifier,
   .default_nrc = UDS_NRC_RequestOutOfRange,
   .registration_type = UDS_REGISTRATION_TYPE__DATA_IDENTIFIER,
+#ifdef CONFIG_UDS_REGISTRATION_INDEX
+  .get_id = uds_get_data_id_of_read,
+#endif
 };
 
 static UDSErr_t uds_check_write_with_data_id(
@@ -68,6 +301,12 @@ uds_check_fn uds_get_check_for_write_data_by_identifier(
 }
 uds_action_fn uds_get_action_for_write_data_by_identifier(
     const struct uds_registration_t* const reg) {
+#ifdef CONFIG_UDS_DATA_ID_CACHE
+  if (reg->data_identifier.cache_max_age_ms != 0 &&
+      reg->data_identifier.write.action != NULL) {
+    return uds_action_write_cached;
+  }
+#endif  // CONFIG_UDS_DATA_ID_CACHE
   return reg->data_identifier.write.action;
 }
 
@@ -78,6 +317,9 @@ STRUCT_SECTION_ITERABLE(uds_event_handler_data,
   .get_action = uds_get_action_for_write_data_by_identifier,
   .default_nrc = UDS_NRC_RequestOutOfRange,
   .registration_type = UDS_REGISTRATION_TYPE__DATA_IDENTIFIER,
+#ifdef CONFIG_UDS_REGISTRATION_INDEX
+  .get_id = uds_get_data_id_of_write,
+#endif
 };
 
 static UDSErr_t uds_check_io_control_with_data_id(
@@ -100,6 +342,12 @@ uds_check_fn uds_get_check_for_io_control_by_identifier(
 }
 uds_action_fn uds_get_action_for_io_control_by_identifier(
     const struct uds_registration_t* const reg) {
+#ifdef CONFIG_UDS_DATA_ID_CACHE
+  if (reg->data_identifier.cache_max_age_ms != 0 &&
+      reg->data_identifier.io_control.action != NULL) {
+    return uds_action_io_control_cached;
+  }
+#endif  // CONFIG_UDS_DATA_ID_CACHE
   return reg->data_identifier.io_control.action;
 }
 
@@ -110,4 +358,7 @@ STRUCT_SECTION_ITERABLE(uds_event_handler_data,
   .get_action = uds_get_action_for_io_control_by_identifier,
   .default_nrc = UDS_NRC_RequestOutOfRange,
   .registration_type = UDS_REGISTRATION_TYPE__DATA_IDENTIFIER,
+#ifdef CONFIG_UDS_REGISTRATION_INDEX
+  .get_id = uds_get_data_id_of_io_control,
+#endif
 };
@@ -30,7 +30,7 @@ static UDSErr_t diag_session_ctrl_action(struct uds_context* const context,
   UDSDiagSessCtrlArgs_t* args = context->arg;
   if (args->type == UDS_DIAG_SESSION__PROGRAMMING) {
     LOG_INF("Switching into firmware loader");
-    return uds_switch_to_firmware_loader_with_programming_session();
+    return uds_switch_to_firmware_loader(context);
   }
 #endif
 
@@ -114,6 +114,17 @@ static int uds_default_instance_init() {
   }
   LOG_INF("CAN device started");
 
+#ifdef CONFIG_UDS_DEFAULT_INSTANCE_RESUME_FIRMWARE_LOADER_HANDOFF
+  // answer the request of the tester before anything else is started
+  struct uds_firmware_loader_handoff handoff;
+  if (uds_firmware_loader_handoff_take(&handoff) == 0) {
+    err = uds_firmware_loader_handoff_resume(&uds_default_instance, &handoff);
+    if (err) {
+      LOG_ERR("Failed to resume handed over session: %d", err);
+    }
+  }
+#endif
+
   uds_default_instance.iso14229.thread_start(&uds_default_instance.iso14229);
   LOG_INF("UDS thread started");
 
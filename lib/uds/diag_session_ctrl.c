@@ -8,6 +8,8 @@
 #include "ardep/uds.h"
 #include "uds.h"
 
+#include <errno.h>
+
 #include <zephyr/logging/log.h>
 #include <zephyr/retention/bootmode.h>
 #include <zephyr/retention/retention.h>
@@ -19,13 +21,10 @@ LOG_MODULE_DECLARE(uds, CONFIG_UDS_LOG_LEVEL);
 static const struct device* retention_data =
     DEVICE_DT_GET(DT_CHOSEN(zephyr_firmware_loader_args));
 
-UDSErr_t uds_switch_to_firmware_loader_with_programming_session() {
-  LOG_INF("Switching to programming session in firmware loader");
-
-  const uint8_t session_type = UDS_DIAG_SESSION__PROGRAMMING;
-
-  int ret =
-      retention_write(retention_data, 0, &session_type, sizeof(session_type));
+static UDSErr_t switch_to_firmware_loader(
+    const struct uds_firmware_loader_handoff* handoff) {
+  int ret = retention_write(retention_data, 0, (const uint8_t*)handoff,
+                            sizeof(*handoff));
   if (ret != 0) {
     LOG_ERR("Failed to write retention: %d", ret);
     return UDS_NRC_ConditionsNotCorrect;
@@ -43,6 +42,61 @@ UDSErr_t uds_switch_to_firmware_loader_with_programming_session() {
 
   return UDS_NRC_GeneralReject;
 }
+
+UDSErr_t uds_switch_to_firmware_loader_with_programming_session() {
+  LOG_INF("Switching to programming session in firmware loader");
+
+  const struct uds_firmware_loader_handoff handoff = {
+    .session_type = UDS_DIAG_SESSION__PROGRAMMING,
+    .flags = UDS_FIRMWARE_LOADER_HANDOFF_RESPONSE_PENDING,
+  };
+
+  return switch_to_firmware_loader(&handoff);
+}
+
+UDSErr_t uds_switch_to_firmware_loader(const struct uds_context* const context) {
+  struct uds_firmware_loader_handoff handoff;
+
+  if (uds_firmware_loader_handoff_capture(context, &handoff) != 0) {
+    return UDS_NRC_ConditionsNotCorrect;
+  }
+
+  LOG_INF("Switching to session 0x%02x in firmware loader",
+          handoff.session_type);
+
+  return switch_to_firmware_loader(&handoff);
+}
+
+int uds_firmware_loader_handoff_take(
+    struct uds_firmware_loader_handoff* handoff) {
+  const ssize_t size = retention_size(retention_data);
+  if (size < (ssize_t)sizeof(*handoff)) {
+    LOG_ERR("Retention area too small for the session handoff");
+    return -ENOSPC;
+  }
+
+  // without a checksum configured, the cleared area tells there is no handoff
+  int ret = retention_is_valid(retention_data);
+  if (ret == 0) {
+    return -ENODATA;
+  }
+  if (ret < 0 && ret != -ENOTSUP) {
+    return ret;
+  }
+
+  ret = retention_read(retention_data, 0, (uint8_t*)handoff, sizeof(*handoff));
+  if (ret != 0) {
+    return ret;
+  }
+
+  // only resume once, a later reset starts without a session
+  ret = retention_clear(retention_data);
+  if (ret != 0) {
+    return ret;
+  }
+
+  return handoff->session_type != 0 ? 0 : -ENODATA;
+}
 #endif
 
 uds_check_fn uds_get_check_for_diag_session_ctrl(
@@ -0,0 +1,1188 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (C) Frickly Systems GmbH
+ * SPDX-FileCopyrightText: Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_DECLARE(uds, CONFIG_UDS_LOG_LEVEL);
+
+#include "dtc_manager.h"
+#include "uds.h"
+
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/util.h>
+
+#include <ardep/uds.h>
+#include <iso14229.h>
+
+#ifdef CONFIG_UDS_DTC_MANAGER_STATS
+#include <zephyr/stats/stats.h>
+
+STATS_SECT_START(uds_dtc_manager_stats)
+STATS_SECT_ENTRY32(words)
+STATS_SECT_ENTRY32(dtcs)
+STATS_SECT_END;
+
+STATS_NAME_START(uds_dtc_manager_stats)
+STATS_NAME(uds_dtc_manager_stats, words)
+STATS_NAME(uds_dtc_manager_stats, dtcs)
+STATS_NAME_END(uds_dtc_manager_stats);
+
+static STATS_SECT_DECL(uds_dtc_manager_stats) uds_dtc_manager_stats;
+
+#define UDS_DTC_MANAGER_STATS_INC(_name) STATS_INC(uds_dtc_manager_stats, _name)
+#else
+#define UDS_DTC_MANAGER_STATS_INC(_name)
+#endif
+
+#define MAX_DTCS CONFIG_UDS_DTC_MANAGER_MAX_DTCS
+#define AVAILABILITY_MASK CONFIG_UDS_DTC_MANAGER_STATUS_AVAILABILITY_MASK
+
+// Bitmaps have one bit per DTC slot, a word covers 32 slots
+#define BITMAP_WORDS(_bits) DIV_ROUND_UP((size_t)(_bits), 32)
+#define DTC_WORDS BITMAP_WORDS(MAX_DTCS)
+
+// DTCFormatIdentifier of ISO 14229-1 DTCs
+#define DTC_FORMAT_ISO_14229_1 0x01
+
+// Status bits kept across resets. The other bits belong to the running
+// operation cycle and change with every test result.
+#define PERSISTED_STATUS_BITS                                           \
+  (UDS_DTC_STATUS_PENDING_DTC | UDS_DTC_STATUS_CONFIRMED_DTC |          \
+   UDS_DTC_STATUS_TEST_NOT_COMPLETED_SINCE_LAST_CLEAR |                 \
+   UDS_DTC_STATUS_TEST_FAILED_SINCE_LAST_CLEAR |                        \
+   UDS_DTC_STATUS_WARNING_INDICATOR_REQUESTED)
+
+#define INITIAL_STATUS                                  \
+  (UDS_DTC_STATUS_TEST_NOT_COMPLETED_SINCE_LAST_CLEAR | \
+   UDS_DTC_STATUS_TEST_NOT_COMPLETED_THIS_OPERATION_CYCLE)
+
+K_MUTEX_DEFINE(dtc_mutex);
+
+// The DTCs are stored as a struct of arrays indexed by a slot, which is
+// assigned in the order of registration. Queries by status mask are answered
+// from one bitmap per status bit, so they only touch the DTC numbers of
+// matching DTCs.
+static struct {
+  uint32_t number[MAX_DTCS];
+  uint8_t status[MAX_DTCS];
+  uint8_t occurrence_counter[MAX_DTCS];
+  // Slots sorted by DTC number
+  uint16_t by_number[MAX_DTCS];
+  // Slots with the status bit set, one bitmap per status bit
+  uint32_t status_bitmap[8][DTC_WORDS];
+  uint16_t count;
+#ifdef CONFIG_UDS_DTC_MANAGER_PERSISTENCE
+  // Chunks of 32 slots with changes that are not stored yet
+  uint32_t dirty[BITMAP_WORDS(DTC_WORDS)];
+#endif
+} dtcs;
+
+// Snapshot and extended data records of all DTCs share a pool each
+struct dtc_record_pool {
+  uint16_t capacity;
+  uint8_t record_size;
+  uint16_t storage_id;
+  uint16_t* slot;
+  uint8_t* record_number;
+  uint8_t* len;
+  uint8_t* data;
+  uint32_t* used;
+#ifdef CONFIG_UDS_DTC_MANAGER_PERSISTENCE
+  uint32_t* dirty;
+#endif
+};
+
+#ifdef CONFIG_UDS_DTC_MANAGER_PERSISTENCE
+#define _DTC_RECORD_POOL_DIRTY_DEFINE(_name, _capacity) \
+  static uint32_t _name##_dirty[BITMAP_WORDS(_capacity)];
+#define _DTC_RECORD_POOL_DIRTY_INIT(_name) .dirty = _name##_dirty,
+#else
+#define _DTC_RECORD_POOL_DIRTY_DEFINE(_name, _capacity)
+#define _DTC_RECORD_POOL_DIRTY_INIT(_name)
+#endif
+
+#define DTC_RECORD_POOL_DEFINE(_name, _capacity, _record_size, _storage_id) \
+  static uint16_t _name##_slot[_capacity];                                  \
+  static uint8_t _name##_record_number[_capacity];                          \
+  static uint8_t _name##_len[_capacity];                                    \
+  static uint8_t _name##_data[_capacity][_record_size];                     \
+  static uint32_t _name##_used[BITMAP_WORDS(_capacity)];                    \
+  _DTC_RECORD_POOL_DIRTY_DEFINE(_name, _capacity)                           \
+  static struct dtc_record_pool _name = {                                   \
+    .capacity = _capacity,                                                  \
+    .record_size = _record_size,                                            \
+    .storage_id = _storage_id,                                              \
+    .slot = _name##_slot,                                                   \
+    .record_number = _name##_record_number,                                 \
+    .len = _name##_len,                                                     \
+    .data = &_name##_data[0][0],                                            \
+    .used = _name##_used,                                                   \
+    _DTC_RECORD_POOL_DIRTY_INIT(_name)                                      \
+  }
+
+// Storage IDs of the persisted entries
+#define STORAGE_ID_DTCS 0x0100
+#define STORAGE_ID_SNAPSHOTS 0x1000
+#define STORAGE_ID_EXT_DATA 0x2000
+
+DTC_RECORD_POOL_DEFINE(snapshots,
+                       CONFIG_UDS_DTC_MANAGER_SNAPSHOT_RECORDS,
+                       CONFIG_UDS_DTC_MANAGER_SNAPSHOT_RECORD_SIZE,
+                       STORAGE_ID_SNAPSHOTS);
+DTC_RECORD_POOL_DEFINE(ext_data,
+                       CONFIG_UDS_DTC_MANAGER_EXT_DATA_RECORDS,
+                       CONFIG_UDS_DTC_MANAGER_EXT_DATA_RECORD_SIZE,
+                       STORAGE_ID_EXT_DATA);
+
+static inline bool bitmap_test(const uint32_t* bitmap, size_t bit) {
+  return (bitmap[bit / 32] & BIT(bit % 32)) != 0;
+}
+
+static inline void bitmap_set(uint32_t* bitmap, size_t bit) {
+  bitmap[bit / 32] |= BIT(bit % 32);
+}
+
+static inline void bitmap_clear(uint32_t* bitmap, size_t bit) {
+  bitmap[bit / 32] &= ~BIT(bit % 32);
+}
+
+// Pops the lowest set bit of a bitmap word
+static inline size_t pop_lowest_bit(uint32_t* word) {
+  size_t bit = __builtin_ctz(*word);
+  *word &= *word - 1;
+  return bit;
+}
+
+#ifdef CONFIG_UDS_DTC_MANAGER_PERSISTENCE
+// Writes to the storage may erase flash sectors, so they are done from a work
+// queue below the priority of the UDS thread
+K_THREAD_STACK_DEFINE(dtc_work_q_stack,
+                      CONFIG_UDS_DTC_MANAGER_WORKQUEUE_STACK_SIZE);
+static struct k_work_q dtc_work_q;
+
+static void dtc_persist_work_handler(struct k_work* work);
+K_WORK_DELAYABLE_DEFINE(dtc_persist_work, dtc_persist_work_handler);
+K_MUTEX_DEFINE(dtc_flush_mutex);
+K_MUTEX_DEFINE(dtc_journal_mutex);
+
+// Clears whose DTCs are not completely stored yet. Every clear increments the
+// generation, and stored entries carry the generation they were written at.
+// After a reset, the journaled clears with a later generation are applied to
+// the loaded entries again. Clear i has the generation
+// generation - pending + 1 + i.
+static struct {
+  uint16_t generation;
+  uint8_t pending;
+  uint32_t group[CONFIG_UDS_DTC_MANAGER_CLEAR_JOURNAL_SIZE];
+} clear_journal;
+
+static void schedule_persist(void) {
+  // Does not move an already scheduled write, so all changes within the
+  // delay are written together
+  k_work_schedule_for_queue(
+      &dtc_work_q, &dtc_persist_work,
+      K_MSEC(CONFIG_UDS_DTC_MANAGER_PERSISTENCE_DELAY_MS));
+}
+#endif
+
+static void mark_dtc_dirty(uint16_t slot) {
+#ifdef CONFIG_UDS_DTC_MANAGER_PERSISTENCE
+  bitmap_set(dtcs.dirty, slot / 32);
+  schedule_persist();
+#endif
+}
+
+static void mark_record_dirty(struct dtc_record_pool* pool, uint16_t index) {
+#ifdef CONFIG_UDS_DTC_MANAGER_PERSISTENCE
+  bitmap_set(pool->dirty, index);
+  schedule_persist();
+#endif
+}
+
+static void set_status(uint16_t slot, uint8_t status) {
+  uint32_t changed = dtcs.status[slot] ^ status;
+  if (changed == 0) {
+    return;
+  }
+
+  if ((changed & PERSISTED_STATUS_BITS) != 0) {
+    mark_dtc_dirty(slot);
+  }
+
+  dtcs.status[slot] = status;
+  while (changed != 0) {
+    size_t bit = pop_lowest_bit(&changed);
+    dtcs.status_bitmap[bit][slot / 32] ^= BIT(slot % 32);
+  }
+}
+
+static void set_occurrence_counter(uint16_t slot, uint8_t counter) {
+  if (dtcs.occurrence_counter[slot] != counter) {
+    dtcs.occurrence_counter[slot] = counter;
+    mark_dtc_dirty(slot);
+  }
+}
+
+// Slots of DTCs in a bitmap word with any of the status bits of the mask
+static uint32_t match_status_mask(uint8_t status_mask, size_t word) {
+  uint32_t mask = status_mask;
+  uint32_t match = 0;
+
+  while (mask != 0) {
+    match |= dtcs.status_bitmap[pop_lowest_bit(&mask)][word];
+  }
+
+  return match;
+}
+
+static uint16_t count_by_status_mask(uint8_t status_mask) {
+  uint16_t count = 0;
+
+  for (size_t word = 0; word < DTC_WORDS; word++) {
+    count += __builtin_popcount(match_status_mask(status_mask, word));
+  }
+
+  return count;
+}
+
+// Slots of registered DTCs in a bitmap word
+static uint32_t match_registered(size_t word) {
+  size_t first = word * 32;
+
+  if (dtcs.count <= first) {
+    return 0;
+  }
+  if (dtcs.count - first >= 32) {
+    return UINT32_MAX;
+  }
+
+  return BIT_MASK(dtcs.count - first);
+}
+
+// Index in by_number of the DTC or where it has to be inserted
+static size_t lower_bound(uint32_t dtc) {
+  size_t low = 0;
+  size_t high = dtcs.count;
+
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+    if (dtcs.number[dtcs.by_number[mid]] < dtc) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+
+  return low;
+}
+
+static int find_slot(uint32_t dtc) {
+  size_t index = lower_bound(dtc);
+
+  if (index == dtcs.count || dtcs.number[dtcs.by_number[index]] != dtc) {
+    return -ENOENT;
+  }
+
+  return dtcs.by_number[index];
+}
+
+static int register_dtc(uint32_t dtc, bool* added) {
+  size_t index = lower_bound(dtc);
+
+  *added = false;
+  if (index < dtcs.count && dtcs.number[dtcs.by_number[index]] == dtc) {
+    return dtcs.by_number[index];
+  }
+  if (dtcs.count == MAX_DTCS) {
+    return -ENOMEM;
+  }
+
+  uint16_t slot = dtcs.count++;
+  memmove(&dtcs.by_number[index + 1], &dtcs.by_number[index],
+          (dtcs.count - 1 - index) * sizeof(dtcs.by_number[0]));
+  dtcs.by_number[index] = slot;
+
+  dtcs.number[slot] = dtc;
+  dtcs.occurrence_counter[slot] = 0;
+  set_status(slot, INITIAL_STATUS);
+  *added = true;
+
+  return slot;
+}
+
+static uint8_t* record_data(const struct dtc_record_pool* pool,
+                            uint16_t index) {
+  return &pool->data[index * pool->record_size];
+}
+
+static int find_record(const struct dtc_record_pool* pool,
+                       uint16_t slot,
+                       uint8_t record_number) {
+  for (uint16_t i = 0; i < pool->capacity; i++) {
+    if (bitmap_test(pool->used, i) && pool->slot[i] == slot &&
+        pool->record_number[i] == record_number) {
+      return i;
+    }
+  }
+
+  return -ENOENT;
+}
+
+static int store_record(struct dtc_record_pool* pool,
+                        uint32_t dtc,
+                        uint8_t record_number,
+                        const uint8_t* data,
+                        size_t len) {
+  if (len == 0 || len > pool->record_size) {
+    return -EINVAL;
+  }
+
+  k_mutex_lock(&dtc_mutex, K_FOREVER);
+
+  int slot = find_slot(dtc);
+  if (slot < 0) {
+    k_mutex_unlock(&dtc_mutex);
+    return slot;
+  }
+
+  int index = find_record(pool, slot, record_number);
+  for (uint16_t i = 0; index < 0 && i < pool->capacity; i++) {
+    if (!bitmap_test(pool->used, i)) {
+      index = i;
+    }
+  }
+  if (index < 0) {
+    k_mutex_unlock(&dtc_mutex);
+    return -ENOMEM;
+  }
+
+  bitmap_set(pool->used, index);
+  pool->slot[index] = slot;
+  pool->record_number[index] = record_number;
+  pool->len[index] = len;
+  memcpy(record_data(pool, index), data, len);
+  mark_record_dirty(pool, index);
+
+  k_mutex_unlock(&dtc_mutex);
+  return 0;
+}
+
+static void free_records(struct dtc_record_pool* pool, uint16_t slot) {
+  for (uint16_t i = 0; i < pool->capacity; i++) {
+    if (bitmap_test(pool->used, i) && pool->slot[i] == slot) {
+      bitmap_clear(pool->used, i);
+      mark_record_dirty(pool, i);
+    }
+  }
+}
+
+static void clear_dtc(uint16_t slot) {
+  set_status(slot, INITIAL_STATUS);
+  set_occurrence_counter(slot, 0);
+  free_records(&snapshots, slot);
+  free_records(&ext_data, slot);
+}
+
+#ifdef CONFIG_UDS_DTC_MANAGER_PERSISTENCE
+#define STORAGE_ID_CLEAR_JOURNAL 0x0001
+
+struct stored_dtc {
+  uint32_t number;
+  uint8_t status;
+  uint8_t occurrence_counter;
+} __packed;
+
+// Entry of a chunk of 32 DTCs
+struct stored_dtc_chunk {
+  uint16_t generation;
+  struct stored_dtc dtcs[32];
+} __packed;
+
+// Entry of a snapshot or extended data record, followed by the data
+struct stored_record {
+  uint32_t dtc;
+  uint8_t record_number;
+  uint16_t generation;
+} __packed;
+
+// Entry of the clear journal, only the pending groups are stored
+struct stored_clear_journal {
+  uint16_t generation;
+  uint8_t pending;
+  uint32_t group[CONFIG_UDS_DTC_MANAGER_CLEAR_JOURNAL_SIZE];
+} __packed;
+
+static union {
+  struct stored_dtc_chunk chunk;
+  uint8_t record[sizeof(struct stored_record) + UINT8_MAX];
+} persist_buf;
+
+static void journal_clear(uint32_t group) {
+  clear_journal.group[clear_journal.pending++] = group;
+  clear_journal.generation++;
+}
+
+// Whether a journaled clear after the generation of a stored entry applies to
+// the DTC
+static bool cleared_after(uint16_t generation, uint32_t dtc) {
+  for (uint8_t i = 0; i < clear_journal.pending; i++) {
+    uint16_t clear_generation =
+        clear_journal.generation - clear_journal.pending + 1 + i;
+    uint32_t group = clear_journal.group[i];
+
+    if ((int16_t)(clear_generation - generation) > 0 &&
+        (group == UDS_DTC_GROUP_ALL || group == dtc)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static size_t encode_clear_journal(struct stored_clear_journal* stored) {
+  stored->generation = sys_cpu_to_le16(clear_journal.generation);
+  stored->pending = clear_journal.pending;
+  for (uint8_t i = 0; i < clear_journal.pending; i++) {
+    stored->group[i] = sys_cpu_to_le32(clear_journal.group[i]);
+  }
+
+  return offsetof(struct stored_clear_journal, group) +
+         clear_journal.pending * sizeof(uint32_t);
+}
+
+// Removes the clears up to a generation from the journal once their DTCs are
+// stored
+static int retire_clears(uint16_t generation) {
+  struct stored_clear_journal stored;
+
+  k_mutex_lock(&dtc_journal_mutex, K_FOREVER);
+  k_mutex_lock(&dtc_mutex, K_FOREVER);
+
+  uint8_t pending = MIN(clear_journal.pending,
+                        (uint16_t)(clear_journal.generation - generation));
+  if (pending == clear_journal.pending) {
+    k_mutex_unlock(&dtc_mutex);
+    k_mutex_unlock(&dtc_journal_mutex);
+    return 0;
+  }
+
+  memmove(&clear_journal.group[0],
+          &clear_journal.group[clear_journal.pending - pending],
+          pending * sizeof(clear_journal.group[0]));
+  clear_journal.pending = pending;
+  size_t len = encode_clear_journal(&stored);
+
+  k_mutex_unlock(&dtc_mutex);
+
+  int ret = uds_dtc_storage_write(STORAGE_ID_CLEAR_JOURNAL, &stored, len);
+
+  k_mutex_unlock(&dtc_journal_mutex);
+  return ret;
+}
+
+static int persist_dtc_chunk(size_t chunk) {
+  k_mutex_lock(&dtc_mutex, K_FOREVER);
+
+  bitmap_clear(dtcs.dirty, chunk);
+
+  size_t first = chunk * 32;
+  size_t count = dtcs.count > first ? MIN(dtcs.count - first, 32) : 0;
+  persist_buf.chunk.generation = sys_cpu_to_le16(clear_journal.generation);
+  for (size_t i = 0; i < count; i++) {
+    persist_buf.chunk.dtcs[i] = (struct stored_dtc){
+      .number = sys_cpu_to_le32(dtcs.number[first + i]),
+      .status = dtcs.status[first + i] & PERSISTED_STATUS_BITS,
+      .occurrence_counter = dtcs.occurrence_counter[first + i],
+    };
+  }
+
+  k_mutex_unlock(&dtc_mutex);
+
+  return uds_dtc_storage_write(
+      STORAGE_ID_DTCS + chunk, &persist_buf.chunk,
+      offsetof(struct stored_dtc_chunk, dtcs) +
+          count * sizeof(struct stored_dtc));
+}
+
+static int persist_record(struct dtc_record_pool* pool, uint16_t index) {
+  k_mutex_lock(&dtc_mutex, K_FOREVER);
+
+  bitmap_clear(pool->dirty, index);
+
+  if (!bitmap_test(pool->used, index)) {
+    k_mutex_unlock(&dtc_mutex);
+    return uds_dtc_storage_delete(pool->storage_id + index);
+  }
+
+  struct stored_record header = {
+    .dtc = sys_cpu_to_le32(dtcs.number[pool->slot[index]]),
+    .record_number = pool->record_number[index],
+    .generation = sys_cpu_to_le16(clear_journal.generation),
+  };
+  size_t len = pool->len[index];
+  memcpy(persist_buf.record, &header, sizeof(header));
+  memcpy(&persist_buf.record[sizeof(header)], record_data(pool, index), len);
+
+  k_mutex_unlock(&dtc_mutex);
+
+  return uds_dtc_storage_write(pool->storage_id + index, persist_buf.record,
+                               sizeof(header) + len);
+}
+
+static int persist_records(struct dtc_record_pool* pool) {
+  for (size_t word = 0; word < BITMAP_WORDS(pool->capacity); word++) {
+    uint32_t dirty = pool->dirty[word];
+    while (dirty != 0) {
+      uint16_t index = word * 32 + pop_lowest_bit(&dirty);
+      int ret = persist_record(pool, index);
+      if (ret < 0) {
+        mark_record_dirty(pool, index);
+        return ret;
+      }
+    }
+  }
+
+  return 0;
+}
+
+static int persist(void) {
+  int ret = 0;
+
+  k_mutex_lock(&dtc_flush_mutex, K_FOREVER);
+
+  // The clears up to this generation marked their DTCs and records dirty
+  // before, so they are completely stored by this pass
+  k_mutex_lock(&dtc_mutex, K_FOREVER);
+  uint16_t generation = clear_journal.generation;
+  k_mutex_unlock(&dtc_mutex);
+
+  for (size_t word = 0; ret == 0 && word < ARRAY_SIZE(dtcs.dirty); word++) {
+    uint32_t dirty = dtcs.dirty[word];
+    while (ret == 0 && dirty != 0) {
+      size_t chunk = word * 32 + pop_lowest_bit(&dirty);
+      ret = persist_dtc_chunk(chunk);
+      if (ret < 0) {
+        mark_dtc_dirty(chunk * 32);
+      }
+    }
+  }
+
+  if (ret == 0) {
+    ret = persist_records(&snapshots);
+  }
+  if (ret == 0) {
+    ret = persist_records(&ext_data);
+  }
+  if (ret == 0) {
+    ret = retire_clears(generation);
+  }
+
+  k_mutex_unlock(&dtc_flush_mutex);
+
+  if (ret < 0) {
+    LOG_ERR("Failed to store DTCs: %d", ret);
+  }
+
+  return ret;
+}
+
+static void dtc_persist_work_handler(struct k_work* work) {
+  ARG_UNUSED(work);
+
+  persist();
+}
+
+static int load_clear_journal(void) {
+  struct stored_clear_journal stored;
+
+  ssize_t len =
+      uds_dtc_storage_read(STORAGE_ID_CLEAR_JOURNAL, &stored, sizeof(stored));
+  if (len == -ENOENT) {
+    return 0;
+  }
+  if (len < 0) {
+    return len;
+  }
+  if ((size_t)len < offsetof(struct stored_clear_journal, group)) {
+    return -EINVAL;
+  }
+
+  uint8_t stored_groups =
+      (len - offsetof(struct stored_clear_journal, group)) / sizeof(uint32_t);
+  if (stored.pending > stored_groups) {
+    // Written with a larger journal size
+    LOG_WRN("Only %u of %u pending DTC clears are restored", stored_groups,
+            stored.pending);
+  }
+
+  clear_journal.pending = MIN(stored.pending, stored_groups);
+  clear_journal.generation = sys_le16_to_cpu(stored.generation);
+  for (uint8_t i = 0; i < clear_journal.pending; i++) {
+    clear_journal.group[i] = sys_le32_to_cpu(stored.group[i]);
+  }
+
+  return 0;
+}
+
+static int load_dtcs(void) {
+  bool rewrite = false;
+
+  for (size_t chunk = 0; chunk < DTC_WORDS; chunk++) {
+    ssize_t len =
+        uds_dtc_storage_read(STORAGE_ID_DTCS + chunk, &persist_buf.chunk,
+                             sizeof(persist_buf.chunk));
+    if (len == -ENOENT) {
+      continue;
+    }
+    if (len < 0) {
+      return len;
+    }
+    if ((size_t)len < offsetof(struct stored_dtc_chunk, dtcs)) {
+      continue;
+    }
+
+    uint16_t generation = sys_le16_to_cpu(persist_buf.chunk.generation);
+    size_t count = (len - offsetof(struct stored_dtc_chunk, dtcs)) /
+                   sizeof(struct stored_dtc);
+    for (size_t i = 0; i < count; i++) {
+      const struct stored_dtc* stored = &persist_buf.chunk.dtcs[i];
+      uint32_t number = sys_le32_to_cpu(stored->number);
+      bool added;
+
+      int slot = register_dtc(number, &added);
+      if (slot < 0 || !added) {
+        continue;
+      }
+
+      set_status(slot,
+                 (stored->status & PERSISTED_STATUS_BITS) |
+                     UDS_DTC_STATUS_TEST_NOT_COMPLETED_THIS_OPERATION_CYCLE);
+      dtcs.occurrence_counter[slot] = stored->occurrence_counter;
+      rewrite |= (size_t)slot != chunk * 32 + i;
+
+      // Interrupted by a reset before the DTC was stored cleared
+      if (cleared_after(generation, number)) {
+        set_status(slot, INITIAL_STATUS);
+        dtcs.occurrence_counter[slot] = 0;
+        rewrite = true;
+      }
+    }
+  }
+
+  // The loaded entries are only written again if DTCs moved to other slots
+  // or a clear has to be stored
+  if (!rewrite) {
+    memset(dtcs.dirty, 0, sizeof(dtcs.dirty));
+  }
+
+  return 0;
+}
+
+static int load_records(struct dtc_record_pool* pool) {
+  for (uint16_t i = 0; i < pool->capacity; i++) {
+    struct stored_record header;
+
+    ssize_t len = uds_dtc_storage_read(pool->storage_id + i, persist_buf.record,
+                                       sizeof(persist_buf.record));
+    if (len == -ENOENT) {
+      continue;
+    }
+    if (len < 0) {
+      return len;
+    }
+
+    memcpy(&header, persist_buf.record, sizeof(header));
+    uint32_t dtc = sys_le32_to_cpu(header.dtc);
+    int slot = find_slot(dtc);
+    if (slot < 0 || (size_t)len <= sizeof(header) ||
+        (size_t)len - sizeof(header) > pool->record_size ||
+        cleared_after(sys_le16_to_cpu(header.generation), dtc)) {
+      // Deleted by the next write
+      mark_record_dirty(pool, i);
+      continue;
+    }
+
+    bitmap_set(pool->used, i);
+    pool->slot[i] = slot;
+    pool->record_number[i] = header.record_number;
+    pool->len[i] = len - sizeof(header);
+    memcpy(record_data(pool, i), &persist_buf.record[sizeof(header)],
+           pool->len[i]);
+  }
+
+  return 0;
+}
+
+static int load(void) {
+  int ret = uds_dtc_storage_mount();
+  if (ret < 0) {
+    return ret;
+  }
+
+  ret = load_clear_journal();
+  if (ret == 0) {
+    ret = load_dtcs();
+  }
+  if (ret == 0) {
+    ret = load_records(&snapshots);
+  }
+  if (ret == 0) {
+    ret = load_records(&ext_data);
+  }
+  if (ret < 0) {
+    LOG_ERR("Failed to load DTCs: %d", ret);
+    return ret;
+  }
+
+  if (clear_journal.pending > 0) {
+    LOG_INF("Completing %u interrupted DTC clears", clear_journal.pending);
+    k_work_reschedule_for_queue(&dtc_work_q, &dtc_persist_work, K_NO_WAIT);
+  }
+
+  LOG_INF("Loaded %u DTCs", dtcs.count);
+  return 0;
+}
+#endif  // CONFIG_UDS_DTC_MANAGER_PERSISTENCE
+
+static void reset_record_pool(struct dtc_record_pool* pool) {
+  memset(pool->used, 0, BITMAP_WORDS(pool->capacity) * sizeof(uint32_t));
+#ifdef CONFIG_UDS_DTC_MANAGER_PERSISTENCE
+  memset(pool->dirty, 0, BITMAP_WORDS(pool->capacity) * sizeof(uint32_t));
+#endif
+}
+
+int uds_dtc_manager_init(void) {
+  int ret = 0;
+
+#ifdef CONFIG_UDS_DTC_MANAGER_PERSISTENCE
+  struct k_work_sync sync;
+  k_work_cancel_delayable_sync(&dtc_persist_work, &sync);
+  k_mutex_lock(&dtc_flush_mutex, K_FOREVER);
+  k_mutex_lock(&dtc_journal_mutex, K_FOREVER);
+#endif
+
+  k_mutex_lock(&dtc_mutex, K_FOREVER);
+
+  memset(&dtcs, 0, sizeof(dtcs));
+  reset_record_pool(&snapshots);
+  reset_record_pool(&ext_data);
+#ifdef CONFIG_UDS_DTC_MANAGER_PERSISTENCE
+  memset(&clear_journal, 0, sizeof(clear_journal));
+#endif
+
+#ifdef CONFIG_UDS_DTC_MANAGER_PERSISTENCE
+  ret = load();
+#endif
+
+  k_mutex_unlock(&dtc_mutex);
+
+#ifdef CONFIG_UDS_DTC_MANAGER_PERSISTENCE
+  k_mutex_unlock(&dtc_journal_mutex);
+  k_mutex_unlock(&dtc_flush_mutex);
+#endif
+
+  return ret;
+}
+
+static int dtc_manager_sys_init(void) {
+#ifdef CONFIG_UDS_DTC_MANAGER_STATS
+  int ret = STATS_INIT_AND_REG(uds_dtc_manager_stats, STATS_SIZE_32,
+                               "uds_dtc_manager");
+  if (ret < 0) {
+    LOG_ERR("Failed to register the DTC manager stats: %d", ret);
+    return ret;
+  }
+#endif
+
+#ifdef CONFIG_UDS_DTC_MANAGER_PERSISTENCE
+  k_work_queue_start(&dtc_work_q, dtc_work_q_stack,
+                     K_THREAD_STACK_SIZEOF(dtc_work_q_stack),
+                     CONFIG_UDS_DTC_MANAGER_WORKQUEUE_PRIORITY, NULL);
+  k_thread_name_set(&dtc_work_q.thread, "dtc_storage");
+#endif
+
+  return uds_dtc_manager_init();
+}
+
+SYS_INIT(dtc_manager_sys_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+int uds_dtc_manager_flush(void) {
+#ifdef CONFIG_UDS_DTC_MANAGER_PERSISTENCE
+  k_work_cancel_delayable(&dtc_persist_work);
+  return persist();
+#else
+  return 0;
+#endif
+}
+
+int uds_dtc_register(uint32_t dtc) {
+  bool added;
+
+  if (dtc > 0xFFFFFF) {
+    return -EINVAL;
+  }
+
+  k_mutex_lock(&dtc_mutex, K_FOREVER);
+  int ret = register_dtc(dtc, &added);
+  k_mutex_unlock(&dtc_mutex);
+
+  return ret < 0 ? ret : 0;
+}
+
+int uds_dtc_report(uint32_t dtc, bool failed) {
+  k_mutex_lock(&dtc_mutex, K_FOREVER);
+
+  int slot = find_slot(dtc);
+  if (slot < 0) {
+    k_mutex_unlock(&dtc_mutex);
+    return slot;
+  }
+
+  uint8_t status = dtcs.status[slot];
+  if (failed) {
+    if ((status & UDS_DTC_STATUS_TEST_FAILED) == 0) {
+      set_occurrence_counter(
+          slot, MIN(dtcs.occurrence_counter[slot] + 1, UINT8_MAX));
+    }
+    status |= UDS_DTC_STATUS_TEST_FAILED |
+              UDS_DTC_STATUS_TEST_FAILED_THIS_OPERATION_CYCLE |
+              UDS_DTC_STATUS_PENDING_DTC |
+              UDS_DTC_STATUS_TEST_FAILED_SINCE_LAST_CLEAR;
+    if (dtcs.occurrence_counter[slot] >=
+        CONFIG_UDS_DTC_MANAGER_CONFIRMATION_THRESHOLD) {
+      status |= UDS_DTC_STATUS_CONFIRMED_DTC;
+    }
+  } else {
+    status &= ~UDS_DTC_STATUS_TEST_FAILED;
+  }
+  status &= ~(UDS_DTC_STATUS_TEST_NOT_COMPLETED_SINCE_LAST_CLEAR |
+              UDS_DTC_STATUS_TEST_NOT_COMPLETED_THIS_OPERATION_CYCLE);
+  set_status(slot, status);
+
+  k_mutex_unlock(&dtc_mutex);
+  return 0;
+}
+
+void uds_dtc_start_operation_cycle(void) {
+  k_mutex_lock(&dtc_mutex, K_FOREVER);
+
+  for (uint16_t slot = 0; slot < dtcs.count; slot++) {
+    uint8_t status = dtcs.status[slot];
+
+    // The test completed in the last cycle without failing
+    if ((status & (UDS_DTC_STATUS_TEST_FAILED_THIS_OPERATION_CYCLE |
+                   UDS_DTC_STATUS_TEST_NOT_COMPLETED_THIS_OPERATION_CYCLE)) ==
+        0) {
+      status &= ~UDS_DTC_STATUS_PENDING_DTC;
+    }
+
+    status &= ~UDS_DTC_STATUS_TEST_FAILED_THIS_OPERATION_CYCLE;
+    status |= UDS_DTC_STATUS_TEST_NOT_COMPLETED_THIS_OPERATION_CYCLE;
+    set_status(slot, status);
+  }
+
+  k_mutex_unlock(&dtc_mutex);
+}
+
+int uds_dtc_get_status(uint32_t dtc,
+                       uint8_t* status,
+                       uint8_t* occurrence_counter) {
+  k_mutex_lock(&dtc_mutex, K_FOREVER);
+
+  int slot = find_slot(dtc);
+  if (slot >= 0) {
+    if (status != NULL) {
+      *status = dtcs.status[slot];
+    }
+    if (occurrence_counter != NULL) {
+      *occurrence_counter = dtcs.occurrence_counter[slot];
+    }
+  }
+
+  k_mutex_unlock(&dtc_mutex);
+  return slot < 0 ? slot : 0;
+}
+
+int uds_dtc_set_warning_indicator(uint32_t dtc, bool requested) {
+  k_mutex_lock(&dtc_mutex, K_FOREVER);
+
+  int slot = find_slot(dtc);
+  if (slot >= 0) {
+    uint8_t status = dtcs.status[slot];
+    if (requested) {
+      status |= UDS_DTC_STATUS_WARNING_INDICATOR_REQUESTED;
+    } else {
+      status &= ~UDS_DTC_STATUS_WARNING_INDICATOR_REQUESTED;
+    }
+    set_status(slot, status);
+  }
+
+  k_mutex_unlock(&dtc_mutex);
+  return slot < 0 ? slot : 0;
+}
+
+uint16_t uds_dtc_count_by_status_mask(uint8_t status_mask) {
+  k_mutex_lock(&dtc_mutex, K_FOREVER);
+  uint16_t count = count_by_status_mask(status_mask & AVAILABILITY_MASK);
+  k_mutex_unlock(&dtc_mutex);
+
+  return count;
+}
+
+int uds_dtc_store_snapshot(uint32_t dtc,
+                           uint8_t record_number,
+                           const uint8_t* data,
+                           size_t len) {
+  if (record_number == 0x00 || record_number == UDS_DTC_RECORD_NUMBER_ALL) {
+    return -EINVAL;
+  }
+
+  return store_record(&snapshots, dtc, record_number, data, len);
+}
+
+int uds_dtc_store_extended_data(uint32_t dtc,
+                                uint8_t record_number,
+                                const uint8_t* data,
+                                size_t len) {
+  // 0xFE and 0xFF select groups of records in requests
+  if (record_number == 0x00 || record_number >= 0xFE) {
+    return -EINVAL;
+  }
+
+  return store_record(&ext_data, dtc, record_number, data, len);
+}
+
+static int clear_group(uint32_t group) {
+  if (group == UDS_DTC_GROUP_ALL) {
+    for (uint16_t slot = 0; slot < dtcs.count; slot++) {
+      clear_dtc(slot);
+    }
+    return 0;
+  }
+
+  int slot = find_slot(group);
+  if (slot < 0) {
+    return slot;
+  }
+
+  clear_dtc(slot);
+  return 0;
+}
+
+int uds_dtc_clear(uint32_t group) {
+#ifdef CONFIG_UDS_DTC_MANAGER_PERSISTENCE
+  struct stored_clear_journal stored;
+  size_t len = 0;
+
+  k_mutex_lock(&dtc_journal_mutex, K_FOREVER);
+  if (clear_journal.pending == ARRAY_SIZE(clear_journal.group)) {
+    k_mutex_unlock(&dtc_journal_mutex);
+
+    // Stores the previous clears in the background to make room in the
+    // journal, the caller tries again later
+    k_work_reschedule_for_queue(&dtc_work_q, &dtc_persist_work, K_NO_WAIT);
+    return -EBUSY;
+  }
+#endif
+
+  k_mutex_lock(&dtc_mutex, K_FOREVER);
+
+  int ret = clear_group(group);
+#ifdef CONFIG_UDS_DTC_MANAGER_PERSISTENCE
+  if (ret == 0) {
+    journal_clear(group);
+    len = encode_clear_journal(&stored);
+  }
+#endif
+
+  k_mutex_unlock(&dtc_mutex);
+
+#ifdef CONFIG_UDS_DTC_MANAGER_PERSISTENCE
+  if (ret == 0) {
+    // Only the journal is written before returning, the cleared DTCs and
+    // records are written in the background
+    ret = uds_dtc_storage_write(STORAGE_ID_CLEAR_JOURNAL, &stored, len);
+    k_work_reschedule_for_queue(&dtc_work_q, &dtc_persist_work, K_NO_WAIT);
+  }
+
+  k_mutex_unlock(&dtc_journal_mutex);
+#endif
+
+  return ret;
+}
+
+UDSErr_t uds_check_default_read_dtc_info(
+    const struct uds_context* const context, bool* apply_action) {
+  *apply_action = true;
+  return UDS_OK;
+}
+
+static UDSErr_t report_number_of_dtc_by_status_mask(
+    const struct uds_context* const context,
+    const UDSRDTCIArgs_t* args,
+    uint8_t status_mask) {
+  uint8_t response[4] = {AVAILABILITY_MASK, DTC_FORMAT_ISO_14229_1};
+  sys_put_be16(count_by_status_mask(status_mask), &response[2]);
+
+  return args->copy(context->server, response, sizeof(response));
+}
+
+// Copies the DTC and status records of the slots in a bitmap word at once
+static UDSErr_t copy_dtc_records(const struct uds_context* const context,
+                                 const UDSRDTCIArgs_t* args,
+                                 size_t word,
+                                 uint32_t slots) {
+  uint8_t records[32 * 4];
+  size_t len = 0;
+
+  UDS_DTC_MANAGER_STATS_INC(words);
+
+  while (slots != 0) {
+    uint16_t slot = word * 32 + pop_lowest_bit(&slots);
+    UDS_DTC_MANAGER_STATS_INC(dtcs);
+    sys_put_be24(dtcs.number[slot], &records[len]);
+    records[len + 3] = dtcs.status[slot] & AVAILABILITY_MASK;
+    len += 4;
+  }
+
+  if (len == 0) {
+    return UDS_OK;
+  }
+
+  return args->copy(context->server, records, len);
+}
+
+static UDSErr_t report_dtc_by_status_mask(
+    const struct uds_context* const context,
+    const UDSRDTCIArgs_t* args,
+    bool supported_dtc,
+    uint8_t status_mask) {
+  const uint8_t availability_mask = AVAILABILITY_MASK;
+
+  UDSErr_t ret = args->copy(context->server, &availability_mask,
+                            sizeof(availability_mask));
+
+  for (size_t word = 0; ret == UDS_OK && word < DTC_WORDS; word++) {
+    uint32_t slots = supported_dtc ? match_registered(word)
+                                   : match_status_mask(status_mask, word);
+    ret = copy_dtc_records(context, args, word, slots);
+  }
+
+  return ret;
+}
+
+static UDSErr_t report_records_by_dtc_number(
+    const struct uds_context* const context,
+    const UDSRDTCIArgs_t* args,
+    const struct dtc_record_pool* pool,
+    uint32_t dtc,
+    uint8_t record_number) {
+  int slot = find_slot(dtc);
+  if (slot < 0) {
+    return UDS_NRC_RequestOutOfRange;
+  }
+
+  UDSErr_t ret = copy_dtc_records(context, args, slot / 32, BIT(slot % 32));
+
+  for (uint16_t i = 0; ret == UDS_OK && i < pool->capacity; i++) {
+    if (!bitmap_test(pool->used, i) || pool->slot[i] != slot ||
+        (record_number != UDS_DTC_RECORD_NUMBER_ALL &&
+         record_number != pool->record_number[i])) {
+      continue;
+    }
+
+    ret = args->copy(context->server, &pool->record_number[i], 1);
+    if (ret == UDS_OK) {
+      ret = args->copy(context->server, record_data(pool, i), pool->len[i]);
+    }
+  }
+
+  return ret;
+}
+
+UDSErr_t uds_action_default_read_dtc_info(struct uds_context* const context,
+                                          bool* consume_event) {
+  UDSRDTCIArgs_t* args = context->arg;
+  UDSErr_t ret;
+
+  k_mutex_lock(&dtc_mutex, K_FOREVER);
+
+  switch (args->type) {
+    case UDS_READ_DTC_INFO_SUBFUNC__NUM_OF_DTC_BY_STATUS_MASK:
+      ret = report_number_of_dtc_by_status_mask(
+          context, args,
+          args->subFuncArgs.numOfDTCByStatusMaskArgs.mask & AVAILABILITY_MASK);
+      break;
+    case UDS_READ_DTC_INFO_SUBFUNC__DTC_BY_STATUS_MASK:
+      ret = report_dtc_by_status_mask(
+          context, args, false,
+          args->subFuncArgs.numOfDTCByStatusMaskArgs.mask & AVAILABILITY_MASK);
+      break;
+    case UDS_READ_DTC_INFO_SUBFUNC__SUPPORTED_DTC:
+      ret = report_dtc_by_status_mask(context, args, true, 0);
+      break;
+    case UDS_READ_DTC_INFO_SUBFUNC__DTC_SNAPSHOT_RECORD_BY_DTC_NUM:
+      ret = report_records_by_dtc_number(
+          context, args, &snapshots,
+          args->subFuncArgs.dtcSnapshotRecordbyDTCNumArgs.dtc,
+          args->subFuncArgs.dtcSnapshotRecordbyDTCNumArgs.snapRecNum);
+      break;
+    case UDS_READ_DTC_INFO_SUBFUNC__DTC_EXT_DATA_RECORD_BY_DTC_NUM:
+      ret = report_records_by_dtc_number(
+          context, args, &ext_data,
+          args->subFuncArgs.dtcExtDtaRecordByDTCNumArgs.dtc,
+          args->subFuncArgs.dtcExtDtaRecordByDTCNumArgs.extDataRecNum);
+      break;
+    default:
+      ret = UDS_NRC_SubFunctionNotSupported;
+      break;
+  }
+
+  k_mutex_unlock(&dtc_mutex);
+
+  *consume_event = true;
+  return ret;
+}
+
+UDSErr_t uds_check_default_clear_diag_info(
+    const struct uds_context* const context, bool* apply_action) {
+  *apply_action = true;
+  return UDS_OK;
+}
+
+UDSErr_t uds_action_default_clear_diag_info(struct uds_context* const context,
+                                            bool* consume_event) {
+  UDSCDIArgs_t* args = context->arg;
+
+  *consume_event = true;
+
+  // Only the primary DTC memory is managed
+  if (args->hasMemorySelection) {
+    return UDS_NRC_RequestOutOfRange;
+  }
+
+  // Returns once the clear is journaled, so the DTCs stay cleared after a
+  // reset without waiting for the storage to be rewritten
+  int ret = uds_dtc_clear(args->groupOfDTC);
+  if (ret == -ENOENT) {
+    return UDS_NRC_RequestOutOfRange;
+  }
+  if (ret == -EBUSY) {
+    // The server calls the handler again until the journal has room
+    return UDS_NRC_RequestCorrectlyReceived_ResponsePending;
+  }
+  if (ret < 0) {
+    return UDS_NRC_GeneralProgrammingFailure;
+  }
+
+  return UDS_PositiveResponse;
+}
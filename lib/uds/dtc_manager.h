@@ -0,0 +1,27 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (C) Frickly Systems GmbH
+ * SPDX-FileCopyrightText: Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef UDS_DTC_MANAGER_H
+#define UDS_DTC_MANAGER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <sys/types.h>
+
+// Key-value backend the DTC manager persists its entries with
+
+// Mounts the storage in the dtc_partition
+int uds_dtc_storage_mount(void);
+// Reads an entry, returns its length or -ENOENT if it does not exist
+ssize_t uds_dtc_storage_read(uint16_t id, void* data, size_t len);
+// Writes an entry
+int uds_dtc_storage_write(uint16_t id, const void* data, size_t len);
+// Deletes an entry, deleting a missing entry is not an error
+int uds_dtc_storage_delete(uint16_t id);
+
+#endif  // UDS_DTC_MANAGER_H
@@ -0,0 +1,81 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (C) Frickly Systems GmbH
+ * SPDX-FileCopyrightText: Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_DECLARE(uds, CONFIG_UDS_LOG_LEVEL);
+
+#include "dtc_manager.h"
+
+#include <errno.h>
+
+#include <zephyr/device.h>
+#include <zephyr/drivers/flash.h>
+#include <zephyr/storage/flash_map.h>
+
+#ifdef CONFIG_UDS_DTC_MANAGER_STORAGE_NVS
+#include <zephyr/fs/nvs.h>
+
+static struct nvs_fs dtc_fs;
+
+#define STORAGE_MOUNT nvs_mount
+#define STORAGE_READ nvs_read
+#define STORAGE_WRITE nvs_write
+#define STORAGE_DELETE nvs_delete
+#endif
+
+#ifdef CONFIG_UDS_DTC_MANAGER_STORAGE_ZMS
+#include <zephyr/fs/zms.h>
+
+static struct zms_fs dtc_fs;
+
+#define STORAGE_MOUNT zms_mount
+#define STORAGE_READ zms_read
+#define STORAGE_WRITE zms_write
+#define STORAGE_DELETE zms_delete
+#endif
+
+int uds_dtc_storage_mount(void) {
+  struct flash_pages_info info;
+
+  dtc_fs.flash_device = FIXED_PARTITION_DEVICE(dtc_partition);
+  if (!device_is_ready(dtc_fs.flash_device)) {
+    LOG_ERR("DTC storage device not ready");
+    return -ENODEV;
+  }
+
+  dtc_fs.offset = FIXED_PARTITION_OFFSET(dtc_partition);
+  int ret = flash_get_page_info_by_offs(dtc_fs.flash_device, dtc_fs.offset,
+                                        &info);
+  if (ret < 0) {
+    LOG_ERR("Failed to get page info of the DTC storage: %d", ret);
+    return ret;
+  }
+
+  dtc_fs.sector_size = info.size;
+  dtc_fs.sector_count = FIXED_PARTITION_SIZE(dtc_partition) / info.size;
+
+  ret = STORAGE_MOUNT(&dtc_fs);
+  if (ret < 0) {
+    LOG_ERR("Failed to mount the DTC storage: %d", ret);
+  }
+
+  return ret;
+}
+
+ssize_t uds_dtc_storage_read(uint16_t id, void* data, size_t len) {
+  return STORAGE_READ(&dtc_fs, id, data, len);
+}
+
+int uds_dtc_storage_write(uint16_t id, const void* data, size_t len) {
+  ssize_t ret = STORAGE_WRITE(&dtc_fs, id, data, len);
+
+  return ret < 0 ? (int)ret : 0;
+}
+
+int uds_dtc_storage_delete(uint16_t id) {
+  return STORAGE_DELETE(&dtc_fs, id);
+}
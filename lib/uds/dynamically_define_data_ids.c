@@ -7,7 +7,8 @@
 
 #ifdef CONFIG_UDS_USE_DYNAMIC_REGISTRATION
 
-/* Requires: a handler for read_memory_by_address and read_data_by_id */
+/* Requires: a handler for read_data_by_id, and for read_memory_by_address if
+ * memory outside of the memory map is used */
 
 #include <zephyr/logging/log.h>
 LOG_MODULE_DECLARE(uds, CONFIG_UDS_LOG_LEVEL);
@@ -120,7 +121,24 @@ static UDSErr_t uds_dynamic_data_by_id_read_data_by_id_action(
       }
     }
 
-    if (data->type == UDS_DYNAMICALLY_DEFINED_DATA_TYPE__MEMORY) {
+    if (data->type == UDS_DYNAMICALLY_DEFINED_DATA_TYPE__MEMORY &&
+        data->memory.map != NULL) {
+      // Session or security level may have changed since the definition
+      bool mmio = false;
+      UDSErr_t nrc = uds_memory_map_check(
+          data->memory.map, context->server, (uintptr_t)data->memory.memAddr,
+          data->memory.memSize, UDS_MEMORY_ACCESS_READ, &mmio);
+      if (nrc != UDS_OK) {
+        return nrc;
+      }
+
+      int ret = uds_memory_read(context->server, parent_read_args->copy,
+                                (uintptr_t)data->memory.memAddr,
+                                data->memory.memSize, mmio);
+      if (ret != UDS_PositiveResponse) {
+        return ret;
+      }
+    } else if (data->type == UDS_DYNAMICALLY_DEFINED_DATA_TYPE__MEMORY) {
       UDSReadMemByAddrArgs_t child_args = {.memAddr = data->memory.memAddr,
                                            .memSize = data->memory.memSize,
                                            .copy = parent_read_args->copy};
@@ -192,7 +210,9 @@ static UDSErr_t uds_append_dynamic_data_identifiers_to_registration(
 }
 
 static UDSErr_t uds_append_dynamic_memory_addresses_to_registration(
-    UDSDDDIArgs_t* args, sys_slist_t* data_list) {
+    UDSDDDIArgs_t* args,
+    sys_slist_t* data_list,
+    const struct uds_memory_map* map) {
   void* memAddr = args->subFuncArgs.defineByMemAddress.memAddr;
   size_t memSize = args->subFuncArgs.defineByMemAddress.memSize;
 
@@ -219,6 +239,7 @@ static UDSErr_t uds_append_dynamic_memory_addresses_to_registration(
   data->type = UDS_DYNAMICALLY_DEFINED_DATA_TYPE__MEMORY;
   data->memory.memAddr = memAddr;
   data->memory.memSize = memSize;
+  data->memory.map = map;
   data->node = (sys_snode_t){0};
 
   sys_slist_append(data_list, &data->node);
@@ -390,6 +411,26 @@ static UDSErr_t uds_dynamicallY_define_data_by_memory_address_add_new_id(
     struct uds_context* const context, bool* consume_event) {
   UDSDDDIArgs_t* args = context->arg;
 
+  // Memory of the memory map is checked here and again on every read, other
+  // memory is read through the read memory by address handlers
+  const struct uds_memory_map* map = uds_memory_map_get_default();
+  uintptr_t mem_addr =
+      (uintptr_t)args->subFuncArgs.defineByMemAddress.memAddr;
+  if (uds_memory_map_find(map, mem_addr) == NULL) {
+    map = NULL;
+  }
+  if (map != NULL) {
+    UDSErr_t nrc = uds_memory_map_check(
+        map, context->server, mem_addr,
+        args->subFuncArgs.defineByMemAddress.memSize, UDS_MEMORY_ACCESS_READ,
+        NULL);
+    if (nrc != UDS_OK) {
+      LOG_WRN("Memory 0x%08lX of dynamic data identifier 0x%04X not readable",
+              (unsigned long)mem_addr, args->dynamicDataId);
+      return nrc;
+    }
+  }
+
   struct uds_registration_t* read_data_by_id_reg = NULL;
   int ret = uds_find_existing_registration_by_data_id(
       context, args->dynamicDataId, &read_data_by_id_reg);
@@ -408,7 +449,8 @@ static UDSErr_t uds_dynamicallY_define_data_by_memory_address_add_new_id(
 
   sys_slist_t* data_list = read_data_by_id_reg->data_identifier.data;
 
-  ret = uds_append_dynamic_memory_addresses_to_registration(args, data_list);
+  ret = uds_append_dynamic_memory_addresses_to_registration(args, data_list,
+                                                            map);
   if (ret != UDS_OK) {
     if (!is_existing_registration) {
       // If we created a new registration but failed to add data, clean it up
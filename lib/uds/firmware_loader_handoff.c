@@ -0,0 +1,105 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (C) Frickly Systems GmbH
+ * SPDX-FileCopyrightText: Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_DECLARE(uds, CONFIG_UDS_LOG_LEVEL);
+
+#include "uds.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/drivers/can.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
+
+#include <ardep/uds.h>
+#include <iso14229.h>
+
+// suppressPosRspMsgIndicationBit of the sub-function byte
+#define SUPPRESS_POS_RESPONSE_BIT 0x80
+
+// The default of isotp-c, which pads its frames with the same value
+#ifndef ISO_TP_FRAME_PADDING_VALUE
+#define ISO_TP_FRAME_PADDING_VALUE 0xAA
+#endif
+
+int uds_firmware_loader_handoff_capture(
+    const struct uds_context* const context,
+    struct uds_firmware_loader_handoff* handoff) {
+  if (context->event != UDS_EVT_DiagSessCtrl) {
+    return -EINVAL;
+  }
+
+  const UDSDiagSessCtrlArgs_t* args = context->arg;
+  const UDSServer_t* server = context->server;
+
+  *handoff = (struct uds_firmware_loader_handoff){
+    .session_type = args->type,
+    .p2_ms = args->p2_ms,
+    .p2_star_ms = args->p2_star_ms,
+    .tester_address = context->instance->iso14229.tp.phys_ta,
+  };
+
+  if ((server->r.recv_buf[1] & SUPPRESS_POS_RESPONSE_BIT) == 0) {
+    handoff->flags |= UDS_FIRMWARE_LOADER_HANDOFF_RESPONSE_PENDING;
+  }
+
+  return 0;
+}
+
+static void handoff_response_sent(const struct device* dev,
+                                  int error,
+                                  void* user_data) {
+  ARG_UNUSED(dev);
+  ARG_UNUSED(user_data);
+
+  if (error != 0) {
+    LOG_ERR("Failed to send handed over response: %d", error);
+  }
+}
+
+int uds_firmware_loader_handoff_resume(
+    struct uds_instance_t* instance,
+    const struct uds_firmware_loader_handoff* handoff) {
+  UDSServer_t* server = &instance->iso14229.server;
+
+  if (handoff->p2_ms != 0) {
+    server->p2_ms = handoff->p2_ms;
+    server->p2_star_ms = handoff->p2_star_ms;
+  }
+
+  server->sessionType = handoff->session_type;
+  // A session change locks security access, and the handed over state in RAM
+  // is no proof that the tester authenticated, so it is not restored
+  server->securityLevel = 0;
+  server->s3_session_timeout_timer = UDSMillis() + server->s3_ms;
+
+  LOG_INF("Resumed session 0x%02x %u ms after boot", handoff->session_type,
+          k_uptime_get_32());
+
+  if ((handoff->flags & UDS_FIRMWARE_LOADER_HANDOFF_RESPONSE_PENDING) == 0) {
+    return 0;
+  }
+
+  // The positive response fits into a single frame, so it is sent without
+  // going through ISO-TP and the UDS thread
+  struct can_frame frame = {
+    .id = handoff->tester_address != 0 ? handoff->tester_address
+                                       : instance->iso14229.tp.phys_ta,
+    .dlc = 8,
+  };
+  memset(frame.data, ISO_TP_FRAME_PADDING_VALUE, can_dlc_to_bytes(frame.dlc));
+  frame.data[0] = 0x06;  // PCI (single frame, 6 bytes of data)
+  frame.data[1] = 0x50;  // positive response to DiagnosticSessionControl
+  frame.data[2] = handoff->session_type;
+  sys_put_be16(server->p2_ms, &frame.data[3]);
+  sys_put_be16(server->p2_star_ms / 10, &frame.data[5]);
+
+  return can_send(instance->can_dev, &frame, K_NO_WAIT, handoff_response_sent,
+                  NULL);
+}
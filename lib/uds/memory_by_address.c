@@ -9,7 +9,6 @@
 #include "uds.h"
 
 #include <zephyr/kernel.h>
-#include <zephyr/linker/linker-defs.h>
 #include <zephyr/logging/log.h>
 #include <zephyr/sys/util.h>
 
@@ -18,53 +17,23 @@
 LOG_MODULE_DECLARE(uds, CONFIG_UDS_LOG_LEVEL);
 
 /**
- * Check if the requested memory address range is within valid memory bounds
+ * Check the requested memory address range against the default memory map
+ * @param server Server with the current session and security level
  * @param addr Starting address to check
  * @param size Size of memory region to check
- * @param readonly Set to `true` if the specified region should be read
- *                 (not written)
- * @return true if address range is valid, false otherwise
+ * @param access UDS_MEMORY_ACCESS_READ or UDS_MEMORY_ACCESS_WRITE
+ * @return UDS_OK if the access is allowed, the NRC otherwise
  */
-static bool is_memory_address_valid(uintptr_t addr,
+static UDSErr_t check_memory_access(const UDSServer_t* server,
+                                    uintptr_t addr,
                                     size_t size,
-                                    bool readonly) {
-  // Prevent overflow
-  if (addr > UINTPTR_MAX - size) {
-    LOG_ERR("Memory address overflow detected");
-    return false;
+                                    uint8_t access) {
+  UDSErr_t ret = uds_memory_map_check(uds_memory_map_get_default(), server,
+                                      addr, size, access, NULL);
+  if (ret != UDS_OK) {
+    LOG_ERR("Memory address 0x%08lX not in valid range", (unsigned long)addr);
   }
-
-#if CONFIG_BOARD_NATIVE_SIM
-  return true;  // In simulation, allow all addresses
-#else
-// Check SRAM address range
-#if DT_HAS_CHOSEN(zephyr_sram) && DT_NODE_HAS_PROP(DT_CHOSEN(zephyr_sram), reg)
-#define RAM_NODE DT_CHOSEN(zephyr_sram)
-  const static uintptr_t ram_base = DT_REG_ADDR(RAM_NODE);
-  const static uintptr_t ram_end = ram_base + DT_REG_SIZE(RAM_NODE);
-
-  if (addr >= ram_base && (addr + size) <= ram_end) {
-    return true;
-  }
-#endif
-
-// Flash memory range check
-#if DT_HAS_CHOSEN(zephyr_flash) && \
-    DT_NODE_HAS_PROP(DT_CHOSEN(zephyr_flash), reg)
-#define FLASH_NODE DT_CHOSEN(zephyr_flash)
-  if (readonly) {
-    const static uintptr_t flash_base = DT_REG_ADDR(FLASH_NODE);
-    const static uintptr_t flash_end = flash_base + DT_REG_SIZE(FLASH_NODE);
-
-    if (addr >= flash_base && (addr + size) <= flash_end) {
-      return true;
-    }
-  }
-#endif
-
-  LOG_ERR("Memory address 0x%08lX not in valid range", (unsigned long)addr);
-  return false;
-#endif
+  return ret;
 }
 
 uds_check_fn uds_get_check_for_read_memory_by_addr(
@@ -121,11 +90,13 @@ UDSErr_t uds_check_default_memory_by_addr_read(
   LOG_DBG("Read Memory By Address: addr=0x%08lX, size=%zu",
           (unsigned long)mem_addr, args->memSize);
 
-  if (!is_memory_address_valid(mem_addr, args->memSize, true)) {
+  UDSErr_t ret = check_memory_access(context->server, mem_addr, args->memSize,
+                                     UDS_MEMORY_ACCESS_READ);
+  if (ret != UDS_OK) {
     LOG_WRN("Read Memory By Address: Invalid address range 0x%08lX-0x%08lX",
             (unsigned long)mem_addr,
             (unsigned long)(mem_addr + args->memSize - 1));
-    return UDS_NRC_RequestOutOfRange;
+    return ret;
   }
 
   *apply_action = true;
@@ -137,8 +108,18 @@ UDSErr_t uds_action_default_memory_by_addr_read(
   UDSReadMemByAddrArgs_t* args = context->arg;
   uintptr_t mem_addr = (uintptr_t)args->memAddr;
 
-  uint8_t copy_result =
-      args->copy(context->server, args->memAddr, args->memSize);
+  // The action may be paired with a custom check, so the range is checked
+  // again, which also looks up the kind of memory
+  bool mmio = false;
+  UDSErr_t nrc = uds_memory_map_check(uds_memory_map_get_default(),
+                                      context->server, mem_addr, args->memSize,
+                                      UDS_MEMORY_ACCESS_READ, &mmio);
+  if (nrc != UDS_OK) {
+    return nrc;
+  }
+
+  uint8_t copy_result = uds_memory_read(context->server, args->copy, mem_addr,
+                                        args->memSize, mmio);
   if (copy_result != UDS_PositiveResponse) {
     LOG_ERR("Read Memory By Address: Copy failed with result %d", copy_result);
     return UDS_NRC_RequestOutOfRange;
@@ -168,11 +149,13 @@ UDSErr_t uds_check_default_memory_by_addr_write(
   LOG_DBG("Write Memory By Address: addr=0x%08lX, size=%zu",
           (unsigned long)mem_addr, args->memSize);
 
-  if (!is_memory_address_valid(mem_addr, args->memSize, false)) {
+  UDSErr_t ret = check_memory_access(context->server, mem_addr, args->memSize,
+                                     UDS_MEMORY_ACCESS_WRITE);
+  if (ret != UDS_OK) {
     LOG_WRN("Write Memory By Address: Invalid address range 0x%08lX-0x%08lX",
             (unsigned long)mem_addr,
             (unsigned long)(mem_addr + args->memSize - 1));
-    return UDS_NRC_RequestOutOfRange;
+    return ret;
   }
 
   *apply_action = true;
@@ -185,7 +168,20 @@ UDSErr_t uds_action_default_memory_by_addr_write(
 
   uintptr_t mem_addr = (uintptr_t)args->memAddr;
 
-  memmove((void*)mem_addr, args->data, args->memSize);
+  // The action may be paired with a custom check, so the range is checked
+  // again, which also looks up the kind of memory
+  bool mmio = false;
+  UDSErr_t nrc = uds_memory_map_check(uds_memory_map_get_default(),
+                                      context->server, mem_addr, args->memSize,
+                                      UDS_MEMORY_ACCESS_WRITE, &mmio);
+  if (nrc != UDS_OK) {
+    return nrc;
+  }
+
+  UDSErr_t ret = uds_memory_write(mem_addr, args->data, args->memSize, mmio);
+  if (ret != UDS_PositiveResponse) {
+    return ret;
+  }
 
   LOG_DBG("Write Memory By Address: Successfully copied %zu bytes to 0x%08lX",
           args->memSize, (unsigned long)mem_addr);
@@ -0,0 +1,389 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (C) Frickly Systems GmbH
+ * SPDX-FileCopyrightText: Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "iso14229.h"
+#include "uds.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/devicetree.h>
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/util.h>
+
+#include <ardep/uds.h>
+
+#ifdef CONFIG_UDS_MEMORY_MAP_STATS
+#include <zephyr/stats/stats.h>
+#endif
+
+LOG_MODULE_DECLARE(uds, CONFIG_UDS_LOG_LEVEL);
+
+#ifdef CONFIG_UDS_MEMORY_MAP_STATS
+STATS_SECT_START(uds_memory_map_stats)
+STATS_SECT_ENTRY32(lookups)
+STATS_SECT_ENTRY32(probes)
+STATS_SECT_END;
+
+STATS_NAME_START(uds_memory_map_stats)
+STATS_NAME(uds_memory_map_stats, lookups)
+STATS_NAME(uds_memory_map_stats, probes)
+STATS_NAME_END(uds_memory_map_stats);
+
+static STATS_SECT_DECL(uds_memory_map_stats) uds_memory_map_stats;
+
+#define UDS_MEMORY_MAP_STATS_INC(_name) STATS_INC(uds_memory_map_stats, _name)
+#else
+#define UDS_MEMORY_MAP_STATS_INC(_name)
+#endif
+
+// Index of the last region starting at or before the address, or count if
+// there is none
+static size_t uds_memory_map_search(const struct uds_memory_map* map,
+                                    uintptr_t addr) {
+  size_t low = 0;
+  size_t high = map->count;
+
+  UDS_MEMORY_MAP_STATS_INC(lookups);
+
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+
+    UDS_MEMORY_MAP_STATS_INC(probes);
+
+    if (map->regions[mid].start <= addr) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+
+  return low == 0 ? map->count : low - 1;
+}
+
+// Places the region on top of the map, splitting and trimming the regions it
+// overlaps
+static int uds_memory_map_paint(struct uds_memory_map* map,
+                                const struct uds_memory_region* region) {
+  struct uds_memory_region* regions = map->regions;
+
+  // regions[first, last) overlap the new region
+  size_t first = uds_memory_map_search(map, region->start);
+  if (first == map->count || regions[first].end < region->start) {
+    first = first == map->count ? 0 : first + 1;
+  }
+  size_t last = first;
+  while (last < map->count && regions[last].start <= region->end) {
+    last++;
+  }
+
+  struct uds_memory_region left;
+  struct uds_memory_region right;
+  bool has_left = first < last && regions[first].start < region->start;
+  bool has_right = first < last && regions[last - 1].end > region->end;
+  if (has_left) {
+    left = regions[first];
+    left.end = region->start - 1;
+  }
+  if (has_right) {
+    right = regions[last - 1];
+    right.start = region->end + 1;
+  }
+
+  size_t inserted = 1 + has_left + has_right;
+  size_t count = map->count - (last - first) + inserted;
+  if (count > map->capacity) {
+    return -ENOMEM;
+  }
+
+  memmove(&regions[first + inserted], &regions[last],
+          (map->count - last) * sizeof(*regions));
+
+  size_t i = first;
+  if (has_left) {
+    regions[i++] = left;
+  }
+  regions[i++] = *region;
+  if (has_right) {
+    regions[i] = right;
+  }
+
+  map->count = count;
+  return 0;
+}
+
+// Regions are painted from the largest to the smallest, so smaller regions end
+// up on top. Of regions with the same size, the later one is painted later.
+static bool uds_memory_region_painted_before(
+    const struct uds_memory_region* regions, size_t a, size_t b) {
+  uintptr_t size_a = regions[a].end - regions[a].start;
+  uintptr_t size_b = regions[b].end - regions[b].start;
+
+  return size_a > size_b || (size_a == size_b && a < b);
+}
+
+int uds_memory_map_init(struct uds_memory_map* map,
+                        struct uds_memory_region* buffer,
+                        size_t capacity,
+                        const struct uds_memory_region* regions,
+                        size_t count) {
+  map->regions = buffer;
+  map->count = 0;
+  map->capacity = capacity;
+
+  for (size_t i = 0; i < count; i++) {
+    if (regions[i].end < regions[i].start) {
+      LOG_ERR("Memory region 0x%08lX-0x%08lX ends before it starts",
+              (unsigned long)regions[i].start, (unsigned long)regions[i].end);
+      return -EINVAL;
+    }
+  }
+
+  // selects the regions in painting order without sorting a copy of them
+  size_t previous = count;
+  for (size_t n = 0; n < count; n++) {
+    size_t next = count;
+    for (size_t i = 0; i < count; i++) {
+      if (previous != count &&
+          !uds_memory_region_painted_before(regions, previous, i)) {
+        continue;
+      }
+      if (next == count || uds_memory_region_painted_before(regions, i, next)) {
+        next = i;
+      }
+    }
+
+    int ret = uds_memory_map_paint(map, &regions[next]);
+    if (ret < 0) {
+      LOG_ERR("Memory map needs more than %zu regions", capacity);
+      return ret;
+    }
+    previous = next;
+  }
+
+  return 0;
+}
+
+const struct uds_memory_region* uds_memory_map_find(
+    const struct uds_memory_map* map, uintptr_t addr) {
+  size_t i = uds_memory_map_search(map, addr);
+
+  if (i == map->count || map->regions[i].end < addr) {
+    return NULL;
+  }
+  return &map->regions[i];
+}
+
+static bool uds_memory_region_allows_session(
+    const struct uds_memory_region* region, uint8_t session) {
+  if (region->session_count == 0) {
+    return true;
+  }
+
+  for (size_t i = 0; i < region->session_count; i++) {
+    if (region->sessions[i] == session) {
+      return true;
+    }
+  }
+  return false;
+}
+
+UDSErr_t uds_memory_map_check(const struct uds_memory_map* map,
+                              const UDSServer_t* server,
+                              uintptr_t addr,
+                              size_t size,
+                              uint8_t access,
+                              bool* mmio) {
+  // Prevent overflow
+  if (size == 0 || addr > UINTPTR_MAX - (size - 1)) {
+    return UDS_NRC_RequestOutOfRange;
+  }
+
+  const uintptr_t last = addr + (size - 1);
+  size_t i = uds_memory_map_search(map, addr);
+  bool is_mmio = false;
+
+  // adjacent regions are checked until one contains the end of the range
+  while (true) {
+    const struct uds_memory_region* region = &map->regions[i];
+
+    if (i >= map->count || region->start > addr || region->end < addr) {
+      return UDS_NRC_RequestOutOfRange;
+    }
+    if ((region->access & access) != access ||
+        !uds_memory_region_allows_session(region, server->sessionType)) {
+      return UDS_NRC_RequestOutOfRange;
+    }
+    if (server->securityLevel < region->security_level) {
+      return UDS_NRC_SecurityAccessDenied;
+    }
+
+    is_mmio |= region->access & UDS_MEMORY_ACCESS_MMIO;
+
+    if (region->end >= last) {
+      break;
+    }
+    addr = region->end + 1;
+    i++;
+  }
+
+  if (mmio != NULL) {
+    *mmio = is_mmio;
+  }
+  return UDS_OK;
+}
+
+// Default memory map from the devicetree
+
+#define UDS_MEMORY_REGION_FROM_REG(node_id, _access)        \
+  {                                                         \
+    .start = DT_REG_ADDR(node_id),                          \
+    .end = DT_REG_ADDR(node_id) + DT_REG_SIZE(node_id) - 1, \
+    .access = (_access),                                    \
+  },
+
+#define UDS_MEMORY_REGION_SESSIONS(node_id) \
+  _CONCAT(uds_memory_region_sessions_, DT_DEP_ORD(node_id))
+
+#define UDS_MEMORY_REGION_SESSIONS_DEFINE(node_id)                 \
+  IF_ENABLED(DT_NODE_HAS_PROP(node_id, sessions),                  \
+             (static const uint8_t UDS_MEMORY_REGION_SESSIONS(     \
+                  node_id)[] = DT_PROP(node_id, sessions);))
+
+// The order of the access enum matches the UDS_MEMORY_ACCESS_* flags
+#define UDS_MEMORY_REGION_FROM_NODE(node_id)                                \
+  {                                                                         \
+    .start = DT_REG_ADDR(node_id),                                          \
+    .end = DT_REG_ADDR(node_id) + DT_REG_SIZE(node_id) - 1,                 \
+    .access = DT_ENUM_IDX(node_id, access) |                                \
+              (DT_PROP(node_id, mmio) ? UDS_MEMORY_ACCESS_MMIO : 0),        \
+    .security_level = DT_PROP(node_id, security_level),                     \
+    .sessions = COND_CODE_1(DT_NODE_HAS_PROP(node_id, sessions),            \
+                            (UDS_MEMORY_REGION_SESSIONS(node_id)), (NULL)), \
+    .session_count = DT_PROP_LEN_OR(node_id, sessions, 0),                  \
+  },
+
+DT_FOREACH_STATUS_OKAY(ardep_uds_memory_region,
+                       UDS_MEMORY_REGION_SESSIONS_DEFINE)
+
+static const struct uds_memory_region uds_memory_map_dt_regions[] = {
+#if CONFIG_BOARD_NATIVE_SIM
+  // In simulation, allow all addresses
+  {
+    .start = 0,
+    .end = UINTPTR_MAX,
+    .access = UDS_MEMORY_ACCESS_READ | UDS_MEMORY_ACCESS_WRITE,
+  },
+#else
+#if DT_HAS_CHOSEN(zephyr_sram) && DT_NODE_HAS_PROP(DT_CHOSEN(zephyr_sram), reg)
+  UDS_MEMORY_REGION_FROM_REG(DT_CHOSEN(zephyr_sram),
+                             UDS_MEMORY_ACCESS_READ | UDS_MEMORY_ACCESS_WRITE)
+#endif
+#if DT_HAS_CHOSEN(zephyr_flash) && \
+    DT_NODE_HAS_PROP(DT_CHOSEN(zephyr_flash), reg)
+  UDS_MEMORY_REGION_FROM_REG(DT_CHOSEN(zephyr_flash), UDS_MEMORY_ACCESS_READ)
+#endif
+  DT_FOREACH_STATUS_OKAY_VARGS(zephyr_memory_region,
+                               UDS_MEMORY_REGION_FROM_REG,
+                               UDS_MEMORY_ACCESS_READ |
+                                   UDS_MEMORY_ACCESS_WRITE)
+#endif
+  DT_FOREACH_STATUS_OKAY(ardep_uds_memory_region, UDS_MEMORY_REGION_FROM_NODE)
+};
+
+static struct uds_memory_region
+    uds_memory_map_dt_buffer[2 * ARRAY_SIZE(uds_memory_map_dt_regions)];
+static struct uds_memory_map uds_memory_map_dt;
+
+const struct uds_memory_map* uds_memory_map_get_default(void) {
+  return &uds_memory_map_dt;
+}
+
+static int uds_memory_map_sys_init(void) {
+#ifdef CONFIG_UDS_MEMORY_MAP_STATS
+  int ret = STATS_INIT_AND_REG(uds_memory_map_stats, STATS_SIZE_32,
+                               "uds_memory_map");
+  if (ret < 0) {
+    LOG_ERR("Failed to register the memory map stats: %d", ret);
+    return ret;
+  }
+#endif
+
+  return uds_memory_map_init(
+      &uds_memory_map_dt, uds_memory_map_dt_buffer,
+      ARRAY_SIZE(uds_memory_map_dt_buffer), uds_memory_map_dt_regions,
+      ARRAY_SIZE(uds_memory_map_dt_regions));
+}
+
+SYS_INIT(uds_memory_map_sys_init,
+         APPLICATION,
+         CONFIG_APPLICATION_INIT_PRIORITY);
+
+// Peripheral registers are accessed with whole, aligned words
+#define UDS_MEMORY_MMIO_WORD sizeof(uint32_t)
+
+UDSErr_t uds_memory_read(UDSServer_t* server,
+                         uint8_t (*copy)(UDSServer_t*, const void*, uint16_t),
+                         uintptr_t addr,
+                         size_t size,
+                         bool mmio) {
+  if (!mmio) {
+    // RAM and flash are streamed straight into the response
+    return copy(server, (const void*)addr, size);
+  }
+
+  uint8_t chunk[16 * UDS_MEMORY_MMIO_WORD];
+  size_t chunk_len = 0;
+
+  while (size > 0) {
+    uintptr_t word_addr = ROUND_DOWN(addr, UDS_MEMORY_MMIO_WORD);
+    uint32_t word = *(volatile const uint32_t*)word_addr;
+    size_t offset = addr - word_addr;
+    size_t len = MIN(UDS_MEMORY_MMIO_WORD - offset, size);
+
+    memcpy(&chunk[chunk_len], (uint8_t*)&word + offset, len);
+    chunk_len += len;
+    addr += len;
+    size -= len;
+
+    if (chunk_len + UDS_MEMORY_MMIO_WORD > sizeof(chunk) || size == 0) {
+      uint8_t ret = copy(server, chunk, chunk_len);
+      if (ret != UDS_PositiveResponse) {
+        return ret;
+      }
+      chunk_len = 0;
+    }
+  }
+
+  return UDS_PositiveResponse;
+}
+
+UDSErr_t uds_memory_write(uintptr_t addr,
+                          const uint8_t* data,
+                          size_t size,
+                          bool mmio) {
+  if (!mmio) {
+    memmove((void*)addr, data, size);
+    return UDS_PositiveResponse;
+  }
+
+  if (addr % UDS_MEMORY_MMIO_WORD != 0 || size % UDS_MEMORY_MMIO_WORD != 0) {
+    LOG_WRN("Peripheral writes must be aligned to %zu bytes",
+            UDS_MEMORY_MMIO_WORD);
+    return UDS_NRC_RequestOutOfRange;
+  }
+
+  for (size_t i = 0; i < size; i += UDS_MEMORY_MMIO_WORD) {
+    uint32_t word;
+    memcpy(&word, &data[i], sizeof(word));
+    *(volatile uint32_t*)(addr + i) = word;
+  }
+
+  return UDS_PositiveResponse;
+}
@@ -30,6 +30,12 @@ static UDSErr_t uds_check_with_routine_id_fn(
   return UDS_OK;
 }
 
+#ifdef CONFIG_UDS_REGISTRATION_INDEX
+static uint16_t uds_get_routine_id(const void* arg) {
+  return ((const UDSRoutineCtrlArgs_t*)arg)->id;
+}
+#endif  // CONFIG_UDS_REGISTRATION_INDEX
+
 uds_check_fn uds_get_check_for_routine_control(
     const struct uds_registration_t* const reg) {
   return uds_check_with_routine_id_fn;
@@ -46,4 +52,7 @@ STRUCT_SECTION_ITERABLE(uds_event_handler_data,
   .get_action = uds_get_action_for_routine_control,
   .default_nrc = UDS_NRC_SubFunctionNotSupported,
   .registration_type = UDS_REGISTRATION_TYPE__ROUTINE_CONTROL,
+#ifdef CONFIG_UDS_REGISTRATION_INDEX
+  .get_id = uds_get_routine_id,
+#endif
 };
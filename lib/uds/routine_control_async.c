@@ -0,0 +1,239 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (C) Frickly Systems GmbH
+ * SPDX-FileCopyrightText: Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_DECLARE(uds, CONFIG_UDS_LOG_LEVEL);
+
+#include "uds.h"
+
+#include <string.h>
+
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/util.h>
+
+#include <ardep/uds.h>
+#include <iso14229.h>
+
+K_THREAD_STACK_ARRAY_DEFINE(routine_worker_stacks,
+                            CONFIG_UDS_ASYNC_ROUTINE_WORKERS,
+                            CONFIG_UDS_ASYNC_ROUTINE_WORKER_STACK_SIZE);
+static struct k_thread routine_workers[CONFIG_UDS_ASYNC_ROUTINE_WORKERS];
+
+// Started routines waiting for a free worker
+static K_FIFO_DEFINE(routine_queue);
+
+void uds_async_routine_set_progress(struct uds_async_routine *routine,
+                                    uint8_t percent) {
+  atomic_set(&routine->progress, MIN(percent, 100));
+}
+
+bool uds_async_routine_stop_requested(const struct uds_async_routine *routine) {
+  return atomic_get(&routine->stop_requested) != 0;
+}
+
+static void routine_worker(void *p1, void *p2, void *p3) {
+  while (true) {
+    struct uds_async_routine *routine = k_fifo_get(&routine_queue, K_FOREVER);
+    int rc = 0;
+
+    // the routine may have been stopped before a worker was free
+    if (!uds_async_routine_stop_requested(routine)) {
+      rc = routine->start(routine, routine->option_record,
+                          routine->option_record_len);
+    }
+
+    routine->result = rc;
+
+    // the state is set last, the routine may be started again afterwards
+    if (rc < 0) {
+      LOG_WRN("Routine %p failed: %d", routine, rc);
+      atomic_set(&routine->state, UDS_ASYNC_ROUTINE_STATE__FAILED);
+    } else if (uds_async_routine_stop_requested(routine)) {
+      atomic_set(&routine->state, UDS_ASYNC_ROUTINE_STATE__STOPPED);
+    } else {
+      atomic_set(&routine->progress, 100);
+      atomic_set(&routine->state, UDS_ASYNC_ROUTINE_STATE__COMPLETED);
+    }
+  }
+}
+
+// The status record starts with the state and the progress in percent
+static UDSErr_t copy_status_record(const struct uds_context *const context,
+                                   struct uds_async_routine *routine,
+                                   bool with_results) {
+  UDSRoutineCtrlArgs_t *args = context->arg;
+  uint8_t record[CONFIG_UDS_ASYNC_ROUTINE_STATUS_RECORD_SIZE];
+  size_t len = 0;
+
+  record[len++] = atomic_get(&routine->state);
+  record[len++] = atomic_get(&routine->progress);
+
+  if (with_results && routine->results != NULL) {
+    int rc = routine->results(routine, &record[len], sizeof(record) - len);
+    if (rc < 0) {
+      LOG_ERR("Routine 0x%04X: results failed: %d", args->id, rc);
+      return UDS_NRC_ConditionsNotCorrect;
+    }
+    len += MIN((size_t)rc, sizeof(record) - len);
+  }
+
+  return args->copyStatusRecord(context->server, record, len);
+}
+
+static UDSErr_t start_routine(const struct uds_context *const context,
+                              struct uds_async_routine *routine) {
+  UDSRoutineCtrlArgs_t *args = context->arg;
+
+  if (atomic_get(&routine->state) == UDS_ASYNC_ROUTINE_STATE__RUNNING) {
+    LOG_WRN("Routine 0x%04X already running", args->id);
+    return UDS_NRC_RequestSequenceError;
+  }
+
+  if (args->len > sizeof(routine->option_record)) {
+    LOG_WRN("Routine 0x%04X: option record of %zu bytes is too long", args->id,
+            (size_t)args->len);
+    return UDS_NRC_IncorrectMessageLengthOrInvalidFormat;
+  }
+
+  if (args->len > 0) {
+    memcpy(routine->option_record, args->optionRecord, args->len);
+  }
+  routine->option_record_len = args->len;
+  routine->result = 0;
+  atomic_clear(&routine->progress);
+  atomic_clear(&routine->stop_requested);
+  atomic_set(&routine->state, UDS_ASYNC_ROUTINE_STATE__RUNNING);
+
+  k_fifo_put(&routine_queue, routine);
+
+  return copy_status_record(context, routine, false);
+}
+
+static void request_stop(struct uds_async_routine *routine) {
+  atomic_set(&routine->stop_requested, 1);
+  if (routine->stop != NULL) {
+    routine->stop(routine);
+  }
+}
+
+static UDSErr_t stop_routine(const struct uds_context *const context,
+                             struct uds_async_routine *routine) {
+  UDSRoutineCtrlArgs_t *args = context->arg;
+
+  if (atomic_get(&routine->state) != UDS_ASYNC_ROUTINE_STATE__RUNNING) {
+    LOG_WRN("Routine 0x%04X not running", args->id);
+    return UDS_NRC_RequestSequenceError;
+  }
+
+  request_stop(routine);
+
+  return copy_status_record(context, routine, false);
+}
+
+static UDSErr_t request_routine_results(
+    const struct uds_context *const context,
+    struct uds_async_routine *routine) {
+  UDSRoutineCtrlArgs_t *args = context->arg;
+
+  if (atomic_get(&routine->state) == UDS_ASYNC_ROUTINE_STATE__NOT_STARTED) {
+    LOG_WRN("Routine 0x%04X not started yet", args->id);
+    return UDS_NRC_RequestSequenceError;
+  }
+
+  return copy_status_record(context, routine, true);
+}
+
+UDSErr_t uds_check_async_routine(const struct uds_context *const context,
+                                 bool *apply_action) {
+  *apply_action = true;
+  return UDS_OK;
+}
+
+UDSErr_t uds_action_async_routine(struct uds_context *const context,
+                                  bool *consume_event) {
+  UDSRoutineCtrlArgs_t *args = context->arg;
+  struct uds_async_routine *routine =
+      context->registration->routine_control.user_context;
+
+  *consume_event = true;
+
+  switch (args->ctrlType) {
+    case UDS_ROUTINE_CONTROL__START_ROUTINE:
+      return start_routine(context, routine);
+    case UDS_ROUTINE_CONTROL__STOP_ROUTINE:
+      return stop_routine(context, routine);
+    case UDS_ROUTINE_CONTROL__REQUEST_ROUTINE_RESULTS:
+      return request_routine_results(context, routine);
+    default:
+      LOG_WRN("Unsupported control type: 0x%02x", args->ctrlType);
+      *consume_event = false;
+      return UDS_NRC_SubFunctionNotSupported;
+  }
+}
+
+static UDSErr_t uds_check_async_routine_session(
+    const struct uds_context *const context, bool *apply_action) {
+  if (context->event == UDS_EVT_DiagSessCtrl) {
+    UDSDiagSessCtrlArgs_t *args = context->arg;
+    if (args->type == UDS_DIAG_SESSION__DEFAULT) {
+      *apply_action = true;
+    }
+  } else if (context->event == UDS_EVT_SessionTimeout) {
+    *apply_action = true;
+  }
+
+  return UDS_OK;
+}
+
+// Routines started in a non-default session must not outlive it
+static UDSErr_t uds_action_async_routine_session(
+    struct uds_context *const context, bool *consume_event) {
+  STRUCT_SECTION_FOREACH (uds_async_routine, routine) {
+    if (atomic_get(&routine->state) == UDS_ASYNC_ROUTINE_STATE__RUNNING &&
+        !uds_async_routine_stop_requested(routine)) {
+      LOG_INF("Stopping routine %p on session change", routine);
+      request_stop(routine);
+    }
+  }
+
+  *consume_event = false;
+  return UDS_OK;
+}
+
+// Registered for all instances
+_UDS_REGISTRATION(diag_session_ctrl, __uds_registration_async_routines) = {
+  .type = UDS_REGISTRATION_TYPE__DIAG_SESSION_CTRL,
+  .diag_session_ctrl = {
+    .diag_sess_ctrl = {
+      .check = uds_check_async_routine_session,
+      .action = uds_action_async_routine_session,
+    },
+    .session_timeout = {
+      .check = uds_check_async_routine_session,
+      .action = uds_action_async_routine_session,
+    },
+  },
+};
+
+static int uds_async_routine_init(void) {
+  for (int i = 0; i < CONFIG_UDS_ASYNC_ROUTINE_WORKERS; i++) {
+    char name[sizeof("uds_routine_15")];
+
+    k_tid_t tid = k_thread_create(
+        &routine_workers[i], routine_worker_stacks[i],
+        K_THREAD_STACK_SIZEOF(routine_worker_stacks[i]), routine_worker, NULL,
+        NULL, NULL, CONFIG_UDS_ASYNC_ROUTINE_WORKER_PRIORITY, 0, K_NO_WAIT);
+
+    snprintk(name, sizeof(name), "uds_routine_%d", i);
+    k_thread_name_set(tid, name);
+  }
+
+  return 0;
+}
+
+SYS_INIT(uds_async_routine_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
@@ -0,0 +1,362 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (C) Frickly Systems GmbH
+ * SPDX-FileCopyrightText: Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_DECLARE(uds, CONFIG_UDS_LOG_LEVEL);
+
+#include "uds.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/util.h>
+
+#ifdef CONFIG_UDS_SECURITY_ACCESS_PERSISTENCE
+#include <zephyr/settings/settings.h>
+#endif
+
+#include <psa/crypto.h>
+
+#include <ardep/uds.h>
+#include <iso14229.h>
+
+#define SEED_POOL_SETTINGS_SUBTREE "uds/sa"
+
+// Seeds and keys are computed below the priority of the UDS thread
+K_THREAD_STACK_DEFINE(seed_pool_work_q_stack,
+                      CONFIG_UDS_SECURITY_ACCESS_WORKQUEUE_STACK_SIZE);
+static struct k_work_q seed_pool_work_q;
+
+static void seed_pool_refill_handler(struct k_work* work);
+K_WORK_DEFINE(seed_pool_refill_work, seed_pool_refill_handler);
+
+static int seed_pool_compute(struct uds_security_access_pool* pool,
+                             struct uds_security_access_challenge* challenge) {
+  psa_status_t status =
+      psa_generate_random(challenge->seed, sizeof(challenge->seed));
+  if (status != PSA_SUCCESS) {
+    LOG_ERR("Failed to generate a seed: %d", status);
+    return -EIO;
+  }
+
+  return pool->compute_key(pool->level, challenge->seed, challenge->key,
+                           pool->user_data);
+}
+
+static bool seed_pool_is_full(struct uds_security_access_pool* pool) {
+  k_spinlock_key_t key = k_spin_lock(&pool->lock);
+  bool full = pool->count == ARRAY_SIZE(pool->challenges);
+  k_spin_unlock(&pool->lock, key);
+
+  return full;
+}
+
+static void seed_pool_refill_handler(struct k_work* work) {
+  ARG_UNUSED(work);
+
+  STRUCT_SECTION_FOREACH (uds_security_access_pool, pool) {
+    while (!seed_pool_is_full(pool)) {
+      struct uds_security_access_challenge challenge;
+
+      int ret = seed_pool_compute(pool, &challenge);
+      if (ret < 0) {
+        LOG_ERR("Failed to compute a key for security level %u: %d",
+                pool->level, ret);
+        break;
+      }
+
+      // The pool is only emptied by the UDS thread, so there is still room
+      k_spinlock_key_t key = k_spin_lock(&pool->lock);
+      size_t tail = (pool->head + pool->count) % ARRAY_SIZE(pool->challenges);
+      pool->challenges[tail] = challenge;
+      pool->count++;
+      k_spin_unlock(&pool->lock, key);
+
+      memset(&challenge, 0, sizeof(challenge));
+    }
+  }
+}
+
+static bool seed_pool_pop(struct uds_security_access_pool* pool,
+                          struct uds_security_access_challenge* challenge) {
+  k_spinlock_key_t key = k_spin_lock(&pool->lock);
+  bool popped = pool->count > 0;
+
+  if (popped) {
+    struct uds_security_access_challenge* head =
+        &pool->challenges[pool->head];
+
+    *challenge = *head;
+    memset(head, 0, sizeof(*head));
+    pool->head = (pool->head + 1) % ARRAY_SIZE(pool->challenges);
+    pool->count--;
+  }
+  k_spin_unlock(&pool->lock, key);
+
+  return popped;
+}
+
+#ifdef CONFIG_UDS_SECURITY_ACCESS_PERSISTENCE
+static int seed_pool_store_attempts(struct uds_security_access_pool* pool) {
+  char name[sizeof(SEED_POOL_SETTINGS_SUBTREE "/255")];
+
+  snprintf(name, sizeof(name), SEED_POOL_SETTINGS_SUBTREE "/%u", pool->level);
+  return settings_save_one(name, &pool->failed_attempts,
+                           sizeof(pool->failed_attempts));
+}
+
+static int seed_pool_settings_set(const char* name,
+                                  size_t len,
+                                  settings_read_cb read_cb,
+                                  void* cb_arg) {
+  char* end;
+  unsigned long level = strtoul(name, &end, 10);
+
+  if (end == name || len != sizeof(uint8_t)) {
+    return -EINVAL;
+  }
+
+  STRUCT_SECTION_FOREACH (uds_security_access_pool, pool) {
+    if (pool->level != level) {
+      continue;
+    }
+
+    ssize_t ret =
+        read_cb(cb_arg, &pool->failed_attempts, sizeof(pool->failed_attempts));
+    return ret < 0 ? ret : 0;
+  }
+
+  // the security level is not used anymore
+  return 0;
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(uds_security_access,
+                               SEED_POOL_SETTINGS_SUBTREE,
+                               NULL,
+                               seed_pool_settings_set,
+                               NULL,
+                               NULL);
+#endif
+
+static UDSErr_t seed_pool_count_failed_attempt(
+    struct uds_security_access_pool* pool) {
+  if (pool->failed_attempts < UINT8_MAX) {
+    pool->failed_attempts++;
+  }
+
+#ifdef CONFIG_UDS_SECURITY_ACCESS_PERSISTENCE
+  // Stored before the response, so resetting the ECU does not reset the count
+  int ret = seed_pool_store_attempts(pool);
+  if (ret < 0) {
+    LOG_ERR("Failed to store the failed attempts of security level %u: %d",
+            pool->level, ret);
+  }
+#endif
+
+  if (pool->failed_attempts >= CONFIG_UDS_SECURITY_ACCESS_MAX_ATTEMPTS) {
+    pool->delay_end = k_uptime_get() + CONFIG_UDS_SECURITY_ACCESS_DELAY_MS;
+    return UDS_NRC_ExceedNumberOfAttempts;
+  }
+  return UDS_NRC_InvalidKey;
+}
+
+static void seed_pool_reset_failed_attempts(
+    struct uds_security_access_pool* pool) {
+  if (pool->failed_attempts == 0) {
+    return;
+  }
+
+  pool->failed_attempts = 0;
+#ifdef CONFIG_UDS_SECURITY_ACCESS_PERSISTENCE
+  int ret = seed_pool_store_attempts(pool);
+  if (ret < 0) {
+    LOG_ERR("Failed to store the failed attempts of security level %u: %d",
+            pool->level, ret);
+  }
+#endif
+}
+
+static struct uds_security_access_pool* seed_pool_from_context(
+    const struct uds_context* const context) {
+  return context->registration->security_access.user_context;
+}
+
+UDSErr_t uds_check_security_access_seed_pool_request_seed(
+    const struct uds_context* const context, bool* apply_action) {
+  const UDSSecAccessRequestSeedArgs_t* args = context->arg;
+
+  if (args->level == seed_pool_from_context(context)->level) {
+    *apply_action = true;
+  }
+  return UDS_OK;
+}
+
+UDSErr_t uds_action_security_access_seed_pool_request_seed(
+    struct uds_context* const context, bool* consume_event) {
+  UDSSecAccessRequestSeedArgs_t* args = context->arg;
+  struct uds_security_access_pool* pool = seed_pool_from_context(context);
+
+  *consume_event = true;
+
+  if (k_uptime_get() < pool->delay_end) {
+    return UDS_NRC_RequiredTimeDelayNotExpired;
+  }
+
+  // A new seed replaces the previous one
+  pool->seed_active = false;
+
+  // An unlocked level answers with a seed of zeros and expects no key
+  if (context->server->securityLevel == pool->level) {
+    const uint8_t unlocked_seed[sizeof(pool->active.seed)] = {0};
+    return args->copySeed(context->server, unlocked_seed,
+                          sizeof(unlocked_seed));
+  }
+
+  if (!seed_pool_pop(pool, &pool->active)) {
+    LOG_WRN("Seed pool of security level %u is empty", pool->level);
+
+    int ret = seed_pool_compute(pool, &pool->active);
+    if (ret < 0) {
+      LOG_ERR("Failed to compute a key for security level %u: %d",
+              pool->level, ret);
+      return UDS_NRC_ConditionsNotCorrect;
+    }
+  }
+  pool->seed_active = true;
+
+  k_work_submit_to_queue(&seed_pool_work_q, &seed_pool_refill_work);
+
+  return args->copySeed(context->server, pool->active.seed,
+                        sizeof(pool->active.seed));
+}
+
+UDSErr_t uds_check_security_access_seed_pool_validate_key(
+    const struct uds_context* const context, bool* apply_action) {
+  const UDSSecAccessValidateKeyArgs_t* args = context->arg;
+
+  if (args->level == seed_pool_from_context(context)->level) {
+    *apply_action = true;
+  }
+  return UDS_OK;
+}
+
+UDSErr_t uds_action_security_access_seed_pool_validate_key(
+    struct uds_context* const context, bool* consume_event) {
+  const UDSSecAccessValidateKeyArgs_t* args = context->arg;
+  struct uds_security_access_pool* pool = seed_pool_from_context(context);
+
+  *consume_event = true;
+
+  if (!pool->seed_active) {
+    return UDS_NRC_RequestSequenceError;
+  }
+  // Every seed allows one attempt
+  pool->seed_active = false;
+
+  uint8_t diff = args->len != sizeof(pool->active.key);
+  if (diff == 0) {
+    // Compares all bytes, so the time does not depend on the first mismatch
+    for (size_t i = 0; i < sizeof(pool->active.key); i++) {
+      diff |= args->key[i] ^ pool->active.key[i];
+    }
+  }
+  memset(&pool->active, 0, sizeof(pool->active));
+
+  if (diff != 0) {
+    LOG_WRN("Invalid key for security level %u", pool->level);
+    return seed_pool_count_failed_attempt(pool);
+  }
+
+  seed_pool_reset_failed_attempts(pool);
+  return UDS_PositiveResponse;
+}
+
+#ifdef CONFIG_UDS_SECURITY_ACCESS_KEY_AES128
+int uds_security_access_key_aes128(uint8_t level,
+                                   const uint8_t* seed,
+                                   uint8_t* key,
+                                   void* user_data) {
+  BUILD_ASSERT(CONFIG_UDS_SECURITY_ACCESS_SEED_SIZE == 16 &&
+                   CONFIG_UDS_SECURITY_ACCESS_KEY_SIZE == 16,
+               "AES-128 keys need 16 byte seeds and keys");
+  ARG_UNUSED(level);
+
+  psa_key_attributes_t attributes = PSA_KEY_ATTRIBUTES_INIT;
+  psa_set_key_type(&attributes, PSA_KEY_TYPE_AES);
+  psa_set_key_bits(&attributes, 128);
+  psa_set_key_usage_flags(&attributes, PSA_KEY_USAGE_ENCRYPT);
+  psa_set_key_algorithm(&attributes, PSA_ALG_ECB_NO_PADDING);
+
+  psa_key_id_t key_id;
+  psa_status_t status = psa_import_key(&attributes, user_data, 16, &key_id);
+  if (status != PSA_SUCCESS) {
+    return -EINVAL;
+  }
+
+  size_t key_len;
+  status = psa_cipher_encrypt(key_id, PSA_ALG_ECB_NO_PADDING, seed,
+                              CONFIG_UDS_SECURITY_ACCESS_SEED_SIZE, key,
+                              CONFIG_UDS_SECURITY_ACCESS_KEY_SIZE, &key_len);
+  psa_destroy_key(key_id);
+
+  return status == PSA_SUCCESS ? 0 : -EIO;
+}
+#endif  // CONFIG_UDS_SECURITY_ACCESS_KEY_AES128
+
+int uds_security_access_seed_pool_wait_full(k_timeout_t timeout) {
+  k_timepoint_t end = sys_timepoint_calc(timeout);
+
+  STRUCT_SECTION_FOREACH (uds_security_access_pool, pool) {
+    while (!seed_pool_is_full(pool)) {
+      if (sys_timepoint_expired(end)) {
+        return -EAGAIN;
+      }
+      k_msleep(1);
+    }
+  }
+
+  return 0;
+}
+
+static int seed_pool_sys_init(void) {
+  psa_status_t status = psa_crypto_init();
+  if (status != PSA_SUCCESS) {
+    LOG_ERR("Failed to initialize PSA crypto: %d", status);
+    return -EIO;
+  }
+
+#ifdef CONFIG_UDS_SECURITY_ACCESS_PERSISTENCE
+  int ret = settings_subsys_init();
+  if (ret == 0) {
+    ret = settings_load_subtree(SEED_POOL_SETTINGS_SUBTREE);
+  }
+  if (ret < 0) {
+    LOG_ERR("Failed to load the failed attempts: %d", ret);
+  }
+
+  // A reset does not shorten the delay
+  STRUCT_SECTION_FOREACH (uds_security_access_pool, pool) {
+    if (pool->failed_attempts >= CONFIG_UDS_SECURITY_ACCESS_MAX_ATTEMPTS) {
+      pool->delay_end = k_uptime_get() + CONFIG_UDS_SECURITY_ACCESS_DELAY_MS;
+    }
+  }
+#endif
+
+  k_work_queue_start(&seed_pool_work_q, seed_pool_work_q_stack,
+                     K_THREAD_STACK_SIZEOF(seed_pool_work_q_stack),
+                     CONFIG_UDS_SECURITY_ACCESS_WORKQUEUE_PRIORITY, NULL);
+  k_thread_name_set(&seed_pool_work_q.thread, "uds_seed_pool");
+
+  k_work_submit_to_queue(&seed_pool_work_q, &seed_pool_refill_work);
+  return 0;
+}
+
+SYS_INIT(seed_pool_sys_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
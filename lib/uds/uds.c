@@ -7,6 +7,7 @@
 
 #include <stdint.h>
 
+#include <zephyr/init.h>
 #include <zephyr/logging/log.h>
 #include <zephyr/sys/util.h>
 LOG_MODULE_REGISTER(uds, CONFIG_UDS_LOG_LEVEL);
@@ -60,15 +61,58 @@ static UDSErr_t uds_check_and_act_on_event(
   return UDS_OK;
 }
 
-// Iterates over event handlers to apply the actions for the event
-UDSErr_t uds_handle_event(struct uds_instance_t* instance,
-                          UDSEvent_t event,
-                          void* arg,
-                          const struct uds_event_handler_data* handler) {
-  bool found_at_least_one_match = false;
-
-  // We start with static registrations
-  STRUCT_SECTION_FOREACH (uds_registration_t, reg) {
+// ROM tables of the static registrations per type, laid out by iterables.ld
+#define UDS_REGISTRATION_TABLES(fn)                    \
+  fn(ECU_RESET, ecu_reset)                             \
+  fn(MEMORY, memory)                                   \
+  fn(READ_DTC_INFO, read_dtc_info)                     \
+  fn(DATA_IDENTIFIER, data_identifier)                 \
+  fn(DIAG_SESSION_CTRL, diag_session_ctrl)             \
+  fn(CLEAR_DIAG_INFO, clear_diag_info)                 \
+  fn(ROUTINE_CONTROL, routine_control)                 \
+  fn(SECURITY_ACCESS, security_access)                 \
+  fn(COMMUNICATION_CONTROL, communication_control)     \
+  fn(DYNAMIC_DEFINE_DATA_IDS, dynamic_define_data_ids) \
+  fn(CONTROL_DTC_SETTING, control_dtc_setting)         \
+  fn(UPLOAD_DOWNLOAD, upload_download)                 \
+  fn(LINK_CONTROL, link_control)                       \
+  fn(AUTHENTICATION, authentication)
+
+#define UDS_REGISTRATION_TABLE_DECLARE(_type, _table)                      \
+  extern struct uds_registration_t _uds_registration_t_##_table##_start[]; \
+  extern struct uds_registration_t _uds_registration_t_##_table##_end[];
+
+#define UDS_REGISTRATION_TABLE_ENTRY(_type, _table) \
+  [UDS_REGISTRATION_TYPE__##_type] = {              \
+    .start = _uds_registration_t_##_table##_start,  \
+    .end = _uds_registration_t_##_table##_end,      \
+  },
+
+UDS_REGISTRATION_TABLES(UDS_REGISTRATION_TABLE_DECLARE)
+
+// Registrations outside of the tables follow them up to the end of the section
+extern struct uds_registration_t _uds_registration_t_other_start[];
+STRUCT_SECTION_END_EXTERN(uds_registration_t);
+
+static const struct {
+  struct uds_registration_t* start;
+  struct uds_registration_t* end;
+} registration_tables[] = {
+  UDS_REGISTRATION_TABLES(UDS_REGISTRATION_TABLE_ENTRY)
+};
+
+// Applies the event to the static registrations from start to end, returns
+// true if one of them consumed the event or failed
+static bool uds_handle_static_registrations(
+    struct uds_instance_t* instance,
+    UDSEvent_t event,
+    void* arg,
+    const struct uds_event_handler_data* handler,
+    struct uds_registration_t* start,
+    struct uds_registration_t* end,
+    bool* found_at_least_one_match,
+    UDSErr_t* ret) {
+  for (struct uds_registration_t* reg = start; reg < end; reg++) {
     bool consume_event = true;
 
     struct uds_context context = {
@@ -79,13 +123,180 @@ UDSErr_t uds_handle_event(struct uds_instance_t* instance,
       .arg = arg,
     };
 
-    int ret = uds_check_and_act_on_event(
-        &context, handler, &found_at_least_one_match, &consume_event);
-    if (consume_event || ret != UDS_OK) {
-      return ret;
+    *ret = uds_check_and_act_on_event(&context, handler,
+                                      found_at_least_one_match, &consume_event);
+    if (consume_event || *ret != UDS_OK) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+#ifdef CONFIG_UDS_REGISTRATION_INDEX
+
+// Offsets of the registrations of a table sorted by their identifier,
+// registrations with the same identifier keep their link order
+struct uds_registration_index {
+  uint16_t entries[CONFIG_UDS_REGISTRATION_INDEX_ENTRIES];
+  uint16_t count;
+  bool valid;
+};
+
+static struct uds_registration_index data_identifier_index;
+static struct uds_registration_index routine_control_index;
+
+static struct uds_registration_index* uds_registration_index_of(
+    enum uds_registration_type_t type) {
+  switch (type) {
+    case UDS_REGISTRATION_TYPE__DATA_IDENTIFIER:
+      return &data_identifier_index;
+    case UDS_REGISTRATION_TYPE__ROUTINE_CONTROL:
+      return &routine_control_index;
+    default:
+      return NULL;
+  }
+}
+
+static uint16_t uds_registration_id(const struct uds_registration_t* reg) {
+  if (reg->type == UDS_REGISTRATION_TYPE__ROUTINE_CONTROL) {
+    return reg->routine_control.routine_id;
+  }
+
+  return reg->data_identifier.data_id;
+}
+
+static void uds_registration_index_build(enum uds_registration_type_t type) {
+  struct uds_registration_index* index = uds_registration_index_of(type);
+  struct uds_registration_t* table = registration_tables[type].start;
+  const size_t count = registration_tables[type].end - table;
+
+  if (count > ARRAY_SIZE(index->entries)) {
+    LOG_WRN("%zu registrations of type %d exceed the index, looking them up "
+            "linearly",
+            count, type);
+    return;
+  }
+
+  // Insertion sort, stable and only done once
+  for (size_t i = 0; i < count; i++) {
+    const uint16_t id = uds_registration_id(&table[i]);
+    size_t j = i;
+
+    while (j > 0 && uds_registration_id(&table[index->entries[j - 1]]) > id) {
+      index->entries[j] = index->entries[j - 1];
+      j--;
+    }
+    index->entries[j] = i;
+  }
+
+  index->count = count;
+  index->valid = true;
+}
+
+static int uds_registration_index_init(void) {
+  uds_registration_index_build(UDS_REGISTRATION_TYPE__DATA_IDENTIFIER);
+  uds_registration_index_build(UDS_REGISTRATION_TYPE__ROUTINE_CONTROL);
+
+  return 0;
+}
+
+SYS_INIT(uds_registration_index_init, PRE_KERNEL_1, 0);
+
+// Applies the event to the registrations of the table with the identifier of
+// the event, found by binary search in the index
+static bool uds_handle_indexed_registrations(
+    struct uds_instance_t* instance,
+    UDSEvent_t event,
+    void* arg,
+    const struct uds_event_handler_data* handler,
+    const struct uds_registration_index* index,
+    bool* found_at_least_one_match,
+    UDSErr_t* ret) {
+  struct uds_registration_t* table =
+      registration_tables[handler->registration_type].start;
+  const uint16_t id = handler->get_id(arg);
+
+  // First entry with an identifier not below the one of the event
+  size_t low = 0;
+  size_t high = index->count;
+  while (low < high) {
+    const size_t mid = low + (high - low) / 2;
+    if (uds_registration_id(&table[index->entries[mid]]) < id) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+
+  for (size_t i = low; i < index->count; i++) {
+    struct uds_registration_t* reg = &table[index->entries[i]];
+    if (uds_registration_id(reg) != id) {
+      break;
+    }
+
+    if (uds_handle_static_registrations(instance, event, arg, handler, reg,
+                                        reg + 1, found_at_least_one_match,
+                                        ret)) {
+      return true;
     }
   }
 
+  return false;
+}
+
+#endif  // CONFIG_UDS_REGISTRATION_INDEX
+
+// Applies the event to the table of the registration type of the handler
+static bool uds_handle_registration_table(
+    struct uds_instance_t* instance,
+    UDSEvent_t event,
+    void* arg,
+    const struct uds_event_handler_data* handler,
+    bool* found_at_least_one_match,
+    UDSErr_t* ret) {
+  if (handler->registration_type >= ARRAY_SIZE(registration_tables)) {
+    return false;
+  }
+
+#ifdef CONFIG_UDS_REGISTRATION_INDEX
+  const struct uds_registration_index* index =
+      uds_registration_index_of(handler->registration_type);
+  if (handler->get_id != NULL && index != NULL && index->valid) {
+    return uds_handle_indexed_registrations(
+        instance, event, arg, handler, index, found_at_least_one_match, ret);
+  }
+#endif  // CONFIG_UDS_REGISTRATION_INDEX
+
+  return uds_handle_static_registrations(
+      instance, event, arg, handler,
+      registration_tables[handler->registration_type].start,
+      registration_tables[handler->registration_type].end,
+      found_at_least_one_match, ret);
+}
+
+// Iterates over event handlers to apply the actions for the event
+UDSErr_t uds_handle_event(struct uds_instance_t* instance,
+                          UDSEvent_t event,
+                          void* arg,
+                          const struct uds_event_handler_data* handler) {
+  bool found_at_least_one_match = false;
+  UDSErr_t ret;
+
+  // We start with static registrations, only the table of the handled type
+  // and the registrations outside of the tables are visited
+  if (uds_handle_registration_table(instance, event, arg, handler,
+                                    &found_at_least_one_match, &ret)) {
+    return ret;
+  }
+
+  if (uds_handle_static_registrations(
+          instance, event, arg, handler, _uds_registration_t_other_start,
+          STRUCT_SECTION_END(uds_registration_t), &found_at_least_one_match,
+          &ret)) {
+    return ret;
+  }
+
   // Optional dynamic registrations
 #ifdef CONFIG_UDS_USE_DYNAMIC_REGISTRATION
   struct uds_registration_t* reg;
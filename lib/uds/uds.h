@@ -21,6 +21,9 @@ struct uds_event_handler_data {
   uds_get_action_fn get_action;
   UDSErr_t default_nrc;
   enum uds_registration_type_t registration_type;
+  // Optional, the identifier addressed by the event to look up the static
+  // registrations of an indexed type (see CONFIG_UDS_REGISTRATION_INDEX)
+  uint16_t (*get_id)(const void* arg);
 };
 
 #ifdef CONFIG_UDS_USE_DYNAMIC_REGISTRATION
@@ -48,4 +51,27 @@ UDSErr_t uds_event_callback(struct iso14229_zephyr_instance* inst,
 
 #endif  // CONFIG_UDS_USE_DYNAMIC_REGISTRATION
 
+/**
+ * @brief Copy memory that passed `uds_memory_map_check()` into the response
+ *
+ * @param mmio `true` to read aligned words from peripheral registers instead
+ *             of copying the memory directly
+ */
+UDSErr_t uds_memory_read(UDSServer_t* server,
+                         uint8_t (*copy)(UDSServer_t*, const void*, uint16_t),
+                         uintptr_t addr,
+                         size_t size,
+                         bool mmio);
+
+/**
+ * @brief Write memory that passed `uds_memory_map_check()`
+ *
+ * @param mmio `true` to write aligned words to peripheral registers instead
+ *             of copying the data directly
+ */
+UDSErr_t uds_memory_write(uintptr_t addr,
+                          const uint8_t* data,
+                          size_t size,
+                          bool mmio);
+
 #endif  // ARDEP_LIB_UDS_UDS_H
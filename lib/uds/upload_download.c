@@ -15,6 +15,8 @@ LOG_MODULE_DECLARE(uds, CONFIG_UDS_LOG_LEVEL);
 #include <zephyr/device.h>
 #include <zephyr/drivers/flash.h>
 #include <zephyr/fs/fs.h>
+#include <zephyr/kernel.h>
+#include <zephyr/spinlock.h>
 #include <zephyr/sys/util.h>
 
 #include <ardep/uds.h>
@@ -22,6 +24,12 @@ LOG_MODULE_DECLARE(uds, CONFIG_UDS_LOG_LEVEL);
 #ifdef CONFIG_UDS_FILE_TRANSFER
 #include "upload_download_file_transfer.h"
 #endif
+#ifdef CONFIG_UDS_DELTA_DOWNLOAD
+#include "upload_download_delta.h"
+#endif
+#ifdef CONFIG_UDS_DOWNLOAD_DIGEST
+#include "upload_download_digest.h"
+#endif
 
 static const struct device* const flash_controller =
     DEVICE_DT_GET_OR_NULL(DT_CHOSEN(zephyr_flash_controller));
@@ -44,6 +52,10 @@ struct upload_download_state {
   uintptr_t current_address;
   size_t total_size;
   size_t write_block_size;
+#ifdef CONFIG_UDS_UPLOAD_DOWNLOAD_ERASE_AHEAD
+  // everything from current_address up to here is erased
+  uintptr_t erased_until;
+#endif
 };
 
 struct upload_download_state upload_download_state = {
@@ -55,8 +67,124 @@ struct upload_download_state upload_download_state = {
   .write_block_size = 0,
 };
 
+#ifdef CONFIG_FLASH_PAGE_LAYOUT
+// Range erased by the erase job handed over with uds_download_use_erase_job(),
+// consumed by the next download
+static struct {
+  struct k_spinlock lock;
+  uintptr_t start;
+  uintptr_t end;
+} erased_range;
+
+void uds_download_use_erase_job(const struct uds_flash_erase_job* job) {
+  K_SPINLOCK(&erased_range.lock) {
+    erased_range.start = job != NULL ? job->start : 0;
+    erased_range.end = job != NULL ? job->next : 0;
+  }
+}
+
+int uds_flash_erase_job_init(struct uds_flash_erase_job* job,
+                             uintptr_t offset,
+                             size_t size) {
+  if (flash_controller == NULL || !device_is_ready(flash_controller)) {
+    return -ENODEV;
+  }
+
+  if (size == 0 || offset + size > FLASH_MAX_SIZE || offset + size < offset) {
+    return -EINVAL;
+  }
+
+  struct flash_pages_info first;
+  struct flash_pages_info last;
+
+  int rc = flash_get_page_info_by_offs(flash_controller, offset, &first);
+  if (rc != 0) {
+    return rc;
+  }
+
+  rc = flash_get_page_info_by_offs(flash_controller, offset + size - 1, &last);
+  if (rc != 0) {
+    return rc;
+  }
+
+  job->start = first.start_offset;
+  job->next = first.start_offset;
+  job->end = last.start_offset + last.size;
+
+  return 0;
+}
+
+int uds_flash_erase_job_step(struct uds_flash_erase_job* job) {
+  if (job->next >= job->end) {
+    return 0;
+  }
+
+  struct flash_pages_info page;
+  int rc = flash_get_page_info_by_offs(flash_controller, job->next, &page);
+  if (rc != 0) {
+    return rc;
+  }
+
+  rc = flash_erase(flash_controller, page.start_offset, page.size);
+  if (rc != 0) {
+    LOG_ERR("Flash erase failed at addr 0x%08lx, size %zu, err %d",
+            (uintptr_t)page.start_offset, page.size, rc);
+    return rc;
+  }
+
+  job->next = page.start_offset + page.size;
+
+  return job->next < job->end ? 1 : 0;
+}
+#endif
+
+#ifdef CONFIG_UDS_UPLOAD_DOWNLOAD_ERASE_AHEAD
+// Returns the end of the already erased range starting at address
+static uintptr_t take_erased_range(uintptr_t address) {
+  uintptr_t erased_until = address;
+
+  K_SPINLOCK(&erased_range.lock) {
+    if (address >= erased_range.start && address < erased_range.end) {
+      erased_until = erased_range.end;
+    }
+
+    // the download writes into the range, so it is not erased anymore
+    erased_range.start = 0;
+    erased_range.end = 0;
+  }
+
+  return erased_until;
+}
+
+// Erases all sectors up to end, that were not erased for this download yet
+static int erase_ahead(uintptr_t end) {
+  while (upload_download_state.erased_until < end) {
+    struct flash_pages_info page;
+    int rc = flash_get_page_info_by_offs(
+        flash_controller, upload_download_state.erased_until, &page);
+    if (rc != 0) {
+      return rc;
+    }
+
+    LOG_DBG("Erasing flash sector at addr 0x%08lx, size %zu",
+            (uintptr_t)page.start_offset, page.size);
+
+    rc = flash_erase(flash_controller, page.start_offset, page.size);
+    if (rc != 0) {
+      LOG_ERR("Flash erase failed at addr 0x%08lx, size %zu, err %d",
+              (uintptr_t)page.start_offset, page.size, rc);
+      return rc;
+    }
+
+    upload_download_state.erased_until = page.start_offset + page.size;
+  }
+
+  return 0;
+}
+#endif
+
 // Note that when downloading, the flash has to be erased in another way before
-// (e.g. using a routine)
+// (e.g. using a routine), unless CONFIG_UDS_UPLOAD_DOWNLOAD_ERASE_AHEAD is set
 static UDSErr_t start_download(const struct uds_context* const context) {
   /*
    * Here we assume that the upper layer has already checked whether an
@@ -68,6 +196,11 @@ static UDSErr_t start_download(const struct uds_context* const context) {
     return UDS_NRC_UploadDownloadNotAccepted;
   }
 
+#ifdef CONFIG_UDS_DOWNLOAD_DIGEST
+  // also discards the digest of the previous download if this one is rejected
+  uds_download_digest_start();
+#endif
+
   UDSRequestDownloadArgs_t* args = (UDSRequestDownloadArgs_t*)context->arg;
 
   if (args->size == 0) {
@@ -90,6 +223,13 @@ static UDSErr_t start_download(const struct uds_context* const context) {
     return UDS_NRC_RequestOutOfRange;
   }
 
+#ifdef CONFIG_UDS_DELTA_DOWNLOAD
+  if (args->dataFormatIdentifier == UDS_DATA_FORMAT_IDENTIFIER_DELTA) {
+    return uds_delta_download_start(flash_controller, (uintptr_t)args->addr,
+                                    args->size);
+  }
+#endif
+
   // only support plain data (it is the only format defined in the standard)
   if (args->dataFormatIdentifier != 0x00) {
     return UDS_NRC_RequestOutOfRange;
@@ -112,11 +252,148 @@ static UDSErr_t start_download(const struct uds_context* const context) {
     return UDS_NRC_UploadDownloadNotAccepted;
   }
 
+#ifdef CONFIG_UDS_UPLOAD_DOWNLOAD_ERASE_AHEAD
+  upload_download_state.erased_until =
+      take_erased_range(upload_download_state.start_address);
+
+  // erase_ahead() erases whole sectors, which must not destroy the data in
+  // front of the download
+  if (upload_download_state.erased_until ==
+      upload_download_state.start_address) {
+    struct flash_pages_info page;
+    int rc = flash_get_page_info_by_offs(
+        flash_controller, upload_download_state.start_address, &page);
+    if (rc != 0 || page.start_offset != upload_download_state.start_address) {
+      LOG_WRN("Download at 0x%08lx does not start at a flash sector",
+              upload_download_state.start_address);
+      return UDS_NRC_RequestOutOfRange;
+    }
+  }
+#endif
+
   upload_download_state.state = UDS_UPDOWN__DOWNLOAD_IN_PROGRESS;
 
   return UDS_OK;
 }
 
+#ifndef CONFIG_UDS_UPLOAD_MEMORY_MAPPED
+// Flash window read for an upload
+struct upload_window {
+  uint8_t data[CONFIG_UDS_UPLOAD_MAX_PAYLOAD_SIZE];
+  uintptr_t address;
+  size_t len;
+  int err;
+};
+
+// Double buffer for uploads, the next window is read on the system work queue
+// while the current one is copied into the responses
+static struct {
+  struct upload_window windows[2];
+  struct upload_window* current;
+  struct upload_window* next;
+  struct k_work work;
+} upload_read_ahead = {
+  .current = &upload_read_ahead.windows[0],
+  .next = &upload_read_ahead.windows[1],
+};
+
+static bool upload_window_contains(const struct upload_window* window,
+                                   uintptr_t address) {
+  return address >= window->address &&
+         address < window->address + window->len;
+}
+
+static void upload_read_ahead_handler(struct k_work* work) {
+  ARG_UNUSED(work);
+
+  struct upload_window* window = upload_read_ahead.next;
+
+  window->err = flash_read(flash_controller, window->address, window->data,
+                           window->len);
+}
+
+// Starts reading the window at address into the next buffer
+static void upload_read_ahead_start(uintptr_t address) {
+  struct upload_window* window = upload_read_ahead.next;
+  const uintptr_t end =
+      upload_download_state.start_address + upload_download_state.total_size;
+
+  window->address = address;
+  window->len = MIN(sizeof(window->data), end - address);
+
+  if (k_work_submit(&upload_read_ahead.work) < 0) {
+    upload_read_ahead_handler(&upload_read_ahead.work);
+  }
+}
+
+// Waits for a pending read and drops both windows
+static void upload_read_ahead_cancel(void) {
+  struct k_work_sync sync;
+
+  k_work_cancel_sync(&upload_read_ahead.work, &sync);
+
+  upload_read_ahead.current->len = 0;
+  upload_read_ahead.next->len = 0;
+}
+
+static void upload_read_ahead_begin(void) {
+  static bool initialized;
+
+  if (!initialized) {
+    k_work_init(&upload_read_ahead.work, upload_read_ahead_handler);
+    initialized = true;
+  }
+
+  upload_read_ahead_cancel();
+  upload_read_ahead_start(upload_download_state.start_address);
+}
+
+// Copies len bytes at the current address into the response. Uploads are
+// sequential, so the next window always follows the current one.
+static UDSErr_t upload_read_ahead_copy(const struct uds_context* const context,
+                                       UDSTransferDataArgs_t* args,
+                                       size_t len) {
+  uintptr_t address = upload_download_state.current_address;
+
+  while (len > 0) {
+    struct upload_window* window = upload_read_ahead.current;
+
+    if (!upload_window_contains(window, address)) {
+      struct k_work_sync sync;
+      k_work_flush(&upload_read_ahead.work, &sync);
+
+      upload_read_ahead.current = upload_read_ahead.next;
+      upload_read_ahead.next = window;
+      window = upload_read_ahead.current;
+
+      if (window->err != 0 || !upload_window_contains(window, address)) {
+        LOG_ERR("Flash read failed at addr 0x%08lx, size %zu, err %d",
+                window->address, window->len, window->err);
+        return UDS_NRC_GeneralProgrammingFailure;
+      }
+
+      const uintptr_t end = window->address + window->len;
+      if (end < upload_download_state.start_address +
+                    upload_download_state.total_size) {
+        upload_read_ahead_start(end);
+      }
+    }
+
+    const size_t chunk = MIN(len, window->address + window->len - address);
+    uint8_t rc = args->copyResponse(
+        context->server, &window->data[address - window->address], chunk);
+    if (rc != UDS_OK) {
+      return rc;
+    }
+
+    address += chunk;
+    len -= chunk;
+  }
+
+  return UDS_OK;
+}
+#endif
+
 static UDSErr_t start_upload(const struct uds_context* const context) {
   if (upload_download_state.state != UDS_UPDOWN__IDLE) {
     return UDS_NRC_RequestSequenceError;
@@ -151,12 +428,15 @@ static UDSErr_t start_upload(const struct uds_context* const context) {
   upload_download_state.current_address = (uintptr_t)args->addr;
   upload_download_state.total_size = args->size;
 
+#ifndef CONFIG_UDS_UPLOAD_MEMORY_MAPPED
+  upload_read_ahead_begin();
+#endif
+
   upload_download_state.state = UDS_UPDOWN__UPLOAD_IN_PROGRESS;
 
-  // maxNumberOfBlockLength includes 2 response bytes
-  args->maxNumberOfBlockLength =
-      MIN(CONFIG_UDS_UPLOAD_MAX_PAYLOAD_SIZE + UDS_0X36_RESP_BASE_LEN,
-          args->maxNumberOfBlockLength);
+  // the data is streamed into the response, so only the transport limits the
+  // block length (maxNumberOfBlockLength includes 2 response bytes)
+  args->maxNumberOfBlockLength = MIN(UDS_TP_MTU, args->maxNumberOfBlockLength);
 
   LOG_INF("Requested upload: from %p, size: %d", args->addr, args->size);
 
@@ -184,6 +464,18 @@ static UDSErr_t continue_download(const struct uds_context* const context) {
   const size_t first_write = args->len - overflow_size;
 
   int rc;
+
+#ifdef CONFIG_UDS_UPLOAD_DOWNLOAD_ERASE_AHEAD
+  const size_t padded_len =
+      first_write +
+      (overflow_size != 0 ? upload_download_state.write_block_size : 0);
+
+  rc = erase_ahead(upload_download_state.current_address + padded_len);
+  if (rc != 0) {
+    return UDS_NRC_GeneralProgrammingFailure;
+  }
+#endif
+
   if (first_write > 0) {
     rc = flash_write(flash_controller, upload_download_state.current_address,
                      args->data, first_write);
@@ -217,13 +509,15 @@ static UDSErr_t continue_download(const struct uds_context* const context) {
 
   LOG_INF("Write finished");
 
+#ifdef CONFIG_UDS_DOWNLOAD_DIGEST
+  uds_download_digest_update(args->data, args->len);
+#endif
+
   upload_download_state.current_address += args->len;
 
   return UDS_OK;
 }
 
-static uint8_t upload_buffer[CONFIG_UDS_UPLOAD_MAX_PAYLOAD_SIZE];
-
 static UDSErr_t continue_upload(const struct uds_context* const context) {
   if (upload_download_state.state != UDS_UPDOWN__UPLOAD_IN_PROGRESS) {
     return UDS_NRC_RequestSequenceError;
@@ -236,24 +530,27 @@ static UDSErr_t continue_upload(const struct uds_context* const context) {
 
   UDSTransferDataArgs_t* args = (UDSTransferDataArgs_t*)context->arg;
 
-  size_t len_to_copy =
-      MIN(CONFIG_UDS_UPLOAD_MAX_PAYLOAD_SIZE,
-          MIN(args->maxRespLen, upload_download_state.start_address +
-                                    upload_download_state.total_size -
-                                    upload_download_state.current_address));
-
-  int ret = flash_read(flash_controller, upload_download_state.current_address,
-                       upload_buffer, len_to_copy);
-
-  if (ret != 0) {
-    return UDS_NRC_GeneralProgrammingFailure;
-  }
-
   if (args->copyResponse == NULL) {
     return UDS_ERR_MISUSE;
   }
 
-  args->copyResponse(context->server, upload_buffer, len_to_copy);
+  size_t len_to_copy =
+      MIN(args->maxRespLen, upload_download_state.start_address +
+                                upload_download_state.total_size -
+                                upload_download_state.current_address);
+
+#ifdef CONFIG_UDS_UPLOAD_MEMORY_MAPPED
+  // the flash is copied into the response without a staging buffer
+  uint8_t rc = args->copyResponse(
+      context->server,
+      (const void*)(FLASH_BASE_ADDRESS + upload_download_state.current_address),
+      len_to_copy);
+#else
+  UDSErr_t rc = upload_read_ahead_copy(context, args, len_to_copy);
+#endif
+  if (rc != UDS_OK) {
+    return rc;
+  }
 
   upload_download_state.current_address += len_to_copy;
 
@@ -265,6 +562,12 @@ static UDSErr_t uds_upload_download_reset() {
     return UDS_NRC_RequestSequenceError;
   }
 
+#ifndef CONFIG_UDS_UPLOAD_MEMORY_MAPPED
+  if (upload_download_state.state == UDS_UPDOWN__UPLOAD_IN_PROGRESS) {
+    upload_read_ahead_cancel();
+  }
+#endif
+
   upload_download_state.state = UDS_UPDOWN__IDLE;
   upload_download_state.start_address = 0;
   upload_download_state.current_address = 0;
@@ -278,17 +581,30 @@ static UDSErr_t transfer_exit(const struct uds_context* const context) {
 
   LOG_INF("Transfer Exit");
 
+#ifdef CONFIG_UDS_DOWNLOAD_DIGEST
+  if (upload_download_state.state == UDS_UPDOWN__DOWNLOAD_IN_PROGRESS) {
+    uds_download_digest_finish();
+  }
+#endif
+
+  UDSErr_t ret = uds_upload_download_reset();
+
+  // only one transfer can be running, the others return out of sequence error
 #ifdef CONFIG_UDS_FILE_TRANSFER
-  UDSErr_t ret1 = uds_upload_download_reset();
-  UDSErr_t ret2 = uds_file_transfer_exit();
+  UDSErr_t ret_file = uds_file_transfer_exit();
+  assert(ret == UDS_NRC_RequestSequenceError ||
+         ret_file == UDS_NRC_RequestSequenceError);
+  ret = ret == UDS_NRC_RequestSequenceError ? ret_file : ret;
+#endif
 
-  // at least one must return out of sequence error, not both can be running
-  assert(ret1 == UDS_NRC_RequestSequenceError ||
-         ret2 == UDS_NRC_RequestSequenceError);
-  return ret1 == UDS_NRC_RequestSequenceError ? ret2 : ret1;
-#else
-  return uds_upload_download_reset();
+#ifdef CONFIG_UDS_DELTA_DOWNLOAD
+  UDSErr_t ret_delta = uds_delta_download_exit();
+  assert(ret == UDS_NRC_RequestSequenceError ||
+         ret_delta == UDS_NRC_RequestSequenceError);
+  ret = ret == UDS_NRC_RequestSequenceError ? ret_delta : ret;
 #endif
+
+  return ret;
 }
 
 static UDSErr_t uds_action_upload_download(struct uds_context* context,
@@ -301,6 +617,10 @@ static UDSErr_t uds_action_upload_download(struct uds_context* context,
     case UDS_EVT_RequestDownload:
     case UDS_EVT_RequestUpload:
     case UDS_EVT_RequestFileTransfer: {
+#ifdef CONFIG_UDS_DELTA_DOWNLOAD
+      // an unfinished delta download is discarded, not reported
+      uds_delta_download_abort();
+#endif
       int err = transfer_exit(context);
       // only return status on non-expected errors
       if (err != UDS_OK && err != UDS_NRC_RequestSequenceError) {
@@ -334,6 +654,13 @@ static UDSErr_t uds_action_upload_download(struct uds_context* context,
       }
 #endif
 
+#ifdef CONFIG_UDS_DELTA_DOWNLOAD
+      if (uds_delta_download_is_active()) {
+        UDSTransferDataArgs_t* args = (UDSTransferDataArgs_t*)context->arg;
+        return uds_delta_download_continue(args->data, args->len);
+      }
+#endif
+
       if (upload_download_state.state == UDS_UPDOWN__DOWNLOAD_IN_PROGRESS) {
         return continue_download(context);
       }
@@ -426,8 +753,8 @@ STRUCT_SECTION_ITERABLE(
 };
 
 // Dummy registration to get the upload/download handler registered
-STRUCT_SECTION_ITERABLE(uds_registration_t,
-                        __uds_registration_dummy_upload_download_) = {
+_UDS_REGISTRATION(upload_download,
+                  __uds_registration_dummy_upload_download_) = {
   .instance = NULL,
   .type = UDS_REGISTRATION_TYPE__UPLOAD_DOWNLOAD,
 };
@@ -0,0 +1,455 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (C) Frickly Systems GmbH
+ * SPDX-FileCopyrightText: Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_DECLARE(uds, CONFIG_UDS_LOG_LEVEL);
+
+#include "uds.h"
+#include "upload_download_delta.h"
+#ifdef CONFIG_UDS_DOWNLOAD_DIGEST
+#include "upload_download_digest.h"
+#endif
+
+#include <string.h>
+
+#include <zephyr/device.h>
+#include <zephyr/drivers/flash.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/crc.h>
+#include <zephyr/sys/util.h>
+
+#include <ardep/uds.h>
+#include <iso14229.h>
+
+#define DELTA_HEADER_SIZE 16
+#define DELTA_OP_COPY_SIZE 9
+#define DELTA_OP_INSERT_SIZE 5
+
+enum DeltaParseState {
+  UDS_DELTA__IDLE,
+  UDS_DELTA__HEADER,
+  UDS_DELTA__CHECK,
+  UDS_DELTA__OP,
+  UDS_DELTA__INSERT,
+};
+
+struct delta_download_state {
+  enum DeltaParseState state;
+  const struct device* flash;
+
+  // flash offset of the old and the new image
+  uintptr_t start_address;
+  size_t old_size;
+  size_t new_size;
+  // bytes of the new image produced so far
+  size_t written;
+
+  // fixed size fields, which may be split across TransferData requests
+  uint8_t field[DELTA_HEADER_SIZE];
+  size_t field_len;
+
+  // CRC of the old image so far, it is checked in chunks while the request
+  // of the header is answered with ResponsePending
+  uint32_t old_crc;
+  uint32_t expected_old_crc;
+  size_t checked;
+  // bytes of that request consumed before the check, skipped when it is
+  // handled again
+  size_t resume_len;
+
+  // remaining bytes and old image offset of the current operation
+  size_t op_remaining;
+  uintptr_t op_source;
+
+  // The sector currently being produced. The old content of this and all
+  // following sectors is still in flash, all sectors before are overwritten
+  uintptr_t sector_start;
+  size_t sector_size;
+  size_t sector_fill;
+  size_t write_block_size;
+};
+
+static struct delta_download_state delta_state = {
+  .state = UDS_DELTA__IDLE,
+};
+
+static uint8_t sector_buffer[CONFIG_UDS_DELTA_DOWNLOAD_SECTOR_BUFFER_SIZE];
+
+bool uds_delta_download_is_active(void) {
+  return delta_state.state != UDS_DELTA__IDLE;
+}
+
+void uds_delta_download_abort(void) {
+  delta_state.state = UDS_DELTA__IDLE;
+}
+
+static int open_sector(uintptr_t offset) {
+  struct flash_pages_info page;
+  int rc = flash_get_page_info_by_offs(delta_state.flash, offset, &page);
+  if (rc != 0) {
+    return rc;
+  }
+
+  if (page.start_offset != offset || page.size > sizeof(sector_buffer)) {
+    LOG_ERR("Flash sector at 0x%08lx of size %zu does not fit the buffer",
+            (uintptr_t)page.start_offset, page.size);
+    return -ENOMEM;
+  }
+
+  delta_state.sector_start = offset;
+  delta_state.sector_size = page.size;
+  delta_state.sector_fill = 0;
+  memset(sector_buffer, 0xFF, page.size);
+
+  return 0;
+}
+
+static int commit_sector(void) {
+  int rc = flash_erase(delta_state.flash, delta_state.sector_start,
+                       delta_state.sector_size);
+  if (rc != 0) {
+    LOG_ERR("Flash erase failed at addr 0x%08lx, err %d",
+            delta_state.sector_start, rc);
+    return rc;
+  }
+
+  rc = flash_write(
+      delta_state.flash, delta_state.sector_start, sector_buffer,
+      ROUND_UP(delta_state.sector_fill, delta_state.write_block_size));
+  if (rc != 0) {
+    LOG_ERR("Flash write failed at addr 0x%08lx, err %d",
+            delta_state.sector_start, rc);
+    return rc;
+  }
+
+#ifdef CONFIG_UDS_DOWNLOAD_DIGEST
+  // the digest covers the new image, not the patch
+  uds_download_digest_update(sector_buffer, delta_state.sector_fill);
+#endif
+
+  if (delta_state.written == delta_state.new_size) {
+    return 0;
+  }
+
+  return open_sector(delta_state.sector_start + delta_state.sector_size);
+}
+
+// Number of bytes the current operation can produce before the sector has to
+// be committed
+static size_t sector_space(size_t len) {
+  return MIN(len, delta_state.sector_size - delta_state.sector_fill);
+}
+
+static int produced(size_t len) {
+  delta_state.sector_fill += len;
+  delta_state.written += len;
+
+  if (delta_state.sector_fill == delta_state.sector_size ||
+      delta_state.written == delta_state.new_size) {
+    return commit_sector();
+  }
+
+  return 0;
+}
+
+static int produce_insert(const uint8_t* data, size_t len) {
+  const size_t chunk = sector_space(len);
+
+  memcpy(&sector_buffer[delta_state.sector_fill], data, chunk);
+  delta_state.op_remaining -= chunk;
+
+  int rc = produced(chunk);
+  return rc != 0 ? rc : (int)chunk;
+}
+
+static int produce_copy(void) {
+  const size_t chunk = sector_space(delta_state.op_remaining);
+
+  // sectors before the current one are already overwritten
+  if (delta_state.op_source < delta_state.sector_start) {
+    LOG_ERR("Delta copies from overwritten offset 0x%08lx",
+            delta_state.op_source);
+    return -EINVAL;
+  }
+
+  int rc = flash_read(delta_state.flash, delta_state.op_source,
+                      &sector_buffer[delta_state.sector_fill], chunk);
+  if (rc != 0) {
+    return rc;
+  }
+
+  delta_state.op_source += chunk;
+  delta_state.op_remaining -= chunk;
+
+  return produced(chunk);
+}
+
+// Collects a field of `size` bytes, returns true once it is complete
+static bool collect_field(const uint8_t** data, size_t* len, size_t size) {
+  const size_t chunk = MIN(*len, size - delta_state.field_len);
+
+  memcpy(&delta_state.field[delta_state.field_len], *data, chunk);
+  delta_state.field_len += chunk;
+  *data += chunk;
+  *len -= chunk;
+
+  if (delta_state.field_len < size) {
+    return false;
+  }
+
+  delta_state.field_len = 0;
+  return true;
+}
+
+// Adds the next chunk of the old image to its CRC, returns ResponsePending
+// until the whole image is checked
+static UDSErr_t check_old_image(void) {
+  uint8_t buf[64];
+  const size_t end =
+      MIN(delta_state.old_size,
+          delta_state.checked + CONFIG_UDS_DELTA_DOWNLOAD_CHECK_CHUNK_SIZE);
+
+  while (delta_state.checked < end) {
+    const size_t len = MIN(sizeof(buf), end - delta_state.checked);
+
+    int rc = flash_read(delta_state.flash,
+                        delta_state.start_address + delta_state.checked, buf,
+                        len);
+    if (rc != 0) {
+      return UDS_NRC_GeneralProgrammingFailure;
+    }
+
+    delta_state.old_crc = crc32_ieee_update(delta_state.old_crc, buf, len);
+    delta_state.checked += len;
+  }
+
+  if (delta_state.checked < delta_state.old_size) {
+    return UDS_NRC_RequestCorrectlyReceived_ResponsePending;
+  }
+
+  if (delta_state.old_crc != delta_state.expected_old_crc) {
+    LOG_WRN("Delta does not match the installed image (crc 0x%08x != 0x%08x)",
+            delta_state.old_crc, delta_state.expected_old_crc);
+    return UDS_NRC_ConditionsNotCorrect;
+  }
+
+  return UDS_OK;
+}
+
+static UDSErr_t parse_header(void) {
+  if (sys_get_le32(&delta_state.field[0]) != UDS_DELTA_MAGIC) {
+    LOG_WRN("Invalid delta header");
+    return UDS_NRC_RequestOutOfRange;
+  }
+
+  delta_state.old_size = sys_get_le32(&delta_state.field[4]);
+  delta_state.expected_old_crc = sys_get_le32(&delta_state.field[8]);
+  const uint32_t new_size = sys_get_le32(&delta_state.field[12]);
+
+  if (new_size != delta_state.new_size) {
+    LOG_WRN("Delta produces %u bytes, but %zu bytes were requested", new_size,
+            delta_state.new_size);
+    return UDS_NRC_RequestOutOfRange;
+  }
+
+  const size_t flash_size = DT_REG_SIZE(DT_CHOSEN(zephyr_flash));
+  if (delta_state.old_size > flash_size - delta_state.start_address) {
+    return UDS_NRC_RequestOutOfRange;
+  }
+
+  delta_state.old_crc = 0;
+  delta_state.checked = 0;
+
+  return UDS_OK;
+}
+
+// Copies need no further data, so they are done as soon as they are parsed
+static int run_copy(void) {
+  int rc = 0;
+
+  while (rc == 0 && delta_state.op_remaining > 0) {
+    rc = produce_copy();
+  }
+
+  return rc;
+}
+
+static UDSErr_t parse_op(const uint8_t** data, size_t* len) {
+  size_t size;
+
+  if (delta_state.field_len == 0) {
+    delta_state.field[0] = **data;
+    delta_state.field_len = 1;
+    *data += 1;
+    *len -= 1;
+  }
+
+  switch (delta_state.field[0]) {
+    case UDS_DELTA_OP_COPY:
+      size = DELTA_OP_COPY_SIZE;
+      break;
+    case UDS_DELTA_OP_INSERT:
+      size = DELTA_OP_INSERT_SIZE;
+      break;
+    default:
+      LOG_WRN("Invalid delta operation 0x%02x", delta_state.field[0]);
+      return UDS_NRC_RequestOutOfRange;
+  }
+
+  if (!collect_field(data, len, size)) {
+    return UDS_OK;
+  }
+
+  delta_state.op_remaining = sys_get_le32(&delta_state.field[1]);
+
+  if (delta_state.op_remaining > delta_state.new_size - delta_state.written) {
+    LOG_WRN("Delta exceeds the requested size");
+    return UDS_NRC_RequestOutOfRange;
+  }
+
+  if (delta_state.field[0] == UDS_DELTA_OP_INSERT) {
+    delta_state.state = delta_state.op_remaining > 0 ? UDS_DELTA__INSERT
+                                                     : UDS_DELTA__OP;
+    return UDS_OK;
+  }
+
+  const uint32_t source = sys_get_le32(&delta_state.field[5]);
+  if (source > delta_state.old_size ||
+      delta_state.op_remaining > delta_state.old_size - source) {
+    LOG_WRN("Delta copies outside of the old image");
+    return UDS_NRC_RequestOutOfRange;
+  }
+
+  delta_state.op_source = delta_state.start_address + source;
+
+  return run_copy() == 0 ? UDS_OK : UDS_NRC_GeneralProgrammingFailure;
+}
+
+UDSErr_t uds_delta_download_start(const struct device* flash,
+                                  uintptr_t address,
+                                  size_t size) {
+  delta_state.flash = flash;
+  delta_state.start_address = address;
+  delta_state.new_size = size;
+  delta_state.written = 0;
+  delta_state.field_len = 0;
+  delta_state.write_block_size = flash_get_write_block_size(flash);
+
+  // the new image is built sector by sector, so it has to start at a sector
+  if (open_sector(address) != 0) {
+    return UDS_NRC_RequestOutOfRange;
+  }
+
+  LOG_INF("Starting delta download to flash addr 0x%08lx, size %zu", address,
+          size);
+
+  delta_state.state = UDS_DELTA__HEADER;
+
+  return UDS_OK;
+}
+
+UDSErr_t uds_delta_download_continue(const uint8_t* data, size_t len) {
+  if (len == 0) {
+    return UDS_NRC_RequestOutOfRange;
+  }
+
+  const size_t request_len = len;
+
+  // the request of the header is handled again while the old image is checked
+  if (delta_state.state == UDS_DELTA__CHECK) {
+    if (len < delta_state.resume_len) {
+      uds_delta_download_abort();
+      return UDS_NRC_RequestSequenceError;
+    }
+    data += delta_state.resume_len;
+    len -= delta_state.resume_len;
+  }
+
+  while (len > 0 || delta_state.state == UDS_DELTA__CHECK) {
+    UDSErr_t err = UDS_OK;
+    int rc = 0;
+
+    switch (delta_state.state) {
+      case UDS_DELTA__HEADER:
+        if (collect_field(&data, &len, DELTA_HEADER_SIZE)) {
+          err = parse_header();
+          delta_state.state = UDS_DELTA__CHECK;
+        }
+        break;
+
+      case UDS_DELTA__CHECK:
+        err = check_old_image();
+        if (err == UDS_NRC_RequestCorrectlyReceived_ResponsePending) {
+          delta_state.resume_len = request_len - len;
+          return err;
+        }
+        delta_state.state = UDS_DELTA__OP;
+        break;
+
+      case UDS_DELTA__OP:
+        if (delta_state.written == delta_state.new_size) {
+          LOG_WRN("Delta exceeds the requested size");
+          err = UDS_NRC_RequestOutOfRange;
+          break;
+        }
+        err = parse_op(&data, &len);
+        break;
+
+      case UDS_DELTA__INSERT:
+        rc = produce_insert(data, MIN(len, delta_state.op_remaining));
+        if (rc > 0) {
+          data += rc;
+          len -= rc;
+          rc = 0;
+        }
+        if (delta_state.op_remaining == 0) {
+          delta_state.state = UDS_DELTA__OP;
+        }
+        break;
+
+      default:
+        return UDS_NRC_RequestSequenceError;
+    }
+
+    if (rc != 0) {
+      err = UDS_NRC_GeneralProgrammingFailure;
+    }
+
+    if (err != UDS_OK) {
+      uds_delta_download_abort();
+      return err;
+    }
+  }
+
+  return UDS_OK;
+}
+
+UDSErr_t uds_delta_download_exit(void) {
+  if (delta_state.state == UDS_DELTA__IDLE) {
+    return UDS_NRC_RequestSequenceError;
+  }
+
+  const bool complete = delta_state.state == UDS_DELTA__OP &&
+                        delta_state.field_len == 0 &&
+                        delta_state.written == delta_state.new_size;
+
+  uds_delta_download_abort();
+
+  if (!complete) {
+    LOG_WRN("Delta download incomplete, %zu of %zu bytes written",
+            delta_state.written, delta_state.new_size);
+    return UDS_NRC_GeneralProgrammingFailure;
+  }
+
+  LOG_INF("Delta download finished");
+
+#ifdef CONFIG_UDS_DOWNLOAD_DIGEST
+  uds_download_digest_finish();
+#endif
+
+  return UDS_OK;
+}
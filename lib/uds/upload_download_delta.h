@@ -0,0 +1,23 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (C) Frickly Systems GmbH
+ * SPDX-FileCopyrightText: Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef UDS_UPLOAD_DOWNLOAD_DELTA_H
+#define UDS_UPLOAD_DOWNLOAD_DELTA_H
+
+#include "uds.h"
+
+#include <ardep/uds.h>
+
+bool uds_delta_download_is_active(void);
+UDSErr_t uds_delta_download_start(const struct device* flash,
+                                  uintptr_t address,
+                                  size_t size);
+UDSErr_t uds_delta_download_continue(const uint8_t* data, size_t len);
+UDSErr_t uds_delta_download_exit(void);
+void uds_delta_download_abort(void);
+
+#endif  // UDS_UPLOAD_DOWNLOAD_DELTA_H
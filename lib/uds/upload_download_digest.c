@@ -0,0 +1,200 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (C) Frickly Systems GmbH
+ * SPDX-FileCopyrightText: Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_DECLARE(uds, CONFIG_UDS_LOG_LEVEL);
+
+#include "uds.h"
+#include "upload_download_digest.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/sys/byteorder.h>
+
+#ifdef CONFIG_UDS_DOWNLOAD_DIGEST_CRC32
+#include <zephyr/sys/crc.h>
+#endif
+#ifdef CONFIG_UDS_DOWNLOAD_DIGEST_SHA256
+#include <psa/crypto.h>
+#endif
+
+#include <ardep/uds.h>
+#include <iso14229.h>
+
+enum DownloadDigestState {
+  // no download was started or the digest could not be computed
+  UDS_DIGEST__NONE,
+  UDS_DIGEST__RUNNING,
+  UDS_DIGEST__DONE,
+};
+
+static struct {
+  enum DownloadDigestState state;
+#ifdef CONFIG_UDS_DOWNLOAD_DIGEST_CRC32
+  uint32_t crc;
+#endif
+#ifdef CONFIG_UDS_DOWNLOAD_DIGEST_SHA256
+  psa_hash_operation_t operation;
+#endif
+  uint8_t digest[UDS_DOWNLOAD_DIGEST_SIZE];
+} digest_state = {
+  .state = UDS_DIGEST__NONE,
+};
+
+#ifdef CONFIG_UDS_DOWNLOAD_DIGEST_CRC32
+static int digest_setup(void) {
+  digest_state.crc = 0;
+  return 0;
+}
+
+static int digest_update(const uint8_t* data, size_t len) {
+  digest_state.crc = crc32_ieee_update(digest_state.crc, data, len);
+  return 0;
+}
+
+static int digest_finish(void) {
+  sys_put_be32(digest_state.crc, digest_state.digest);
+  return 0;
+}
+
+static void digest_abort(void) {}
+#endif
+
+#ifdef CONFIG_UDS_DOWNLOAD_DIGEST_SHA256
+static int digest_setup(void) {
+  psa_status_t status = psa_crypto_init();
+  if (status != PSA_SUCCESS) {
+    return status;
+  }
+
+  digest_state.operation = psa_hash_operation_init();
+  return psa_hash_setup(&digest_state.operation, PSA_ALG_SHA_256);
+}
+
+static int digest_update(const uint8_t* data, size_t len) {
+  return psa_hash_update(&digest_state.operation, data, len);
+}
+
+static int digest_finish(void) {
+  size_t len;
+  return psa_hash_finish(&digest_state.operation, digest_state.digest,
+                         sizeof(digest_state.digest), &len);
+}
+
+static void digest_abort(void) {
+  psa_hash_abort(&digest_state.operation);
+}
+#endif
+
+void uds_download_digest_start(void) {
+  if (digest_state.state == UDS_DIGEST__RUNNING) {
+    digest_abort();
+  }
+
+  int rc = digest_setup();
+  if (rc != 0) {
+    LOG_ERR("Failed to start download digest, err %d", rc);
+    digest_state.state = UDS_DIGEST__NONE;
+    return;
+  }
+
+  digest_state.state = UDS_DIGEST__RUNNING;
+}
+
+void uds_download_digest_update(const uint8_t* data, size_t len) {
+  if (digest_state.state != UDS_DIGEST__RUNNING) {
+    return;
+  }
+
+  int rc = digest_update(data, len);
+  if (rc != 0) {
+    LOG_ERR("Failed to update download digest, err %d", rc);
+    digest_abort();
+    digest_state.state = UDS_DIGEST__NONE;
+  }
+}
+
+void uds_download_digest_finish(void) {
+  if (digest_state.state != UDS_DIGEST__RUNNING) {
+    return;
+  }
+
+  int rc = digest_finish();
+  if (rc != 0) {
+    LOG_ERR("Failed to finish download digest, err %d", rc);
+    digest_abort();
+    digest_state.state = UDS_DIGEST__NONE;
+    return;
+  }
+
+  digest_state.state = UDS_DIGEST__DONE;
+}
+
+int uds_download_digest_get(uint8_t digest[UDS_DOWNLOAD_DIGEST_SIZE]) {
+  if (digest_state.state != UDS_DIGEST__DONE) {
+    return -ENODATA;
+  }
+
+  memcpy(digest, digest_state.digest, UDS_DOWNLOAD_DIGEST_SIZE);
+  return 0;
+}
+
+UDSErr_t uds_check_default_check_programming_dependencies(
+    const struct uds_context* const context, bool* apply_action) {
+  // the dependencies are only checked after programming
+  if (context->server->sessionType != UDS_DIAG_SESSION__PROGRAMMING) {
+    return UDS_NRC_RequestOutOfRange;
+  }
+
+  *apply_action = true;
+  return UDS_OK;
+}
+
+UDSErr_t uds_action_default_check_programming_dependencies(
+    struct uds_context* const context, bool* consume_event) {
+  UDSRoutineCtrlArgs_t* args = (UDSRoutineCtrlArgs_t*)context->arg;
+
+  // result byte followed by the digest
+  uint8_t record[1 + UDS_DOWNLOAD_DIGEST_SIZE];
+
+  *consume_event = true;
+
+  if (args->ctrlType != UDS_ROUTINE_CONTROL__START_ROUTINE &&
+      args->ctrlType != UDS_ROUTINE_CONTROL__REQUEST_ROUTINE_RESULTS) {
+    LOG_WRN("Unsupported control type: 0x%02x", args->ctrlType);
+    *consume_event = false;
+    return UDS_NRC_SubFunctionNotSupported;
+  }
+
+  if (uds_download_digest_get(&record[1]) != 0) {
+    LOG_WRN("No digest of a finished download available");
+    return UDS_NRC_RequestSequenceError;
+  }
+
+  // without an expected digest, the digest is returned to the tester
+  if (args->ctrlType == UDS_ROUTINE_CONTROL__REQUEST_ROUTINE_RESULTS ||
+      args->len == 0) {
+    return args->copyStatusRecord(context->server, &record[1],
+                                  UDS_DOWNLOAD_DIGEST_SIZE);
+  }
+
+  if (args->len != UDS_DOWNLOAD_DIGEST_SIZE) {
+    return UDS_NRC_IncorrectMessageLengthOrInvalidFormat;
+  }
+
+  const bool correct =
+      memcmp(args->optionRecord, &record[1], UDS_DOWNLOAD_DIGEST_SIZE) == 0;
+  record[0] = correct ? UDS_CHECK_PROGRAMMING_DEPENDENCIES_CORRECT
+                      : UDS_CHECK_PROGRAMMING_DEPENDENCIES_INCORRECT;
+
+  if (!correct) {
+    LOG_WRN("Downloaded data does not match the expected digest");
+  }
+
+  return args->copyStatusRecord(context->server, record, sizeof(record));
+}
@@ -0,0 +1,21 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (C) Frickly Systems GmbH
+ * SPDX-FileCopyrightText: Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef UDS_UPLOAD_DOWNLOAD_DIGEST_H
+#define UDS_UPLOAD_DOWNLOAD_DIGEST_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Discards the digest of the previous download and starts a new one
+void uds_download_digest_start(void);
+// Adds data written to flash by the running download
+void uds_download_digest_update(const uint8_t* data, size_t len);
+// Completes the digest once the download is exited successfully
+void uds_download_digest_finish(void);
+
+#endif  // UDS_UPLOAD_DOWNLOAD_DIGEST_H
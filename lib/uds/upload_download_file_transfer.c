@@ -15,17 +15,51 @@ LOG_MODULE_DECLARE(uds, CONFIG_UDS_LOG_LEVEL);
 #include <string.h>
 
 #include <zephyr/fs/fs.h>
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
 #include <zephyr/sys/util.h>
 
 #include <ardep/uds.h>
 #include <iso14229.h>
 
+#ifdef CONFIG_UDS_FILE_TRANSFER_STATS
+#include <zephyr/stats/stats.h>
+
+STATS_SECT_START(uds_file_transfer_stats)
+STATS_SECT_ENTRY32(writes)
+STATS_SECT_ENTRY32(reads)
+STATS_SECT_ENTRY32(waits)
+STATS_SECT_END;
+
+STATS_NAME_START(uds_file_transfer_stats)
+STATS_NAME(uds_file_transfer_stats, writes)
+STATS_NAME(uds_file_transfer_stats, reads)
+STATS_NAME(uds_file_transfer_stats, waits)
+STATS_NAME_END(uds_file_transfer_stats);
+
+static STATS_SECT_DECL(uds_file_transfer_stats) uds_file_transfer_stats;
+
+#define UDS_FILE_TRANSFER_STATS_INC(_name) \
+  STATS_INC(uds_file_transfer_stats, _name)
+#else
+#define UDS_FILE_TRANSFER_STATS_INC(_name)
+#endif
+
 enum FileTransferMode {
   UDS_FILE_TRANSFER__IDLE,
   UDS_FILE_TRANSFER__WRITE,
   UDS_FILE_TRANSFER__READ,
 };
 
+// Data staged for a write or read ahead from the file
+struct file_transfer_buffer {
+  uint8_t data[CONFIG_UDS_FILE_TRANSFER_BUFFER_SIZE];
+  size_t len;
+  // bytes already copied into responses while reading
+  size_t offset;
+};
+
 struct file_transfer_state {
   enum FileTransferMode mode;
   struct fs_file_t file;
@@ -33,6 +67,18 @@ struct file_transfer_state {
   size_t expected_size;
   size_t transferred;
   uint16_t block_length;
+
+  // TransferData fills or drains the current buffer, while the work queue
+  // writes or reads the other one
+  struct file_transfer_buffer buffers[2];
+  struct file_transfer_buffer *current;
+  struct file_transfer_buffer *pending;
+  // bytes read from the file, including the ones not sent yet
+  size_t read_position;
+  // bytes written since the last fs_sync
+  size_t unsynced;
+  // first error of the work queue, reported at the next block or at exit
+  atomic_t err;
 };
 
 struct file_transfer_state file_transfer_state = {
@@ -41,15 +87,40 @@ struct file_transfer_state file_transfer_state = {
   .expected_size = 0,
   .transferred = 0,
   .block_length = 0,
+  .current = &file_transfer_state.buffers[0],
+  .pending = &file_transfer_state.buffers[1],
 };
 
+// The file system is accessed from a work queue below the priority of the UDS
+// thread, so TransferData responses do not wait for flash programs
+K_THREAD_STACK_DEFINE(file_transfer_work_q_stack,
+                      CONFIG_UDS_FILE_TRANSFER_WORKQUEUE_STACK_SIZE);
+static struct k_work_q file_transfer_work_q;
+
+static void file_transfer_work_handler(struct k_work *work);
+K_WORK_DEFINE(file_transfer_work, file_transfer_work_handler);
+
 #define UDS_FILE_TRANSFER_MAX_PATH 256U
 
-static uint16_t uds_file_transfer_block_length(uint16_t requested) {
+// TransferData requests and responses carry 2 bytes in front of the data
+#define UDS_FILE_TRANSFER_BLOCK_HEADER_LEN UDS_0X36_RESP_BASE_LEN
+
+static uint16_t uds_file_transfer_block_length(const char *path,
+                                               uint16_t requested) {
   uint16_t limit = UDS_TP_MTU;
 
   if (requested > 0 && requested < limit) {
-    return requested;
+    limit = requested;
+  }
+
+  // whole program units of the file system per block, so littlefs programs
+  // full units instead of merging partial ones in its cache
+  struct fs_statvfs stat;
+  if (fs_statvfs(path, &stat) == 0 && stat.f_bsize > 0 &&
+      limit > UDS_FILE_TRANSFER_BLOCK_HEADER_LEN + stat.f_bsize) {
+    return ROUND_DOWN(limit - UDS_FILE_TRANSFER_BLOCK_HEADER_LEN,
+                      stat.f_bsize) +
+           UDS_FILE_TRANSFER_BLOCK_HEADER_LEN;
   }
 
   return limit;
@@ -67,7 +138,73 @@ static UDSErr_t fs_error_to_nrc(int err) {
   }
 }
 
+static void file_transfer_work_handler(struct k_work *work) {
+  ARG_UNUSED(work);
+
+  struct file_transfer_buffer *buffer = file_transfer_state.pending;
+  ssize_t rc;
+
+  if (file_transfer_state.mode == UDS_FILE_TRANSFER__READ) {
+    size_t len = MIN(sizeof(buffer->data),
+                     file_transfer_state.expected_size -
+                         file_transfer_state.read_position);
+
+    rc = fs_read(&file_transfer_state.file, buffer->data, len);
+    UDS_FILE_TRANSFER_STATS_INC(reads);
+
+    buffer->len = rc > 0 ? (size_t)rc : 0;
+    buffer->offset = 0;
+    file_transfer_state.read_position += buffer->len;
+  } else {
+    rc = fs_write(&file_transfer_state.file, buffer->data, buffer->len);
+    UDS_FILE_TRANSFER_STATS_INC(writes);
+    if (rc >= 0 && (size_t)rc != buffer->len) {
+      rc = -ENOSPC;
+    }
+
+    if (rc >= 0 && CONFIG_UDS_FILE_TRANSFER_SYNC_INTERVAL > 0) {
+      file_transfer_state.unsynced += buffer->len;
+
+      if (file_transfer_state.unsynced >=
+          CONFIG_UDS_FILE_TRANSFER_SYNC_INTERVAL) {
+        rc = fs_sync(&file_transfer_state.file);
+        file_transfer_state.unsynced = 0;
+      }
+    }
+
+    buffer->len = 0;
+  }
+
+  if (rc < 0) {
+    LOG_ERR("File transfer %s failed (%d)",
+            file_transfer_state.mode == UDS_FILE_TRANSFER__READ ? "read"
+                                                                : "write",
+            (int)rc);
+    atomic_cas(&file_transfer_state.err, 0, (atomic_val_t)rc);
+  }
+}
+
+// Waits for the work queue, then hands the current buffer to it and continues
+// with the buffer it finished
+static void file_transfer_swap_buffers(void) {
+  struct k_work_sync sync;
+  if (k_work_flush(&file_transfer_work, &sync)) {
+    UDS_FILE_TRANSFER_STATS_INC(waits);
+  }
+
+  struct file_transfer_buffer *finished = file_transfer_state.pending;
+  file_transfer_state.pending = file_transfer_state.current;
+  file_transfer_state.current = finished;
+}
+
+static void file_transfer_submit(void) {
+  k_work_submit_to_queue(&file_transfer_work_q, &file_transfer_work);
+}
+
 static void uds_file_transfer_reset(void) {
+  struct k_work_sync sync;
+  k_work_flush(&file_transfer_work, &sync);
+
   if (file_transfer_state.file_open) {
     fs_close(&file_transfer_state.file);
   }
@@ -77,6 +214,14 @@ static void uds_file_transfer_reset(void) {
   file_transfer_state.expected_size = 0;
   file_transfer_state.transferred = 0;
   file_transfer_state.block_length = 0;
+
+  file_transfer_state.buffers[0].len = 0;
+  file_transfer_state.buffers[0].offset = 0;
+  file_transfer_state.buffers[1].len = 0;
+  file_transfer_state.buffers[1].offset = 0;
+  file_transfer_state.read_position = 0;
+  file_transfer_state.unsynced = 0;
+  atomic_clear(&file_transfer_state.err);
 }
 
 static UDSErr_t uds_file_transfer_begin_write(
@@ -96,7 +241,7 @@ static UDSErr_t uds_file_transfer_begin_write(
   file_transfer_state.expected_size = expected_size;
   file_transfer_state.transferred = 0U;
   file_transfer_state.block_length =
-      uds_file_transfer_block_length(args->maxNumberOfBlockLength);
+      uds_file_transfer_block_length(path, args->maxNumberOfBlockLength);
 
   args->maxNumberOfBlockLength = file_transfer_state.block_length;
 
@@ -113,6 +258,7 @@ static UDSErr_t uds_file_transfer_begin_read(
   if (rc < 0) {
     return fs_error_to_nrc(rc);
   }
+  file_transfer_state.file_open = true;
 
   rc = fs_stat(path, &entry);
   if (rc < 0) {
@@ -130,10 +276,15 @@ static UDSErr_t uds_file_transfer_begin_read(
   file_transfer_state.expected_size = entry.size;
   file_transfer_state.transferred = 0U;
   file_transfer_state.block_length =
-      uds_file_transfer_block_length(args->maxNumberOfBlockLength);
+      uds_file_transfer_block_length(path, args->maxNumberOfBlockLength);
 
   args->maxNumberOfBlockLength = file_transfer_state.block_length;
 
+  // the first data is read while the response is sent
+  if (entry.size > 0) {
+    file_transfer_submit();
+  }
+
   return UDS_OK;
 }
 
@@ -196,14 +347,29 @@ static UDSErr_t uds_file_transfer_write(const UDSTransferDataArgs_t *args) {
     return UDS_NRC_RequestOutOfRange;
   }
 
-  ssize_t rc = fs_write(&file_transfer_state.file, args->data, args->len);
-
-  if (rc < 0) {
-    return fs_error_to_nrc((int)rc);
+  int err = (int)atomic_get(&file_transfer_state.err);
+  if (err < 0) {
+    return fs_error_to_nrc(err);
   }
 
-  if ((size_t)rc != args->len) {
-    return UDS_NRC_UploadDownloadNotAccepted;
+  // the block is acknowledged once it is staged, full buffers are written by
+  // the work queue
+  const uint8_t *data = args->data;
+  size_t len = args->len;
+
+  while (len > 0) {
+    struct file_transfer_buffer *buffer = file_transfer_state.current;
+    size_t chunk = MIN(len, sizeof(buffer->data) - buffer->len);
+
+    memcpy(&buffer->data[buffer->len], data, chunk);
+    buffer->len += chunk;
+    data += chunk;
+    len -= chunk;
+
+    if (buffer->len == sizeof(buffer->data)) {
+      file_transfer_swap_buffers();
+      file_transfer_submit();
+    }
   }
 
   file_transfer_state.transferred += args->len;
@@ -231,25 +397,43 @@ UDSErr_t uds_file_transfer_read(struct uds_context *context,
     return UDS_NRC_RequestSequenceError;
   }
 
-  size_t max_len = MIN((size_t)args->maxRespLen, remaining);
+  size_t len = MIN((size_t)args->maxRespLen, remaining);
 
-  ssize_t rc = fs_read(&file_transfer_state.file, (void *)args->data, max_len);
+  while (len > 0) {
+    struct file_transfer_buffer *buffer = file_transfer_state.current;
 
-  if (rc < 0) {
-    return fs_error_to_nrc((int)rc);
-  }
+    if (buffer->offset == buffer->len) {
+      file_transfer_swap_buffers();
+      buffer = file_transfer_state.current;
 
-  if (rc == 0) {
-    return UDS_NRC_RequestSequenceError;
-  }
+      int err = (int)atomic_get(&file_transfer_state.err);
+      if (err < 0) {
+        return fs_error_to_nrc(err);
+      }
 
-  uint8_t copy_status =
-      args->copyResponse(context->server, args->data, (uint16_t)rc);
-  if (copy_status != UDS_PositiveResponse) {
-    return copy_status;
-  }
+      // the file got shorter since the request
+      if (buffer->len == 0) {
+        return UDS_NRC_RequestSequenceError;
+      }
+
+      if (file_transfer_state.read_position <
+          file_transfer_state.expected_size) {
+        file_transfer_submit();
+      }
+    }
 
-  file_transfer_state.transferred += (size_t)rc;
+    size_t chunk = MIN(len, buffer->len - buffer->offset);
+
+    uint8_t copy_status = args->copyResponse(
+        context->server, &buffer->data[buffer->offset], (uint16_t)chunk);
+    if (copy_status != UDS_PositiveResponse) {
+      return copy_status;
+    }
+
+    buffer->offset += chunk;
+    file_transfer_state.transferred += chunk;
+    len -= chunk;
+  }
 
   return UDS_OK;
 }
@@ -283,6 +467,21 @@ UDSErr_t uds_file_transfer_exit(void) {
     complete = false;
   }
 
+  if (mode == UDS_FILE_TRANSFER__WRITE) {
+    if (file_transfer_state.current->len > 0) {
+      file_transfer_swap_buffers();
+      file_transfer_submit();
+    }
+
+    // the staged data has to be written before the transfer is complete
+    struct k_work_sync sync;
+    k_work_flush(&file_transfer_work, &sync);
+
+    if (atomic_get(&file_transfer_state.err) < 0) {
+      complete = false;
+    }
+  }
+
   uds_file_transfer_reset();
 
   return complete ? UDS_OK : UDS_NRC_GeneralProgrammingFailure;
@@ -291,3 +490,23 @@ UDSErr_t uds_file_transfer_exit(void) {
 bool uds_file_transfer_is_active(void) {
   return file_transfer_state.mode != UDS_FILE_TRANSFER__IDLE;
 }
+
+static int uds_file_transfer_init(void) {
+#ifdef CONFIG_UDS_FILE_TRANSFER_STATS
+  int ret = STATS_INIT_AND_REG(uds_file_transfer_stats, STATS_SIZE_32,
+                               "uds_file_transfer");
+  if (ret < 0) {
+    LOG_ERR("Failed to register the file transfer stats: %d", ret);
+    return ret;
+  }
+#endif
+
+  k_work_queue_start(&file_transfer_work_q, file_transfer_work_q_stack,
+                     K_THREAD_STACK_SIZEOF(file_transfer_work_q_stack),
+                     CONFIG_UDS_FILE_TRANSFER_WORKQUEUE_PRIORITY, NULL);
+  k_thread_name_set(&file_transfer_work_q.thread, "uds_file_transfer");
+
+  return 0;
+}
+
+SYS_INIT(uds_file_transfer_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
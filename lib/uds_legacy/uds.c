@@ -13,6 +13,10 @@ LOG_MODULE_REGISTER(uds_legacy, CONFIG_UDS_LEGACY_LOG_LEVEL);
 #include "uds.h"
 #include "uds_session.h"
 
+#ifdef CONFIG_UDS_LEGACY_GEARSHIFT_ADDRESSING
+#include <ardep/drivers/binary_encoded_gpio.h>
+#endif
+
 #include <zephyr/dfu/flash_img.h>
 #include <zephyr/dfu/mcuboot.h>
 #include <zephyr/storage/flash_map.h>
@@ -23,11 +27,11 @@ LOG_MODULE_REGISTER(uds_legacy, CONFIG_UDS_LEGACY_LOG_LEVEL);
 
 const struct isotp_fc_opts fc_opts = {.bs = 0, .stmin = 10};
 
-const struct isotp_msg_id rx_addr = {
-  .std_id = 0x80,
+struct isotp_msg_id rx_addr = {
+  .std_id = CONFIG_UDS_LEGACY_RX_ID,
 };
-const struct isotp_msg_id tx_addr = {
-  .std_id = 0x180,
+struct isotp_msg_id tx_addr = {
+  .std_id = CONFIG_UDS_LEGACY_TX_ID,
 };
 
 const struct device *can_dev;
@@ -71,6 +75,21 @@ static int init_can() {
   return 0;
 }
 
+#ifdef CONFIG_UDS_LEGACY_GEARSHIFT_ADDRESSING
+static void apply_gearshift_position() {
+  const struct device *gearshift_dev = DEVICE_DT_GET(DT_NODELABEL(gearshift));
+
+  int ret = binary_encoded_gpios_get_value(gearshift_dev);
+  if (ret < 0) {
+    LOG_ERR("Failed to read gearshift position [%d]\n", ret);
+    return;
+  }
+
+  rx_addr.std_id += ret;
+  tx_addr.std_id += ret;
+}
+#endif
+
 static void send_complete_cb(int error_nr, void *arg) {
   ARG_UNUSED(arg);
   LOG_DBG("TX complete cb [%d]\n", error_nr);
@@ -324,6 +343,34 @@ static void handle_transfer_exit() {
   send_transer_exit_positive_response();
 }
 
+static void send_tester_present_response(uint8_t *data, size_t len) {
+  if (len != 2) {
+    send_negative_response(UDS_SID_TESTER_PRESENT,
+                           UDS_NRC_INCORRECT_MESSAGE_LENGTH_OR_INVALID_FORMAT);
+    return;
+  }
+
+  // suppressPosRspMsgIndicationBit
+  if (data[1] == 0x80) {
+    return;
+  }
+
+  if (data[1] != 0x00) {
+    send_negative_response(UDS_SID_TESTER_PRESENT,
+                           UDS_NRC_SUBFUNCTION_NOT_SUPPORTED);
+    return;
+  }
+
+  int ret;
+  uint8_t tx_data[] = {UDS_SID_TESTER_PRESENT + 0x40, 0x00};
+
+  ret = isotp_send(&send_ctx, can_dev, tx_data, sizeof(tx_data), &tx_addr,
+                   &rx_addr, send_complete_cb, NULL);
+  if (ret != ISOTP_N_OK) {
+    LOG_ERR("Error while sending data to ID %d [%d]\n", tx_addr.std_id, ret);
+  }
+}
+
 static void thread_entry(void *arg1, void *arg2, void *arg3) {
   ARG_UNUSED(arg1);
   ARG_UNUSED(arg2);
@@ -340,6 +387,10 @@ static void thread_entry(void *arg1, void *arg2, void *arg3) {
     return;
   }
 
+#ifdef CONFIG_UDS_LEGACY_GEARSHIFT_ADDRESSING
+  apply_gearshift_position();
+#endif
+
   ret =
       isotp_bind(&recv_ctx, can_dev, &rx_addr, &tx_addr, &fc_opts, K_MSEC(50));
   if (ret != ISOTP_N_OK) {
@@ -410,6 +461,8 @@ static void thread_entry(void *arg1, void *arg2, void *arg3) {
       handle_transfer_data(rx_buffer, received_len);
     } else if (sid == UDS_SID_REQUEST_TRANSFER_EXIT) {
       handle_transfer_exit();
+    } else if (sid == UDS_SID_TESTER_PRESENT) {
+      send_tester_present_response(rx_buffer, received_len);
     } else {
       LOG_ERR("Service %x not supported\n", sid);
       send_negative_response(sid, UDS_NRC_SERVICE_NOT_SUPPORTED);
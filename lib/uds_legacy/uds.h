@@ -15,6 +15,7 @@ enum UDS_SID {
   UDS_SID_REQUEST_DOWNLOAD = 0x34,
   UDS_SID_TRANSFER_DATA = 0x36,
   UDS_SID_REQUEST_TRANSFER_EXIT = 0x37,
+  UDS_SID_TESTER_PRESENT = 0x3E,
   UDS_SID_NEGATIVE_RESPONSE = 0x7F,
 };
 
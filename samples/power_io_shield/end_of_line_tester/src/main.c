@@ -13,6 +13,7 @@
 #include <zephyr/logging/log.h>
 #include <zephyr/sys/reboot.h>
 
+#include <ardep/drivers/power_io_shield.h>
 #include <ardep/dt-bindings/power-io-shield.h>
 
 LOG_MODULE_REGISTER(main, LOG_LEVEL_INF);
@@ -126,6 +127,12 @@ int main() {
 
   // Go through all output patterns and validate inputs and fault pins
   for (uint8_t pattern = 0; pattern < ((1 << 6) - 1); pattern++) {
+    // apply the whole pattern with a single write
+    err = power_io_shield_batch_begin(power_io_shield);
+    if (err) {
+      LOG_ERR("Failed to start a batch for pattern 0x%02X: %d", pattern, err);
+      return err;
+    }
     for (int i = 0; i < ARRAY_SIZE(output_gpios); i++) {
       bool state = (pattern & (1 << i)) != 0;
       expected_input_states[i] = state;
@@ -133,9 +140,15 @@ int main() {
       int err = gpio_pin_set(output_gpios[i].port, output_gpios[i].pin, state);
       if (err) {
         LOG_ERR("Failed to set output GPIO %d to %d: %d", i, state, err);
+        power_io_shield_batch_commit(power_io_shield);
         return err;
       }
     }
+    err = power_io_shield_batch_commit(power_io_shield);
+    if (err) {
+      LOG_ERR("Failed to write pattern 0x%02X: %d", pattern, err);
+      return err;
+    }
     k_msleep(1);
     err = assert_input_pins(expected_input_states);
     if (err) {
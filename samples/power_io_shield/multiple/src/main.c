@@ -11,6 +11,9 @@
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
 
+#include <ardep/drivers/power_io_shield.h>
+#include <ardep/dt-bindings/power-io-shield.h>
+
 LOG_MODULE_REGISTER(main, LOG_LEVEL_INF);
 
 static const struct device* power_io_shield_0 =
@@ -72,19 +75,28 @@ int main() {
 
   LOG_INF("Entering main loop, toggling output GPIOs and logging inputs");
 
+  const struct device* const shields[] = {power_io_shield_0,
+                                          power_io_shield_1};
+  const gpio_port_pins_t output_masks[] = {
+    0x3F << POWER_IO_SHIELD_OUTPUT_BASE,
+    0x3F << POWER_IO_SHIELD_OUTPUT_BASE,
+  };
+
   uint8_t output_value = 0;
   for (;;) {
-    for (size_t i = 0; i < ARRAY_SIZE(output_gpios) / 2; i++) {
-      int ret = gpio_pin_set_dt(&output_gpios[i], (output_value >> i) & 1);
-      if (ret != 0) {
-        LOG_ERR("Failed to set output GPIO pin %d: %d", i, ret);
-      }
-      ret = gpio_pin_set_dt(&output_gpios[i + (ARRAY_SIZE(output_gpios) / 2)],
-                            (output_value >> i) & 1);
-      if (ret != 0) {
-        LOG_ERR("Failed to set output GPIO pin %d: %d",
-                i + (ARRAY_SIZE(output_gpios) / 2), ret);
-      }
+    // set the outputs of both shields in one sequence
+    const gpio_port_value_t output_values[] = {
+      (output_value & 0x3F) << POWER_IO_SHIELD_OUTPUT_BASE,
+      (output_value & 0x3F) << POWER_IO_SHIELD_OUTPUT_BASE,
+    };
+    struct power_io_shield_bulk_timing timing;
+    int ret = power_io_shield_bulk_write(shields, ARRAY_SIZE(shields),
+                                         output_masks, output_values, &timing);
+    if (ret != 0) {
+      LOG_ERR("Failed to set outputs: %d", ret);
+    } else {
+      LOG_DBG("Outputs set within %u us (%u us total)", timing.spread_us,
+              timing.total_us);
     }
     output_value++;
 
@@ -8,18 +8,114 @@ from udsoncan.connections import IsoTPSocketConnection
 from udsoncan.exceptions import (
     NegativeResponseException,
     InvalidResponseException,
+    TimeoutException,
     UnexpectedResponseException,
 )
 from udsoncan.services import DiagnosticSessionControl, RoutineControl, ECUReset
-from argparse import ArgumentParser, Namespace
+from argparse import ArgumentParser, ArgumentTypeError, Namespace
+from concurrent.futures import ThreadPoolExecutor
+from dataclasses import dataclass
 from west import log
 
 import isotp
+import threading
+import time
 import udsoncan
 
 from .util import Util
 
 
+# gearshift addressing of the ardep boards, see gearshift_address_providers.
+# The boards receive on 0x7E8 and respond on 0x7E0 plus their position
+GEARSHIFT_POSITIONS = 8
+GEARSHIFT_BASE_RXID = 0x7E0
+GEARSHIFT_BASE_TXID = 0x7E8
+
+TRANSFER_RETRIES = 10
+
+
+@dataclass
+class Ecu:
+    name: str
+    rxid: int
+    txid: int
+
+    @staticmethod
+    def parse(value: str) -> "Ecu":
+        try:
+            rxid, txid = (int(can_id, 0) for can_id in value.split(":"))
+        except ValueError:
+            raise ArgumentTypeError(f"expected RXID:TXID, got {value}")
+        return Ecu(f"0x{rxid:X}", rxid, txid)
+
+    @staticmethod
+    def gearshift(position: int) -> "Ecu":
+        return Ecu(
+            f"gearshift {position}",
+            GEARSHIFT_BASE_RXID + position,
+            GEARSHIFT_BASE_TXID + position,
+        )
+
+    def connection(self, interface: str) -> IsoTPSocketConnection:
+        addr = isotp.Address(
+            isotp.AddressingMode.Normal_11bits, rxid=self.rxid, txid=self.txid
+        )
+        return IsoTPSocketConnection(interface, addr)
+
+
+class Progress:
+    """Transferred bytes of all ECUs flashed at the same time"""
+
+    def __init__(self, ecus: int):
+        self._lock = threading.Lock()
+        self._ecus = ecus
+        self._done = 0
+        self._total = 0
+        self._transferred = 0
+        self._start = time.monotonic()
+
+    def add(self, size: int):
+        with self._lock:
+            self._total += size
+
+    def update(self, transferred: int):
+        with self._lock:
+            self._transferred += transferred
+            self._print()
+
+    def finish(self):
+        with self._lock:
+            self._done += 1
+            self._print()
+
+    @property
+    def transferred(self) -> int:
+        return self._transferred
+
+    def throughput(self) -> float:
+        return self._transferred / max(time.monotonic() - self._start, 1e-3)
+
+    def _print(self):
+        def message():
+            o = self._transferred % 20_000
+            if o < 4_000:
+                return "Prove P==NP           "
+            elif o < 8_000:
+                return "Talk to a colleague   "
+            elif o < 12_000:
+                return "Look out of the window"
+            elif o < 16_000:
+                return "Recite Pi             "
+            else:
+                return "Get a coffee          "
+
+        ecus = f" from {self._done}/{self._ecus} ECUs" if self._ecus > 1 else ""
+        print(
+            f"progress: {str(self._transferred).zfill(len(str(self._total)))}/{self._total} bytes{ecus}, {self.throughput() / 1024:.1f} KiB/s    In the meantime: {message()}",
+            end="\r",
+        )
+
+
 class UdsDfu:
     command: str = "uds-dfu"
     _board_name: str = None
@@ -28,7 +124,7 @@ class UdsDfu:
     def __init__(self, board_name: str):
         self._board_name = board_name
         self._description = """\
-Perform a firmware upgrade via CAN using the UDS protocol.
+Perform a firmware upgrade via CAN using the legacy UDS protocol.
 """
 
     def add_args(self, parser: ArgumentParser):
@@ -58,36 +154,118 @@ Perform a firmware upgrade via CAN using the UDS protocol.
         subcommand_parser.add_argument(
             "--txid", help="txid (default: 0x80)", default=0x80, type=int
         )
+        subcommand_parser.add_argument(
+            "--ecu",
+            help="flash the ECU with the rxid and txid of the tester, repeat to "
+            "flash several ECUs at the same time (default: --rxid and --txid)",
+            action="append",
+            default=[],
+            type=Ecu.parse,
+            metavar="RXID:TXID",
+        )
+        subcommand_parser.add_argument(
+            "-g",
+            "--gearshift",
+            help="flash the ECU with the gearshift addressing of the position, "
+            "repeat to flash several ECUs at the same time",
+            action="append",
+            default=[],
+            type=int,
+            choices=range(0, GEARSHIFT_POSITIONS),
+        )
+        subcommand_parser.add_argument(
+            "--discover",
+            help="flash all ECUs answering on a gearshift address",
+            action="store_true",
+        )
 
     def run(self, args: Namespace):
         log.dbg("build dir", args.build_dir)
         log.dbg("can interface", args.interface)
-        log.dbg("rxid", args.rxid)
-        log.dbg("txid", args.txid)
 
         binary = Util.get_zephyr_signed_bin(args.build_dir)
 
-        addr = isotp.Address(
-            isotp.AddressingMode.Normal_11bits, rxid=args.rxid, txid=args.txid
+        ecus = self.get_ecus(args)
+        if not ecus:
+            log.die("no ECU found", exit_code=2)
+
+        log.inf(f"flashing {len(ecus)} ECU(s): {', '.join(e.name for e in ecus)}")
+
+        progress = Progress(len(ecus))
+
+        # every ECU has its own ISO-TP socket, so the transfers only share the bus
+        with ThreadPoolExecutor(max_workers=len(ecus)) as executor:
+            results = list(
+                executor.map(
+                    lambda ecu: self.flash(args, ecu, binary, progress), ecus
+                )
+            )
+
+        print()
+        log.inf(
+            f"transferred {progress.transferred} bytes at "
+            f"{progress.throughput() / 1024:.1f} KiB/s"
         )
-        conn = IsoTPSocketConnection(args.interface, addr)
 
-        with Client(conn, request_timeout=2) as client:
+        failed = [ecu.name for ecu, ok in zip(ecus, results) if not ok]
+        if failed:
+            log.die(f"failed to flash {', '.join(failed)}")
+
+    def get_ecus(self, args: Namespace) -> list[Ecu]:
+        ecus = list(args.ecu)
+        ecus += [Ecu.gearshift(position) for position in args.gearshift]
+
+        if args.discover:
+            ecus += self.discover(args.interface)
+
+        # an ECU may be given several times, e.g. by --gearshift and --discover
+        ecus = list({(ecu.rxid, ecu.txid): ecu for ecu in ecus}.values())
+
+        if not ecus:
+            log.dbg("rxid", args.rxid)
+            log.dbg("txid", args.txid)
+            ecus.append(Ecu(f"0x{args.rxid:X}", args.rxid, args.txid))
+
+        return ecus
+
+    def discover(self, interface: str) -> list[Ecu]:
+        def responds(ecu: Ecu) -> bool:
+            try:
+                with Client(ecu.connection(interface), request_timeout=0.5) as client:
+                    client.tester_present()
+                return True
+            except NegativeResponseException:
+                # refusing the request still shows an ECU on the address
+                return True
+            except (TimeoutError, TimeoutException):
+                return False
+
+        candidates = [Ecu.gearshift(p) for p in range(GEARSHIFT_POSITIONS)]
+        with ThreadPoolExecutor(max_workers=len(candidates)) as executor:
+            found = list(executor.map(responds, candidates))
+
+        return [ecu for ecu, ok in zip(candidates, found) if ok]
+
+    def flash(self, args: Namespace, ecu: Ecu, binary: str, progress: Progress):
+        with Client(ecu.connection(args.interface), request_timeout=2) as client:
             try:
                 client.change_session(
                     DiagnosticSessionControl.Session.programmingSession
                 )
 
-                self.write_image(client, binary)
+                self.write_image(client, ecu, binary, progress)
 
                 client.routine_control(1338, RoutineControl.ControlType.startRoutine)
 
                 client.ecu_reset(ECUReset.ResetType.hardReset)
 
+                return True
+
             except NegativeResponseException as e:
                 log.err(
-                    'Server refused our request for service %s with code "%s" (0x%02x)'
+                    '%s: Server refused our request for service %s with code "%s" (0x%02x)'
                     % (
+                        ecu.name,
                         e.response.service.get_name(),
                         e.response.code_name,
                         e.response.code,
@@ -95,10 +273,17 @@ Perform a firmware upgrade via CAN using the UDS protocol.
                 )
             except (InvalidResponseException, UnexpectedResponseException) as e:
                 log.err(
-                    "Server sent an invalid payload : %s" % e.response.original_payload
+                    "%s: Server sent an invalid payload : %s"
+                    % (ecu.name, e.response.original_payload)
                 )
+            except (TimeoutError, TimeoutException) as e:
+                log.err(f"{ecu.name}: {e}")
+
+            return False
 
-    def write_image(self, client: Client, filename: str):
+    def write_image(
+        self, client: Client, ecu: Ecu, filename: str, progress: Progress
+    ):
         # open flash context
         client.routine_control(1337, RoutineControl.ControlType.startRoutine)
 
@@ -108,51 +293,47 @@ Perform a firmware upgrade via CAN using the UDS protocol.
             )
         )
 
-        log.inf("max block length is", response.service_data.max_length)
+        with open(filename, "rb") as f:
+            self.transfer(client, ecu, response, f.read(), progress)
+
+    def transfer(
+        self, client: Client, ecu: Ecu, response, data: bytes, progress: Progress
+    ):
+        # the block length of each ECU is taken from its RequestDownload response
+        log.inf(f"{ecu.name}: max block length is", response.service_data.max_length)
 
         max_block_length = (
             response.service_data.max_length - 2
         )  # subtract 2 for overhead
 
-        log.inf("uploading...")
+        log.inf(f"{ecu.name}: uploading...")
+        progress.add(len(data))
 
-        with open(filename, "rb") as f:
-            data = f.read()
-            offset = 0
-            block = 0
-            while offset < len(data):
-                for i in range(0, 10):
-                    try:
-                        client.transfer_data(
-                            block, data[offset : offset + max_block_length]
-                        )
-                        break
-                    except TimeoutError:
-                        log.wrn("Timeout, retrying")
-
-                    if i == 9:
-                        raise TimeoutError("Failed to transfer data")
-
-                offset += max_block_length
-                block = (block + 1) % 0x100
-
-                def message():
-                    o = offset % 20_000
-                    if o < 4_000:
-                        return "Prove P==NP           "
-                    elif o < 8_000:
-                        return "Talk to a colleague   "
-                    elif o < 12_000:
-                        return "Look out of the window"
-                    elif o < 16_000:
-                        return "Recite Pi             "
-                    else:
-                        return "Get a coffee          "
-
-                # print progress
-                print(
-                    f"progress: {str(offset).zfill(len(str(len(data))))}/{len(data)} bytes    In the meantime: {message()}",
-                    end="\r",
-                )
+        offset = 0
+        block = 0
+        while offset < len(data):
+            self.transfer_block(
+                client, ecu, block, data[offset : offset + max_block_length]
+            )
+
+            transferred = min(max_block_length, len(data) - offset)
+            offset += max_block_length
+            block = (block + 1) % 0x100
+
+            progress.update(transferred)
 
         client.request_transfer_exit()
+        progress.finish()
+
+    def transfer_block(self, client: Client, ecu: Ecu, block: int, data: bytes):
+        # the server answers a repeated block positively without writing it
+        # again, so a block whose response was lost is simply sent again. Any
+        # negative response fails the ECU
+        for i in range(0, TRANSFER_RETRIES):
+            try:
+                client.transfer_data(block, data)
+                return
+            except (TimeoutError, TimeoutException):
+                log.wrn(f"{ecu.name}: Timeout, retrying block {block}")
+
+        raise TimeoutError(f"Failed to transfer block {block}")
@@ -4,6 +4,8 @@
 # SPDX-License-Identifier: Apache-2.0
 
 from runners.core import RunnerCaps, ZephyrBinaryRunner  # pylint: disable=import-error
+from pathlib import Path
+import importlib.util
 import time
 
 
@@ -13,6 +15,25 @@ from udsoncan.services import DiagnosticSessionControl, ECUReset
 import isotp
 from intelhex import IntelHex
 import struct
+import hashlib
+import zlib
+
+
+def load_delta_patch():
+    # west loads runners by path, so the module next to this file is loaded the same way
+    spec = importlib.util.spec_from_file_location("delta_patch", Path(__file__).parent / "delta_patch.py")
+    module = importlib.util.module_from_spec(spec)
+    spec.loader.exec_module(module)
+    return module.DeltaPatch
+
+
+# dataFormatIdentifier of delta downloads, see UDS_DATA_FORMAT_IDENTIFIER_DELTA
+DELTA_DATA_FORMAT_IDENTIFIER = 0x10
+
+# The erase of slot0 must finish within this time plus the time per MiB erased
+ERASE_TIMEOUT_S = 10
+ERASE_TIMEOUT_S_PER_MIB = 30
+
 
 class ArdepUDSRunner(ZephyrBinaryRunner):
     """Runner for ardep board using UDS for flashing"""
@@ -22,9 +43,12 @@ class ArdepUDSRunner(ZephyrBinaryRunner):
     uds_target_address: str
     gearshift: int | None
     block_size: int
+    delta_from: str | None
+    sector_size: int
     hex_file: IntelHex | None
 
-    def __init__(self, cfg, can_interface, uds_source_address, uds_target_address, gearshift, block_size):
+    def __init__(self, cfg, can_interface, uds_source_address, uds_target_address, gearshift, block_size,
+                 delta_from=None, sector_size=2048):
         super().__init__(cfg)
         self.hex_file = IntelHex(cfg.hex_file) if cfg.hex_file else None
         self.can_interface = can_interface
@@ -32,6 +56,8 @@ class ArdepUDSRunner(ZephyrBinaryRunner):
         self.uds_target_address = uds_target_address
         self.gearshift = gearshift
         self.block_size = block_size
+        self.delta_from = delta_from
+        self.sector_size = sector_size
 
     @classmethod
     def name(cls):
@@ -72,6 +98,18 @@ class ArdepUDSRunner(ZephyrBinaryRunner):
             type=int,
             default=512,
         )
+        parser.add_argument(
+            "--delta-from",
+            help="Signed binary currently installed in slot0, only the difference to it is transferred",
+            default=None,
+            metavar="BIN",
+        )
+        parser.add_argument(
+            "--sector-size",
+            help="Flash sector size of the device for delta downloads in bytes (default: 2048)",
+            type=int,
+            default=2048,
+        )
 
     @classmethod
     def do_create(cls, cfg, args):
@@ -82,18 +120,27 @@ class ArdepUDSRunner(ZephyrBinaryRunner):
             uds_target_address=args.uds_target_address,
             gearshift=args.gearshift,
             block_size=args.block_size,
+            delta_from=args.delta_from,
+            sector_size=args.sector_size,
         )
 
-    def read_and_split_firmware_into_blocks(self):
+    def read_firmware(self):
         base_address = self.hex_file.addresses()[0]
         firmware_data = bytes(self.hex_file.tobinarray(base_address))
 
-        blocks = [
-            firmware_data[i : i + self.block_size]
-            for i in range(0, len(firmware_data), self.block_size)
-        ]
+        return firmware_data, base_address
+
+    def split_into_blocks(self, data: bytes):
+        return [data[i : i + self.block_size] for i in range(0, len(data), self.block_size)]
 
-        return blocks, base_address
+    def create_delta(self, firmware_data: bytes):
+        with open(self.delta_from, "rb") as f:
+            installed = f.read()
+
+        patch = load_delta_patch().create(installed, firmware_data, self.sector_size)
+        print(f"Delta download: transferring {len(patch)} bytes instead of {len(firmware_data)} bytes")
+
+        return patch
 
     def get_isotp_address(self) -> isotp.Address:
         source_id = 0x7E0 + self.gearshift if self.gearshift is not None else int(self.uds_source_address, 0)
@@ -123,35 +170,58 @@ class ArdepUDSRunner(ZephyrBinaryRunner):
             except udsoncan.exceptions.TimeoutException:
                 pass
 
-    def erase_slot0(self, client: Client):
+    def erase_slot0(self, client: Client, size: int, base_address: int):
         print("Erasing slot0 ...")
-        client.start_routine(0xFF00) # Erase slot0 routine
+        # Erase slot0 routine, limited to the sectors of the new firmware
+        option_record = struct.pack(">BII", 0x44, base_address, size)
+        client.start_routine(0xFF00, data=option_record)
+
+        timeout = ERASE_TIMEOUT_S + ERASE_TIMEOUT_S_PER_MIB * size / (1024 * 1024)
+        deadline = time.monotonic() + timeout
 
-        time.sleep(3)
+        while True:
+            if time.monotonic() > deadline:
+                raise TimeoutError(f"Erase slot0 routine did not finish within {timeout:.0f} s")
 
-        for _ in range(5):
+            time.sleep(0.1)
             try:
-                client.tester_present()
-                break
+                response = client.get_routine_result(0xFF00)
             except udsoncan.exceptions.TimeoutException:
-                pass
-            time.sleep(1)
+                continue
+            except udsoncan.exceptions.NegativeResponseException as e:
+                # older firmware loaders only answer once the erase is done
+                if e.response.code == udsoncan.Response.Code.RequestSequenceError:
+                    continue
+                raise
+
+            record = response.service_data.routine_status_record
+            if len(record) >= 12:
+                result, erased, total = struct.unpack(">III", record[:12])
+            elif len(record) >= 4:
+                # older firmware loaders only return the result
+                result = struct.unpack(">I", record[:4])[0]
+                erased = total = None
+            else:
+                raise RuntimeError(f"Unexpected erase slot0 routine status record: {record.hex()}")
+
+            if result != 0x78:  # requestCorrectlyReceived-ResponsePending
+                break
+            if total is not None:
+                print(f"Erased {erased}/{total} bytes")
 
-        response = client.get_routine_result(0xFF00)
-        result = struct.unpack(">I", response.service_data.routine_status_record)[0]
         if result != 0:
             raise RuntimeError(f"Erase slot0 routine failed with code 0x{result:08X}")
 
         print("Slot0 erased successfully.")
 
-    def upload_firmware(self, client: Client, blocks, base_address):
+    def upload_firmware(self, client: Client, blocks, base_address, size: int, dfi=None):
         print("Starting firmware transfer...")
 
         block_count = len(blocks)
 
         print(f"Requesting download of {block_count} blocks starting at address 0x{base_address:08X}...")
-        address = udsoncan.MemoryLocation(memorysize=block_count * self.block_size, address=base_address, address_format=32)
-        client.request_download(memory_location=address)
+        address = udsoncan.MemoryLocation(memorysize=size, address=base_address, address_format=32)
+        client.request_download(memory_location=address, dfi=dfi)
 
         for i in range(block_count):
             print(f"Transferring block {i + 1}/{block_count}...")
@@ -162,19 +232,49 @@ class ArdepUDSRunner(ZephyrBinaryRunner):
 
         client.request_transfer_exit()
 
+    def verify_download(self, client: Client, data: bytes):
+        print("Verifying firmware...")
+        try:
+            response = client.start_routine(0xFF01)
+        except udsoncan.exceptions.NegativeResponseException as e:
+            print(f"Verification not supported by the device ({e.response.code_name}), skipping")
+            return
+
+        digest = bytes(response.service_data.routine_status_record)
+        if len(digest) == 4:
+            expected = struct.pack(">I", zlib.crc32(data))
+        else:
+            expected = hashlib.sha256(data).digest()
+
+        if digest != expected:
+            raise RuntimeError(f"Firmware digest mismatch: device {digest.hex()}, expected {expected.hex()}")
+
+        print("Firmware verified successfully.")
+
     def do_run(self, command, **kwargs):  # pylint: disable=unused-argument
         if self.hex_file == None:
             print("No hex file provided, please check that you are building a hex file")
             exit(1)
 
-        blocks, base_address = self.read_and_split_firmware_into_blocks()
+        firmware_data, base_address = self.read_firmware()
 
         with self.create_client() as client:
             self.test_connection(client)
             self.switch_to_programming_session(client)
 
-            self.erase_slot0(client)
-            self.upload_firmware(client, blocks, base_address)
+            if self.delta_from is None:
+                blocks = self.split_into_blocks(firmware_data)
+                size = len(blocks) * self.block_size
+                self.erase_slot0(client, size, base_address)
+                self.upload_firmware(client, blocks, base_address, size)
+            else:
+                # the delta is applied in place and erases its sectors itself
+                blocks = self.split_into_blocks(self.create_delta(firmware_data))
+                dfi = udsoncan.DataFormatIdentifier.from_byte(DELTA_DATA_FORMAT_IDENTIFIER)
+                self.upload_firmware(client, blocks, base_address, len(firmware_data), dfi)
+
+            # the digest covers the written image, also for delta downloads
+            self.verify_download(client, firmware_data)
 
             client.ecu_reset(ECUReset.ResetType.hardReset)
 
@@ -0,0 +1,98 @@
+# SPDX-FileCopyrightText: Copyright (C) Frickly Systems GmbH
+# SPDX-FileCopyrightText: Copyright (C) MBition GmbH
+#
+# SPDX-License-Identifier: Apache-2.0
+
+import struct
+import zlib
+
+
+class DeltaPatch:
+    """Creates patches for delta downloads (see UDS_DATA_FORMAT_IDENTIFIER_DELTA)
+
+    The patch is applied in place, one flash sector at a time. So every copy
+    may only read from the old image at or after the start of the sector that
+    is currently written.
+    """
+
+    MAGIC = 0x544C4441
+    OP_COPY = 0x01
+    OP_INSERT = 0x02
+
+    # shorter matches are cheaper to insert than to copy
+    MIN_MATCH = 16
+    MAX_CANDIDATES = 8
+
+    @staticmethod
+    def create(old: bytes, new: bytes, sector_size: int) -> bytes:
+        index: dict[bytes, list[int]] = {}
+        for offset in range(len(old) - DeltaPatch.MIN_MATCH + 1):
+            candidates = index.setdefault(old[offset : offset + DeltaPatch.MIN_MATCH], [])
+            if len(candidates) < DeltaPatch.MAX_CANDIDATES:
+                candidates.append(offset)
+
+        patch = bytearray(
+            struct.pack("<IIII", DeltaPatch.MAGIC, len(old), zlib.crc32(old), len(new))
+        )
+        literal = bytearray()
+        pos = 0
+
+        while pos < len(new):
+            source, length = DeltaPatch._find_match(old, new, pos, sector_size, index)
+
+            if length < DeltaPatch.MIN_MATCH:
+                literal.append(new[pos])
+                pos += 1
+                continue
+
+            if literal:
+                patch += struct.pack("<BI", DeltaPatch.OP_INSERT, len(literal))
+                patch += literal
+                literal = bytearray()
+
+            patch += struct.pack("<BII", DeltaPatch.OP_COPY, length, source)
+            pos += length
+
+        if literal:
+            patch += struct.pack("<BI", DeltaPatch.OP_INSERT, len(literal))
+            patch += literal
+
+        return bytes(patch)
+
+    @staticmethod
+    def _find_match(old: bytes, new: bytes, pos: int, sector_size: int, index):
+        sector_start = pos - pos % sector_size
+        best_source, best_length = 0, 0
+
+        for source in index.get(new[pos : pos + DeltaPatch.MIN_MATCH], []):
+            if source < sector_start:
+                continue
+
+            # a copy moving data backwards can not cross into the next sector, as
+            # its source would be overwritten by then
+            limit = len(new) - pos
+            if source < pos:
+                limit = min(limit, sector_start + sector_size - pos)
+
+            length = DeltaPatch._common_length(old, source, new, pos, limit)
+            if length > best_length:
+                best_source, best_length = source, length
+
+        return best_source, best_length
+
+    @staticmethod
+    def _common_length(old: bytes, source: int, new: bytes, pos: int, limit: int) -> int:
+        limit = min(limit, len(old) - source)
+        length = 0
+        step = 256
+
+        while length < limit:
+            chunk = min(step, limit - length)
+            if old[source + length : source + length + chunk] == new[pos + length : pos + length + chunk]:
+                length += chunk
+                continue
+            if chunk == 1:
+                break
+            step = max(1, chunk // 2)
+
+        return length
@@ -0,0 +1,161 @@
+# SPDX-FileCopyrightText: Copyright (C) Frickly Systems GmbH
+# SPDX-FileCopyrightText: Copyright (C) MBition GmbH
+#
+# SPDX-License-Identifier: Apache-2.0
+
+"""Tests of DeltaPatch.create, run with `python3 -m pytest scripts/runner`"""
+
+import random
+import struct
+import zlib
+
+from delta_patch import DeltaPatch
+
+SECTOR_SIZES = (256, 2048)
+
+
+def apply_in_place(old: bytes, patch: bytes, sector_size: int) -> bytes:
+    """Applies the patch like the ECU does (see upload_download_delta.c)
+
+    The new image is assembled one sector at a time and replaces the old
+    content of that sector once it is complete, so copies may only read at or
+    after the start of the sector currently written.
+    """
+    magic, old_size, old_crc, new_size = struct.unpack_from("<IIII", patch)
+    assert magic == DeltaPatch.MAGIC
+    assert old_size == len(old)
+    assert old_crc == zlib.crc32(old)
+
+    flash = bytearray(old) + bytearray(b"\xff" * max(0, new_size - len(old)))
+    sector = bytearray()
+    written = 0
+    pos = 16
+
+    def produce(data: bytes):
+        nonlocal sector, written
+        sector += data
+        written += len(data)
+        if len(sector) == sector_size or written == new_size:
+            start = written - len(sector)
+            flash[start : start + len(sector)] = sector
+            sector = bytearray()
+
+    while pos < len(patch):
+        op = patch[pos]
+        if op == DeltaPatch.OP_COPY:
+            length, source = struct.unpack_from("<II", patch, pos + 1)
+            pos += 9
+            assert source + length <= len(old)
+            while length > 0:
+                sector_start = written - len(sector)
+                assert source >= sector_start, f"copy from overwritten offset {source}"
+                chunk = min(length, sector_size - len(sector))
+                produce(bytes(flash[source : source + chunk]))
+                source += chunk
+                length -= chunk
+        elif op == DeltaPatch.OP_INSERT:
+            (length,) = struct.unpack_from("<I", patch, pos + 1)
+            pos += 5
+            data = patch[pos : pos + length]
+            assert len(data) == length
+            pos += length
+            while data:
+                chunk = sector_size - len(sector)
+                produce(data[:chunk])
+                data = data[chunk:]
+        else:
+            raise AssertionError(f"invalid operation 0x{op:02x}")
+
+    assert written == new_size
+    return bytes(flash[:new_size])
+
+
+def random_bytes(rng: random.Random, size: int) -> bytes:
+    return bytes(rng.getrandbits(8) for _ in range(size))
+
+
+def edited_image(rng: random.Random, old: bytes) -> bytes:
+    """Inserts, deletes and changes data like a rebuilt firmware"""
+    new = bytearray(old)
+    for _ in range(20):
+        at = rng.randrange(len(new))
+        edit = rng.choice(("insert", "delete", "change"))
+        if edit == "insert":
+            new[at:at] = random_bytes(rng, rng.randrange(1, 64))
+        elif edit == "delete":
+            del new[at : at + rng.randrange(1, 64)]
+        else:
+            new[at : at + 4] = random_bytes(rng, 4)
+    return bytes(new)
+
+
+def test_round_trip_of_edited_image():
+    rng = random.Random(1)
+    old = random_bytes(rng, 16 * 1024)
+    new = edited_image(rng, old)
+
+    for sector_size in SECTOR_SIZES:
+        patch = DeltaPatch.create(old, new, sector_size)
+        assert apply_in_place(old, patch, sector_size) == new
+        # data shifted back by insertions before it can only be copied within
+        # its sector, so less is copied than without the in place rule
+        assert len(patch) < len(new) // 2
+
+
+def test_identical_image_is_copied():
+    rng = random.Random(2)
+    old = random_bytes(rng, 8 * 1024)
+
+    for sector_size in SECTOR_SIZES:
+        patch = DeltaPatch.create(old, old, sector_size)
+        assert apply_in_place(old, patch, sector_size) == old
+        # the header and one copy per sector at most
+        assert len(patch) <= 16 + 9 * (len(old) // sector_size)
+
+
+def test_data_moved_to_the_front_is_copied():
+    rng = random.Random(3)
+    sector_size = 256
+    old = random_bytes(rng, 4 * sector_size)
+    # the last sector moves to the front, its source is still intact, while
+    # the other sectors were overwritten by the time they are needed
+    new = old[3 * sector_size :] + old[: 3 * sector_size]
+
+    patch = DeltaPatch.create(old, new, sector_size)
+    assert apply_in_place(old, patch, sector_size) == new
+    assert len(patch) < len(new) - sector_size + 64
+
+
+def test_data_moved_to_the_back_is_not_copied_from_overwritten_sectors():
+    rng = random.Random(4)
+    sector_size = 256
+    old = random_bytes(rng, 4 * sector_size)
+    # the first sector moves to the back, it is overwritten by then
+    new = old[sector_size:] + old[:sector_size]
+
+    patch = DeltaPatch.create(old, new, sector_size)
+    assert apply_in_place(old, patch, sector_size) == new
+    assert len(patch) > sector_size
+
+
+def test_backward_copy_does_not_cross_the_sector():
+    rng = random.Random(5)
+    sector_size = 256
+    old = random_bytes(rng, 4 * sector_size)
+    # the content shifts back by half a sector, so each sector copies from the
+    # start of the old sector, the rest is in the previous one which is
+    # overwritten when the copy continues in the next sector
+    new = random_bytes(rng, sector_size // 2) + old
+
+    patch = DeltaPatch.create(old, new, sector_size)
+    assert apply_in_place(old, patch, sector_size) == new
+
+
+def test_new_image_larger_than_old_image():
+    rng = random.Random(6)
+    old = random_bytes(rng, 3000)
+    new = old + random_bytes(rng, 5000)
+
+    for sector_size in SECTOR_SIZES:
+        patch = DeltaPatch.create(old, new, sector_size)
+        assert apply_in_place(old, patch, sector_size) == new
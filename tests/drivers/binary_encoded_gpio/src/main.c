@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) Frickly Systems GmbH
+ * Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+
+#include <zephyr/device.h>
+#include <zephyr/drivers/gpio.h>
+#include <zephyr/drivers/gpio/gpio_emul.h>
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+
+#include <ardep/drivers/binary_encoded_gpio.h>
+
+static const struct device* encoded = DEVICE_DT_GET(DT_NODELABEL(encoded));
+
+static const struct gpio_dt_spec input_pins[] = {
+  DT_FOREACH_PROP_ELEM_SEP(DT_NODELABEL(encoded),
+                           input_gpios,
+                           GPIO_DT_SPEC_GET_BY_IDX,
+                           (, )),
+};
+
+#ifdef CONFIG_BINARY_ENCODED_GPIO_CACHED
+#define DEBOUNCE_MS CONFIG_BINARY_ENCODED_GPIO_DEBOUNCE_MS
+#else
+#define DEBOUNCE_MS 0
+#endif
+
+static struct {
+  int calls;
+  int value;
+  void* user_data;
+} change;
+
+static void on_change(const struct device* dev, int value, void* user_data) {
+  zassert_equal(dev, encoded);
+
+  change.calls++;
+  change.value = value;
+  change.user_data = user_data;
+}
+
+// Sets the pins to the logical bits of the value, honoring active low pins
+static void set_pins(int value) {
+  for (int i = 0; i < ARRAY_SIZE(input_pins); i++) {
+    const struct gpio_dt_spec* pin = &input_pins[i];
+    int level = (value >> i) & 1;
+
+    if (pin->dt_flags & GPIO_ACTIVE_LOW) {
+      level = !level;
+    }
+    zassert_equal(gpio_emul_input_set(pin->port, pin->pin, level), 0);
+  }
+}
+
+static void wait_until_settled(void) {
+  k_msleep(2 * DEBOUNCE_MS + 1);
+}
+
+static void before_each(void* f) {
+  ARG_UNUSED(f);
+
+  set_pins(0);
+  wait_until_settled();
+
+  binary_encoded_gpios_set_change_callback(encoded, NULL, NULL);
+  wait_until_settled();
+  memset(&change, 0, sizeof(change));
+}
+
+ZTEST_SUITE(binary_encoded_gpio, NULL, NULL, before_each, NULL, NULL);
+
+ZTEST(binary_encoded_gpio, test_reads_all_values) {
+  for (int value = 0; value < BIT(ARRAY_SIZE(input_pins)); value++) {
+    set_pins(value);
+    wait_until_settled();
+
+    zassert_equal(binary_encoded_gpios_get_value(encoded), value);
+  }
+}
+
+ZTEST(binary_encoded_gpio, test_change_callback_needs_cache) {
+  Z_TEST_SKIP_IFDEF(CONFIG_BINARY_ENCODED_GPIO_CACHED);
+
+  zassert_equal(
+      binary_encoded_gpios_set_change_callback(encoded, on_change, NULL),
+      -ENOSYS);
+}
+
+ZTEST(binary_encoded_gpio, test_value_is_debounced) {
+  Z_TEST_SKIP_IFNDEF(CONFIG_BINARY_ENCODED_GPIO_CACHED);
+
+  set_pins(0b0101);
+  wait_until_settled();
+  zassert_equal(binary_encoded_gpios_get_value(encoded), 0b0101);
+
+  // while a switch moves, the pins pass through intermediate values
+  set_pins(0b0111);
+  k_msleep(DEBOUNCE_MS / 2);
+  zassert_equal(binary_encoded_gpios_get_value(encoded), 0b0101);
+
+  set_pins(0b1111);
+  k_msleep(DEBOUNCE_MS / 2);
+  zassert_equal(binary_encoded_gpios_get_value(encoded), 0b0101);
+
+  set_pins(0b1010);
+  k_msleep(DEBOUNCE_MS / 2);
+  zassert_equal(binary_encoded_gpios_get_value(encoded), 0b0101);
+
+  wait_until_settled();
+  zassert_equal(binary_encoded_gpios_get_value(encoded), 0b1010);
+}
+
+ZTEST(binary_encoded_gpio, test_change_callback) {
+  Z_TEST_SKIP_IFNDEF(CONFIG_BINARY_ENCODED_GPIO_CACHED);
+
+  int user_data;
+  zassert_equal(
+      binary_encoded_gpios_set_change_callback(encoded, on_change, &user_data),
+      0);
+  wait_until_settled();
+  zassert_equal(change.calls, 0);
+
+  // bouncing pins report the settled value once
+  set_pins(0b0001);
+  set_pins(0b0000);
+  set_pins(0b0011);
+  wait_until_settled();
+  zassert_equal(change.calls, 1);
+  zassert_equal(change.value, 0b0011);
+  zassert_equal(change.user_data, &user_data);
+
+  // a glitch back to the same value is not a change
+  set_pins(0b1011);
+  set_pins(0b0011);
+  wait_until_settled();
+  zassert_equal(change.calls, 1);
+
+  // the active low pin is reported like the others
+  set_pins(0b0100);
+  wait_until_settled();
+  zassert_equal(change.calls, 2);
+  zassert_equal(change.value, 0b0100);
+
+  zassert_equal(binary_encoded_gpios_set_change_callback(encoded, NULL, NULL),
+                0);
+  set_pins(0b1000);
+  wait_until_settled();
+  zassert_equal(change.calls, 2);
+  zassert_equal(binary_encoded_gpios_get_value(encoded), 0b1000);
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) Frickly Systems GmbH
+ * Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define DT_DRV_COMPAT vnd_dac_emul
+
+#include "dac_emul.h"
+
+#include <string.h>
+
+#include <zephyr/device.h>
+#include <zephyr/drivers/dac.h>
+#include <zephyr/kernel.h>
+#include <zephyr/spinlock.h>
+
+struct dac_emul_data {
+  struct k_spinlock lock;
+  struct dac_emul_write writes[DAC_EMUL_CHANNELS][DAC_EMUL_MAX_WRITES];
+  size_t write_count[DAC_EMUL_CHANNELS];
+};
+
+static int dac_emul_channel_setup(const struct device* dev,
+                                  const struct dac_channel_cfg* channel_cfg) {
+  return channel_cfg->channel_id < DAC_EMUL_CHANNELS ? 0 : -EINVAL;
+}
+
+static int dac_emul_write_value(const struct device* dev,
+                                uint8_t channel,
+                                uint32_t value) {
+  struct dac_emul_data* data = dev->data;
+
+  if (channel >= DAC_EMUL_CHANNELS) {
+    return -EINVAL;
+  }
+
+  k_spinlock_key_t key = k_spin_lock(&data->lock);
+
+  // writes beyond the capacity are not recorded
+  size_t count = data->write_count[channel];
+  if (count < DAC_EMUL_MAX_WRITES) {
+    data->writes[channel][count] = (struct dac_emul_write){
+      .value = value,
+      .cycles = k_cycle_get_64(),
+    };
+    data->write_count[channel]++;
+  }
+
+  k_spin_unlock(&data->lock, key);
+  return 0;
+}
+
+void dac_emul_reset(const struct device* dev) {
+  struct dac_emul_data* data = dev->data;
+
+  k_spinlock_key_t key = k_spin_lock(&data->lock);
+  memset(data->write_count, 0, sizeof(data->write_count));
+  k_spin_unlock(&data->lock, key);
+}
+
+size_t dac_emul_get_writes(const struct device* dev,
+                           uint8_t channel,
+                           const struct dac_emul_write** writes) {
+  struct dac_emul_data* data = dev->data;
+
+  *writes = data->writes[channel];
+  return data->write_count[channel];
+}
+
+static const struct dac_driver_api dac_emul_api = {
+  .channel_setup = dac_emul_channel_setup,
+  .write_value = dac_emul_write_value,
+};
+
+static struct dac_emul_data dac_emul_data_0;
+
+DEVICE_DT_INST_DEFINE(0,
+                      NULL,
+                      NULL,
+                      &dac_emul_data_0,
+                      NULL,
+                      POST_KERNEL,
+                      CONFIG_DAC_INIT_PRIORITY,
+                      &dac_emul_api);
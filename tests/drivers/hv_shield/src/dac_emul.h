@@ -0,0 +1,33 @@
+/*
+ * Copyright (C) Frickly Systems GmbH
+ * Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef TESTS_DRIVERS_HV_SHIELD_DAC_EMUL_H_
+#define TESTS_DRIVERS_HV_SHIELD_DAC_EMUL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zephyr/device.h>
+
+#define DAC_EMUL_CHANNELS 2
+#define DAC_EMUL_MAX_WRITES 512
+
+struct dac_emul_write {
+  uint32_t value;
+  // time of the write in hardware cycles
+  uint64_t cycles;
+};
+
+// Forget all recorded writes
+void dac_emul_reset(const struct device* dev);
+
+// Get the writes to a channel in the order they were made, returns the count
+size_t dac_emul_get_writes(const struct device* dev,
+                           uint8_t channel,
+                           const struct dac_emul_write** writes);
+
+#endif  // TESTS_DRIVERS_HV_SHIELD_DAC_EMUL_H_
@@ -0,0 +1,191 @@
+/*
+ * Copyright (C) Frickly Systems GmbH
+ * Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "dac_emul.h"
+
+#include <stdlib.h>
+
+#include <zephyr/device.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+
+#include <ardep/drivers/emul/hv_shield.h>
+#include <ardep/drivers/hv_shield.h>
+#include <ardep/drivers/hv_shield_dac_waveform.h>
+
+static const struct device* hv_shield = DEVICE_DT_GET(DT_NODELABEL(hvshield));
+static const struct device* hv_dac = DEVICE_DT_GET(DT_NODELABEL(hvdac));
+static const struct device* dac_emul = DEVICE_DT_GET(DT_NODELABEL(dac_emul));
+static const struct emul* hv_shield_emul = EMUL_DT_GET(DT_NODELABEL(hvshield));
+
+#define TABLE_SIZE 16
+#define SAMPLE_RATE 1000
+#define SAMPLE_PERIOD_US (USEC_PER_SEC / SAMPLE_RATE)
+#define TICK_US (USEC_PER_SEC / CONFIG_SYS_CLOCK_TICKS_PER_SEC)
+
+static uint16_t ramp[TABLE_SIZE];
+static uint16_t sine[TABLE_SIZE];
+
+static void* setup(void) {
+  hv_shield_dac_waveform_ramp(ramp, TABLE_SIZE, 0, 0xFFF);
+  hv_shield_dac_waveform_sine(sine, TABLE_SIZE, 0x800, 0x7FF);
+
+  return NULL;
+}
+
+static void before_each(void* f) {
+  ARG_UNUSED(f);
+
+  hv_shield_dac_waveform_stop(hv_dac);
+  zassert_equal(hv_shield_dac_waveform_set(hv_dac, 0, NULL), 0);
+  zassert_equal(hv_shield_dac_waveform_set(hv_dac, 1, NULL), 0);
+  dac_emul_reset(dac_emul);
+
+  // written at once, so no deferred flush is pending afterwards
+  zassert_equal(hv_shield_begin_update(hv_shield), 0);
+  zassert_equal(hv_shield_set_dac_gain(hv_shield, 0, HV_SHIELD_DAC_GAIN_1), 0);
+  zassert_equal(hv_shield_set_dac_gain(hv_shield, 1, HV_SHIELD_DAC_GAIN_1), 0);
+  zassert_equal(hv_shield_commit_update(hv_shield), 0);
+}
+
+static void wait_for_samples(uint32_t samples) {
+  k_usleep((samples + 2) * SAMPLE_PERIOD_US);
+}
+
+ZTEST_SUITE(hv_shield_dac_waveform, NULL, setup, before_each, NULL, NULL);
+
+ZTEST(hv_shield_dac_waveform, test_tables) {
+  zassert_equal(ramp[0], 0);
+  zassert_equal(ramp[TABLE_SIZE / 2], 0xFFF * (TABLE_SIZE / 2) / 15);
+  zassert_equal(ramp[TABLE_SIZE - 1], 0xFFF);
+
+  zassert_equal(sine[0], 0x800);
+  zassert_equal(sine[TABLE_SIZE / 4], 0x800 + 0x7FF);
+  zassert_equal(sine[TABLE_SIZE / 2], 0x800);
+  zassert_equal(sine[3 * TABLE_SIZE / 4], 0x800 - 0x7FF);
+}
+
+ZTEST(hv_shield_dac_waveform, test_plays_cycles_on_both_channels) {
+  const struct hv_shield_dac_waveform ramp_waveform = {
+    .samples = ramp,
+    .sample_count = TABLE_SIZE,
+    .cycles = 2,
+    .gain = HV_SHIELD_DAC_GAIN_4,
+  };
+  const struct hv_shield_dac_waveform sine_waveform = {
+    .samples = sine,
+    .sample_count = TABLE_SIZE,
+    .cycles = 2,
+    .gain = HV_SHIELD_DAC_GAIN_2,
+  };
+
+  zassert_equal(hv_shield_dac_waveform_set(hv_dac, 0, &ramp_waveform), 0);
+  zassert_equal(hv_shield_dac_waveform_set(hv_dac, 1, &sine_waveform), 0);
+
+  hv_shield_emul_reset_transfer_count(hv_shield_emul);
+  zassert_equal(hv_shield_dac_waveform_start(hv_dac, SAMPLE_RATE), 0);
+  zassert_true(hv_shield_dac_waveform_is_running(hv_dac));
+
+  // both gains are written in one transfer before the first sample
+  zassert_equal(hv_shield_emul_get_transfer_count(hv_shield_emul), 1);
+  zassert_equal(hv_shield_emul_get_dac_gain(hv_shield_emul, 0),
+                HV_SHIELD_DAC_GAIN_4);
+  zassert_equal(hv_shield_emul_get_dac_gain(hv_shield_emul, 1),
+                HV_SHIELD_DAC_GAIN_2);
+
+  wait_for_samples(2 * TABLE_SIZE);
+  zassert_false(hv_shield_dac_waveform_is_running(hv_dac));
+
+  const struct dac_emul_write* writes_0;
+  const struct dac_emul_write* writes_1;
+  zassert_equal(dac_emul_get_writes(dac_emul, 0, &writes_0), 2 * TABLE_SIZE);
+  zassert_equal(dac_emul_get_writes(dac_emul, 1, &writes_1), 2 * TABLE_SIZE);
+
+  for (int i = 0; i < 2 * TABLE_SIZE; i++) {
+    zassert_equal(writes_0[i].value, ramp[i % TABLE_SIZE]);
+    zassert_equal(writes_1[i].value, sine[i % TABLE_SIZE]);
+
+    // the channels are updated together
+    zassert_equal(writes_0[i].cycles, writes_1[i].cycles);
+  }
+
+  // playback is over, so the channel can be changed again
+  zassert_equal(hv_shield_dac_waveform_set(hv_dac, 0, NULL), 0);
+}
+
+ZTEST(hv_shield_dac_waveform, test_sample_timing_jitter) {
+  const struct hv_shield_dac_waveform waveform = {
+    .samples = sine,
+    .sample_count = TABLE_SIZE,
+    .cycles = 0,
+  };
+  const int samples = 200;
+
+  zassert_equal(hv_shield_dac_waveform_set(hv_dac, 0, &waveform), 0);
+  zassert_equal(hv_shield_dac_waveform_start(hv_dac, SAMPLE_RATE), 0);
+
+  wait_for_samples(samples);
+  zassert_equal(hv_shield_dac_waveform_stop(hv_dac), 0);
+
+  const struct dac_emul_write* writes;
+  size_t count = dac_emul_get_writes(dac_emul, 0, &writes);
+  zassert_true(count >= samples, "only %zu samples played", count);
+
+  // the first sample is written on start, the timer is aligned to the ticks
+  int64_t max_jitter_us = 0;
+  for (size_t i = 2; i < count; i++) {
+    int64_t period_us =
+        k_cyc_to_us_near64(writes[i].cycles - writes[i - 1].cycles);
+    max_jitter_us = MAX(max_jitter_us, llabs(period_us - SAMPLE_PERIOD_US));
+  }
+
+  // the samples do not drift from the sample rate
+  int64_t total_us =
+      k_cyc_to_us_near64(writes[count - 1].cycles - writes[1].cycles);
+  int64_t drift_us = total_us - (int64_t)(count - 2) * SAMPLE_PERIOD_US;
+
+  TC_PRINT("%zu samples, max jitter %lld us, drift %lld us\n", count,
+           max_jitter_us, drift_us);
+  zassert_true(max_jitter_us <= TICK_US);
+  zassert_true(llabs(drift_us) <= TICK_US);
+
+  // values keep cycling through the table
+  for (size_t i = 0; i < count; i++) {
+    zassert_equal(writes[i].value, sine[i % TABLE_SIZE]);
+  }
+}
+
+ZTEST(hv_shield_dac_waveform, test_invalid_usage) {
+  const struct hv_shield_dac_waveform waveform = {
+    .samples = ramp,
+    .sample_count = TABLE_SIZE,
+    .cycles = 1,
+  };
+  const struct hv_shield_dac_waveform empty = {
+    .samples = ramp,
+    .sample_count = 0,
+  };
+
+  zassert_equal(hv_shield_dac_waveform_start(hv_dac, SAMPLE_RATE), -ENODATA);
+  zassert_equal(hv_shield_dac_waveform_stop(hv_dac), -EALREADY);
+
+  zassert_equal(hv_shield_dac_waveform_set(hv_dac, 2, &waveform), -EINVAL);
+  zassert_equal(hv_shield_dac_waveform_set(hv_dac, 0, &empty), -EINVAL);
+  zassert_equal(hv_shield_dac_waveform_set(hv_dac, 0, &waveform), 0);
+
+  zassert_equal(hv_shield_dac_waveform_start(hv_dac, 0), -EINVAL);
+  // the k_timer cannot play more than one sample per tick
+  zassert_equal(hv_shield_dac_waveform_start(
+                    hv_dac, CONFIG_SYS_CLOCK_TICKS_PER_SEC + 1),
+                -EINVAL);
+
+  zassert_equal(hv_shield_dac_waveform_start(hv_dac, SAMPLE_RATE), 0);
+  zassert_equal(hv_shield_dac_waveform_start(hv_dac, SAMPLE_RATE), -EALREADY);
+  zassert_equal(hv_shield_dac_waveform_set(hv_dac, 0, &waveform), -EBUSY);
+  zassert_equal(hv_shield_dac_waveform_stop(hv_dac), 0);
+}
@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) Frickly Systems GmbH
+ * Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifdef CONFIG_HV_SHIELD_DAC_WAVEFORM_UDS
+
+#include <string.h>
+
+#include <zephyr/device.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/ztest.h>
+
+#include <ardep/drivers/hv_shield_dac_waveform.h>
+#include <ardep/uds.h>
+
+static const struct device* hv_dac = DEVICE_DT_GET(DT_NODELABEL(hvdac));
+
+#define TABLE_SIZE 16
+#define SAMPLE_RATE 1000
+
+static uint16_t ramp[TABLE_SIZE];
+
+static uint8_t status_record[8];
+static uint16_t status_record_len;
+
+static uint8_t copy_status_record(UDSServer_t* server,
+                                  const void* data,
+                                  uint16_t len) {
+  ARG_UNUSED(server);
+
+  zassert_true(len <= sizeof(status_record));
+  memcpy(status_record, data, len);
+  status_record_len = len;
+  return UDS_PositiveResponse;
+}
+
+static struct uds_registration_t registration = {
+  .type = UDS_REGISTRATION_TYPE__ROUTINE_CONTROL,
+  .routine_control = {
+    .user_context = NULL,
+    .routine_id = 0xF000,
+  },
+};
+
+// Calls the action of the routine handler like the UDS server does
+static UDSErr_t routine_control(uint8_t ctrl_type,
+                                const uint8_t* option_record,
+                                size_t len,
+                                bool* consume_event) {
+  UDSRoutineCtrlArgs_t args = {
+    .ctrlType = ctrl_type,
+    .id = registration.routine_control.routine_id,
+    .optionRecord = option_record,
+    .len = len,
+    .copyStatusRecord = copy_status_record,
+  };
+  struct uds_context context = {
+    .registration = &registration,
+    .event = UDS_EVT_RoutineCtrl,
+    .arg = &args,
+  };
+  bool apply_action = false;
+
+  registration.routine_control.user_context = (void*)hv_dac;
+
+  zassert_equal(hv_shield_dac_waveform_uds_check(&context, &apply_action),
+                UDS_OK);
+  zassert_true(apply_action);
+
+  return hv_shield_dac_waveform_uds_action(&context, consume_event);
+}
+
+static UDSErr_t start_routine(uint32_t sample_rate) {
+  uint8_t option_record[sizeof(uint32_t)];
+  bool consume_event;
+
+  sys_put_be32(sample_rate, option_record);
+  return routine_control(UDS_ROUTINE_CONTROL__START_ROUTINE, option_record,
+                         sizeof(option_record), &consume_event);
+}
+
+static void before_each(void* f) {
+  ARG_UNUSED(f);
+
+  hv_shield_dac_waveform_stop(hv_dac);
+  zassert_equal(hv_shield_dac_waveform_set(hv_dac, 0, NULL), 0);
+  zassert_equal(hv_shield_dac_waveform_set(hv_dac, 1, NULL), 0);
+
+  hv_shield_dac_waveform_ramp(ramp, TABLE_SIZE, 0, 0xFFF);
+  status_record_len = 0;
+}
+
+ZTEST_SUITE(hv_shield_dac_waveform_uds, NULL, NULL, before_each, NULL, NULL);
+
+ZTEST(hv_shield_dac_waveform_uds, test_start_and_stop) {
+  const struct hv_shield_dac_waveform waveform = {
+    .samples = ramp,
+    .sample_count = TABLE_SIZE,
+    .cycles = 0,
+  };
+  bool consume_event;
+
+  zassert_equal(hv_shield_dac_waveform_set(hv_dac, 0, &waveform), 0);
+
+  zassert_equal(start_routine(SAMPLE_RATE), UDS_OK);
+  zassert_true(hv_shield_dac_waveform_is_running(hv_dac));
+
+  // running state followed by the sample rate
+  zassert_equal(routine_control(UDS_ROUTINE_CONTROL__REQUEST_ROUTINE_RESULTS,
+                                NULL, 0, &consume_event),
+                UDS_OK);
+  zassert_true(consume_event);
+  const uint8_t running[] = {0x01, 0x00, 0x00, 0x03, 0xE8};
+  zassert_equal(status_record_len, sizeof(running));
+  zassert_mem_equal(status_record, running, sizeof(running));
+
+  zassert_equal(start_routine(SAMPLE_RATE), UDS_NRC_RequestSequenceError);
+
+  zassert_equal(routine_control(UDS_ROUTINE_CONTROL__STOP_ROUTINE, NULL, 0,
+                                &consume_event),
+                UDS_OK);
+  zassert_false(hv_shield_dac_waveform_is_running(hv_dac));
+
+  zassert_equal(routine_control(UDS_ROUTINE_CONTROL__REQUEST_ROUTINE_RESULTS,
+                                NULL, 0, &consume_event),
+                UDS_OK);
+  zassert_equal(status_record[0], 0x00);
+
+  // already stopped
+  zassert_equal(routine_control(UDS_ROUTINE_CONTROL__STOP_ROUTINE, NULL, 0,
+                                &consume_event),
+                UDS_NRC_RequestSequenceError);
+}
+
+ZTEST(hv_shield_dac_waveform_uds, test_start_errors) {
+  const struct hv_shield_dac_waveform waveform = {
+    .samples = ramp,
+    .sample_count = TABLE_SIZE,
+    .cycles = 1,
+  };
+  bool consume_event;
+
+  // no channel has a waveform
+  zassert_equal(start_routine(SAMPLE_RATE), UDS_NRC_ConditionsNotCorrect);
+
+  zassert_equal(hv_shield_dac_waveform_set(hv_dac, 0, &waveform), 0);
+
+  zassert_equal(start_routine(0), UDS_NRC_RequestOutOfRange);
+
+  // the sample rate has 32 bit
+  const uint8_t short_record[] = {0x03, 0xE8};
+  zassert_equal(routine_control(UDS_ROUTINE_CONTROL__START_ROUTINE,
+                                short_record, sizeof(short_record),
+                                &consume_event),
+                UDS_NRC_IncorrectMessageLengthOrInvalidFormat);
+  zassert_false(hv_shield_dac_waveform_is_running(hv_dac));
+}
+
+ZTEST(hv_shield_dac_waveform_uds, test_unsupported_control_type) {
+  bool consume_event = true;
+
+  zassert_equal(routine_control(0x7F, NULL, 0, &consume_event),
+                UDS_NRC_SubFunctionNotSupported);
+  zassert_false(consume_event);
+}
+
+#endif  // CONFIG_HV_SHIELD_DAC_WAVEFORM_UDS
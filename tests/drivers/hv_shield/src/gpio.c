@@ -0,0 +1,190 @@
+/*
+ * Copyright (C) Frickly Systems GmbH
+ * Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/device.h>
+#include <zephyr/drivers/gpio.h>
+#include <zephyr/drivers/gpio/gpio_emul.h>
+#include <zephyr/ztest.h>
+
+#ifdef CONFIG_HV_SHIELD_GPIO_STATS
+#include <string.h>
+
+#include <zephyr/stats/stats.h>
+#endif
+
+static const struct device* hv_gpio = DEVICE_DT_GET(DT_NODELABEL(hvgpio));
+
+static const struct gpio_dt_spec lv_gpios[] = {
+  DT_FOREACH_PROP_ELEM_SEP(DT_NODELABEL(hvgpio),
+                           low_voltage_gpios,
+                           GPIO_DT_SPEC_GET_BY_IDX,
+                           (, )),
+};
+
+BUILD_ASSERT(ARRAY_SIZE(lv_gpios) == 32, "Tests expect 32 hv pins");
+
+#define BENCHMARK_ITERATIONS 1000
+
+static void configure_all(gpio_flags_t flags) {
+  for (int i = 0; i < ARRAY_SIZE(lv_gpios); i++) {
+    zassert_equal(gpio_pin_configure(hv_gpio, i, flags), 0);
+  }
+}
+
+static void before_each(void* f) {
+  ARG_UNUSED(f);
+
+  configure_all(GPIO_INPUT);
+  for (int i = 0; i < ARRAY_SIZE(lv_gpios); i++) {
+    zassert_equal(gpio_emul_input_set(lv_gpios[i].port, lv_gpios[i].pin, 0),
+                  0);
+  }
+}
+
+ZTEST_SUITE(hv_shield_gpio, NULL, NULL, before_each, NULL, NULL);
+
+ZTEST(hv_shield_gpio, test_port_get_gathers_inputs_of_all_ports) {
+  const uint32_t patterns[] = {0x00000001, 0x80000000, 0xA5A5A5A5,
+                               0x0F0F00FF, 0xFFFFFFFF};
+
+  for (int p = 0; p < ARRAY_SIZE(patterns); p++) {
+    for (int i = 0; i < ARRAY_SIZE(lv_gpios); i++) {
+      zassert_equal(gpio_emul_input_set(lv_gpios[i].port, lv_gpios[i].pin,
+                                        (patterns[p] >> i) & 1),
+                    0);
+    }
+
+    gpio_port_value_t value;
+    zassert_equal(gpio_port_get_raw(hv_gpio, &value), 0);
+    zassert_equal(value, patterns[p], "read 0x%08x, expected 0x%08x", value,
+                  patterns[p]);
+  }
+}
+
+ZTEST(hv_shield_gpio, test_port_get_only_reads_inputs) {
+  zassert_equal(gpio_pin_configure(hv_gpio, 3, GPIO_OUTPUT_INACTIVE), 0);
+  zassert_equal(gpio_emul_input_set(lv_gpios[4].port, lv_gpios[4].pin, 1), 0);
+
+  gpio_port_value_t value;
+  zassert_equal(gpio_port_get_raw(hv_gpio, &value), 0);
+  zassert_equal(value, BIT(4));
+}
+
+ZTEST(hv_shield_gpio, test_port_set_masked_scatters_outputs_to_all_ports) {
+  configure_all(GPIO_OUTPUT_INACTIVE);
+
+  const uint32_t mask = 0x00FFFF00;
+  const uint32_t value = 0x5A5AA5A5;
+  zassert_equal(gpio_port_set_masked_raw(hv_gpio, mask, value), 0);
+
+  for (int i = 0; i < ARRAY_SIZE(lv_gpios); i++) {
+    const int expected = (mask & value & BIT(i)) ? 1 : 0;
+    zassert_equal(gpio_emul_output_get(lv_gpios[i].port, lv_gpios[i].pin),
+                  expected, "hv pin %d", i);
+  }
+}
+
+ZTEST(hv_shield_gpio, test_port_set_clear_toggle_bits) {
+  configure_all(GPIO_OUTPUT_INACTIVE);
+
+  zassert_equal(gpio_port_set_bits_raw(hv_gpio, 0x80018001), 0);
+  zassert_equal(gpio_port_clear_bits_raw(hv_gpio, 0x00010000), 0);
+  zassert_equal(gpio_port_toggle_bits(hv_gpio, 0x00000003), 0);
+
+  const uint32_t expected = 0x80008002;
+  for (int i = 0; i < ARRAY_SIZE(lv_gpios); i++) {
+    zassert_equal(gpio_emul_output_get(lv_gpios[i].port, lv_gpios[i].pin),
+                  (expected >> i) & 1, "hv pin %d", i);
+  }
+}
+
+#ifdef CONFIG_HV_SHIELD_GPIO_STATS
+struct stat_lookup {
+  const char* name;
+  uint32_t* value;
+};
+
+static int find_stat_entry(struct stats_hdr* hdr,
+                           void* arg,
+                           const char* name,
+                           uint16_t off) {
+  struct stat_lookup* lookup = arg;
+
+  if (strcmp(name, lookup->name) == 0) {
+    lookup->value = (uint32_t*)((uint8_t*)hdr + off);
+  }
+
+  return 0;
+}
+
+static uint32_t* find_stat(const char* group, const char* name) {
+  struct stat_lookup lookup = {.name = name};
+  struct stats_hdr* hdr = stats_group_find(group);
+
+  zassert_not_null(hdr);
+  stats_walk(hdr, find_stat_entry, &lookup);
+  zassert_not_null(lookup.value);
+
+  return lookup.value;
+}
+
+// Number of distinct ports of the low voltage gpios
+static uint32_t count_ports(void) {
+  uint32_t ports = 0;
+
+  for (int i = 0; i < ARRAY_SIZE(lv_gpios); i++) {
+    int j = 0;
+    while (lv_gpios[j].port != lv_gpios[i].port) {
+      j++;
+    }
+    if (j == i) {
+      ports++;
+    }
+  }
+
+  return ports;
+}
+
+ZTEST(hv_shield_gpio, test_benchmark_32_pin_read_and_write) {
+  const uint32_t* port_reads = find_stat("hv_shield_gpio", "port_reads");
+  const uint32_t* port_writes = find_stat("hv_shield_gpio", "port_writes");
+  // one access per underlying port instead of one per pin
+  const uint32_t ports = count_ports();
+  gpio_port_value_t value;
+
+  zassert_true(ports < ARRAY_SIZE(lv_gpios));
+
+  uint32_t before = *port_reads;
+  for (int n = 0; n < BENCHMARK_ITERATIONS; n++) {
+    zassert_equal(gpio_port_get_raw(hv_gpio, &value), 0);
+  }
+  zassert_equal(*port_reads - before, BENCHMARK_ITERATIONS * ports);
+
+  configure_all(GPIO_OUTPUT_INACTIVE);
+
+  before = *port_writes;
+  for (int n = 0; n < BENCHMARK_ITERATIONS; n++) {
+    zassert_equal(gpio_port_set_masked_raw(hv_gpio, UINT32_MAX, n * 0x01010101),
+                  0);
+  }
+  zassert_equal(*port_writes - before, BENCHMARK_ITERATIONS * ports);
+
+  before = *port_writes;
+  zassert_equal(gpio_port_toggle_bits(hv_gpio, UINT32_MAX), 0);
+  zassert_equal(*port_writes - before, ports);
+
+  // pins of a single port only access that port
+  before = *port_writes;
+  zassert_equal(gpio_port_set_masked_raw(hv_gpio, BIT(0), 1), 0);
+  zassert_equal(*port_writes - before, 1);
+
+  zassert_equal(gpio_pin_configure(hv_gpio, 0, GPIO_INPUT), 0);
+  before = *port_reads;
+  zassert_equal(gpio_port_get_raw(hv_gpio, &value), 0);
+  zassert_equal(*port_reads - before, 1);
+}
+#endif  // CONFIG_HV_SHIELD_GPIO_STATS
@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) Frickly Systems GmbH
+ * Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/device.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/drivers/gpio.h>
+#include <zephyr/ztest.h>
+
+#include <ardep/drivers/emul/hv_shield.h>
+#include <ardep/drivers/hv_shield.h>
+
+static const struct device* hv_shield = DEVICE_DT_GET(DT_NODELABEL(hvshield));
+static const struct device* hv_gpio = DEVICE_DT_GET(DT_NODELABEL(hvgpio));
+static const struct emul* hv_shield_emul = EMUL_DT_GET(DT_NODELABEL(hvshield));
+
+// Waits until register changes outside of an update are written
+static void wait_for_deferred_flush(void) {
+  if (CONFIG_HV_SHIELD_DEFERRED_FLUSH_US > 0) {
+    k_usleep(2 * CONFIG_HV_SHIELD_DEFERRED_FLUSH_US);
+  }
+}
+
+static void before_each(void* f) {
+  ARG_UNUSED(f);
+
+  zassert_equal(
+      hv_shield_set_gpio_output_enable_mask(hv_shield, UINT32_MAX, 0), 0);
+  zassert_equal(hv_shield_set_dac_gain(hv_shield, 0, HV_SHIELD_DAC_GAIN_1), 0);
+  zassert_equal(hv_shield_set_dac_gain(hv_shield, 1, HV_SHIELD_DAC_GAIN_1), 0);
+  wait_for_deferred_flush();
+
+  hv_shield_emul_reset_transfer_count(hv_shield_emul);
+}
+
+ZTEST_SUITE(hv_shield, NULL, NULL, before_each, NULL, NULL);
+
+ZTEST(hv_shield, test_set_gpio_output_enable) {
+  zassert_equal(hv_shield_set_gpio_output_enable(hv_shield, 0, true), 0);
+  wait_for_deferred_flush();
+  zassert_equal(hv_shield_emul_get_gpio_output_enable(hv_shield_emul), BIT(0));
+  zassert_equal(hv_shield_emul_get_transfer_count(hv_shield_emul), 1);
+
+  zassert_equal(hv_shield_set_gpio_output_enable(hv_shield, 13, true), 0);
+  wait_for_deferred_flush();
+  zassert_equal(hv_shield_emul_get_gpio_output_enable(hv_shield_emul),
+                BIT(0) | BIT(13));
+  zassert_equal(hv_shield_emul_get_transfer_count(hv_shield_emul), 2);
+
+  // unchanged registers are not written again
+  zassert_equal(hv_shield_set_gpio_output_enable(hv_shield, 13, true), 0);
+  wait_for_deferred_flush();
+  zassert_equal(hv_shield_emul_get_transfer_count(hv_shield_emul), 2);
+
+  zassert_equal(hv_shield_set_gpio_output_enable(hv_shield, 0, false), 0);
+  wait_for_deferred_flush();
+  zassert_equal(hv_shield_emul_get_gpio_output_enable(hv_shield_emul),
+                BIT(13));
+
+  zassert_equal(hv_shield_set_gpio_output_enable(hv_shield, 32, true),
+                -EINVAL);
+}
+
+ZTEST(hv_shield, test_set_gpio_output_enable_mask) {
+  zassert_equal(hv_shield_set_gpio_output_enable_mask(hv_shield, 0x00FF00FF,
+                                                      UINT32_MAX),
+                0);
+  wait_for_deferred_flush();
+  zassert_equal(hv_shield_emul_get_gpio_output_enable(hv_shield_emul),
+                0x00FF00FF);
+  zassert_equal(hv_shield_emul_get_transfer_count(hv_shield_emul), 1);
+
+  // only bits in the mask are changed
+  zassert_equal(
+      hv_shield_set_gpio_output_enable_mask(hv_shield, 0x0000FFFF, 0x00001234),
+      0);
+  wait_for_deferred_flush();
+  zassert_equal(hv_shield_emul_get_gpio_output_enable(hv_shield_emul),
+                0x00FF1234);
+  zassert_equal(hv_shield_emul_get_transfer_count(hv_shield_emul), 2);
+}
+
+ZTEST(hv_shield, test_set_dac_gain) {
+  zassert_equal(hv_shield_set_dac_gain(hv_shield, 1, HV_SHIELD_DAC_GAIN_4), 0);
+  wait_for_deferred_flush();
+  zassert_equal(hv_shield_emul_get_dac_gain(hv_shield_emul, 0),
+                HV_SHIELD_DAC_GAIN_1);
+  zassert_equal(hv_shield_emul_get_dac_gain(hv_shield_emul, 1),
+                HV_SHIELD_DAC_GAIN_4);
+  zassert_equal(hv_shield_emul_get_transfer_count(hv_shield_emul), 1);
+
+  zassert_equal(hv_shield_set_dac_gain(hv_shield, 2, HV_SHIELD_DAC_GAIN_4),
+                -EINVAL);
+}
+
+ZTEST(hv_shield, test_update_writes_once) {
+  zassert_equal(hv_shield_begin_update(hv_shield), 0);
+
+  for (int i = 0; i < 32; i++) {
+    zassert_equal(hv_shield_set_gpio_output_enable(hv_shield, i, true), 0);
+  }
+  zassert_equal(hv_shield_set_dac_gain(hv_shield, 0, HV_SHIELD_DAC_GAIN_16),
+                0);
+  wait_for_deferred_flush();
+  zassert_equal(hv_shield_emul_get_transfer_count(hv_shield_emul), 0);
+
+  zassert_equal(hv_shield_commit_update(hv_shield), 0);
+  zassert_equal(hv_shield_emul_get_transfer_count(hv_shield_emul), 1);
+  zassert_equal(hv_shield_emul_get_gpio_output_enable(hv_shield_emul),
+                UINT32_MAX);
+  zassert_equal(hv_shield_emul_get_dac_gain(hv_shield_emul, 0),
+                HV_SHIELD_DAC_GAIN_16);
+}
+
+ZTEST(hv_shield, test_nested_update_writes_on_outermost_commit) {
+  zassert_equal(hv_shield_begin_update(hv_shield), 0);
+  zassert_equal(hv_shield_begin_update(hv_shield), 0);
+
+  zassert_equal(hv_shield_set_gpio_output_enable(hv_shield, 3, true), 0);
+  zassert_equal(hv_shield_commit_update(hv_shield), 0);
+  zassert_equal(hv_shield_emul_get_transfer_count(hv_shield_emul), 0);
+
+  zassert_equal(hv_shield_commit_update(hv_shield), 0);
+  zassert_equal(hv_shield_emul_get_transfer_count(hv_shield_emul), 1);
+  zassert_equal(hv_shield_emul_get_gpio_output_enable(hv_shield_emul), BIT(3));
+
+  // no update is open anymore
+  zassert_equal(hv_shield_commit_update(hv_shield), -EINVAL);
+}
+
+ZTEST(hv_shield, test_gpio_configure_within_update) {
+  zassert_equal(hv_shield_begin_update(hv_shield), 0);
+  for (int i = 0; i < 8; i++) {
+    zassert_equal(gpio_pin_configure(hv_gpio, i, GPIO_OUTPUT_INACTIVE), 0);
+  }
+  zassert_equal(hv_shield_commit_update(hv_shield), 0);
+
+  zassert_equal(hv_shield_emul_get_transfer_count(hv_shield_emul), 1);
+  zassert_equal(hv_shield_emul_get_gpio_output_enable(hv_shield_emul), 0xFF);
+
+  zassert_equal(hv_shield_begin_update(hv_shield), 0);
+  for (int i = 0; i < 8; i++) {
+    zassert_equal(gpio_pin_configure(hv_gpio, i, GPIO_INPUT), 0);
+  }
+  zassert_equal(hv_shield_commit_update(hv_shield), 0);
+
+  zassert_equal(hv_shield_emul_get_transfer_count(hv_shield_emul), 2);
+  zassert_equal(hv_shield_emul_get_gpio_output_enable(hv_shield_emul), 0x00);
+}
+
+ZTEST(hv_shield, test_deferred_flush_combines_changes) {
+  if (CONFIG_HV_SHIELD_DEFERRED_FLUSH_US == 0) {
+    ztest_test_skip();
+  }
+
+  for (int i = 0; i < 32; i++) {
+    zassert_equal(hv_shield_set_gpio_output_enable(hv_shield, i, true), 0);
+  }
+  zassert_equal(hv_shield_emul_get_transfer_count(hv_shield_emul), 0);
+
+  wait_for_deferred_flush();
+  zassert_equal(hv_shield_emul_get_transfer_count(hv_shield_emul), 1);
+  zassert_equal(hv_shield_emul_get_gpio_output_enable(hv_shield_emul),
+                UINT32_MAX);
+}
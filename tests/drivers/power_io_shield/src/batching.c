@@ -0,0 +1,270 @@
+/*
+ * Copyright (C) Frickly Systems GmbH
+ * Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "devices.h"
+#include "regs.h"
+
+#include <zephyr/drivers/gpio.h>
+#include <zephyr/drivers/gpio/gpio_emul.h>
+#include <zephyr/ztest.h>
+
+#include <ardep/drivers/emul/power_io_shield.h>
+#include <ardep/drivers/power_io_shield.h>
+#include <ardep/dt-bindings/power-io-shield.h>
+
+static const struct device* gpio0 = DEVICE_DT_GET(DT_NODELABEL(gpio0));
+
+#define ALL_OUTPUTS_MASK (0x3F << POWER_IO_SHIELD_OUTPUT_BASE)
+
+static void before_each(void* f) {
+  ARG_UNUSED(f);
+
+  zassert_equal(power_io_shield_set_write_coalescing_window(power_io_shield, 0),
+                0);
+  zassert_equal(power_io_shield_set_input_cache_max_age(power_io_shield, 0), 0);
+  power_io_shield_emul_reset_transfer_count(power_io_shield_emul);
+}
+
+static void after_each(void* f) {
+  ARG_UNUSED(f);
+
+  zassert_equal(power_io_shield_set_write_coalescing_window(power_io_shield, 0),
+                0);
+  zassert_equal(power_io_shield_set_input_cache_max_age(power_io_shield, 0), 0);
+  zassert_equal(gpio_port_clear_bits_raw(power_io_shield, ALL_OUTPUTS_MASK), 0);
+  power_io_shield_emul_set_u16_reg(power_io_shield_emul, REG_GPIOA, 0x0000);
+}
+
+ZTEST_SUITE(mcp_driver_batching, NULL, NULL, before_each, after_each, NULL);
+
+ZTEST(mcp_driver_batching, test_unbatched_writes_one_transfer_per_change) {
+  for (int i = 0; i < 6; i++) {
+    zassert_equal(gpio_pin_set(power_io_shield, POWER_IO_SHIELD_OUTPUT(i), 1),
+                  0);
+  }
+
+  zassert_equal(
+      power_io_shield_emul_get_transfer_count(power_io_shield_emul), 6);
+  zassert_equal(
+      power_io_shield_emul_get_u16_reg(power_io_shield_emul, REG_GPIOA),
+      0x00FC);
+}
+
+ZTEST(mcp_driver_batching, test_unchanged_outputs_are_not_written) {
+  zassert_equal(gpio_pin_set(power_io_shield, POWER_IO_SHIELD_OUTPUT(0), 1), 0);
+  zassert_equal(
+      power_io_shield_emul_get_transfer_count(power_io_shield_emul), 1);
+
+  // the output already has this value
+  zassert_equal(gpio_pin_set(power_io_shield, POWER_IO_SHIELD_OUTPUT(0), 1), 0);
+  // nothing is selected by the mask
+  zassert_equal(gpio_port_set_masked_raw(power_io_shield, 0, ALL_OUTPUTS_MASK),
+                0);
+
+  zassert_equal(power_io_shield_batch_begin(power_io_shield), 0);
+  zassert_equal(gpio_pin_set(power_io_shield, POWER_IO_SHIELD_OUTPUT(0), 1), 0);
+  zassert_equal(power_io_shield_batch_commit(power_io_shield), 0);
+
+  zassert_equal(
+      power_io_shield_emul_get_transfer_count(power_io_shield_emul), 1);
+  zassert_equal(
+      power_io_shield_emul_get_u16_reg(power_io_shield_emul, REG_GPIOA),
+      0x0004);
+}
+
+ZTEST(mcp_driver_batching, test_batch_writes_once_on_commit) {
+  zassert_equal(power_io_shield_batch_begin(power_io_shield), 0);
+
+  for (int i = 0; i < 6; i++) {
+    zassert_equal(gpio_pin_set(power_io_shield, POWER_IO_SHIELD_OUTPUT(i), 1),
+                  0);
+  }
+
+  // nothing is written until the batch is committed
+  zassert_equal(
+      power_io_shield_emul_get_transfer_count(power_io_shield_emul), 0);
+  zassert_equal(
+      power_io_shield_emul_get_u16_reg(power_io_shield_emul, REG_GPIOA),
+      0x0000);
+
+  zassert_equal(power_io_shield_batch_commit(power_io_shield), 0);
+
+  zassert_equal(
+      power_io_shield_emul_get_transfer_count(power_io_shield_emul), 1);
+  zassert_equal(
+      power_io_shield_emul_get_u16_reg(power_io_shield_emul, REG_GPIOA),
+      0x00FC);
+}
+
+ZTEST(mcp_driver_batching, test_nested_batch_writes_on_outermost_commit) {
+  zassert_equal(power_io_shield_batch_begin(power_io_shield), 0);
+  zassert_equal(power_io_shield_batch_begin(power_io_shield), 0);
+
+  zassert_equal(gpio_pin_set(power_io_shield, POWER_IO_SHIELD_OUTPUT(0), 1), 0);
+  zassert_equal(power_io_shield_batch_commit(power_io_shield), 0);
+  zassert_equal(
+      power_io_shield_emul_get_transfer_count(power_io_shield_emul), 0);
+
+  zassert_equal(gpio_pin_set(power_io_shield, POWER_IO_SHIELD_OUTPUT(5), 1), 0);
+  zassert_equal(power_io_shield_batch_commit(power_io_shield), 0);
+  zassert_equal(
+      power_io_shield_emul_get_transfer_count(power_io_shield_emul), 1);
+  zassert_equal(
+      power_io_shield_emul_get_u16_reg(power_io_shield_emul, REG_GPIOA),
+      0x0084);
+
+  // no batch is open anymore
+  zassert_equal(power_io_shield_batch_commit(power_io_shield), -EINVAL);
+}
+
+ZTEST(mcp_driver_batching, test_configure_within_batch_writes_on_commit) {
+  zassert_equal(power_io_shield_batch_begin(power_io_shield), 0);
+
+  zassert_equal(gpio_pin_configure(power_io_shield, POWER_IO_SHIELD_OUTPUT(1),
+                                   GPIO_OUTPUT_ACTIVE),
+                0);
+  zassert_equal(gpio_pin_set(power_io_shield, POWER_IO_SHIELD_OUTPUT(2), 1), 0);
+
+  // the configuration is written together with the other changes
+  zassert_equal(
+      power_io_shield_emul_get_transfer_count(power_io_shield_emul), 0);
+
+  zassert_equal(power_io_shield_batch_commit(power_io_shield), 0);
+
+  zassert_equal(
+      power_io_shield_emul_get_transfer_count(power_io_shield_emul), 1);
+  zassert_equal(
+      power_io_shield_emul_get_u16_reg(power_io_shield_emul, REG_GPIOA),
+      0x0018);
+}
+
+ZTEST(mcp_driver_batching, test_read_within_batch_returns_pending_outputs) {
+  gpio_port_value_t value;
+
+  zassert_equal(power_io_shield_batch_begin(power_io_shield), 0);
+  zassert_equal(gpio_pin_set(power_io_shield, POWER_IO_SHIELD_OUTPUT(1), 1), 0);
+
+  zassert_equal(gpio_port_get_raw(power_io_shield, &value), 0);
+  zassert_equal(value & ALL_OUTPUTS_MASK, BIT(POWER_IO_SHIELD_OUTPUT(1)));
+
+  zassert_equal(power_io_shield_batch_commit(power_io_shield), 0);
+  zassert_equal(
+      power_io_shield_emul_get_u16_reg(power_io_shield_emul, REG_GPIOA),
+      0x0008);
+}
+
+ZTEST(mcp_driver_batching, test_coalescing_window_writes_once) {
+  zassert_equal(
+      power_io_shield_set_write_coalescing_window(power_io_shield, 10000), 0);
+
+  for (int i = 0; i < 6; i++) {
+    zassert_equal(gpio_pin_set(power_io_shield, POWER_IO_SHIELD_OUTPUT(i), 1),
+                  0);
+  }
+  zassert_equal(
+      power_io_shield_emul_get_transfer_count(power_io_shield_emul), 0);
+
+  k_msleep(20);
+
+  zassert_equal(
+      power_io_shield_emul_get_transfer_count(power_io_shield_emul), 1);
+  zassert_equal(
+      power_io_shield_emul_get_u16_reg(power_io_shield_emul, REG_GPIOA),
+      0x00FC);
+}
+
+ZTEST(mcp_driver_batching, test_flush_writes_pending_changes) {
+  zassert_equal(
+      power_io_shield_set_write_coalescing_window(power_io_shield, 1000000), 0);
+
+  zassert_equal(gpio_pin_set(power_io_shield, POWER_IO_SHIELD_OUTPUT(2), 1), 0);
+  zassert_equal(power_io_shield_flush(power_io_shield), 0);
+
+  zassert_equal(
+      power_io_shield_emul_get_transfer_count(power_io_shield_emul), 1);
+  zassert_equal(
+      power_io_shield_emul_get_u16_reg(power_io_shield_emul, REG_GPIOA),
+      0x0010);
+
+  // nothing left to write
+  zassert_equal(power_io_shield_flush(power_io_shield), 0);
+  zassert_equal(
+      power_io_shield_emul_get_transfer_count(power_io_shield_emul), 1);
+}
+
+ZTEST(mcp_driver_batching, test_input_cache) {
+  gpio_port_value_t value;
+
+  zassert_equal(
+      power_io_shield_set_input_cache_max_age(power_io_shield, 1000000), 0);
+
+  // input 0 high (note the inversion of the input pins)
+  power_io_shield_emul_set_u16_reg(power_io_shield_emul, REG_GPIOA,
+                                   0x0100 ^ 0x3f00);
+
+  zassert_equal(gpio_port_get_raw(power_io_shield, &value), 0);
+  zassert_equal((value >> POWER_IO_SHIELD_INPUT_BASE) & 0x3F, 0b000001);
+
+  // changed input is not seen while the cache is fresh
+  power_io_shield_emul_set_u16_reg(power_io_shield_emul, REG_GPIOA,
+                                   0x0200 ^ 0x3f00);
+  zassert_equal(gpio_port_get_raw(power_io_shield, &value), 0);
+  zassert_equal((value >> POWER_IO_SHIELD_INPUT_BASE) & 0x3F, 0b000001);
+  zassert_equal(
+      power_io_shield_emul_get_transfer_count(power_io_shield_emul), 1);
+
+  // disabling the cache reads the register again
+  zassert_equal(power_io_shield_set_input_cache_max_age(power_io_shield, 0), 0);
+  zassert_equal(gpio_port_get_raw(power_io_shield, &value), 0);
+  zassert_equal((value >> POWER_IO_SHIELD_INPUT_BASE) & 0x3F, 0b000010);
+  zassert_equal(
+      power_io_shield_emul_get_transfer_count(power_io_shield_emul), 2);
+}
+
+ZTEST(mcp_driver_batching, test_input_cache_expires) {
+  gpio_port_value_t value;
+
+  zassert_equal(power_io_shield_set_input_cache_max_age(power_io_shield, 5000),
+                0);
+
+  zassert_equal(gpio_port_get_raw(power_io_shield, &value), 0);
+  zassert_equal(gpio_port_get_raw(power_io_shield, &value), 0);
+  zassert_equal(
+      power_io_shield_emul_get_transfer_count(power_io_shield_emul), 1);
+
+  k_msleep(10);
+
+  zassert_equal(gpio_port_get_raw(power_io_shield, &value), 0);
+  zassert_equal(
+      power_io_shield_emul_get_transfer_count(power_io_shield_emul), 2);
+}
+
+ZTEST(mcp_driver_batching, test_interrupt_reads_intf_and_intcap_in_one_burst) {
+  zassert_equal(
+      gpio_pin_interrupt_configure(power_io_shield, POWER_IO_SHIELD_INPUT(0),
+                                   GPIO_INT_EDGE_TO_ACTIVE),
+      0);
+
+  power_io_shield_emul_set_u16_reg(power_io_shield_emul, REG_INTFA, 0x0100);
+  power_io_shield_emul_set_u16_reg(power_io_shield_emul, REG_INTCAPA,
+                                   0x0100 ^ 0x3f00);
+  power_io_shield_emul_reset_transfer_count(power_io_shield_emul);
+
+  zassert_equal(gpio_emul_input_set(gpio0, 0, 1), 0);
+  k_yield();
+  zassert_equal(
+      power_io_shield_emul_get_transfer_count(power_io_shield_emul), 1);
+  zassert_equal(gpio_emul_input_set(gpio0, 0, 0), 0);
+
+  // reset
+  power_io_shield_emul_set_u16_reg(power_io_shield_emul, REG_INTFA, 0x0000);
+  power_io_shield_emul_set_u16_reg(power_io_shield_emul, REG_INTCAPA, 0x0000);
+  zassert_equal(
+      gpio_pin_interrupt_configure(power_io_shield, POWER_IO_SHIELD_INPUT(0),
+                                   GPIO_INT_DISABLE),
+      0);
+}
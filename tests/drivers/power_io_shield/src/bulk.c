@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) Frickly Systems GmbH
+ * Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "regs.h"
+
+#include <zephyr/device.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/drivers/gpio.h>
+#include <zephyr/ztest.h>
+
+#include <ardep/drivers/emul/power_io_shield.h>
+#include <ardep/drivers/power_io_shield.h>
+#include <ardep/dt-bindings/power-io-shield.h>
+
+static const struct device* const shields[] = {
+  DEVICE_DT_GET(DT_NODELABEL(power_io_shield0)),
+  DEVICE_DT_GET(DT_NODELABEL(power_io_shield1)),
+  DEVICE_DT_GET(DT_NODELABEL(power_io_shield2)),
+};
+
+static const struct emul* const shield_emuls[] = {
+  EMUL_DT_GET(DT_NODELABEL(power_io_shield0)),
+  EMUL_DT_GET(DT_NODELABEL(power_io_shield1)),
+  EMUL_DT_GET(DT_NODELABEL(power_io_shield2)),
+};
+
+#define ALL_OUTPUTS_MASK (0x3F << POWER_IO_SHIELD_OUTPUT_BASE)
+#define ALL_INPUTS_MASK (0x3F << POWER_IO_SHIELD_INPUT_BASE)
+#define ALL_FAULTS_MASK (0x7 << POWER_IO_SHIELD_FAULT_BASE)
+
+static void before_each(void* f) {
+  ARG_UNUSED(f);
+
+  for (size_t i = 0; i < ARRAY_SIZE(shield_emuls); i++) {
+    power_io_shield_emul_reset_transfer_count(shield_emuls[i]);
+  }
+}
+
+static void after_each(void* f) {
+  ARG_UNUSED(f);
+
+  for (size_t i = 0; i < ARRAY_SIZE(shields); i++) {
+    zassert_equal(gpio_port_clear_bits_raw(shields[i], ALL_OUTPUTS_MASK), 0);
+    power_io_shield_emul_set_u16_reg(shield_emuls[i], REG_GPIOA, 0x0000);
+  }
+}
+
+ZTEST_SUITE(mcp_driver_bulk, NULL, NULL, before_each, after_each, NULL);
+
+ZTEST(mcp_driver_bulk, test_bulk_read) {
+  gpio_port_value_t values[ARRAY_SIZE(shields)];
+  struct power_io_shield_bulk_timing timing;
+
+  // note the xor for 0x3f00, this is for the hard-inverted input pins
+  power_io_shield_emul_set_u16_reg(shield_emuls[0], REG_GPIOA,
+                                   0x0100 ^ 0x3f00);  // input 0
+  power_io_shield_emul_set_u16_reg(shield_emuls[1], REG_GPIOA,
+                                   0x0200 ^ 0x3f00);  // input 1
+  power_io_shield_emul_set_u16_reg(shield_emuls[2], REG_GPIOA,
+                                   0x4001 ^ 0x3f00);  // fault 0 and 1
+
+  zassert_equal(power_io_shield_bulk_read(shields, ARRAY_SIZE(shields), values,
+                                          &timing),
+                0);
+
+  zassert_equal(values[0] & ALL_INPUTS_MASK, BIT(POWER_IO_SHIELD_INPUT(0)));
+  zassert_equal(values[1] & ALL_INPUTS_MASK, BIT(POWER_IO_SHIELD_INPUT(1)));
+  zassert_equal(values[2] & ALL_INPUTS_MASK, 0);
+  zassert_equal(values[2] & ALL_FAULTS_MASK,
+                BIT(POWER_IO_SHIELD_FAULT(0)) | BIT(POWER_IO_SHIELD_FAULT(1)));
+
+  // one transfer per shield
+  for (size_t i = 0; i < ARRAY_SIZE(shield_emuls); i++) {
+    zassert_equal(power_io_shield_emul_get_transfer_count(shield_emuls[i]), 1);
+  }
+
+  zassert_true(timing.spread_us <= timing.total_us);
+}
+
+ZTEST(mcp_driver_bulk, test_bulk_write) {
+  const gpio_port_pins_t masks[] = {
+    ALL_OUTPUTS_MASK,
+    BIT(POWER_IO_SHIELD_OUTPUT(5)),
+    0,
+  };
+  const gpio_port_value_t values[] = {
+    BIT(POWER_IO_SHIELD_OUTPUT(0)) | BIT(POWER_IO_SHIELD_OUTPUT(1)),
+    ALL_OUTPUTS_MASK,  // only output 5 is changed by the mask
+    ALL_OUTPUTS_MASK,  // nothing is changed
+  };
+  struct power_io_shield_bulk_timing timing;
+
+  zassert_equal(power_io_shield_bulk_write(shields, ARRAY_SIZE(shields), masks,
+                                           values, &timing),
+                0);
+
+  zassert_equal(power_io_shield_emul_get_u16_reg(shield_emuls[0], REG_GPIOA),
+                0x000C);
+  zassert_equal(power_io_shield_emul_get_u16_reg(shield_emuls[1], REG_GPIOA),
+                0x0080);
+  zassert_equal(power_io_shield_emul_get_u16_reg(shield_emuls[2], REG_GPIOA),
+                0x0000);
+
+  // one transfer per changed shield
+  zassert_equal(power_io_shield_emul_get_transfer_count(shield_emuls[0]), 1);
+  zassert_equal(power_io_shield_emul_get_transfer_count(shield_emuls[1]), 1);
+  zassert_equal(power_io_shield_emul_get_transfer_count(shield_emuls[2]), 0);
+
+  zassert_true(timing.spread_us <= timing.total_us);
+}
+
+ZTEST(mcp_driver_bulk, test_bulk_write_flushes_open_batch) {
+  zassert_equal(power_io_shield_batch_begin(shields[1]), 0);
+  zassert_equal(gpio_pin_set_raw(shields[1], POWER_IO_SHIELD_OUTPUT(0), 1), 0);
+
+  const gpio_port_pins_t masks[] = {BIT(POWER_IO_SHIELD_OUTPUT(1))};
+  const gpio_port_value_t values[] = {BIT(POWER_IO_SHIELD_OUTPUT(1))};
+  zassert_equal(
+      power_io_shield_bulk_write(&shields[1], 1, masks, values, NULL), 0);
+
+  zassert_equal(power_io_shield_emul_get_u16_reg(shield_emuls[1], REG_GPIOA),
+                0x000C);
+  zassert_equal(power_io_shield_batch_commit(shields[1]), 0);
+  zassert_equal(power_io_shield_emul_get_transfer_count(shield_emuls[1]), 1);
+}
+
+ZTEST(mcp_driver_bulk, test_bulk_rejects_duplicate_shields) {
+  const struct device* const duplicated[] = {shields[0], shields[1],
+                                             shields[0]};
+  gpio_port_value_t values[ARRAY_SIZE(duplicated)];
+
+  zassert_equal(power_io_shield_bulk_read(duplicated, ARRAY_SIZE(duplicated),
+                                          values, NULL),
+                -EINVAL);
+
+  for (size_t i = 0; i < ARRAY_SIZE(shield_emuls); i++) {
+    zassert_equal(power_io_shield_emul_get_transfer_count(shield_emuls[i]), 0);
+  }
+}
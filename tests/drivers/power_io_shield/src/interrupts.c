@@ -14,6 +14,7 @@
 #include <zephyr/ztest.h>
 
 #include <ardep/drivers/emul/power_io_shield.h>
+#include <ardep/drivers/power_io_shield.h>
 #include <ardep/dt-bindings/power-io-shield.h>
 
 static const struct device* gpio0 = DEVICE_DT_GET(DT_NODELABEL(gpio0));
@@ -214,10 +215,12 @@ ZTEST(mcp_driver_interrupts, test_level_interrupt) {
 
   // set interrupt gpio to 1
   zassert_equal(gpio_emul_input_set(gpio0, 0, 1), 0);
-  k_msleep(1);
-  // driver now does its thing and calls the interrupt handler and after 20
-  // times, the handler resets the intf which stops further interrupts then we
-  // jump back here as the wq is then empty
+  // driver now does its thing and polls the level interrupt, calling the
+  // interrupt handler until it resets the intf after 20 times, which stops
+  // further interrupts
+  for (int i = 0; i < 100 && gpio_demo_interrupt_fake.call_count < 20; i++) {
+    k_msleep(CONFIG_POWER_IO_SHIELD_LEVEL_POLL_MAX_PERIOD_US / 1000);
+  }
 
   // the interrupt handler should only be called 20 times, not more or less
   zassert_true(gpio_demo_interrupt_fake.call_count == 20);
@@ -230,7 +233,7 @@ ZTEST(mcp_driver_interrupts, test_level_interrupt) {
   zassert_equal(
       power_io_shield_emul_get_u16_reg(power_io_shield_emul, REG_INTCAPA),
       0x0000);
-  k_msleep(1);
+  k_msleep(2 * CONFIG_POWER_IO_SHIELD_LEVEL_POLL_MAX_PERIOD_US / 1000);
   zassert_equal(gpio_emul_input_set(gpio0, 0, 0), 0);
 
   zassert_true(gpio_demo_interrupt_fake.call_count == 20);
@@ -241,3 +244,113 @@ ZTEST(mcp_driver_interrupts, test_level_interrupt) {
                                    GPIO_INT_DISABLE),
       0);
 }
+
+ZTEST(mcp_driver_interrupts, test_level_interrupt_poll_rate_is_limited) {
+  struct gpio_callback callback;
+  gpio_init_callback(&callback, gpio_demo_interrupt,
+                     BIT(POWER_IO_SHIELD_INPUT(2)));
+  zassert_equal(gpio_add_callback(power_io_shield, &callback), 0);
+
+  zassert_equal(
+      gpio_pin_interrupt_configure(power_io_shield, POWER_IO_SHIELD_INPUT(2),
+                                   GPIO_INT_LEVEL_HIGH),
+      0);
+
+  // level stays active for the whole test
+  power_io_shield_emul_set_u16_reg(power_io_shield_emul, REG_INTFA,
+                                   0x0400);  // input pin 2
+  power_io_shield_emul_set_u16_reg(power_io_shield_emul, REG_INTCAPA,
+                                   0x0400 ^ 0x3f00);  // input pin 2
+
+  const int window_ms = 200;
+  zassert_equal(gpio_emul_input_set(gpio0, 0, 1), 0);
+  k_msleep(window_ms);
+
+  // without backoff the level would be polled once every poll period
+  const uint32_t unlimited_calls =
+      window_ms * 1000 / CONFIG_POWER_IO_SHIELD_LEVEL_POLL_PERIOD_US;
+  const uint32_t calls = gpio_demo_interrupt_fake.call_count;
+  zassert_true(calls >= 2, "level interrupt was not polled: %u", calls);
+  zassert_true(calls < unlimited_calls, "%u polls within %d ms", calls,
+               window_ms);
+
+  // polling stops after the level went inactive
+  power_io_shield_emul_set_u16_reg(power_io_shield_emul, REG_INTFA, 0x0000);
+  power_io_shield_emul_set_u16_reg(power_io_shield_emul, REG_INTCAPA, 0x0000);
+  k_msleep(2 * CONFIG_POWER_IO_SHIELD_LEVEL_POLL_MAX_PERIOD_US / 1000);
+  const uint32_t calls_after_release = gpio_demo_interrupt_fake.call_count;
+  k_msleep(2 * CONFIG_POWER_IO_SHIELD_LEVEL_POLL_MAX_PERIOD_US / 1000);
+  zassert_equal(gpio_demo_interrupt_fake.call_count, calls_after_release);
+
+  zassert_equal(gpio_emul_input_set(gpio0, 0, 0), 0);
+  zassert_equal(gpio_remove_callback(power_io_shield, &callback), 0);
+  zassert_equal(
+      gpio_pin_interrupt_configure(power_io_shield, POWER_IO_SHIELD_INPUT(2),
+                                   GPIO_INT_DISABLE),
+      0);
+}
+
+static int64_t last_event_timestamp;
+static bool event_timestamps_monotonic;
+static void record_event_timestamp(const struct device* dev,
+                                   struct gpio_callback* cb,
+                                   gpio_port_pins_t pins) {
+  ARG_UNUSED(cb);
+  ARG_UNUSED(pins);
+
+  int64_t timestamp = power_io_shield_get_event_timestamp(dev);
+  if (timestamp < last_event_timestamp) {
+    event_timestamps_monotonic = false;
+  }
+  last_event_timestamp = timestamp;
+}
+
+ZTEST(mcp_driver_interrupts, test_edge_interrupt_stress) {
+  gpio_demo_interrupt_fake.custom_fake = record_event_timestamp;
+  last_event_timestamp = 0;
+  event_timestamps_monotonic = true;
+
+  struct gpio_callback callback;
+  gpio_init_callback(&callback, gpio_demo_interrupt,
+                     BIT(POWER_IO_SHIELD_INPUT(0)));
+  zassert_equal(gpio_add_callback(power_io_shield, &callback), 0);
+
+  zassert_equal(
+      gpio_pin_interrupt_configure(power_io_shield, POWER_IO_SHIELD_INPUT(0),
+                                   GPIO_INT_EDGE_TO_ACTIVE),
+      0);
+
+  power_io_shield_emul_set_u16_reg(power_io_shield_emul, REG_INTFA,
+                                   0x0100);  // input pin 0
+  power_io_shield_emul_set_u16_reg(power_io_shield_emul, REG_INTCAPA,
+                                   0x0100 ^ 0x3f00);  // input pin 0
+  power_io_shield_emul_reset_transfer_count(power_io_shield_emul);
+
+  const int events = 500;
+  for (int i = 0; i < events; i++) {
+    int64_t before = k_uptime_ticks();
+    zassert_equal(gpio_emul_input_set(gpio0, 0, 1), 0);
+    k_yield();
+    zassert_equal(gpio_emul_input_set(gpio0, 0, 0), 0);
+
+    // the callback sees the time of the edge, not the time it runs
+    zassert_equal(gpio_demo_interrupt_fake.call_count, i + 1);
+    zassert_true(last_event_timestamp >= before);
+    zassert_true(last_event_timestamp <= k_uptime_ticks());
+  }
+
+  zassert_true(event_timestamps_monotonic);
+  // one burst read of INTF and INTCAP per event
+  zassert_equal(power_io_shield_emul_get_transfer_count(power_io_shield_emul),
+                events);
+
+  // reset
+  power_io_shield_emul_set_u16_reg(power_io_shield_emul, REG_INTFA, 0x0000);
+  power_io_shield_emul_set_u16_reg(power_io_shield_emul, REG_INTCAPA, 0x0000);
+
+  zassert_equal(gpio_remove_callback(power_io_shield, &callback), 0);
+  zassert_equal(
+      gpio_pin_interrupt_configure(power_io_shield, POWER_IO_SHIELD_INPUT(0),
+                                   GPIO_INT_DISABLE),
+      0);
+}
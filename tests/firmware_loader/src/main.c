@@ -0,0 +1,263 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (C) Frickly Systems GmbH
+ * SPDX-FileCopyrightText: Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+// Declared by the routines of the firmware loader
+LOG_MODULE_REGISTER(firmware_loader, CONFIG_APP_LOG_LEVEL);
+
+#include <string.h>
+
+#include <zephyr/drivers/flash.h>
+#include <zephyr/kernel.h>
+#include <zephyr/storage/flash_map.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/ztest.h>
+
+#include <ardep/uds.h>
+#include <iso14229.h>
+
+#define ERASE_ROUTINE_ID 0xFF00
+#define SLOT0_OFFSET FIXED_PARTITION_OFFSET(slot0_partition)
+#define SLOT0_SIZE FIXED_PARTITION_SIZE(slot0_partition)
+
+static const struct device *const flash_controller =
+    DEVICE_DT_GET(DT_CHOSEN(zephyr_flash_controller));
+
+static uint8_t status_record[16];
+static uint16_t status_record_len;
+
+static uint8_t copy_status_record(UDSServer_t *server,
+                                  const void *data,
+                                  uint16_t len) {
+  zassert_true(len <= sizeof(status_record));
+  memcpy(status_record, data, len);
+  status_record_len = len;
+
+  return 0;
+}
+
+static UDSErr_t routine_control(uint8_t ctrl_type,
+                                const uint8_t *option_record,
+                                uint16_t len) {
+  UDSRoutineCtrlArgs_t args = {
+    .id = ERASE_ROUTINE_ID,
+    .ctrlType = ctrl_type,
+    .optionRecord = option_record,
+    .len = len,
+    .copyStatusRecord = copy_status_record,
+  };
+
+  status_record_len = 0;
+
+  return uds_default_instance.iso14229.event_callback(
+      &uds_default_instance.iso14229, UDS_EVT_RoutineCtrl, &args,
+      &uds_default_instance);
+}
+
+struct erase_status {
+  int32_t result;
+  uint32_t erased_bytes;
+  uint32_t total_bytes;
+};
+
+static struct erase_status request_erase_results(void) {
+  zassert_equal(
+      routine_control(UDS_ROUTINE_CONTROL__REQUEST_ROUTINE_RESULTS, NULL, 0),
+      UDS_PositiveResponse);
+  zassert_equal(status_record_len, 12);
+
+  return (struct erase_status){
+    .result = sys_get_be32(&status_record[0]),
+    .erased_bytes = sys_get_be32(&status_record[4]),
+    .total_bytes = sys_get_be32(&status_record[8]),
+  };
+}
+
+// Polls the results until the erase is done, checking the progress on the way
+static struct erase_status wait_for_erase(void) {
+  uint32_t erased_bytes = 0;
+
+  for (int i = 0; i < 1000; i++) {
+    struct erase_status status = request_erase_results();
+
+    zassert_true(status.erased_bytes >= erased_bytes);
+    zassert_true(status.erased_bytes <= status.total_bytes);
+    erased_bytes = status.erased_bytes;
+
+    if (status.result != UDS_NRC_RequestCorrectlyReceived_ResponsePending) {
+      return status;
+    }
+
+    k_sleep(K_MSEC(1));
+  }
+
+  ztest_test_fail();
+  return (struct erase_status){0};
+}
+
+static struct flash_pages_info get_slot0_sector(size_t index) {
+  struct flash_pages_info first;
+  zassert_ok(
+      flash_get_page_info_by_offs(flash_controller, SLOT0_OFFSET, &first));
+
+  struct flash_pages_info sector;
+  zassert_ok(flash_get_page_info_by_offs(
+      flash_controller, first.start_offset + index * first.size, &sector));
+
+  return sector;
+}
+
+static bool sector_is_erased(struct flash_pages_info sector) {
+  uint8_t buf[64];
+
+  for (size_t offset = 0; offset < sector.size; offset += sizeof(buf)) {
+    size_t len = MIN(sizeof(buf), sector.size - offset);
+    zassert_ok(flash_read(flash_controller, sector.start_offset + offset, buf,
+                          len));
+
+    for (size_t i = 0; i < len; i++) {
+      if (buf[i] != 0xFF) {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+// Programs the first sectors of slot0, so erased sectors can be told apart
+static void program_slot0_sectors(size_t count) {
+  static const uint8_t pattern[64] = {[0 ... 63] = 0xA5};
+
+  for (size_t i = 0; i < count; i++) {
+    const struct flash_pages_info sector = get_slot0_sector(i);
+
+    zassert_ok(flash_erase(flash_controller, sector.start_offset, sector.size));
+    for (size_t offset = 0; offset < sector.size; offset += sizeof(pattern)) {
+      zassert_ok(flash_write(flash_controller, sector.start_offset + offset,
+                             pattern, sizeof(pattern)));
+    }
+  }
+}
+
+ZTEST(firmware_loader_erase, test_erase_range_of_option_record) {
+  const struct flash_pages_info sector0 = get_slot0_sector(0);
+  const struct flash_pages_info sector1 = get_slot0_sector(1);
+  const struct flash_pages_info sector2 = get_slot0_sector(2);
+
+  program_slot0_sectors(3);
+
+  // two bytes within sector 1, 32 bit address and size
+  uint8_t option_record[9] = {0x44};
+  sys_put_be32(sector1.start_offset + 1, &option_record[1]);
+  sys_put_be32(2, &option_record[5]);
+
+  zassert_equal(routine_control(UDS_ROUTINE_CONTROL__START_ROUTINE,
+                                option_record, sizeof(option_record)),
+                UDS_PositiveResponse);
+
+  const struct erase_status status = wait_for_erase();
+  zassert_equal(status.result, UDS_OK);
+  zassert_equal(status.erased_bytes, sector1.size);
+  zassert_equal(status.total_bytes, sector1.size);
+
+  zassert_false(sector_is_erased(sector0));
+  zassert_true(sector_is_erased(sector1));
+  zassert_false(sector_is_erased(sector2));
+}
+
+ZTEST(firmware_loader_erase, test_erase_short_address_and_size) {
+  const struct flash_pages_info sector0 = get_slot0_sector(0);
+  const struct flash_pages_info sector1 = get_slot0_sector(1);
+
+  program_slot0_sectors(2);
+
+  // 24 bit address, 16 bit size covering the end of sector 0
+  uint8_t option_record[6] = {0x23};
+  sys_put_be24(sector0.start_offset + sector0.size - 16, &option_record[1]);
+  sys_put_be16(16, &option_record[4]);
+
+  zassert_equal(routine_control(UDS_ROUTINE_CONTROL__START_ROUTINE,
+                                option_record, sizeof(option_record)),
+                UDS_PositiveResponse);
+
+  const struct erase_status status = wait_for_erase();
+  zassert_equal(status.result, UDS_OK);
+  zassert_equal(status.total_bytes, sector0.size);
+
+  zassert_true(sector_is_erased(sector0));
+  zassert_false(sector_is_erased(sector1));
+}
+
+ZTEST(firmware_loader_erase, test_erase_whole_slot0) {
+  program_slot0_sectors(1);
+
+  zassert_equal(routine_control(UDS_ROUTINE_CONTROL__START_ROUTINE, NULL, 0),
+                UDS_PositiveResponse);
+
+  // the results are available while the erase is running
+  const struct erase_status running = request_erase_results();
+  zassert_equal(running.result,
+                UDS_NRC_RequestCorrectlyReceived_ResponsePending);
+  zassert_equal(running.total_bytes, SLOT0_SIZE);
+
+  const struct erase_status status = wait_for_erase();
+  zassert_equal(status.result, UDS_OK);
+  zassert_equal(status.erased_bytes, SLOT0_SIZE);
+  zassert_equal(status.total_bytes, SLOT0_SIZE);
+
+  zassert_true(sector_is_erased(get_slot0_sector(0)));
+}
+
+ZTEST(firmware_loader_erase, test_erase_rejects_invalid_option_record) {
+  // size of address and size do not match the length of the record
+  uint8_t option_record[9] = {0x44};
+  zassert_equal(routine_control(UDS_ROUTINE_CONTROL__START_ROUTINE,
+                                option_record, sizeof(option_record) - 1),
+                UDS_NRC_IncorrectMessageLengthOrInvalidFormat);
+
+  // no address bytes
+  option_record[0] = 0x40;
+  zassert_equal(routine_control(UDS_ROUTINE_CONTROL__START_ROUTINE,
+                                option_record, 5),
+                UDS_NRC_IncorrectMessageLengthOrInvalidFormat);
+
+  // address bytes exceeding 32 bit
+  option_record[0] = 0x15;
+  zassert_equal(routine_control(UDS_ROUTINE_CONTROL__START_ROUTINE,
+                                option_record, 7),
+                UDS_NRC_IncorrectMessageLengthOrInvalidFormat);
+
+  // empty range
+  option_record[0] = 0x44;
+  sys_put_be32(SLOT0_OFFSET, &option_record[1]);
+  sys_put_be32(0, &option_record[5]);
+  zassert_equal(routine_control(UDS_ROUTINE_CONTROL__START_ROUTINE,
+                                option_record, sizeof(option_record)),
+                UDS_NRC_RequestOutOfRange);
+
+  // in front of slot0
+  sys_put_be32(SLOT0_OFFSET - 1, &option_record[1]);
+  sys_put_be32(2, &option_record[5]);
+  zassert_equal(routine_control(UDS_ROUTINE_CONTROL__START_ROUTINE,
+                                option_record, sizeof(option_record)),
+                UDS_NRC_RequestOutOfRange);
+
+  // beyond the end of slot0
+  sys_put_be32(SLOT0_OFFSET + SLOT0_SIZE - 1, &option_record[1]);
+  sys_put_be32(2, &option_record[5]);
+  zassert_equal(routine_control(UDS_ROUTINE_CONTROL__START_ROUTINE,
+                                option_record, sizeof(option_record)),
+                UDS_NRC_RequestOutOfRange);
+}
+
+ZTEST(firmware_loader_erase, test_erase_stop_not_supported) {
+  zassert_equal(routine_control(UDS_ROUTINE_CONTROL__STOP_ROUTINE, NULL, 0),
+                UDS_NRC_SubFunctionNotSupported);
+}
+
+ZTEST_SUITE(firmware_loader_erase, NULL, NULL, NULL, NULL, NULL);
@@ -0,0 +1,282 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (C) Frickly Systems GmbH
+ * SPDX-FileCopyrightText: Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+
+#include <zephyr/drivers/adc.h>
+#include <zephyr/drivers/adc/adc_emul.h>
+#include <zephyr/drivers/can.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/ztest.h>
+
+#include <ardep/adc_stream.h>
+
+#define CHANNEL_COUNT 4
+#define BLOCK_SCANS 50
+#define BLOCK_COUNT 4
+// Each channel is a ramp starting at its channel offset
+#define CHANNEL_OFFSET 1000
+#define RAMP_LENGTH 1000
+
+#define PUBLISH_CAN_ID 0x321
+
+static const struct adc_dt_spec channels[CHANNEL_COUNT] = {
+  ADC_DT_SPEC_GET_BY_IDX(DT_PATH(zephyr_user), 0),
+  ADC_DT_SPEC_GET_BY_IDX(DT_PATH(zephyr_user), 1),
+  ADC_DT_SPEC_GET_BY_IDX(DT_PATH(zephyr_user), 2),
+  ADC_DT_SPEC_GET_BY_IDX(DT_PATH(zephyr_user), 3),
+};
+
+static const struct device *const adc_dev = DEVICE_DT_GET(DT_NODELABEL(adc0));
+static const struct device *const can_dev =
+    DEVICE_DT_GET(DT_CHOSEN(zephyr_canbus));
+
+ADC_STREAM_DEFINE(stream, CHANNEL_COUNT, BLOCK_SCANS, BLOCK_COUNT);
+
+// Holds all frames of a block
+CAN_MSGQ_DEFINE(can_msgq, 64);
+
+static uint32_t ramp[CHANNEL_COUNT];
+
+static int ramp_value(const struct device *dev,
+                      unsigned int chan,
+                      void *data,
+                      uint32_t *result) {
+  *result = chan * CHANNEL_OFFSET + ramp[chan];
+  ramp[chan] = (ramp[chan] + 1) % RAMP_LENGTH;
+  return 0;
+}
+
+static struct adc_stream_config config(enum adc_stream_filter filter,
+                                       uint16_t decimation,
+                                       uint8_t cic_order) {
+  return (struct adc_stream_config){
+    .channels = channels,
+    .channel_count = CHANNEL_COUNT,
+    // 2500 scans of 4 channels per second are 10 kS/s
+    .interval_us = 400,
+    .filter = filter,
+    .decimation = decimation,
+    .cic_order = cic_order,
+  };
+}
+
+static void *adc_stream_setup(void) {
+  zassert_true(device_is_ready(adc_dev));
+  zassert_true(device_is_ready(can_dev));
+
+  zassert_ok(can_set_mode(can_dev, CAN_MODE_LOOPBACK));
+  zassert_ok(can_start(can_dev));
+
+  struct can_filter filter = {
+    .id = PUBLISH_CAN_ID,
+    .mask = CAN_STD_ID_MASK,
+  };
+  zassert_true(can_add_rx_filter_msgq(can_dev, &can_msgq, &filter) >= 0);
+
+  return NULL;
+}
+
+static void adc_stream_before(void *fixture) {
+  for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++) {
+    ramp[ch] = 0;
+    zassert_ok(adc_emul_value_func_set(adc_dev, ch, ramp_value, NULL));
+  }
+  k_msgq_purge(&can_msgq);
+}
+
+static void adc_stream_after(void *fixture) {
+  adc_stream_stop(&stream);
+}
+
+ZTEST_SUITE(adc_stream,
+            NULL,
+            adc_stream_setup,
+            adc_stream_before,
+            adc_stream_after,
+            NULL);
+
+ZTEST(adc_stream, test_streams_10_ksps_without_gaps) {
+  struct adc_stream_config cfg = config(ADC_STREAM_FILTER_NONE, 1, 0);
+  zassert_ok(adc_stream_start(&stream, &cfg));
+
+  uint32_t samples = 0;
+  uint32_t sequence = 0;
+  int64_t end = k_uptime_get() + MSEC_PER_SEC;
+
+  while (k_uptime_get() < end) {
+    struct adc_stream_block block;
+    zassert_ok(adc_stream_get_block(&stream, &block, K_MSEC(100)));
+    zassert_equal(block.sequence, sequence++);
+    zassert_equal(block.channels, CHANNEL_COUNT);
+    zassert_equal(block.scans, BLOCK_SCANS);
+
+    for (uint16_t scan = 0; scan < block.scans; scan++) {
+      uint32_t expected = (samples / CHANNEL_COUNT) % RAMP_LENGTH;
+      for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++) {
+        zassert_equal(block.data[scan * CHANNEL_COUNT + ch],
+                      ch * CHANNEL_OFFSET + expected);
+      }
+      samples += CHANNEL_COUNT;
+    }
+
+    zassert_ok(adc_stream_release_block(&stream, &block));
+  }
+
+  zassert_ok(adc_stream_stop(&stream));
+
+  struct adc_stream_stats stats;
+  adc_stream_get_stats(&stream, &stats);
+  zassert_equal(stats.dropped_blocks, 0);
+  zassert_within(samples, 10000, 2 * BLOCK_SCANS * CHANNEL_COUNT);
+}
+
+ZTEST(adc_stream, test_counts_dropped_blocks) {
+  struct adc_stream_config cfg = config(ADC_STREAM_FILTER_NONE, 1, 0);
+  zassert_ok(adc_stream_start(&stream, &cfg));
+
+  // The consumer stalls for 10 blocks
+  k_msleep(10 * BLOCK_SCANS * cfg.interval_us / USEC_PER_MSEC);
+  zassert_ok(adc_stream_stop(&stream));
+
+  uint32_t received = 0;
+  uint32_t last_sequence = 0;
+  struct adc_stream_block block;
+  while (adc_stream_get_block(&stream, &block, K_NO_WAIT) == 0) {
+    if (received > 0) {
+      zassert_true(block.sequence > last_sequence);
+    }
+    last_sequence = block.sequence;
+    received++;
+    zassert_ok(adc_stream_release_block(&stream, &block));
+  }
+
+  struct adc_stream_stats stats;
+  adc_stream_get_stats(&stream, &stats);
+  zassert_equal(received, BLOCK_COUNT - 1);
+  zassert_true(stats.dropped_blocks > 0);
+  zassert_equal(received + stats.dropped_blocks, stats.blocks);
+}
+
+ZTEST(adc_stream, test_blocks_are_released_in_order) {
+  struct adc_stream_config cfg = config(ADC_STREAM_FILTER_NONE, 1, 0);
+  zassert_ok(adc_stream_start(&stream, &cfg));
+
+  struct adc_stream_block first;
+  struct adc_stream_block second;
+  zassert_ok(adc_stream_get_block(&stream, &first, K_MSEC(100)));
+  zassert_ok(adc_stream_get_block(&stream, &second, K_MSEC(100)));
+  zassert_not_equal(first.data, second.data);
+
+  zassert_equal(adc_stream_release_block(&stream, &second), -EINVAL);
+  zassert_ok(adc_stream_release_block(&stream, &first));
+  zassert_ok(adc_stream_release_block(&stream, &second));
+}
+
+ZTEST(adc_stream, test_moving_average) {
+  struct adc_stream_config cfg =
+      config(ADC_STREAM_FILTER_MOVING_AVERAGE, 4, 0);
+  zassert_ok(adc_stream_start(&stream, &cfg));
+
+  struct adc_stream_block block;
+  zassert_ok(adc_stream_get_block(&stream, &block, K_MSEC(200)));
+
+  // The average of 4 ramp samples is truncated
+  for (uint16_t scan = 0; scan < block.scans; scan++) {
+    for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++) {
+      zassert_equal(block.data[scan * CHANNEL_COUNT + ch],
+                    ch * CHANNEL_OFFSET + 4 * scan + 1);
+    }
+  }
+
+  zassert_ok(adc_stream_release_block(&stream, &block));
+}
+
+ZTEST(adc_stream, test_cic_filter_settles) {
+  const uint8_t order = 3;
+
+  for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++) {
+    zassert_ok(adc_emul_const_value_set(adc_dev, ch, 1234 + ch));
+  }
+
+  struct adc_stream_config cfg = config(ADC_STREAM_FILTER_CIC, 8, order);
+  zassert_ok(adc_stream_start(&stream, &cfg));
+
+  struct adc_stream_block block;
+  zassert_ok(adc_stream_get_block(&stream, &block, K_MSEC(500)));
+
+  for (uint16_t scan = order; scan < block.scans; scan++) {
+    for (uint8_t ch = 0; ch < CHANNEL_COUNT; ch++) {
+      zassert_equal(block.data[scan * CHANNEL_COUNT + ch], 1234 + ch);
+    }
+  }
+
+  zassert_ok(adc_stream_release_block(&stream, &block));
+}
+
+ZTEST(adc_stream, test_rejects_invalid_configs) {
+  struct adc_stream_config cfg = config(ADC_STREAM_FILTER_NONE, 2, 0);
+  zassert_equal(adc_stream_start(&stream, &cfg), -EINVAL);
+
+  cfg = config(ADC_STREAM_FILTER_CIC, 8, 0);
+  zassert_equal(adc_stream_start(&stream, &cfg), -EINVAL);
+
+  cfg = config(ADC_STREAM_FILTER_MOVING_AVERAGE, 0, 0);
+  zassert_equal(adc_stream_start(&stream, &cfg), -EINVAL);
+
+  // 12 bit + 3 * 8 bit do not fit into the integrators
+  cfg = config(ADC_STREAM_FILTER_CIC, 256, 3);
+  zassert_equal(adc_stream_start(&stream, &cfg), -EINVAL);
+
+  cfg = config(ADC_STREAM_FILTER_NONE, 1, 0);
+  cfg.channel_count = 0;
+  zassert_equal(adc_stream_start(&stream, &cfg), -EINVAL);
+
+  const struct adc_dt_spec duplicate[] = {channels[0], channels[0]};
+  cfg.channels = duplicate;
+  cfg.channel_count = ARRAY_SIZE(duplicate);
+  zassert_equal(adc_stream_start(&stream, &cfg), -EINVAL);
+
+  zassert_equal(adc_stream_stop(&stream), -EALREADY);
+
+  cfg = config(ADC_STREAM_FILTER_NONE, 1, 0);
+  zassert_ok(adc_stream_start(&stream, &cfg));
+  zassert_equal(adc_stream_start(&stream, &cfg), -EALREADY);
+}
+
+ZTEST(adc_stream, test_publish_can) {
+  struct adc_stream_config cfg = config(ADC_STREAM_FILTER_NONE, 1, 0);
+  zassert_ok(adc_stream_start(&stream, &cfg));
+
+  struct adc_stream_block block;
+  zassert_ok(adc_stream_get_block(&stream, &block, K_MSEC(100)));
+  zassert_ok(
+      adc_stream_publish_can(can_dev, PUBLISH_CAN_ID, &block, K_MSEC(100)));
+
+  struct can_frame frame;
+  zassert_ok(k_msgq_get(&can_msgq, &frame, K_MSEC(100)));
+  zassert_equal(can_dlc_to_bytes(frame.dlc), 7);
+  zassert_equal(sys_get_le32(&frame.data[0]), block.sequence);
+  zassert_equal(sys_get_le16(&frame.data[4]), block.scans);
+  zassert_equal(frame.data[6], block.channels);
+
+  size_t samples = block.scans * block.channels;
+  size_t received = 0;
+  while (received < samples) {
+    zassert_ok(k_msgq_get(&can_msgq, &frame, K_MSEC(100)));
+    uint8_t len = can_dlc_to_bytes(frame.dlc);
+
+    for (uint8_t i = 0; i < len; i += sizeof(uint16_t)) {
+      zassert_equal(sys_get_le16(&frame.data[i]), block.data[received++]);
+    }
+  }
+  zassert_equal(received, samples);
+  zassert_not_ok(k_msgq_get(&can_msgq, &frame, K_NO_WAIT));
+
+  zassert_ok(adc_stream_release_block(&stream, &block));
+}
@@ -0,0 +1,209 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (C) Frickly Systems GmbH
+ * SPDX-FileCopyrightText: Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+
+#include <zephyr/drivers/can.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/ztest.h>
+
+#include <ardep/can_gate.h>
+
+#define APPLICATION_CAN_ID 0x123
+#define NM_CAN_ID 0x512
+#define PROGRAMMING_CAN_ID 0x7E0
+#define PROGRAMMING_FRAMES 256
+
+static const struct device *const can_dev =
+    DEVICE_DT_GET(DT_CHOSEN(zephyr_canbus));
+
+static const struct can_filter nm_filter = {
+  .id = 0x500,
+  .mask = 0x700,
+};
+
+CAN_GATE_DEFINE(gate,
+                DEVICE_DT_GET(DT_CHOSEN(zephyr_canbus)),
+                1,
+                &nm_filter);
+
+static const struct can_frame application_frame = {
+  .id = APPLICATION_CAN_ID,
+  .dlc = 8,
+};
+
+static const struct can_frame nm_frame = {
+  .id = NM_CAN_ID,
+  .dlc = 8,
+};
+
+static const struct can_frame programming_frame = {
+  .id = PROGRAMMING_CAN_ID,
+  .dlc = 8,
+};
+
+static const struct can_filter all_frames = {
+  .id = 0,
+  .mask = 0,
+};
+
+CAN_MSGQ_DEFINE(can_msgq, 16);
+
+// Counts every frame on the bus
+static atomic_t bus_frames;
+
+static void count_bus_frame(const struct device *dev,
+                            struct can_frame *frame,
+                            void *user_data) {
+  atomic_inc(&bus_frames);
+}
+
+static atomic_t gated_frames;
+
+static void count_gated_frame(const struct device *dev,
+                              struct can_frame *frame,
+                              void *user_data) {
+  atomic_inc(&gated_frames);
+}
+
+static void *can_gate_setup(void) {
+  zassert_true(device_is_ready(can_dev));
+
+  zassert_ok(can_set_mode(can_dev, CAN_MODE_LOOPBACK));
+  zassert_ok(can_start(can_dev));
+
+  zassert_true(can_add_rx_filter(can_dev, count_bus_frame, NULL,
+                                 &all_frames) >= 0);
+
+  return NULL;
+}
+
+static void can_gate_before(void *fixture) {
+  can_gate_enable_all();
+  k_msgq_purge(&can_msgq);
+  atomic_clear(&gated_frames);
+}
+
+ZTEST_SUITE(can_gate, NULL, can_gate_setup, can_gate_before, NULL, NULL);
+
+ZTEST(can_gate, test_classify) {
+  zassert_equal(can_gate_classify(&gate, &application_frame),
+                CAN_GATE_CLASS_NORMAL);
+  zassert_equal(can_gate_classify(&gate, &nm_frame),
+                CAN_GATE_CLASS_NETWORK_MANAGEMENT);
+
+  // extended IDs do not match the standard network management filter
+  struct can_frame frame = nm_frame;
+  frame.flags = CAN_FRAME_IDE;
+  zassert_equal(can_gate_classify(&gate, &frame), CAN_GATE_CLASS_NORMAL);
+}
+
+ZTEST(can_gate, test_get) {
+  zassert_equal_ptr(can_gate_get(can_dev), &gate);
+  zassert_is_null(can_gate_get(NULL));
+}
+
+ZTEST(can_gate, test_tx) {
+  int filter_id = can_add_rx_filter_msgq(can_dev, &can_msgq, &all_frames);
+  zassert_true(filter_id >= 0);
+
+  can_gate_set(&gate, CAN_GATE_CLASS_NORMAL, true, false);
+
+  zassert_equal(can_gate_send(&gate, &application_frame, K_FOREVER, NULL, NULL),
+                -ENETDOWN);
+  zassert_ok(can_gate_send(&gate, &nm_frame, K_FOREVER, NULL, NULL));
+
+  struct can_frame frame;
+  zassert_ok(k_msgq_get(&can_msgq, &frame, K_MSEC(100)));
+  zassert_equal(frame.id, NM_CAN_ID);
+  zassert_equal(k_msgq_num_used_get(&can_msgq), 0);
+
+  can_gate_set(&gate, CAN_GATE_CLASS_NORMAL, true, true);
+  zassert_ok(can_gate_send(&gate, &application_frame, K_FOREVER, NULL, NULL));
+  zassert_ok(k_msgq_get(&can_msgq, &frame, K_MSEC(100)));
+  zassert_equal(frame.id, APPLICATION_CAN_ID);
+
+  can_remove_rx_filter(can_dev, filter_id);
+}
+
+ZTEST(can_gate, test_rx) {
+  struct can_gate_rx rx;
+  int filter_id =
+      can_gate_add_rx_filter(&gate, &rx, count_gated_frame, NULL, &all_frames);
+  zassert_true(filter_id >= 0);
+
+  can_gate_set(&gate, CAN_GATE_CLASS_NETWORK_MANAGEMENT, false, true);
+
+  // the frames are received before can_send() returns
+  zassert_ok(can_send(can_dev, &nm_frame, K_FOREVER, NULL, NULL));
+  zassert_equal(atomic_get(&gated_frames), 0);
+  zassert_ok(can_send(can_dev, &application_frame, K_FOREVER, NULL, NULL));
+  zassert_equal(atomic_get(&gated_frames), 1);
+
+  can_gate_set(&gate, CAN_GATE_CLASS_ALL, true, true);
+  zassert_ok(can_send(can_dev, &nm_frame, K_FOREVER, NULL, NULL));
+  zassert_equal(atomic_get(&gated_frames), 2);
+
+  can_remove_rx_filter(can_dev, filter_id);
+}
+
+K_THREAD_STACK_DEFINE(load_stack, 1024);
+static struct k_thread load_thread;
+static atomic_t load_running;
+
+// Application sending as fast as the bus allows
+static void load(void *p1, void *p2, void *p3) {
+  while (atomic_get(&load_running)) {
+    if (can_gate_send(&gate, &application_frame, K_FOREVER, NULL, NULL) != 0) {
+      // suppressed, the application tries again in its next cycle
+      k_sleep(K_MSEC(1));
+    }
+  }
+}
+
+// Sends the frames of a download while the application loads the bus,
+// returns the number of frames on the bus in the meantime
+static uint32_t program_under_load(int64_t *elapsed_ms) {
+  atomic_set(&load_running, 1);
+  k_thread_create(&load_thread, load_stack, K_THREAD_STACK_SIZEOF(load_stack),
+                  load, NULL, NULL, NULL,
+                  k_thread_priority_get(k_current_get()) + 1, 0, K_NO_WAIT);
+
+  const atomic_val_t start_frames = atomic_get(&bus_frames);
+  int64_t start = k_uptime_get();
+
+  for (int i = 0; i < PROGRAMMING_FRAMES; i++) {
+    zassert_ok(can_send(can_dev, &programming_frame, K_FOREVER, NULL, NULL));
+  }
+
+  *elapsed_ms = k_uptime_delta(&start);
+  const uint32_t frames = atomic_get(&bus_frames) - start_frames;
+
+  atomic_clear(&load_running);
+  zassert_ok(k_thread_join(&load_thread, K_FOREVER));
+
+  return frames;
+}
+
+ZTEST(can_gate, test_programming_throughput) {
+  int64_t open_ms;
+  int64_t gated_ms;
+
+  const uint32_t open_frames = program_under_load(&open_ms);
+
+  // disableRxAndTx of normal messages, like a tester before programming
+  can_gate_set(&gate, CAN_GATE_CLASS_NORMAL, false, false);
+  const uint32_t closed_frames = program_under_load(&gated_ms);
+
+  TC_PRINT("%u programming frames: %u frames on the bus in %lld ms without "
+           "the gate, %u frames in %lld ms with the gate\n",
+           PROGRAMMING_FRAMES, open_frames, open_ms, closed_frames, gated_ms);
+
+  zassert_true(open_frames > PROGRAMMING_FRAMES);
+  zassert_equal(closed_frames, PROGRAMMING_FRAMES);
+}
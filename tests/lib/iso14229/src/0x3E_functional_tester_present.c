@@ -0,0 +1,137 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (C) Frickly Systems GmbH
+ * SPDX-FileCopyrightText: Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "fixture.h"
+#include "zephyr/ztest_assert.h"
+
+#include <zephyr/fff.h>
+#include <zephyr/ztest.h>
+
+// Include UDS minimal library headers
+#include <ardep/iso14229.h>
+#include <iso14229.h>
+
+#ifdef CONFIG_ISO14229_FUNCTIONAL_FAST_PATH
+
+static uint8_t suppressed_tester_present[] = {
+  0x02,  // PCI (single frame, 2 bytes of data)
+  0x3E,  // SID (Tester Present)
+  0x80,  // SubFunction (zeroSubFunction, suppressPosRspMsgIndicationBit)
+};
+
+UDSErr_t test_0x3E_functional_tester_present_callback(
+    struct iso14229_zephyr_instance *inst,
+    UDSEvent_t event,
+    void *arg,
+    void *user_context) {
+  if (event == UDS_EVT_DiagSessCtrl) {
+    return UDS_PositiveResponse;
+  } else if (event == UDS_EVT_SessionTimeout) {
+    session_timeout_event_fired = true;
+    return UDS_PositiveResponse;
+  }
+
+  return UDS_NRC_GeneralProgrammingFailure;
+}
+
+static void enter_programming_session(struct lib_iso14229_fixture *fixture) {
+  struct iso14229_zephyr_instance *instance = &fixture->instance;
+
+  test_uds_callback_fake.custom_fake =
+      test_0x3E_functional_tester_present_callback;
+
+  uint8_t request_data[] = {
+    0x02,  // PCI (single frame, 2 bytes of data)
+    0x10,  // SID (DiagnosticSessionControl)
+    0x02,  // DS  (Programming Session)
+  };
+
+  receive_phys_can_frame_array(fixture, request_data);
+  advance_time_and_tick_thread(instance);
+  tick_thread(instance);
+
+  zassert_equal(instance->server.sessionType, 0x02);
+  zassert_equal(fake_can_send_fake.call_count, 1);
+}
+
+ZTEST_F(lib_iso14229, test_0x3E_functional_tester_present_fast_path) {
+  struct iso14229_zephyr_instance *instance = &fixture->instance;
+
+  enter_programming_session(fixture);
+  const int callback_calls = test_uds_callback_fake.call_count;
+
+  receive_func_can_frame_array(fixture, suppressed_tester_present);
+
+  // handled in the RX callback, nothing is queued for ISO-TP
+  zassert_equal(k_msgq_num_used_get(&instance->can_func_msgq), 0);
+  zassert_equal(atomic_get(&instance->tester_present_pending), 1);
+
+  k_msleep(1000);
+  tick_thread(instance);
+
+  zassert_equal(atomic_get(&instance->tester_present_pending), 0);
+  zassert_equal(instance->server.s3_session_timeout_timer,
+                (uint32_t)atomic_get(&instance->tester_present_ms) +
+                    instance->server.s3_ms);
+
+  // no response and no event
+  zassert_equal(fake_can_send_fake.call_count, 1);
+  zassert_equal(test_uds_callback_fake.call_count, callback_calls);
+}
+
+ZTEST_F(lib_iso14229, test_0x3E_functional_tester_present_keeps_session) {
+  struct iso14229_zephyr_instance *instance = &fixture->instance;
+
+  enter_programming_session(fixture);
+
+  // a tester keeps the session alive every 2 s
+  for (size_t i = 0; i < 10; i++) {
+    k_msleep(2000);
+    receive_func_can_frame_array(fixture, suppressed_tester_present);
+    tick_thread(instance);
+  }
+
+  zassert_false(session_timeout_event_fired);
+  zassert_equal(instance->server.sessionType, 0x02);
+  zassert_equal(fake_can_send_fake.call_count, 1);
+}
+
+ZTEST_F(lib_iso14229, test_0x3E_functional_tester_present_during_transfer) {
+  struct iso14229_zephyr_instance *instance = &fixture->instance;
+
+  enter_programming_session(fixture);
+
+  // a TransferData request with the maximum length, its frames fill the
+  // physical queue
+  uint8_t first_frame[] = {0x1F, 0xFF, 0x36, 0x01, 0x00, 0x00, 0x00, 0x00};
+  receive_phys_can_frame_array(fixture, first_frame);
+  for (uint8_t i = 1; k_msgq_num_free_get(&instance->can_phys_msgq) > 0; i++) {
+    uint8_t consecutive_frame[] = {0x20 | (i & 0x0F), 0, 0, 0, 0, 0, 0, 0};
+    receive_phys_can_frame_array(fixture, consecutive_frame);
+  }
+
+  const uint32_t queued = k_msgq_num_used_get(&instance->can_phys_msgq);
+  receive_func_can_frame_array(fixture, suppressed_tester_present);
+
+  // handled ahead of the queued transfer, before any of its frames
+  zassert_equal(atomic_get(&instance->tester_present_pending), 1);
+  zassert_equal(k_msgq_num_used_get(&instance->can_phys_msgq), queued);
+  zassert_equal(k_msgq_num_used_get(&instance->can_func_msgq), 0);
+
+  // other functional requests still pass ISO-TP and the server
+  uint8_t tester_present[] = {0x02, 0x3E, 0x00};
+  receive_func_can_frame_array(fixture, tester_present);
+  zassert_equal(k_msgq_num_used_get(&instance->can_func_msgq), 1);
+
+  tick_thread(instance);
+
+  zassert_equal(atomic_get(&instance->tester_present_pending), 0);
+  zassert_equal(k_msgq_num_used_get(&instance->can_func_msgq), 0);
+  zassert_equal(k_msgq_num_used_get(&instance->can_phys_msgq), 0);
+}
+
+#endif  // CONFIG_ISO14229_FUNCTIONAL_FAST_PATH
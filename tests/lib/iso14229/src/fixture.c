@@ -78,6 +78,21 @@ void receive_phys_can_frame(const struct lib_iso14229_fixture *fixture,
   captured_rx_callback_phys(dev, &frame, captured_user_data_phy);
 }
 
+void receive_func_can_frame(const struct lib_iso14229_fixture *fixture,
+                            uint8_t *data,
+                            uint8_t data_len) {
+  const struct device *dev = fixture->can_dev;
+
+  struct can_frame frame = {
+    .id = fixture->cfg.source_addr_func,  // 0x7DF - message to all servers
+    .dlc = data_len,                      // data_len == dlc for Can CC
+    .flags = 0,
+  };
+  memcpy(frame.data, data, data_len);
+
+  captured_rx_callback_func(dev, &frame, captured_user_data_func);
+}
+
 void assert_send_phy_can_frame(const struct lib_iso14229_fixture *fixture,
                                uint32_t frame_index,
                                uint8_t *data,
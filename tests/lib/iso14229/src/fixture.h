@@ -79,6 +79,25 @@ void receive_phys_can_frame(const struct lib_iso14229_fixture *fixture,
 #define receive_phys_can_frame_array(fixture, data_array) \
   receive_phys_can_frame(fixture, data_array, ARRAY_SIZE(data_array))
 
+/**
+ *  Fake the reception of a functional CAN Frame
+ *
+ * @param fixture The fixture containing the configuration and device
+ * @param data The whole CAN frame data
+ * @param data_len  The length of the CAN frame data (== dlc)
+ */
+void receive_func_can_frame(const struct lib_iso14229_fixture *fixture,
+                            uint8_t *data,
+                            uint8_t data_len);
+
+/**
+ * Fake the reception of a functional CAN Frame from an Array of bytes
+ *
+ * The array holds the full CAN Frame received. Array-length == dlc
+ */
+#define receive_func_can_frame_array(fixture, data_array) \
+  receive_func_can_frame(fixture, data_array, ARRAY_SIZE(data_array))
+
 /**
  * Assert that a CAN Frame was send to the physical target address
  *
@@ -18,6 +18,10 @@
 #include <zephyr/storage/flash_map.h>
 #include <zephyr/ztest.h>
 
+#ifdef CONFIG_STATS
+#include <zephyr/stats/stats.h>
+#endif
+
 #include <errno.h>
 
 DEFINE_FFF_GLOBALS;
@@ -186,6 +190,11 @@ UDS_REGISTER_AUTHENTICATION_HANDLER(&fixture_uds_instance,
 
 UDS_REGISTER_DYNAMICALLY_DEFINE_DATA_IDS_DEFAULT_HANDLER(&fixture_uds_instance)
 
+#ifdef CONFIG_UDS_DOWNLOAD_DIGEST
+UDS_REGISTER_CHECK_PROGRAMMING_DEPENDENCIES_DEFAULT_HANDLER(
+    &fixture_uds_instance)
+#endif
+
 static const UDSISOTpCConfig_t default_cfg = {
   // Hardware Addresses
   .source_addr = 0x7E8,  // Can ID Server (us)
@@ -232,6 +241,37 @@ void assert_auth_state(uint8_t expected_state) {
   zassert_equal(expected_state, auth_state_data);
 }
 
+#ifdef CONFIG_STATS
+struct stat_lookup {
+  const char *name;
+  uint32_t *value;
+};
+
+static int find_stat_entry(struct stats_hdr *hdr,
+                           void *arg,
+                           const char *name,
+                           uint16_t off) {
+  struct stat_lookup *lookup = arg;
+
+  if (strcmp(name, lookup->name) == 0) {
+    lookup->value = (uint32_t *)((uint8_t *)hdr + off);
+  }
+
+  return 0;
+}
+
+uint32_t *find_stat(const char *group, const char *name) {
+  struct stat_lookup lookup = {.name = name};
+  struct stats_hdr *hdr = stats_group_find(group);
+
+  zassert_not_null(hdr);
+  stats_walk(hdr, find_stat_entry, &lookup);
+  zassert_not_null(lookup.value);
+
+  return lookup.value;
+}
+#endif  // CONFIG_STATS
+
 static uint8_t custom_set_auth_state(UDSServer_t *server, uint8_t state) {
   auth_state_data = state;
   return UDS_OK;
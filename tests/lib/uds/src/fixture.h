@@ -80,4 +80,11 @@ void assert_copy_data_offset(const uint8_t *data,
  */
 void assert_auth_state(uint8_t expected_state);
 
+#ifdef CONFIG_STATS
+/**
+ * @brief Find a 32 bit statistic of a registered stats group
+ */
+uint32_t *find_stat(const char *group, const char *name);
+#endif  // CONFIG_STATS
+
 #endif  // APP_TESTS_LIB_ISO14229_SRC_FIXTURE_H_
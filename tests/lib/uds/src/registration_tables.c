@@ -0,0 +1,128 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (C) Frickly Systems GmbH
+ * SPDX-FileCopyrightText: Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "fixture.h"
+
+#include <string.h>
+
+#include <zephyr/ztest.h>
+
+ZTEST_F(lib_uds, test_static_registrations_are_grouped_by_type) {
+  bool seen[UDS_REGISTRATION_TYPE__AUTHENTICATION + 1] = {0};
+  int last_type = -1;
+
+  // every type forms a single run in the iterable section
+  STRUCT_SECTION_FOREACH (uds_registration_t, reg) {
+    if ((int)reg->type == last_type) {
+      continue;
+    }
+
+    zassert_true(reg->type < ARRAY_SIZE(seen));
+    zassert_false(seen[reg->type], "registrations of type %d are split",
+                  reg->type);
+    seen[reg->type] = true;
+    last_type = reg->type;
+  }
+
+  zassert_true(seen[UDS_REGISTRATION_TYPE__DATA_IDENTIFIER]);
+  zassert_true(seen[UDS_REGISTRATION_TYPE__ROUTINE_CONTROL]);
+}
+
+#ifdef CONFIG_UDS_REGISTRATION_INDEX
+
+#define INDEXED_ROUTINE_LOW 0x7A01
+#define INDEXED_ROUTINE_MID 0x7A02
+#define INDEXED_ROUTINE_HIGH 0x7A03
+
+extern struct uds_instance_t fixture_uds_instance;
+
+static int indexed_routine_calls[3];
+static int indexed_routine_chained_calls;
+
+static UDSErr_t indexed_routine_check(const struct uds_context *const context,
+                                      bool *apply_action) {
+  *apply_action = true;
+  return UDS_OK;
+}
+
+static UDSErr_t indexed_routine_act(struct uds_context *const context,
+                                    bool *consume_event) {
+  UDSRoutineCtrlArgs_t *args = context->arg;
+
+  indexed_routine_calls[args->id - INDEXED_ROUTINE_LOW]++;
+  // both handlers of the low routine must run, whatever their link order
+  *consume_event = args->id != INDEXED_ROUTINE_LOW;
+  return UDS_OK;
+}
+
+static UDSErr_t indexed_routine_chained_act(struct uds_context *const context,
+                                            bool *consume_event) {
+  indexed_routine_chained_calls++;
+  *consume_event = false;
+  return UDS_OK;
+}
+
+// Registered out of order, the low routine has two chained handlers
+UDS_REGISTER_ROUTINE_CONTROL_HANDLER(&fixture_uds_instance,
+                                     INDEXED_ROUTINE_HIGH,
+                                     indexed_routine_check,
+                                     indexed_routine_act,
+                                     NULL)
+
+UDS_REGISTER_ROUTINE_CONTROL_HANDLER(&fixture_uds_instance,
+                                     INDEXED_ROUTINE_LOW,
+                                     indexed_routine_check,
+                                     indexed_routine_chained_act,
+                                     NULL)
+
+UDS_REGISTER_ROUTINE_CONTROL_HANDLER(&fixture_uds_instance,
+                                     INDEXED_ROUTINE_MID,
+                                     indexed_routine_check,
+                                     indexed_routine_act,
+                                     NULL)
+
+UDS_REGISTER_ROUTINE_CONTROL_HANDLER(&fixture_uds_instance,
+                                     INDEXED_ROUTINE_LOW,
+                                     indexed_routine_check,
+                                     indexed_routine_act,
+                                     NULL)
+
+static UDSErr_t start_indexed_routine(struct uds_instance_t *instance,
+                                      uint16_t id) {
+  UDSRoutineCtrlArgs_t args = {
+    .ctrlType = UDS_ROUTINE_CONTROL__START_ROUTINE,
+    .id = id,
+  };
+
+  return receive_event(instance, UDS_EVT_RoutineCtrl, &args);
+}
+
+ZTEST_F(lib_uds, test_static_registrations_are_found_by_identifier) {
+  struct uds_instance_t *instance = fixture->instance;
+
+  memset(indexed_routine_calls, 0, sizeof(indexed_routine_calls));
+  indexed_routine_chained_calls = 0;
+
+  zassert_ok(start_indexed_routine(instance, INDEXED_ROUTINE_HIGH));
+  zassert_ok(start_indexed_routine(instance, INDEXED_ROUTINE_MID));
+  zassert_ok(start_indexed_routine(instance, INDEXED_ROUTINE_LOW));
+
+  zassert_equal(indexed_routine_calls[0], 1);
+  zassert_equal(indexed_routine_calls[1], 1);
+  zassert_equal(indexed_routine_calls[2], 1);
+
+  // registrations with the same identifier are all visited
+  zassert_equal(indexed_routine_chained_calls, 1);
+
+  // identifiers between and next to the registered ones
+  zassert_equal(start_indexed_routine(instance, INDEXED_ROUTINE_LOW - 1),
+                UDS_NRC_SubFunctionNotSupported);
+  zassert_equal(start_indexed_routine(instance, INDEXED_ROUTINE_HIGH + 1),
+                UDS_NRC_SubFunctionNotSupported);
+}
+
+#endif  // CONFIG_UDS_REGISTRATION_INDEX
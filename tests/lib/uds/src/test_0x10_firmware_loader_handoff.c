@@ -0,0 +1,174 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (C) Frickly Systems GmbH
+ * SPDX-FileCopyrightText: Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "ardep/uds.h"
+#include "fixture.h"
+#include "iso14229.h"
+
+#include <string.h>
+
+#include <zephyr/drivers/can/can_fake.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/ztest.h>
+
+static struct uds_firmware_loader_handoff captured_handoff;
+static uint32_t request_cycles;
+
+static struct can_frame sent_frame;
+static uint32_t sent_cycles;
+
+static UDSErr_t capture_handoff_check(const struct uds_context *const context,
+                                      bool *apply_action) {
+  *apply_action = context->event == UDS_EVT_DiagSessCtrl;
+  return UDS_OK;
+}
+
+static UDSErr_t capture_handoff_action(struct uds_context *const context,
+                                       bool *consume_event) {
+  *consume_event = true;
+  zassert_ok(uds_firmware_loader_handoff_capture(context, &captured_handoff));
+  return UDS_OK;
+}
+
+static int capture_can_send(const struct device *dev,
+                            const struct can_frame *frame,
+                            k_timeout_t timeout,
+                            can_tx_callback_t callback,
+                            void *user_data) {
+  sent_cycles = k_cycle_get_32();
+  sent_frame = *frame;
+  return 0;
+}
+
+static void request_programming_session(struct uds_instance_t *instance) {
+  UDSDiagSessCtrlArgs_t args = {
+    .type = UDS_DIAG_SESSION__PROGRAMMING,
+    .p2_ms = 0x100,
+    .p2_star_ms = 0x200,
+  };
+
+  data_id_check_fn_fake.custom_fake = capture_handoff_check;
+  data_id_action_fn_fake.custom_fake = capture_handoff_action;
+
+  request_cycles = k_cycle_get_32();
+  zassert_ok(receive_event(instance, UDS_EVT_DiagSessCtrl, &args));
+}
+
+static void before_resume(struct lib_uds_fixture *fixture) {
+  RESET_FAKE(fake_can_send);
+  fake_can_send_fake.custom_fake = capture_can_send;
+  memset(&sent_frame, 0, sizeof(sent_frame));
+
+  // state of the freshly started firmware loader
+  zassert_ok(
+      uds_init(fixture->instance, &fixture->cfg, fixture->can_dev, fixture));
+}
+
+ZTEST_F(lib_uds, test_0x10_firmware_loader_handoff_capture) {
+  struct uds_instance_t *instance = fixture->instance;
+
+  request_programming_session(instance);
+
+  zassert_equal(captured_handoff.session_type, UDS_DIAG_SESSION__PROGRAMMING);
+  zassert_equal(captured_handoff.p2_ms, 0x100);
+  zassert_equal(captured_handoff.p2_star_ms, 0x200);
+  zassert_equal(captured_handoff.tester_address, fixture->cfg.target_addr);
+  zassert_equal(captured_handoff.flags,
+                UDS_FIRMWARE_LOADER_HANDOFF_RESPONSE_PENDING);
+}
+
+ZTEST_F(lib_uds, test_0x10_firmware_loader_handoff_capture_suppressed) {
+  struct uds_instance_t *instance = fixture->instance;
+
+  // suppressPosRspMsgIndicationBit set in the request
+  instance->iso14229.server.r.recv_buf[0] = 0x10;
+  instance->iso14229.server.r.recv_buf[1] = 0x82;
+  request_programming_session(instance);
+
+  zassert_equal(captured_handoff.flags, 0);
+}
+
+ZTEST_F(lib_uds, test_0x10_firmware_loader_handoff_resume) {
+  struct uds_instance_t *instance = fixture->instance;
+
+  instance->iso14229.server.securityLevel = 1;
+  request_programming_session(instance);
+
+  before_resume(fixture);
+  zassert_ok(uds_firmware_loader_handoff_resume(instance, &captured_handoff));
+
+  zassert_equal(instance->iso14229.server.sessionType,
+                UDS_DIAG_SESSION__PROGRAMMING);
+  // security access is unlocked again in the new session
+  zassert_equal(instance->iso14229.server.securityLevel, 0);
+
+  // the single frame is padded to 8 bytes
+  const uint8_t response[] = {0x06, 0x50, 0x02, 0x01, 0x00, 0x00, 0x33, 0xAA};
+  zassert_equal(fake_can_send_fake.call_count, 1);
+  zassert_equal(sent_frame.id, fixture->cfg.target_addr);
+  zassert_equal(sent_frame.dlc, sizeof(response));
+  zassert_mem_equal(sent_frame.data, response, sizeof(response));
+}
+
+ZTEST_F(lib_uds, test_0x10_firmware_loader_handoff_resume_without_response) {
+  struct uds_instance_t *instance = fixture->instance;
+
+  const struct uds_firmware_loader_handoff handoff = {
+    .session_type = UDS_DIAG_SESSION__EXTENDED,
+  };
+
+  before_resume(fixture);
+  zassert_ok(uds_firmware_loader_handoff_resume(instance, &handoff));
+
+  zassert_equal(instance->iso14229.server.sessionType,
+                UDS_DIAG_SESSION__EXTENDED);
+  zassert_equal(fake_can_send_fake.call_count, 0);
+}
+
+ZTEST_F(lib_uds, test_0x10_firmware_loader_handoff_legacy_defaults) {
+  struct uds_instance_t *instance = fixture->instance;
+
+  // as written by uds_switch_to_firmware_loader_with_programming_session()
+  const struct uds_firmware_loader_handoff handoff = {
+    .session_type = UDS_DIAG_SESSION__PROGRAMMING,
+    .flags = UDS_FIRMWARE_LOADER_HANDOFF_RESPONSE_PENDING,
+  };
+
+  before_resume(fixture);
+  const uint16_t p2_ms = instance->iso14229.server.p2_ms;
+  zassert_ok(uds_firmware_loader_handoff_resume(instance, &handoff));
+
+  zassert_equal(fake_can_send_fake.call_count, 1);
+  zassert_equal(sent_frame.id, fixture->cfg.target_addr);
+  zassert_equal(sent_frame.data[2], UDS_DIAG_SESSION__PROGRAMMING);
+  zassert_equal(sys_get_be16(&sent_frame.data[3]), p2_ms);
+}
+
+// Time from the DiagnosticSessionControl request in the application to the
+// response of the firmware loader, without the reboot and the kernel start
+ZTEST_F(lib_uds, test_0x10_firmware_loader_handoff_timing) {
+  struct uds_instance_t *instance = fixture->instance;
+
+  request_programming_session(instance);
+  const uint32_t captured_cycles = k_cycle_get_32();
+
+  before_resume(fixture);
+  const uint32_t resume_cycles = k_cycle_get_32();
+  zassert_ok(uds_firmware_loader_handoff_resume(instance, &captured_handoff));
+
+  const uint32_t app_us =
+      k_cyc_to_us_ceil32(captured_cycles - request_cycles);
+  const uint32_t loader_us = k_cyc_to_us_ceil32(sent_cycles - resume_cycles);
+
+  TC_PRINT(
+      "handoff: %u us in the application, %u us in the firmware loader from "
+      "CAN start to response\n",
+      app_us, loader_us);
+
+  // P2 of the programming session
+  zassert_true(app_us + loader_us < captured_handoff.p2_ms * USEC_PER_MSEC);
+}
@@ -0,0 +1,565 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (C) Frickly Systems GmbH
+ * SPDX-FileCopyrightText: Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "ardep/uds.h"
+#include "fixture.h"
+#include "iso14229.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/ztest.h>
+
+#ifdef CONFIG_UDS_DTC_MANAGER_PERSISTENCE
+#include <zephyr/storage/flash_map.h>
+#endif
+
+#if defined(CONFIG_UDS_DTC_MANAGER) && \
+    defined(CONFIG_UDS_USE_DYNAMIC_REGISTRATION)
+
+#define DTC_A 0x0A9B17
+#define DTC_B 0x805111
+#define DTC_C 0xC10000
+
+static const uint8_t read_dtc_info_sub_functions[] = {
+  UDS_READ_DTC_INFO_SUBFUNC__NUM_OF_DTC_BY_STATUS_MASK,
+  UDS_READ_DTC_INFO_SUBFUNC__DTC_BY_STATUS_MASK,
+  UDS_READ_DTC_INFO_SUBFUNC__DTC_SNAPSHOT_RECORD_BY_DTC_NUM,
+  UDS_READ_DTC_INFO_SUBFUNC__DTC_EXT_DATA_RECORD_BY_DTC_NUM,
+  UDS_READ_DTC_INFO_SUBFUNC__SUPPORTED_DTC,
+};
+
+// The fixture registers handlers for all sub-functions, which do not apply
+// without custom fakes. The default handlers are registered after them.
+static void setup_default_handlers(struct uds_instance_t *instance) {
+  uint32_t id;
+
+#ifdef CONFIG_UDS_DTC_MANAGER_PERSISTENCE
+  const struct flash_area *fa;
+  zassert_ok(flash_area_open(FIXED_PARTITION_ID(dtc_partition), &fa));
+  zassert_ok(flash_area_erase(fa, 0, fa->fa_size));
+  flash_area_close(fa);
+#endif
+
+  zassert_ok(uds_dtc_manager_init());
+
+  for (size_t i = 0; i < ARRAY_SIZE(read_dtc_info_sub_functions); i++) {
+    struct uds_registration_t reg = {
+      .type = UDS_REGISTRATION_TYPE__READ_DTC_INFO,
+      .read_dtc = {
+        .sub_function = read_dtc_info_sub_functions[i],
+        .actor = {
+          .check = uds_check_default_read_dtc_info,
+          .action = uds_action_default_read_dtc_info,
+        },
+      },
+    };
+    zassert_ok(instance->register_event_handler(instance, reg, &id, NULL));
+  }
+
+  struct uds_registration_t reg = {
+    .type = UDS_REGISTRATION_TYPE__CLEAR_DIAG_INFO,
+    .clear_diagnostic_information = {
+      .actor = {
+        .check = uds_check_default_clear_diag_info,
+        .action = uds_action_default_clear_diag_info,
+      },
+    },
+  };
+  zassert_ok(instance->register_event_handler(instance, reg, &id, NULL));
+}
+
+static void setup_dtc_manager(struct uds_instance_t *instance) {
+  setup_default_handlers(instance);
+
+  zassert_ok(uds_dtc_register(DTC_A));
+  zassert_ok(uds_dtc_register(DTC_B));
+  zassert_ok(uds_dtc_register(DTC_C));
+}
+
+static UDSErr_t read_dtc_by_status_mask(struct uds_instance_t *instance,
+                                        uint8_t type,
+                                        uint8_t mask) {
+  UDSRDTCIArgs_t args = {
+    .type = type,
+    .copy = copy,
+    .subFuncArgs.numOfDTCByStatusMaskArgs.mask = mask,
+  };
+
+  return receive_event(instance, UDS_EVT_ReadDTCInformation, &args);
+}
+
+static UDSErr_t clear_diag_info(struct uds_instance_t *instance,
+                                uint32_t group) {
+  UDSCDIArgs_t args = {
+    .groupOfDTC = group,
+  };
+
+  return receive_event(instance, UDS_EVT_ClearDiagnosticInfo, &args);
+}
+
+ZTEST_F(lib_uds, test_0x19_dtc_manager_num_of_dtc_by_status_mask) {
+  struct uds_instance_t *instance = fixture->instance;
+  setup_dtc_manager(instance);
+
+  zassert_ok(uds_dtc_report(DTC_A, true));
+  zassert_ok(uds_dtc_report(DTC_B, true));
+  zassert_ok(uds_dtc_report(DTC_B, false));
+
+  zassert_ok(read_dtc_by_status_mask(
+      instance, UDS_READ_DTC_INFO_SUBFUNC__NUM_OF_DTC_BY_STATUS_MASK,
+      UDS_DTC_STATUS_TEST_FAILED));
+
+  // availability mask, ISO 14229-1 DTC format, count
+  assert_copy_data((uint8_t[]){0xFF, 0x01, 0x00, 0x01}, 4);
+  zassert_equal(uds_dtc_count_by_status_mask(UDS_DTC_STATUS_CONFIRMED_DTC), 2);
+}
+
+ZTEST_F(lib_uds, test_0x19_dtc_manager_dtc_by_status_mask) {
+  struct uds_instance_t *instance = fixture->instance;
+  setup_dtc_manager(instance);
+
+  zassert_ok(uds_dtc_report(DTC_A, true));
+  zassert_ok(uds_dtc_report(DTC_C, false));
+
+  zassert_ok(read_dtc_by_status_mask(
+      instance, UDS_READ_DTC_INFO_SUBFUNC__DTC_BY_STATUS_MASK,
+      UDS_DTC_STATUS_CONFIRMED_DTC |
+          UDS_DTC_STATUS_TEST_NOT_COMPLETED_SINCE_LAST_CLEAR));
+
+  // DTCs in the order of registration
+  assert_copy_data(
+      (uint8_t[]){
+        0xFF,                    // availability mask
+        0x0A, 0x9B, 0x17, 0x2F,  // failed
+        0x80, 0x51, 0x11, 0x50,  // not completed
+      },
+      9);
+}
+
+ZTEST_F(lib_uds, test_0x19_dtc_manager_supported_dtc) {
+  struct uds_instance_t *instance = fixture->instance;
+  setup_dtc_manager(instance);
+
+  zassert_ok(uds_dtc_report(DTC_B, false));
+
+  zassert_ok(read_dtc_by_status_mask(
+      instance, UDS_READ_DTC_INFO_SUBFUNC__SUPPORTED_DTC, 0x00));
+
+  assert_copy_data(
+      (uint8_t[]){
+        0xFF,                    // availability mask
+        0x0A, 0x9B, 0x17, 0x50,  //
+        0x80, 0x51, 0x11, 0x00,  //
+        0xC1, 0x00, 0x00, 0x50,  //
+      },
+      13);
+}
+
+ZTEST_F(lib_uds, test_0x19_dtc_manager_register) {
+  struct uds_instance_t *instance = fixture->instance;
+  uint8_t status;
+
+  setup_dtc_manager(instance);
+  zassert_ok(uds_dtc_report(DTC_A, true));
+
+  // registering a known DTC again keeps its state
+  zassert_ok(uds_dtc_register(DTC_A));
+  zassert_ok(uds_dtc_get_status(DTC_A, &status, NULL));
+  zassert_equal(status, 0x2F);
+
+  zassert_equal(uds_dtc_register(0x1000000), -EINVAL);
+  zassert_equal(uds_dtc_report(0x123456, true), -ENOENT);
+}
+
+ZTEST_F(lib_uds, test_0x19_dtc_manager_occurrence_counter) {
+  struct uds_instance_t *instance = fixture->instance;
+  uint8_t counter;
+
+  setup_dtc_manager(instance);
+
+  // counts transitions to failed, not failed test results
+  zassert_ok(uds_dtc_report(DTC_A, true));
+  zassert_ok(uds_dtc_report(DTC_A, true));
+  zassert_ok(uds_dtc_report(DTC_A, false));
+  zassert_ok(uds_dtc_report(DTC_A, true));
+
+  zassert_ok(uds_dtc_get_status(DTC_A, NULL, &counter));
+  zassert_equal(counter, 2);
+}
+
+ZTEST_F(lib_uds, test_0x19_dtc_manager_operation_cycle) {
+  struct uds_instance_t *instance = fixture->instance;
+  uint8_t status;
+
+  setup_dtc_manager(instance);
+
+  zassert_ok(uds_dtc_report(DTC_A, true));
+  zassert_ok(uds_dtc_report(DTC_B, true));
+
+  // DTC_A is not tested in the next cycle, DTC_B passes
+  uds_dtc_start_operation_cycle();
+  zassert_ok(uds_dtc_report(DTC_B, false));
+  uds_dtc_start_operation_cycle();
+
+  zassert_ok(uds_dtc_get_status(DTC_A, &status, NULL));
+  zassert_equal(status, 0x6D);
+  zassert_ok(uds_dtc_get_status(DTC_B, &status, NULL));
+  zassert_equal(status, 0x68);
+}
+
+ZTEST_F(lib_uds, test_0x19_dtc_manager_snapshot_record) {
+  struct uds_instance_t *instance = fixture->instance;
+  // one data identifier 0x1234 with two bytes
+  const uint8_t snapshot[] = {0x01, 0x12, 0x34, 0xAB, 0xCD};
+
+  setup_dtc_manager(instance);
+  zassert_ok(uds_dtc_report(DTC_B, true));
+  zassert_ok(uds_dtc_store_snapshot(DTC_B, 0x01, snapshot, sizeof(snapshot)));
+  zassert_ok(uds_dtc_store_snapshot(DTC_A, 0x01, snapshot, 1));
+
+  UDSRDTCIArgs_t args = {
+    .type = UDS_READ_DTC_INFO_SUBFUNC__DTC_SNAPSHOT_RECORD_BY_DTC_NUM,
+    .copy = copy,
+    .subFuncArgs.dtcSnapshotRecordbyDTCNumArgs = {
+      .dtc = DTC_B,
+      .snapRecNum = UDS_DTC_RECORD_NUMBER_ALL,
+    },
+  };
+  zassert_ok(receive_event(instance, UDS_EVT_ReadDTCInformation, &args));
+
+  assert_copy_data(
+      (uint8_t[]){
+        0x80, 0x51, 0x11, 0x2F,              // DTC and status
+        0x01,                                // record number
+        0x01, 0x12, 0x34, 0xAB, 0xCD,        // record
+      },
+      10);
+}
+
+ZTEST_F(lib_uds, test_0x19_dtc_manager_ext_data_record) {
+  struct uds_instance_t *instance = fixture->instance;
+
+  setup_dtc_manager(instance);
+  zassert_ok(uds_dtc_store_extended_data(DTC_C, 0x01, (uint8_t[]){0x11}, 1));
+  zassert_ok(
+      uds_dtc_store_extended_data(DTC_C, 0x02, (uint8_t[]){0x22, 0x23}, 2));
+  // replaces the first record
+  zassert_ok(uds_dtc_store_extended_data(DTC_C, 0x01, (uint8_t[]){0x12}, 1));
+
+  UDSRDTCIArgs_t args = {
+    .type = UDS_READ_DTC_INFO_SUBFUNC__DTC_EXT_DATA_RECORD_BY_DTC_NUM,
+    .copy = copy,
+    .subFuncArgs.dtcExtDtaRecordByDTCNumArgs = {
+      .dtc = DTC_C,
+      .extDataRecNum = 0x02,
+    },
+  };
+  zassert_ok(receive_event(instance, UDS_EVT_ReadDTCInformation, &args));
+
+  assert_copy_data((uint8_t[]){0xC1, 0x00, 0x00, 0x50, 0x02, 0x22, 0x23}, 7);
+
+  zassert_equal(uds_dtc_store_extended_data(DTC_C, 0xFE, (uint8_t[]){0}, 1),
+                -EINVAL);
+}
+
+ZTEST_F(lib_uds, test_0x19_dtc_manager_record_of_unknown_dtc) {
+  struct uds_instance_t *instance = fixture->instance;
+
+  setup_dtc_manager(instance);
+
+  UDSRDTCIArgs_t args = {
+    .type = UDS_READ_DTC_INFO_SUBFUNC__DTC_SNAPSHOT_RECORD_BY_DTC_NUM,
+    .copy = copy,
+    .subFuncArgs.dtcSnapshotRecordbyDTCNumArgs = {
+      .dtc = 0x123456,
+      .snapRecNum = UDS_DTC_RECORD_NUMBER_ALL,
+    },
+  };
+  zassert_equal(receive_event(instance, UDS_EVT_ReadDTCInformation, &args),
+                UDS_NRC_RequestOutOfRange);
+}
+
+ZTEST_F(lib_uds, test_0x14_dtc_manager_clear_all) {
+  struct uds_instance_t *instance = fixture->instance;
+  uint8_t status;
+  uint8_t counter;
+
+  setup_dtc_manager(instance);
+  zassert_ok(uds_dtc_report(DTC_A, true));
+  zassert_ok(uds_dtc_report(DTC_B, true));
+  zassert_ok(uds_dtc_store_snapshot(DTC_A, 0x01, (uint8_t[]){0x00}, 1));
+
+  zassert_ok(clear_diag_info(instance, UDS_DTC_GROUP_ALL));
+
+  zassert_equal(uds_dtc_count_by_status_mask(0xFF), 3);
+  zassert_equal(
+      uds_dtc_count_by_status_mask(UDS_DTC_STATUS_TEST_FAILED_SINCE_LAST_CLEAR),
+      0);
+  zassert_ok(uds_dtc_get_status(DTC_A, &status, &counter));
+  zassert_equal(status, 0x50);
+  zassert_equal(counter, 0);
+
+  // the snapshot record is freed
+  for (uint8_t i = 0; i < CONFIG_UDS_DTC_MANAGER_SNAPSHOT_RECORDS; i++) {
+    zassert_ok(uds_dtc_store_snapshot(DTC_B, i + 1, (uint8_t[]){0x00}, 1));
+  }
+}
+
+ZTEST_F(lib_uds, test_0x14_dtc_manager_clear_single) {
+  struct uds_instance_t *instance = fixture->instance;
+  uint8_t status;
+
+  setup_dtc_manager(instance);
+  zassert_ok(uds_dtc_report(DTC_A, true));
+  zassert_ok(uds_dtc_report(DTC_B, true));
+
+  zassert_ok(clear_diag_info(instance, DTC_B));
+
+  zassert_ok(uds_dtc_get_status(DTC_A, &status, NULL));
+  zassert_equal(status, 0x2F);
+  zassert_ok(uds_dtc_get_status(DTC_B, &status, NULL));
+  zassert_equal(status, 0x50);
+
+  zassert_equal(clear_diag_info(instance, 0x123456), UDS_NRC_RequestOutOfRange);
+}
+
+#ifdef CONFIG_UDS_DTC_MANAGER_PERSISTENCE
+ZTEST_F(lib_uds, test_0x19_dtc_manager_persistence) {
+  struct uds_instance_t *instance = fixture->instance;
+  uint8_t status;
+  uint8_t counter;
+
+  setup_dtc_manager(instance);
+  zassert_ok(uds_dtc_report(DTC_A, true));
+  zassert_ok(uds_dtc_report(DTC_B, true));
+  zassert_ok(uds_dtc_report(DTC_B, false));
+  zassert_ok(
+      uds_dtc_store_extended_data(DTC_B, 0x01, (uint8_t[]){0x42, 0x43}, 2));
+  zassert_ok(uds_dtc_manager_flush());
+
+  // simulates a reset
+  zassert_ok(uds_dtc_manager_init());
+
+  // the test results of the last operation cycle are not restored
+  zassert_ok(uds_dtc_get_status(DTC_A, &status, &counter));
+  zassert_equal(status, 0x6C);
+  zassert_equal(counter, 1);
+  zassert_ok(uds_dtc_get_status(DTC_C, &status, NULL));
+  zassert_equal(status, 0x50);
+
+  UDSRDTCIArgs_t args = {
+    .type = UDS_READ_DTC_INFO_SUBFUNC__DTC_EXT_DATA_RECORD_BY_DTC_NUM,
+    .copy = copy,
+    .subFuncArgs.dtcExtDtaRecordByDTCNumArgs = {
+      .dtc = DTC_B,
+      .extDataRecNum = UDS_DTC_RECORD_NUMBER_ALL,
+    },
+  };
+  zassert_ok(receive_event(instance, UDS_EVT_ReadDTCInformation, &args));
+  assert_copy_data((uint8_t[]){0x80, 0x51, 0x11, 0x6C, 0x01, 0x42, 0x43}, 7);
+}
+
+ZTEST_F(lib_uds, test_0x14_dtc_manager_clear_is_persisted) {
+  struct uds_instance_t *instance = fixture->instance;
+  uint8_t status;
+
+  setup_dtc_manager(instance);
+  zassert_ok(uds_dtc_report(DTC_A, true));
+  zassert_ok(uds_dtc_manager_flush());
+
+  // ClearDiagnosticInformation stores the cleared DTCs right away
+  zassert_ok(clear_diag_info(instance, UDS_DTC_GROUP_ALL));
+  zassert_ok(uds_dtc_manager_init());
+
+  zassert_ok(uds_dtc_get_status(DTC_A, &status, NULL));
+  zassert_equal(status, 0x50);
+}
+
+ZTEST_F(lib_uds, test_0x14_dtc_manager_clear_with_full_journal) {
+  struct uds_instance_t *instance = fixture->instance;
+
+  setup_dtc_manager(instance);
+  zassert_ok(uds_dtc_manager_flush());
+
+  // The storage work queue does not run before the test sleeps
+  for (int i = 0; i < CONFIG_UDS_DTC_MANAGER_CLEAR_JOURNAL_SIZE; i++) {
+    zassert_ok(clear_diag_info(instance, DTC_A));
+  }
+
+  // The clear is pending until the previous clears are stored
+  zassert_equal(clear_diag_info(instance, DTC_A),
+                UDS_NRC_RequestCorrectlyReceived_ResponsePending);
+  zassert_equal(uds_dtc_clear(DTC_A), -EBUSY);
+
+  k_sleep(K_MSEC(10));
+  zassert_ok(clear_diag_info(instance, DTC_A));
+}
+
+#ifdef CONFIG_FLASH_SIMULATOR_STATS
+static size_t copied_response_len;
+
+// Only counts the copied bytes, as the response is read several times
+static uint8_t length_copy(UDSServer_t *server,
+                           const void *data,
+                           uint16_t len) {
+  copied_response_len += len;
+  return UDS_OK;
+}
+
+// Clears all DTCs and lets the background write them with a limit of flash
+// writes. The flash simulator ignores the writes after the limit, like a
+// power failure. Returns the number of flash writes of the response and the
+// background.
+static void clear_with_power_failure(struct uds_instance_t *instance,
+                                     uint32_t max_writes,
+                                     uint32_t *response_writes,
+                                     uint32_t *background_writes) {
+  uint32_t *write_calls = find_stat("flash_sim_stats", "flash_write_calls");
+  uint32_t *max_write_calls =
+      find_stat("flash_sim_thresholds", "max_write_calls");
+
+  setup_dtc_manager(instance);
+  zassert_ok(uds_dtc_report(DTC_A, true));
+  zassert_ok(uds_dtc_report(DTC_B, true));
+  zassert_ok(uds_dtc_store_snapshot(DTC_A, 0x01, (uint8_t[]){0x01}, 1));
+  zassert_ok(uds_dtc_manager_flush());
+
+  *write_calls = 0;
+  zassert_ok(clear_diag_info(instance, UDS_DTC_GROUP_ALL));
+  *response_writes = *write_calls;
+
+  // The background work queue runs while the test sleeps
+  *write_calls = 0;
+  *max_write_calls = max_writes == UINT32_MAX ? 0 : max_writes + 1;
+  k_sleep(K_MSEC(10));
+  *max_write_calls = 0;
+  *background_writes = *write_calls;
+}
+
+ZTEST_F(lib_uds, test_0x14_dtc_manager_power_failure_during_clear) {
+  struct uds_instance_t *instance = fixture->instance;
+  uint32_t response_writes;
+  uint32_t background_writes;
+  uint32_t writes;
+
+  clear_with_power_failure(instance, UINT32_MAX, &response_writes,
+                           &background_writes);
+
+  // Only the clear journal is written before the response
+  zassert_true(response_writes < background_writes);
+
+  for (uint32_t max_writes = 0; max_writes <= background_writes;
+       max_writes++) {
+    uint8_t status;
+    uint8_t counter;
+
+    clear_with_power_failure(instance, max_writes, &response_writes, &writes);
+
+    // simulates the reset after the power failure
+    zassert_ok(uds_dtc_manager_init());
+
+    zassert_ok(uds_dtc_get_status(DTC_A, &status, &counter));
+    zassert_equal(status, 0x50, "status 0x%02X after %u writes", status,
+                  max_writes);
+    zassert_equal(counter, 0);
+    zassert_ok(uds_dtc_get_status(DTC_B, &status, NULL));
+    zassert_equal(status, 0x50, "status 0x%02X after %u writes", status,
+                  max_writes);
+
+    // only the DTC and its status, the snapshot record is deleted
+    UDSRDTCIArgs_t args = {
+      .type = UDS_READ_DTC_INFO_SUBFUNC__DTC_SNAPSHOT_RECORD_BY_DTC_NUM,
+      .copy = length_copy,
+      .subFuncArgs.dtcSnapshotRecordbyDTCNumArgs = {
+        .dtc = DTC_A,
+        .snapRecNum = UDS_DTC_RECORD_NUMBER_ALL,
+      },
+    };
+    copied_response_len = 0;
+    zassert_ok(receive_event(instance, UDS_EVT_ReadDTCInformation, &args));
+    zassert_equal(copied_response_len, 4);
+  }
+}
+
+ZTEST_F(lib_uds, test_0x14_dtc_manager_report_after_clear) {
+  struct uds_instance_t *instance = fixture->instance;
+  uint8_t status;
+
+  setup_dtc_manager(instance);
+  zassert_ok(uds_dtc_report(DTC_A, true));
+  zassert_ok(uds_dtc_manager_flush());
+
+  // The failure after the clear is stored with the clear and not cleared
+  // again by the journal after a reset
+  zassert_ok(clear_diag_info(instance, DTC_A));
+  zassert_ok(uds_dtc_report(DTC_A, true));
+  zassert_ok(uds_dtc_manager_flush());
+  zassert_ok(uds_dtc_manager_init());
+
+  zassert_ok(uds_dtc_get_status(DTC_A, &status, NULL));
+  zassert_equal(status, 0x6C);
+}
+#endif  // CONFIG_FLASH_SIMULATOR_STATS
+
+#endif  // CONFIG_UDS_DTC_MANAGER_PERSISTENCE
+
+#if CONFIG_UDS_DTC_MANAGER_MAX_DTCS >= 1000
+
+#define BENCHMARK_DTCS 1000
+
+static size_t benchmark_copied;
+
+static uint8_t count_copy(UDSServer_t *server,
+                          const void *data,
+                          uint16_t len) {
+  benchmark_copied += len;
+  return UDS_OK;
+}
+
+ZTEST_F(lib_uds, test_0x19_dtc_manager_benchmark_dtc_by_status_mask) {
+  struct uds_instance_t *instance = fixture->instance;
+
+  setup_default_handlers(instance);
+
+  // every 8th DTC is confirmed
+  for (uint32_t i = 0; i < BENCHMARK_DTCS; i++) {
+    uint32_t dtc = 0x100000 + i * 0x10;
+    zassert_ok(uds_dtc_register(dtc));
+    zassert_ok(uds_dtc_report(dtc, i % 8 == 0));
+  }
+
+  UDSRDTCIArgs_t args = {
+    .type = UDS_READ_DTC_INFO_SUBFUNC__DTC_BY_STATUS_MASK,
+    .copy = count_copy,
+    .subFuncArgs.numOfDTCByStatusMaskArgs.mask = UDS_DTC_STATUS_CONFIRMED_DTC,
+  };
+
+#ifdef CONFIG_UDS_DTC_MANAGER_STATS
+  const uint32_t *words = find_stat("uds_dtc_manager", "words");
+  const uint32_t *dtcs = find_stat("uds_dtc_manager", "dtcs");
+  const uint32_t words_before = *words;
+  const uint32_t dtcs_before = *dtcs;
+#endif
+
+  benchmark_copied = 0;
+  zassert_ok(receive_event(instance, UDS_EVT_ReadDTCInformation, &args));
+  zassert_equal(benchmark_copied, 1 + BENCHMARK_DTCS / 8 * 4);
+
+#ifdef CONFIG_UDS_DTC_MANAGER_STATS
+  // one bitmap word per 32 DTCs, and only the matching DTCs are touched
+  // instead of all of them
+  zassert_equal(*words - words_before,
+                DIV_ROUND_UP(CONFIG_UDS_DTC_MANAGER_MAX_DTCS, 32));
+  zassert_equal(*dtcs - dtcs_before, BENCHMARK_DTCS / 8);
+#endif
+}
+
+#endif  // CONFIG_UDS_DTC_MANAGER_MAX_DTCS >= 1000
+
+#endif  // CONFIG_UDS_DTC_MANAGER && CONFIG_UDS_USE_DYNAMIC_REGISTRATION
@@ -0,0 +1,250 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (C) Frickly Systems GmbH
+ * SPDX-FileCopyrightText: Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "ardep/uds.h"
+#include "fixture.h"
+#include "iso14229.h"
+
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/ztest.h>
+
+#ifdef CONFIG_UDS_DATA_ID_CACHE
+
+#define CACHED_DATA_ID_A 0xCA01
+#define CACHED_DATA_ID_B 0xCA02
+#define CACHED_DATA_ID_C 0xCA03
+#define MAX_AGE_MS 100
+
+// Duration of the bus transaction of a read
+#define READ_DURATION_US 500
+
+extern struct uds_instance_t fixture_uds_instance;
+
+struct cached_data {
+  uint32_t value;
+  int reads;
+};
+
+static struct cached_data data_a;
+static struct cached_data data_b;
+static struct cached_data data_c;
+
+static uint8_t response[4];
+static uint16_t response_len;
+
+// Keeps only the data of the latest response
+static uint8_t copy_response(UDSServer_t *server,
+                             const void *data,
+                             uint16_t len) {
+  zassert_true(len <= sizeof(response));
+  memcpy(response, data, len);
+  response_len = len;
+
+  return 0;
+}
+
+static UDSErr_t cached_read_check(const struct uds_context *const context,
+                                  bool *apply_action) {
+  *apply_action = true;
+  return UDS_OK;
+}
+
+// Reads the value like a sensor on the I2C bus
+static UDSErr_t cached_read(struct uds_context *const context,
+                            bool *consume_event) {
+  struct cached_data *data = context->registration->data_identifier.data;
+  UDSRDBIArgs_t *args = context->arg;
+  uint8_t value[4];
+
+  data->reads++;
+  k_busy_wait(READ_DURATION_US);
+
+  sys_put_be32(data->value, value);
+  *consume_event = true;
+  return args->copy(context->server, value, sizeof(value));
+}
+
+static UDSErr_t cached_write_check(const struct uds_context *const context,
+                                   bool *apply_action) {
+  *apply_action = true;
+  return UDS_OK;
+}
+
+static UDSErr_t cached_write(struct uds_context *const context,
+                             bool *consume_event) {
+  struct cached_data *data = context->registration->data_identifier.data;
+  UDSWDBIArgs_t *args = context->arg;
+
+  zassert_equal(args->len, sizeof(data->value));
+  data->value = sys_get_be32(args->data);
+
+  *consume_event = true;
+  return UDS_OK;
+}
+
+UDS_REGISTER_CACHED_DATA_BY_IDENTIFIER_HANDLER(&fixture_uds_instance,
+                                               CACHED_DATA_ID_A,
+                                               &data_a,
+                                               cached_read_check,
+                                               cached_read,
+                                               cached_write_check,
+                                               cached_write,
+                                               NULL,
+                                               NULL,
+                                               NULL,
+                                               MAX_AGE_MS);
+
+UDS_REGISTER_CACHED_DATA_BY_IDENTIFIER_HANDLER(&fixture_uds_instance,
+                                               CACHED_DATA_ID_B,
+                                               &data_b,
+                                               cached_read_check,
+                                               cached_read,
+                                               NULL,
+                                               NULL,
+                                               NULL,
+                                               NULL,
+                                               NULL,
+                                               MAX_AGE_MS);
+
+UDS_REGISTER_CACHED_DATA_BY_IDENTIFIER_HANDLER(&fixture_uds_instance,
+                                               CACHED_DATA_ID_C,
+                                               &data_c,
+                                               cached_read_check,
+                                               cached_read,
+                                               NULL,
+                                               NULL,
+                                               NULL,
+                                               NULL,
+                                               NULL,
+                                               MAX_AGE_MS);
+
+static void reset_cached_data(void) {
+  uds_data_id_cache_invalidate_all();
+
+  data_a = (struct cached_data){.value = 0x11223344};
+  data_b = (struct cached_data){.value = 0x55667788};
+  data_c = (struct cached_data){.value = 0x99AABBCC};
+}
+
+// Reads the data identifier and returns the value of the response
+static uint32_t read_cached(struct uds_instance_t *instance, uint16_t data_id) {
+  UDSRDBIArgs_t args = {
+    .dataId = data_id,
+    .copy = copy,
+  };
+
+  copy_fake.custom_fake = copy_response;
+  response_len = 0;
+
+  zassert_ok(receive_event(instance, UDS_EVT_ReadDataByIdent, &args));
+  zassert_equal(response_len, sizeof(uint32_t));
+
+  return sys_get_be32(response);
+}
+
+ZTEST_F(lib_uds, test_0x22_data_id_cache_hit) {
+  struct uds_instance_t *instance = fixture->instance;
+
+  reset_cached_data();
+
+  uint32_t start = k_cycle_get_32();
+  zassert_equal(read_cached(instance, CACHED_DATA_ID_A), 0x11223344);
+  const uint32_t miss_cycles = k_cycle_get_32() - start;
+
+  start = k_cycle_get_32();
+  zassert_equal(read_cached(instance, CACHED_DATA_ID_A), 0x11223344);
+  const uint32_t hit_cycles = k_cycle_get_32() - start;
+
+  TC_PRINT("ReadDataByIdentifier: %u cycles on a miss, %u cycles on a hit\n",
+           miss_cycles, hit_cycles);
+
+  zassert_equal(data_a.reads, 1);
+  zassert_true(hit_cycles < miss_cycles);
+}
+
+ZTEST_F(lib_uds, test_0x22_data_id_cache_max_age) {
+  struct uds_instance_t *instance = fixture->instance;
+
+  reset_cached_data();
+
+  read_cached(instance, CACHED_DATA_ID_A);
+  data_a.value = 0x01020304;
+  zassert_equal(read_cached(instance, CACHED_DATA_ID_A), 0x11223344);
+
+  k_sleep(K_MSEC(MAX_AGE_MS));
+  zassert_equal(read_cached(instance, CACHED_DATA_ID_A), 0x01020304);
+  zassert_equal(data_a.reads, 2);
+}
+
+ZTEST_F(lib_uds, test_0x22_data_id_cache_invalidation) {
+  struct uds_instance_t *instance = fixture->instance;
+
+  reset_cached_data();
+
+  // by the owner
+  read_cached(instance, CACHED_DATA_ID_A);
+  read_cached(instance, CACHED_DATA_ID_B);
+  data_a.value = 0x01020304;
+  uds_data_id_cache_invalidate(CACHED_DATA_ID_A);
+  zassert_equal(read_cached(instance, CACHED_DATA_ID_A), 0x01020304);
+  zassert_equal(data_a.reads, 2);
+  read_cached(instance, CACHED_DATA_ID_B);
+  zassert_equal(data_b.reads, 1);
+
+  // by WriteDataByIdentifier
+  const uint8_t written[] = {0xDE, 0xAD, 0xBE, 0xEF};
+  UDSWDBIArgs_t write_args = {
+    .dataId = CACHED_DATA_ID_A,
+    .data = written,
+    .len = sizeof(written),
+  };
+  zassert_ok(receive_event(instance, UDS_EVT_WriteDataByIdent, &write_args));
+  zassert_equal(read_cached(instance, CACHED_DATA_ID_A), 0xDEADBEEF);
+  zassert_equal(data_a.reads, 3);
+
+  // by a session change
+  UDSDiagSessCtrlArgs_t session_args = {
+    .type = UDS_DIAG_SESSION__EXTENDED,
+  };
+  zassert_ok(receive_event(instance, UDS_EVT_DiagSessCtrl, &session_args));
+  read_cached(instance, CACHED_DATA_ID_A);
+  read_cached(instance, CACHED_DATA_ID_B);
+  zassert_equal(data_a.reads, 4);
+  zassert_equal(data_b.reads, 2);
+
+  // responses are only served in the session they were read in
+  const uint8_t session = instance->iso14229.server.sessionType;
+  instance->iso14229.server.sessionType = session + 1;
+  read_cached(instance, CACHED_DATA_ID_A);
+  zassert_equal(data_a.reads, 5);
+  instance->iso14229.server.sessionType = session;
+}
+
+ZTEST_F(lib_uds, test_0x22_data_id_cache_lru_eviction) {
+  struct uds_instance_t *instance = fixture->instance;
+
+  zassert_equal(CONFIG_UDS_DATA_ID_CACHE_ENTRIES, 2);
+
+  reset_cached_data();
+
+  read_cached(instance, CACHED_DATA_ID_A);
+  read_cached(instance, CACHED_DATA_ID_B);
+  read_cached(instance, CACHED_DATA_ID_A);
+
+  // evicts B, the least recently used response
+  read_cached(instance, CACHED_DATA_ID_C);
+
+  read_cached(instance, CACHED_DATA_ID_A);
+  zassert_equal(data_a.reads, 1);
+  read_cached(instance, CACHED_DATA_ID_B);
+  zassert_equal(data_b.reads, 2);
+}
+
+#endif  // CONFIG_UDS_DATA_ID_CACHE
@@ -0,0 +1,253 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (C) Frickly Systems GmbH
+ * SPDX-FileCopyrightText: Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "fixture.h"
+
+#include <string.h>
+
+#include <zephyr/ztest.h>
+
+#define READ UDS_MEMORY_ACCESS_READ
+#define WRITE UDS_MEMORY_ACCESS_WRITE
+
+static const uint8_t extended_session_only[] = {UDS_DIAG_SESSION__EXTENDED};
+
+static const struct uds_memory_region regions[] = {
+  {.start = 0x1000, .end = 0x1FFF, .access = READ | WRITE},
+  // holes and windows in the region above
+  {.start = 0x1800, .end = 0x18FF, .access = 0},
+  {.start = 0x1F00, .end = 0x20FF, .access = WRITE},
+  // the whole range below 0x10000, painted first as the largest region
+  {.start = 0x0000, .end = 0xFFFF, .access = READ},
+  {.start = 0x3000, .end = 0x3FFF, .access = READ | UDS_MEMORY_ACCESS_MMIO,
+   .security_level = 3},
+  {.start = 0x4000, .end = 0x4FFF, .access = READ | WRITE,
+   .sessions = extended_session_only,
+   .session_count = ARRAY_SIZE(extended_session_only)},
+  // same size as the region above, takes precedence as the later one
+  {.start = 0x4000, .end = 0x4FFF, .access = READ},
+  {.start = UINTPTR_MAX - 0xFF, .end = UINTPTR_MAX, .access = READ},
+};
+
+static const UDSServer_t default_server = {
+  .sessionType = UDS_DIAG_SESSION__DEFAULT,
+};
+
+static struct uds_memory_region buffer[2 * ARRAY_SIZE(regions)];
+static struct uds_memory_map map;
+
+static UDSErr_t check(const UDSServer_t *server,
+                      uintptr_t addr,
+                      size_t size,
+                      uint8_t access) {
+  return uds_memory_map_check(&map, server, addr, size, access, NULL);
+}
+
+ZTEST(lib_uds, test_0x23_0x3D_memory_map_boundaries) {
+  const UDSServer_t *server = &default_server;
+
+  zassert_ok(uds_memory_map_init(&map, buffer, ARRAY_SIZE(buffer), regions,
+                                 ARRAY_SIZE(regions)));
+
+  // first and last byte of a region
+  zassert_equal(check(server, 0x1000, 1, WRITE), UDS_OK);
+  zassert_equal(check(server, 0x17FF, 1, WRITE), UDS_OK);
+  zassert_equal(check(server, 0x1000, 0x800, WRITE), UDS_OK);
+  zassert_equal(check(server, 0x1000, 0x801, WRITE), UDS_NRC_RequestOutOfRange);
+  zassert_equal(check(server, 0x0FFF, 2, WRITE), UDS_NRC_RequestOutOfRange);
+
+  // outside of all regions
+  zassert_equal(check(server, 0x10000, 1, READ), UDS_NRC_RequestOutOfRange);
+  zassert_equal(check(server, 0xFFFF, 2, READ), UDS_NRC_RequestOutOfRange);
+  zassert_equal(check(server, 0xFFFF, 1, READ), UDS_OK);
+
+  // up to the end of the address space, without overflowing
+  zassert_equal(check(server, UINTPTR_MAX, 1, READ), UDS_OK);
+  zassert_equal(check(server, UINTPTR_MAX - 0xFF, 0x100, READ), UDS_OK);
+  zassert_equal(check(server, UINTPTR_MAX, 2, READ),
+                UDS_NRC_RequestOutOfRange);
+  zassert_equal(check(server, 0x1000, 0, READ), UDS_NRC_RequestOutOfRange);
+
+  zassert_is_null(uds_memory_map_find(&map, 0x10000));
+  zassert_equal(uds_memory_map_find(&map, 0xFFFF)->end, 0xFFFF);
+}
+
+ZTEST(lib_uds, test_0x23_0x3D_memory_map_overlaps) {
+  const UDSServer_t *server = &default_server;
+
+  zassert_ok(uds_memory_map_init(&map, buffer, ARRAY_SIZE(buffer), regions,
+                                 ARRAY_SIZE(regions)));
+
+  // the hole splits the region
+  zassert_equal(check(server, 0x1800, 1, READ), UDS_NRC_RequestOutOfRange);
+  zassert_equal(check(server, 0x17FF, 2, READ), UDS_NRC_RequestOutOfRange);
+  zassert_equal(check(server, 0x1900, 0x600, READ | WRITE), UDS_OK);
+
+  // the write only window reaches out of the region
+  zassert_equal(check(server, 0x1F00, 0x200, WRITE), UDS_OK);
+  zassert_equal(check(server, 0x1F00, 1, READ), UDS_NRC_RequestOutOfRange);
+  zassert_equal(check(server, 0x2100, 1, READ), UDS_OK);
+  zassert_equal(check(server, 0x2100, 1, WRITE), UDS_NRC_RequestOutOfRange);
+
+  // ranges over adjacent regions need the access in all of them
+  zassert_equal(check(server, 0x1E00, 0x200, WRITE), UDS_OK);
+  zassert_equal(check(server, 0x0F00, 0x200, READ), UDS_OK);
+  zassert_equal(check(server, 0x0F00, 0x200, WRITE),
+                UDS_NRC_RequestOutOfRange);
+
+  // the later of two regions with the same size
+  const struct uds_memory_region *region = uds_memory_map_find(&map, 0x4800);
+  zassert_not_null(region);
+  zassert_equal(region->access, READ);
+  zassert_equal(region->session_count, 0);
+}
+
+ZTEST(lib_uds, test_0x23_0x3D_memory_map_session_and_security) {
+  UDSServer_t server = default_server;
+
+  const struct uds_memory_region session_regions[] = {
+    {.start = 0x4000, .end = 0x4FFF, .access = READ,
+     .sessions = extended_session_only,
+     .session_count = ARRAY_SIZE(extended_session_only)},
+    {.start = 0x3000, .end = 0x3FFF, .access = READ | UDS_MEMORY_ACCESS_MMIO,
+     .security_level = 3},
+  };
+  zassert_ok(uds_memory_map_init(&map, buffer, ARRAY_SIZE(buffer),
+                                 session_regions,
+                                 ARRAY_SIZE(session_regions)));
+
+  zassert_equal(check(&server, 0x4000, 4, READ), UDS_NRC_RequestOutOfRange);
+  zassert_equal(check(&server, 0x3000, 4, READ),
+                UDS_NRC_SecurityAccessDenied);
+
+  server.sessionType = UDS_DIAG_SESSION__EXTENDED;
+  server.securityLevel = 3;
+  zassert_equal(check(&server, 0x4000, 4, READ), UDS_OK);
+
+  bool mmio = false;
+  zassert_equal(uds_memory_map_check(&map, &server, 0x3FFC, 8, READ, &mmio),
+                UDS_OK);
+  zassert_true(mmio);
+
+  mmio = true;
+  zassert_equal(uds_memory_map_check(&map, &server, 0x4000, 8, READ, &mmio),
+                UDS_OK);
+  zassert_false(mmio);
+}
+
+ZTEST(lib_uds, test_0x23_0x3D_memory_map_invalid) {
+  struct uds_memory_region small_buffer[2];
+
+  const struct uds_memory_region reversed[] = {
+    {.start = 0x2000, .end = 0x1000, .access = READ},
+  };
+  zassert_equal(uds_memory_map_init(&map, buffer, ARRAY_SIZE(buffer), reversed,
+                                    ARRAY_SIZE(reversed)),
+                -EINVAL);
+
+  // a hole splits a region in three
+  zassert_equal(uds_memory_map_init(&map, small_buffer,
+                                    ARRAY_SIZE(small_buffer), regions, 2),
+                -ENOMEM);
+}
+
+#define LOOKUP_REGIONS 64
+// a binary search over the regions
+#define LOOKUP_MAX_PROBES (LOG2CEIL(LOOKUP_REGIONS) + 1)
+
+ZTEST(lib_uds, test_0x23_0x3D_memory_map_lookup_cost) {
+  static struct uds_memory_region many[LOOKUP_REGIONS];
+  static struct uds_memory_region many_buffer[2 * LOOKUP_REGIONS];
+
+  // regions with gaps in between, declared in reverse order
+  for (int i = 0; i < LOOKUP_REGIONS; i++) {
+    uintptr_t start = 0x100 * (LOOKUP_REGIONS - 1 - i);
+
+    many[i] = (struct uds_memory_region){
+      .start = start,
+      .end = start + 0x7F,
+      .access = READ,
+    };
+  }
+  zassert_ok(uds_memory_map_init(&map, many_buffer, ARRAY_SIZE(many_buffer),
+                                 many, ARRAY_SIZE(many)));
+  zassert_equal(map.count, LOOKUP_REGIONS);
+
+  // the map is sorted by address, the precondition of the binary search
+  for (int i = 1; i < LOOKUP_REGIONS; i++) {
+    zassert_true(map.regions[i - 1].end < map.regions[i].start);
+  }
+
+  for (int i = 0; i < LOOKUP_REGIONS; i++) {
+    zassert_equal(uds_memory_map_find(&map, 0x100 * i), &map.regions[i]);
+    zassert_equal(uds_memory_map_find(&map, 0x100 * i + 0x7F),
+                  &map.regions[i]);
+    zassert_is_null(uds_memory_map_find(&map, 0x100 * i + 0x80));
+  }
+
+#ifdef CONFIG_UDS_MEMORY_MAP_STATS
+  const uint32_t *lookups = find_stat("uds_memory_map", "lookups");
+  const uint32_t *probes = find_stat("uds_memory_map", "probes");
+  uint32_t map_probes = 0;
+  uint32_t linear_probes = 0;
+
+  for (int i = 0; i < LOOKUP_REGIONS; i++) {
+    const uintptr_t addr = 0x100 * i + 0x40;
+    const uint32_t lookups_before = *lookups;
+    const uint32_t probes_before = *probes;
+
+    zassert_not_null(uds_memory_map_find(&map, addr));
+
+    zassert_equal(*lookups - lookups_before, 1);
+    zassert_true(*probes - probes_before <= LOOKUP_MAX_PROBES,
+                 "%u probes to find 0x%04lx", *probes - probes_before,
+                 (unsigned long)addr);
+    map_probes += *probes - probes_before;
+
+    // the regions a linear search of the declared table compares
+    for (int j = 0; j < LOOKUP_REGIONS; j++) {
+      linear_probes++;
+      if (many[j].start <= addr && addr <= many[j].end) {
+        break;
+      }
+    }
+  }
+
+  TC_PRINT("%d lookups in %d regions: %u regions probed with the memory map, "
+           "%u searching linearly\n",
+           LOOKUP_REGIONS, LOOKUP_REGIONS, map_probes, linear_probes);
+  zassert_true(map_probes < linear_probes);
+#endif  // CONFIG_UDS_MEMORY_MAP_STATS
+}
+
+#if CONFIG_BOARD_NATIVE_SIM
+
+ZTEST_F(lib_uds, test_0x23_0x3D_memory_map_from_devicetree) {
+  struct uds_instance_t *instance = fixture->instance;
+
+  // uds_protected in the board overlay can not be accessed
+  UDSReadMemByAddrArgs_t read_args = {
+    .memAddr = (void *)0x1000,
+    .memSize = 4,
+    .copy = copy,
+  };
+
+  int ret = receive_event(instance, UDS_EVT_ReadMemByAddr, &read_args);
+  zassert_equal(ret, UDS_NRC_RequestOutOfRange);
+  zassert_equal(copy_fake.call_count, 0);
+
+  const uint8_t data[4] = {0};
+  UDSWriteMemByAddrArgs_t write_args = {
+    .memAddr = (void *)0x1ffc,
+    .memSize = sizeof(data),
+    .data = data,
+  };
+
+  ret = receive_event(instance, UDS_EVT_WriteMemByAddr, &write_args);
+  zassert_equal(ret, UDS_NRC_RequestOutOfRange);
+}
+#endif
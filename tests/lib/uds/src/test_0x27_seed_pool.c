@@ -0,0 +1,267 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (C) Frickly Systems GmbH
+ * SPDX-FileCopyrightText: Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "ardep/uds.h"
+#include "fixture.h"
+#include "iso14229.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <zephyr/ztest.h>
+
+#ifdef CONFIG_UDS_SECURITY_ACCESS_SEED_POOL
+
+#ifdef CONFIG_UDS_SECURITY_ACCESS_PERSISTENCE
+#include <zephyr/settings/settings.h>
+#endif
+
+#define SEED_SIZE CONFIG_UDS_SECURITY_ACCESS_SEED_SIZE
+#define KEY_SIZE CONFIG_UDS_SECURITY_ACCESS_KEY_SIZE
+
+// Levels the security access tests of the fixture do not use
+#define AES_LEVEL 3
+#define INVERTED_LEVEL 5
+
+extern struct uds_instance_t fixture_uds_instance;
+
+static uint8_t aes_key[16] = {0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6,
+                              0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C};
+
+static int inverted_key(uint8_t level,
+                        const uint8_t *seed,
+                        uint8_t *key,
+                        void *user_data) {
+  for (size_t i = 0; i < KEY_SIZE; i++) {
+    key[i] = ~seed[i % SEED_SIZE];
+  }
+  return 0;
+}
+
+UDS_REGISTER_SECURITY_ACCESS_SEED_POOL_HANDLER(&fixture_uds_instance,
+                                               AES_LEVEL,
+                                               uds_security_access_key_aes128,
+                                               aes_key);
+
+UDS_REGISTER_SECURITY_ACCESS_SEED_POOL_HANDLER(&fixture_uds_instance,
+                                               INVERTED_LEVEL,
+                                               inverted_key,
+                                               NULL);
+
+static uint8_t seed[SEED_SIZE];
+
+static uint8_t copy_seed(UDSServer_t *server, const void *data, uint16_t len) {
+  zassert_equal(len, sizeof(seed));
+  memcpy(seed, data, len);
+  return UDS_PositiveResponse;
+}
+
+static UDSErr_t request_seed(struct uds_instance_t *instance, uint8_t level) {
+  UDSSecAccessRequestSeedArgs_t args = {
+    .level = level,
+    .copySeed = copy_seed,
+  };
+
+  return receive_event(instance, UDS_EVT_SecAccessRequestSeed, &args);
+}
+
+static UDSErr_t send_key(struct uds_instance_t *instance,
+                         uint8_t level,
+                         const uint8_t *key,
+                         uint16_t len) {
+  UDSSecAccessValidateKeyArgs_t args = {
+    .level = level,
+    .key = key,
+    .len = len,
+  };
+
+  return receive_event(instance, UDS_EVT_SecAccessValidateKey, &args);
+}
+
+ZTEST_F(lib_uds, test_0x27_seed_pool_aes_key) {
+  struct uds_instance_t *instance = fixture->instance;
+  uint8_t key[KEY_SIZE];
+
+  zassert_ok(uds_security_access_seed_pool_wait_full(K_SECONDS(1)));
+
+  zassert_equal(request_seed(instance, AES_LEVEL), UDS_PositiveResponse);
+  zassert_ok(uds_security_access_key_aes128(AES_LEVEL, seed, key, aes_key));
+  zassert_equal(send_key(instance, AES_LEVEL, key, sizeof(key)),
+                UDS_PositiveResponse);
+
+  // every seed is only valid once
+  zassert_equal(send_key(instance, AES_LEVEL, key, sizeof(key)),
+                UDS_NRC_RequestSequenceError);
+
+  // the seeds differ
+  uint8_t previous_seed[SEED_SIZE];
+  memcpy(previous_seed, seed, sizeof(seed));
+  zassert_equal(request_seed(instance, AES_LEVEL), UDS_PositiveResponse);
+  zassert_true(memcmp(previous_seed, seed, sizeof(seed)) != 0);
+  zassert_ok(uds_security_access_key_aes128(AES_LEVEL, seed, key, aes_key));
+  zassert_equal(send_key(instance, AES_LEVEL, key, sizeof(key)),
+                UDS_PositiveResponse);
+}
+
+ZTEST_F(lib_uds, test_0x27_seed_pool_invalid_key) {
+  struct uds_instance_t *instance = fixture->instance;
+  uint8_t key[KEY_SIZE];
+
+  zassert_equal(send_key(instance, INVERTED_LEVEL, key, sizeof(key)),
+                UDS_NRC_RequestSequenceError);
+
+  zassert_equal(request_seed(instance, INVERTED_LEVEL), UDS_PositiveResponse);
+  inverted_key(INVERTED_LEVEL, seed, key, NULL);
+  key[KEY_SIZE - 1] ^= 1;
+  zassert_equal(send_key(instance, INVERTED_LEVEL, key, sizeof(key)),
+                UDS_NRC_InvalidKey);
+
+  // a key for the seed of another level
+  zassert_equal(request_seed(instance, AES_LEVEL), UDS_PositiveResponse);
+  inverted_key(INVERTED_LEVEL, seed, key, NULL);
+  zassert_equal(send_key(instance, INVERTED_LEVEL, key, sizeof(key)),
+                UDS_NRC_RequestSequenceError);
+
+  zassert_equal(request_seed(instance, INVERTED_LEVEL), UDS_PositiveResponse);
+  inverted_key(INVERTED_LEVEL, seed, key, NULL);
+  zassert_equal(send_key(instance, INVERTED_LEVEL, key, sizeof(key) - 1),
+                UDS_NRC_InvalidKey);
+
+  // a valid key resets the failed attempts
+  zassert_equal(request_seed(instance, INVERTED_LEVEL), UDS_PositiveResponse);
+  inverted_key(INVERTED_LEVEL, seed, key, NULL);
+  zassert_equal(send_key(instance, INVERTED_LEVEL, key, sizeof(key)),
+                UDS_PositiveResponse);
+}
+
+ZTEST_F(lib_uds, test_0x27_seed_pool_unlocked_level) {
+  struct uds_instance_t *instance = fixture->instance;
+  const uint8_t zeros[SEED_SIZE] = {0};
+  uint8_t key[KEY_SIZE];
+
+  zassert_equal(request_seed(instance, INVERTED_LEVEL), UDS_PositiveResponse);
+  inverted_key(INVERTED_LEVEL, seed, key, NULL);
+
+  instance->iso14229.server.securityLevel = INVERTED_LEVEL;
+
+  zassert_equal(request_seed(instance, INVERTED_LEVEL), UDS_PositiveResponse);
+  zassert_mem_equal(seed, zeros, sizeof(seed));
+
+  // the seed of zeros expects no key and drops the previous seed
+  zassert_equal(send_key(instance, INVERTED_LEVEL, key, sizeof(key)),
+                UDS_NRC_RequestSequenceError);
+
+  // other levels still get a seed
+  zassert_equal(request_seed(instance, AES_LEVEL), UDS_PositiveResponse);
+  zassert_true(memcmp(seed, zeros, sizeof(seed)) != 0);
+
+  instance->iso14229.server.securityLevel = 0;
+}
+
+#ifdef CONFIG_UDS_SECURITY_ACCESS_PERSISTENCE
+static int load_failed_attempts(const char *key,
+                                size_t len,
+                                settings_read_cb read_cb,
+                                void *cb_arg,
+                                void *param) {
+  zassert_equal(len, sizeof(uint8_t));
+  return read_cb(cb_arg, param, len) < 0 ? -EIO : 0;
+}
+
+static uint8_t stored_failed_attempts(uint8_t level) {
+  char name[16];
+  uint8_t attempts = 0;
+
+  snprintf(name, sizeof(name), "uds/sa/%u", level);
+  zassert_ok(
+      settings_load_subtree_direct(name, load_failed_attempts, &attempts));
+  return attempts;
+}
+#endif
+
+ZTEST_F(lib_uds, test_0x27_seed_pool_attempt_limit) {
+  struct uds_instance_t *instance = fixture->instance;
+  uint8_t key[KEY_SIZE] = {0};
+
+  for (int i = 1; i < CONFIG_UDS_SECURITY_ACCESS_MAX_ATTEMPTS; i++) {
+    zassert_equal(request_seed(instance, INVERTED_LEVEL),
+                  UDS_PositiveResponse);
+    zassert_equal(send_key(instance, INVERTED_LEVEL, key, sizeof(key)),
+                  UDS_NRC_InvalidKey);
+  }
+
+  zassert_equal(request_seed(instance, INVERTED_LEVEL), UDS_PositiveResponse);
+  zassert_equal(send_key(instance, INVERTED_LEVEL, key, sizeof(key)),
+                UDS_NRC_ExceedNumberOfAttempts);
+
+#ifdef CONFIG_UDS_SECURITY_ACCESS_PERSISTENCE
+  zassert_equal(stored_failed_attempts(INVERTED_LEVEL),
+                CONFIG_UDS_SECURITY_ACCESS_MAX_ATTEMPTS);
+#endif
+
+  // only the failing level is delayed
+  zassert_equal(request_seed(instance, INVERTED_LEVEL),
+                UDS_NRC_RequiredTimeDelayNotExpired);
+  zassert_equal(request_seed(instance, AES_LEVEL), UDS_PositiveResponse);
+
+  k_msleep(CONFIG_UDS_SECURITY_ACCESS_DELAY_MS);
+
+  // after the delay, every invalid key starts it again
+  zassert_equal(request_seed(instance, INVERTED_LEVEL), UDS_PositiveResponse);
+  zassert_equal(send_key(instance, INVERTED_LEVEL, key, sizeof(key)),
+                UDS_NRC_ExceedNumberOfAttempts);
+  zassert_equal(request_seed(instance, INVERTED_LEVEL),
+                UDS_NRC_RequiredTimeDelayNotExpired);
+
+  k_msleep(CONFIG_UDS_SECURITY_ACCESS_DELAY_MS);
+
+  zassert_equal(request_seed(instance, INVERTED_LEVEL), UDS_PositiveResponse);
+  inverted_key(INVERTED_LEVEL, seed, key, NULL);
+  zassert_equal(send_key(instance, INVERTED_LEVEL, key, sizeof(key)),
+                UDS_PositiveResponse);
+
+#ifdef CONFIG_UDS_SECURITY_ACCESS_PERSISTENCE
+  zassert_equal(stored_failed_attempts(INVERTED_LEVEL), 0);
+#endif
+}
+
+ZTEST_F(lib_uds, test_0x27_seed_pool_latency) {
+  struct uds_instance_t *instance = fixture->instance;
+  uint8_t key[KEY_SIZE];
+
+  zassert_ok(uds_security_access_seed_pool_wait_full(K_SECONDS(1)));
+
+  // The test thread is not preempted by the refilling work queue, so the
+  // requests after the first CONFIG_UDS_SECURITY_ACCESS_SEED_POOL_SIZE ones
+  // compute the seed and key like a handler without a pool
+  uint64_t start = k_cycle_get_64();
+  for (int i = 0; i < CONFIG_UDS_SECURITY_ACCESS_SEED_POOL_SIZE; i++) {
+    zassert_equal(request_seed(instance, AES_LEVEL), UDS_PositiveResponse);
+  }
+  const uint64_t pool_cycles = k_cycle_get_64() - start;
+
+  start = k_cycle_get_64();
+  for (int i = 0; i < CONFIG_UDS_SECURITY_ACCESS_SEED_POOL_SIZE; i++) {
+    zassert_equal(request_seed(instance, AES_LEVEL), UDS_PositiveResponse);
+  }
+  const uint64_t on_demand_cycles = k_cycle_get_64() - start;
+
+  // the seeds computed on demand are valid as well
+  zassert_ok(uds_security_access_key_aes128(AES_LEVEL, seed, key, aes_key));
+  zassert_equal(send_key(instance, AES_LEVEL, key, sizeof(key)),
+                UDS_PositiveResponse);
+
+  TC_PRINT("%d requestSeed: %llu cycles from the seed pool, "
+           "%llu cycles computed on demand\n",
+           CONFIG_UDS_SECURITY_ACCESS_SEED_POOL_SIZE,
+           (unsigned long long)pool_cycles,
+           (unsigned long long)on_demand_cycles);
+
+  zassert_ok(uds_security_access_seed_pool_wait_full(K_SECONDS(1)));
+}
+
+#endif  // CONFIG_UDS_SECURITY_ACCESS_SEED_POOL
@@ -0,0 +1,186 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (C) Frickly Systems GmbH
+ * SPDX-FileCopyrightText: Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "ardep/uds.h"
+#include "fixture.h"
+#include "iso14229.h"
+
+#include <zephyr/drivers/can.h>
+#include <zephyr/drivers/can/can_fake.h>
+#include <zephyr/ztest.h>
+
+#ifdef CONFIG_CAN_GATE
+
+#include <ardep/can_gate.h>
+
+#define APPLICATION_CAN_ID 0x123
+#define NM_CAN_ID 0x512
+
+extern struct uds_instance_t fixture_uds_instance;
+
+UDS_REGISTER_COMMUNICATION_CONTROL_DEFAULT_HANDLER(&fixture_uds_instance)
+
+static const struct can_filter nm_filter = {
+  .id = 0x500,
+  .mask = 0x700,
+};
+
+CAN_GATE_DEFINE(gate_subnet_1,
+                DEVICE_DT_GET(DT_CHOSEN(zephyr_canbus)),
+                1,
+                &nm_filter);
+
+CAN_GATE_DEFINE(gate_subnet_2,
+                DEVICE_DT_GET(DT_CHOSEN(zephyr_canbus)),
+                2,
+                &nm_filter);
+
+static const struct can_frame application_frame = {
+  .id = APPLICATION_CAN_ID,
+  .dlc = 8,
+};
+
+static const struct can_frame nm_frame = {
+  .id = NM_CAN_ID,
+  .dlc = 8,
+};
+
+static UDSErr_t communication_control(struct uds_instance_t *instance,
+                                      uint8_t ctrl_type,
+                                      uint8_t comm_type) {
+  UDSCommCtrlArgs_t args = {
+    .ctrlType = ctrl_type,
+    .commType = comm_type,
+  };
+
+  return receive_event(instance, UDS_EVT_CommCtrl, &args);
+}
+
+static int received_frames;
+
+static void count_frame(const struct device *dev,
+                        struct can_frame *frame,
+                        void *user_data) {
+  received_frames++;
+}
+
+ZTEST_F(lib_uds, test_0x28_can_gate_disable_tx) {
+  struct uds_instance_t *instance = fixture->instance;
+
+  can_gate_enable_all();
+
+  // disableRxAndTx of normal messages on all subnets
+  zassert_ok(communication_control(
+      instance, UDS_COMMUNICATION_CONTROL__DISABLE_RX_AND_TX, 0x01));
+
+  zassert_equal(can_gate_send(&gate_subnet_1, &application_frame, K_NO_WAIT,
+                              NULL, NULL),
+                -ENETDOWN);
+  zassert_equal(can_gate_send(&gate_subnet_2, &application_frame, K_NO_WAIT,
+                              NULL, NULL),
+                -ENETDOWN);
+  zassert_equal(fake_can_send_fake.call_count, 0);
+
+  // network management messages are still sent
+  zassert_ok(can_gate_send(&gate_subnet_1, &nm_frame, K_NO_WAIT, NULL, NULL));
+  zassert_equal(fake_can_send_fake.call_count, 1);
+
+  zassert_ok(communication_control(
+      instance, UDS_COMMUNICATION_CONTROL__ENABLE_RX_AND_TX, 0x01));
+  zassert_ok(can_gate_send(&gate_subnet_1, &application_frame, K_NO_WAIT,
+                           NULL, NULL));
+  zassert_equal(fake_can_send_fake.call_count, 2);
+}
+
+ZTEST_F(lib_uds, test_0x28_can_gate_disable_rx) {
+  struct uds_instance_t *instance = fixture->instance;
+  struct can_gate_rx rx;
+  struct can_frame frame;
+  const struct can_filter filter = {
+    .id = 0,
+    .mask = 0,
+  };
+
+  can_gate_enable_all();
+  received_frames = 0;
+
+  zassert_ok(can_gate_add_rx_filter(&gate_subnet_1, &rx, count_frame, NULL,
+                                    &filter));
+  can_rx_callback_t gate_callback = fake_can_add_rx_filter_fake.arg1_val;
+  void *gate_user_data = fake_can_add_rx_filter_fake.arg2_val;
+
+  // disableRxAndEnableTx of network management messages on subnet 1
+  zassert_ok(communication_control(
+      instance, UDS_COMMUNICATION_CONTROL__DISABLE_RX_AND_ENABLE_TX, 0x12));
+
+  frame = nm_frame;
+  gate_callback(fixture->can_dev, &frame, gate_user_data);
+  zassert_equal(received_frames, 0);
+
+  frame = application_frame;
+  gate_callback(fixture->can_dev, &frame, gate_user_data);
+  zassert_equal(received_frames, 1);
+
+  zassert_ok(can_gate_send(&gate_subnet_1, &nm_frame, K_NO_WAIT, NULL, NULL));
+  zassert_equal(fake_can_send_fake.call_count, 1);
+}
+
+ZTEST_F(lib_uds, test_0x28_can_gate_subnets) {
+  struct uds_instance_t *instance = fixture->instance;
+
+  can_gate_enable_all();
+
+  // enableRxAndDisableTx of both classes on subnet 2
+  zassert_ok(communication_control(
+      instance, UDS_COMMUNICATION_CONTROL__ENABLE_RX_AND_DISABLE_TX, 0x23));
+  zassert_true(can_gate_tx_enabled(&gate_subnet_1, &application_frame));
+  zassert_false(can_gate_tx_enabled(&gate_subnet_2, &application_frame));
+  zassert_false(can_gate_tx_enabled(&gate_subnet_2, &nm_frame));
+  zassert_true(can_gate_rx_enabled(&gate_subnet_2, &nm_frame));
+
+  // the subnet the request was received on
+  zassert_ok(communication_control(
+      instance, UDS_COMMUNICATION_CONTROL__ENABLE_RX_AND_DISABLE_TX, 0xF1));
+  zassert_false(can_gate_tx_enabled(&gate_subnet_1, &application_frame));
+
+  // no gate for subnet 3
+  zassert_equal(communication_control(
+                    instance,
+                    UDS_COMMUNICATION_CONTROL__ENABLE_RX_AND_DISABLE_TX, 0x31),
+                UDS_NRC_RequestOutOfRange);
+  // no message class
+  zassert_equal(communication_control(
+                    instance,
+                    UDS_COMMUNICATION_CONTROL__ENABLE_RX_AND_DISABLE_TX, 0x00),
+                UDS_NRC_RequestOutOfRange);
+}
+
+ZTEST_F(lib_uds, test_0x28_can_gate_restored_on_session_timeout) {
+  struct uds_instance_t *instance = fixture->instance;
+
+  can_gate_enable_all();
+
+  zassert_ok(communication_control(
+      instance, UDS_COMMUNICATION_CONTROL__DISABLE_RX_AND_TX, 0x03));
+  zassert_false(can_gate_tx_enabled(&gate_subnet_1, &application_frame));
+  zassert_false(can_gate_rx_enabled(&gate_subnet_2, &nm_frame));
+
+  zassert_ok(receive_event(instance, UDS_EVT_SessionTimeout, NULL));
+  zassert_true(can_gate_tx_enabled(&gate_subnet_1, &application_frame));
+  zassert_true(can_gate_rx_enabled(&gate_subnet_2, &nm_frame));
+
+  // as well as when the default session is entered
+  zassert_ok(communication_control(
+      instance, UDS_COMMUNICATION_CONTROL__DISABLE_RX_AND_TX, 0x03));
+  UDSDiagSessCtrlArgs_t args = {
+    .type = UDS_DIAG_SESSION__DEFAULT,
+  };
+  zassert_ok(receive_event(instance, UDS_EVT_DiagSessCtrl, &args));
+  zassert_true(can_gate_tx_enabled(&gate_subnet_1, &application_frame));
+}
+
+#endif  // CONFIG_CAN_GATE
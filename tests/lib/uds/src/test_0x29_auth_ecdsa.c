@@ -0,0 +1,293 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (C) Frickly Systems GmbH
+ * SPDX-FileCopyrightText: Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "ardep/uds.h"
+#include "fixture.h"
+#include "iso14229.h"
+
+#include <string.h>
+
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/ztest.h>
+
+#ifdef CONFIG_UDS_AUTHENTICATION_ECDSA
+
+#include <psa/crypto.h>
+
+#define ECDSA_ALGORITHM PSA_ALG_ECDSA(PSA_ALG_SHA_256)
+#define MAX_POLLS 10000
+
+extern struct uds_instance_t fixture_uds_instance;
+
+static const uint8_t algorithm_indicator
+    [UDS_AUTHENTICATION_ALGORITHM_INDICATOR_SIZE] = {
+      // BER encoded OID of ecdsa-with-SHA256 (1.2.840.10045.4.3.2)
+      0x06, 0x08, 0x2A, 0x86, 0x48, 0xCE, 0x3D, 0x04, 0x03, 0x02,
+};
+
+static uint8_t tester_public_key[UDS_AUTHENTICATION_ECDSA_PUBLIC_KEY_SIZE];
+static psa_key_id_t tester_signing_key;
+static psa_key_id_t tester_agreement_key;
+
+UDS_AUTHENTICATION_ECDSA_DEFINE(test_auth,
+                                algorithm_indicator,
+                                tester_public_key);
+
+UDS_REGISTER_AUTHENTICATION_ECDSA_HANDLER(&fixture_uds_instance, &test_auth);
+
+static uint8_t response[128];
+static size_t response_len;
+
+static uint8_t copy_response(UDSServer_t *server,
+                             const void *data,
+                             uint16_t len) {
+  zassert_true(response_len + len <= sizeof(response));
+  memcpy(&response[response_len], data, len);
+  response_len += len;
+  return UDS_PositiveResponse;
+}
+
+// Generates the key pair of the tester once, the tester key is cached
+static void setup_tester_key(void) {
+  if (tester_signing_key != PSA_KEY_ID_NULL) {
+    return;
+  }
+
+  zassert_equal(psa_crypto_init(), PSA_SUCCESS);
+
+  psa_key_attributes_t attributes = PSA_KEY_ATTRIBUTES_INIT;
+  psa_set_key_type(&attributes,
+                   PSA_KEY_TYPE_ECC_KEY_PAIR(PSA_ECC_FAMILY_SECP_R1));
+  psa_set_key_bits(&attributes, 256);
+  psa_set_key_usage_flags(&attributes,
+                          PSA_KEY_USAGE_SIGN_MESSAGE | PSA_KEY_USAGE_EXPORT);
+  psa_set_key_algorithm(&attributes, ECDSA_ALGORITHM);
+  zassert_equal(psa_generate_key(&attributes, &tester_signing_key),
+                PSA_SUCCESS);
+
+  size_t len;
+  zassert_equal(psa_export_public_key(tester_signing_key, tester_public_key,
+                                      sizeof(tester_public_key), &len),
+                PSA_SUCCESS);
+
+  // the same key derives the session key on the tester side
+  uint8_t private_key[32];
+  zassert_equal(psa_export_key(tester_signing_key, private_key,
+                               sizeof(private_key), &len),
+                PSA_SUCCESS);
+  psa_set_key_usage_flags(&attributes, PSA_KEY_USAGE_DERIVE);
+  psa_set_key_algorithm(&attributes, PSA_ALG_ECDH);
+  zassert_equal(psa_import_key(&attributes, private_key, len,
+                               &tester_agreement_key),
+                PSA_SUCCESS);
+}
+
+// The tester only uses PSA while the work queue is idle
+static void wait_until_idle(void) {
+  for (int i = 0; i < MAX_POLLS; i++) {
+    if (atomic_get(&test_auth.prepared) &&
+        atomic_get(&test_auth.state) !=
+            UDS_AUTHENTICATION_ECDSA_STATE__VERIFYING) {
+      return;
+    }
+    k_msleep(1);
+  }
+  ztest_test_fail();
+}
+
+static UDSErr_t receive_auth(struct uds_instance_t *instance,
+                             UDSAuthArgs_t *args,
+                             uint32_t *pending) {
+  response_len = 0;
+
+  // like the server, the request is handled again after responsePending
+  for (int i = 0; i < MAX_POLLS; i++) {
+    UDSErr_t ret = receive_event(instance, UDS_EVT_Auth, args);
+    if (ret != UDS_NRC_RequestCorrectlyReceived_ResponsePending) {
+      return ret;
+    }
+    if (pending != NULL) {
+      (*pending)++;
+    }
+    k_msleep(1);
+  }
+  return UDS_NRC_RequestCorrectlyReceived_ResponsePending;
+}
+
+static void request_challenge(struct uds_instance_t *instance,
+                              uint8_t challenge[]) {
+  UDSAuthArgs_t args = {
+    .type = UDS_LEV_AT_RCFA,
+    .copy = copy_response,
+    .set_auth_state = set_auth_state,
+    .subFuncArgs.reqChallengeArgs.algoInd = algorithm_indicator,
+  };
+
+  zassert_equal(receive_auth(instance, &args, NULL), UDS_PositiveResponse);
+  assert_auth_state(UDS_AT_RA);
+
+  zassert_equal(response_len, 2 + UDS_AUTHENTICATION_ECDSA_CHALLENGE_SIZE + 2);
+  zassert_equal(sys_get_be16(response),
+                UDS_AUTHENTICATION_ECDSA_CHALLENGE_SIZE);
+  memcpy(challenge, &response[2], UDS_AUTHENTICATION_ECDSA_CHALLENGE_SIZE);
+}
+
+static void sign_challenge(const uint8_t challenge[], uint8_t signature[]) {
+  size_t len;
+
+  zassert_equal(
+      psa_sign_message(tester_signing_key, ECDSA_ALGORITHM, challenge,
+                       UDS_AUTHENTICATION_ECDSA_CHALLENGE_SIZE, signature,
+                       UDS_AUTHENTICATION_ECDSA_SIGNATURE_SIZE, &len),
+      PSA_SUCCESS);
+  zassert_equal(len, UDS_AUTHENTICATION_ECDSA_SIGNATURE_SIZE);
+}
+
+static UDSErr_t read_data_by_id_check(const struct uds_context *const context,
+                                      bool *apply_action) {
+  if (context->registration->type == UDS_REGISTRATION_TYPE__DATA_IDENTIFIER &&
+      context->registration->data_identifier.data_id == data_id_r &&
+      context->event == UDS_EVT_ReadDataByIdent) {
+    *apply_action = true;
+  }
+  return UDS_OK;
+}
+
+ZTEST_F(lib_uds, test_0x29_auth_ecdsa_proof_of_ownership) {
+  struct uds_instance_t *instance = fixture->instance;
+  uint8_t challenge[UDS_AUTHENTICATION_ECDSA_CHALLENGE_SIZE];
+  uint8_t signature[UDS_AUTHENTICATION_ECDSA_SIGNATURE_SIZE];
+
+  setup_tester_key();
+  wait_until_idle();
+
+  // the challenge and ephemeral key were generated in the background
+  uint64_t start = k_cycle_get_64();
+  request_challenge(instance, challenge);
+  const uint64_t challenge_cycles = k_cycle_get_64() - start;
+
+  sign_challenge(challenge, signature);
+
+  UDSAuthArgs_t args = {
+    .type = UDS_LEV_AT_VPOWNU,
+    .copy = copy_response,
+    .set_auth_state = set_auth_state,
+    .subFuncArgs.verifyPownArgs = {
+      .algoInd = algorithm_indicator,
+      .pown = signature,
+      .pownLen = sizeof(signature),
+    },
+  };
+
+  // the first request only starts the verification
+  start = k_cycle_get_64();
+  response_len = 0;
+  zassert_equal(receive_event(instance, UDS_EVT_Auth, &args),
+                UDS_NRC_RequestCorrectlyReceived_ResponsePending);
+  const uint64_t blocking_cycles = k_cycle_get_64() - start;
+
+  // other services are answered during the verification
+  data_id_check_fn_fake.custom_fake = read_data_by_id_check;
+  UDSRDBIArgs_t read_args = {
+    .dataId = data_id_r,
+    .copy = copy,
+  };
+  zassert_ok(receive_event(instance, UDS_EVT_ReadDataByIdent, &read_args));
+  zassert_equal(data_id_action_fn_fake.call_count, 1);
+  zassert_equal(atomic_get(&test_auth.state),
+                UDS_AUTHENTICATION_ECDSA_STATE__VERIFYING);
+
+  uint32_t pending = 1;
+  zassert_equal(receive_auth(instance, &args, &pending), UDS_PositiveResponse);
+  const uint64_t verify_cycles = k_cycle_get_64() - start;
+
+  assert_auth_state(UDS_AT_OVAC);
+  zassert_true(test_auth.authenticated);
+
+  // the session key info is the ephemeral public key of the server
+  zassert_equal(response_len, 2 + UDS_AUTHENTICATION_ECDSA_PUBLIC_KEY_SIZE);
+  zassert_equal(sys_get_be16(response),
+                UDS_AUTHENTICATION_ECDSA_PUBLIC_KEY_SIZE);
+
+  wait_until_idle();
+  uint8_t session_key[UDS_AUTHENTICATION_ECDSA_SESSION_KEY_SIZE];
+  size_t len;
+  zassert_equal(psa_raw_key_agreement(PSA_ALG_ECDH, tester_agreement_key,
+                                      &response[2],
+                                      UDS_AUTHENTICATION_ECDSA_PUBLIC_KEY_SIZE,
+                                      session_key, sizeof(session_key), &len),
+                PSA_SUCCESS);
+  zassert_mem_equal(session_key, test_auth.session_key, sizeof(session_key));
+
+  TC_PRINT("requestChallengeForAuthentication: %llu cycles, "
+           "verifyProofOfOwnershipUnidirectional: %llu cycles with %u "
+           "responsePending, %llu cycles on the UDS thread until the first\n",
+           (unsigned long long)challenge_cycles,
+           (unsigned long long)verify_cycles, pending,
+           (unsigned long long)blocking_cycles);
+}
+
+ZTEST_F(lib_uds, test_0x29_auth_ecdsa_invalid_proof) {
+  struct uds_instance_t *instance = fixture->instance;
+  uint8_t challenge[UDS_AUTHENTICATION_ECDSA_CHALLENGE_SIZE];
+  uint8_t signature[UDS_AUTHENTICATION_ECDSA_SIGNATURE_SIZE] = {0};
+  const uint8_t unknown_algorithm
+      [UDS_AUTHENTICATION_ALGORITHM_INDICATOR_SIZE] = {0};
+
+  setup_tester_key();
+  wait_until_idle();
+
+  UDSAuthArgs_t args = {
+    .type = UDS_LEV_AT_VPOWNU,
+    .copy = copy_response,
+    .set_auth_state = set_auth_state,
+    .subFuncArgs.verifyPownArgs = {
+      .algoInd = algorithm_indicator,
+      .pown = signature,
+      .pownLen = sizeof(signature),
+    },
+  };
+
+  // deAuthenticate discards the challenge
+  request_challenge(instance, challenge);
+  UDSAuthArgs_t deauth_args = {
+    .type = UDS_LEV_AT_DA,
+    .copy = copy_response,
+    .set_auth_state = set_auth_state,
+  };
+  zassert_equal(receive_auth(instance, &deauth_args, NULL),
+                UDS_PositiveResponse);
+  assert_auth_state(UDS_AT_DAS);
+  zassert_equal(receive_auth(instance, &args, NULL),
+                UDS_NRC_RequestSequenceError);
+
+  wait_until_idle();
+  request_challenge(instance, challenge);
+
+  args.subFuncArgs.verifyPownArgs.algoInd = unknown_algorithm;
+  zassert_equal(receive_auth(instance, &args, NULL),
+                UDS_NRC_ConditionsNotCorrect);
+  args.subFuncArgs.verifyPownArgs.algoInd = algorithm_indicator;
+
+  args.subFuncArgs.verifyPownArgs.pownLen = sizeof(signature) - 1;
+  zassert_equal(receive_auth(instance, &args, NULL),
+                UDS_NRC_IncorrectMessageLengthOrInvalidFormat);
+  args.subFuncArgs.verifyPownArgs.pownLen = sizeof(signature);
+
+  // a signature of the previous challenge
+  wait_until_idle();
+  sign_challenge(challenge, signature);
+  request_challenge(instance, challenge);
+  zassert_equal(receive_auth(instance, &args, NULL), UDS_NRC_InvalidKey);
+  zassert_false(test_auth.authenticated);
+
+  // every challenge allows one attempt
+  zassert_equal(receive_auth(instance, &args, NULL),
+                UDS_NRC_RequestSequenceError);
+}
+
+#endif  // CONFIG_UDS_AUTHENTICATION_ECDSA
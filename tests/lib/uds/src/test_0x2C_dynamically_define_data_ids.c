@@ -385,3 +385,89 @@ ZTEST_F(lib_uds, test_0x2C_dynamically_define_data_ids__mixed_data) {
   assert_dynamic_data_registration_with_id(&instance->dynamic_registrations,
                                            0xFEDC, false);
 }
+
+#if CONFIG_BOARD_NATIVE_SIM
+
+ZTEST_F(lib_uds,
+        test_0x2C_dynamically_define_data_ids__memory_checked_on_definition) {
+  struct uds_instance_t *instance = fixture->instance;
+
+  data_id_check_fn_fake.custom_fake =
+      custom_check_for_0x2C_dynamically_define_data;
+  data_id_action_fn_fake.custom_fake =
+      custom_action_for_0x2C_dynamically_define_data;
+
+  // uds_protected in the board overlay can not be accessed
+  UDSDDDIArgs_t args = {
+    .type = 0x02,  // define by memory address
+    .allDataIds = false,
+    .dynamicDataId = 0xFEDC,
+    .subFuncArgs.defineByMemAddress =
+        {
+          .memAddr = (void *)0x1ffe,
+          .memSize = 2,
+        },
+  };
+
+  int ret = receive_event(instance, UDS_EVT_DynamicDefineDataId, &args);
+  zassert_equal(ret, UDS_NRC_RequestOutOfRange);
+
+  assert_dynamic_data_registration_with_id(&instance->dynamic_registrations,
+                                           0xFEDC, false);
+
+  // ranges reaching into the hole are rejected as well
+  args.subFuncArgs.defineByMemAddress.memAddr = (void *)0xfff;
+
+  ret = receive_event(instance, UDS_EVT_DynamicDefineDataId, &args);
+  zassert_equal(ret, UDS_NRC_RequestOutOfRange);
+
+  assert_dynamic_data_registration_with_id(&instance->dynamic_registrations,
+                                           0xFEDC, false);
+}
+
+ZTEST_F(lib_uds,
+        test_0x2C_dynamically_define_data_ids__memory_checked_on_read) {
+  struct uds_instance_t *instance = fixture->instance;
+
+  // uds_secured in the board overlay needs security level 1
+  instance->iso14229.server.securityLevel = 1;
+
+  UDSDDDIArgs_t args = {
+    .type = 0x02,  // define by memory address
+    .allDataIds = false,
+    .dynamicDataId = 0xFEDC,
+    .subFuncArgs.defineByMemAddress =
+        {
+          .memAddr = (void *)0x3000,
+          .memSize = 4,
+        },
+  };
+
+  int ret = receive_event(instance, UDS_EVT_DynamicDefineDataId, &args);
+  zassert_ok(ret);
+
+  assert_dynamic_data_registration_with_id(&instance->dynamic_registrations,
+                                           0xFEDC, true);
+
+  // Relocked, e.g. by a session change
+  instance->iso14229.server.securityLevel = 0;
+
+  UDSRDBIArgs_t read_arg = {
+    .dataId = 0xFEDC,
+    .copy = copy,
+  };
+
+  ret = receive_event(instance, UDS_EVT_ReadDataByIdent, &read_arg);
+  zassert_equal(ret, UDS_NRC_SecurityAccessDenied);
+  zassert_equal(copy_fake.call_count, 0);
+
+  UDSDDDIArgs_t remove_args = {
+    .type = 0x03,  // clear dynamic data id
+    .allDataIds = false,
+    .dynamicDataId = 0xFEDC,
+  };
+
+  ret = receive_event(instance, UDS_EVT_DynamicDefineDataId, &remove_args);
+  zassert_ok(ret);
+}
+#endif
@@ -0,0 +1,417 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (C) Frickly Systems GmbH
+ * SPDX-FileCopyrightText: Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "ardep/uds.h"
+#include "fixture.h"
+#include "iso14229.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+
+#ifdef CONFIG_UDS_ASYNC_ROUTINES
+
+#define BLOCKING_ROUTINE_A_ID 0xA001
+#define BLOCKING_ROUTINE_B_ID 0xA002
+#define BLOCKING_ROUTINE_C_ID 0xA003
+#define STOPPABLE_ROUTINE_ID 0xA004
+#define FAILING_ROUTINE_ID 0xA005
+#define NEVER_STARTED_ROUTINE_ID 0xA006
+#define SECURED_ROUTINE_ID 0xA007
+
+// Time for the routine workers to catch up
+#define SETTLE_TIME K_MSEC(10)
+
+extern struct uds_instance_t fixture_uds_instance;
+
+static uint8_t status_record[CONFIG_UDS_ASYNC_ROUTINE_STATUS_RECORD_SIZE];
+static uint16_t status_record_len;
+
+// Keeps only the status record of the latest response
+static uint8_t copy_status_record(UDSServer_t *server,
+                                  const void *data,
+                                  uint16_t len) {
+  zassert_true(len <= sizeof(status_record));
+  memcpy(status_record, data, len);
+  status_record_len = len;
+
+  return 0;
+}
+
+static UDSErr_t routine_control(struct uds_instance_t *instance,
+                                uint16_t id,
+                                uint8_t ctrl_type,
+                                const uint8_t *option_record,
+                                uint16_t len) {
+  UDSRoutineCtrlArgs_t args = {
+    .id = id,
+    .ctrlType = ctrl_type,
+    .optionRecord = option_record,
+    .len = len,
+    .copyStatusRecord = copy,
+  };
+
+  copy_fake.custom_fake = copy_status_record;
+  status_record_len = 0;
+
+  return receive_event(instance, UDS_EVT_RoutineCtrl, &args);
+}
+
+static void assert_status(uint8_t state, uint8_t progress) {
+  zassert_true(status_record_len >= 2);
+  zassert_equal(status_record[0], state);
+  zassert_equal(status_record[1], progress);
+}
+
+static atomic_t running_routines;
+
+// Runs until its semaphore is given
+static int blocking_routine(struct uds_async_routine *routine,
+                            const uint8_t *option_record,
+                            size_t len) {
+  struct k_sem *release = routine->user_data;
+
+  atomic_inc(&running_routines);
+  k_sem_take(release, K_FOREVER);
+  atomic_dec(&running_routines);
+
+  return 0;
+}
+
+static K_SEM_DEFINE(release_a, 0, 1);
+static K_SEM_DEFINE(release_b, 0, 1);
+static K_SEM_DEFINE(release_c, 0, 1);
+
+UDS_ASYNC_ROUTINE_DEFINE(blocking_routine_a,
+                         blocking_routine,
+                         NULL,
+                         NULL,
+                         &release_a);
+UDS_ASYNC_ROUTINE_DEFINE(blocking_routine_b,
+                         blocking_routine,
+                         NULL,
+                         NULL,
+                         &release_b);
+UDS_ASYNC_ROUTINE_DEFINE(blocking_routine_c,
+                         blocking_routine,
+                         NULL,
+                         NULL,
+                         &release_c);
+
+UDS_REGISTER_ASYNC_ROUTINE_HANDLER(&fixture_uds_instance,
+                                   BLOCKING_ROUTINE_A_ID,
+                                   uds_check_async_routine,
+                                   &blocking_routine_a);
+UDS_REGISTER_ASYNC_ROUTINE_HANDLER(&fixture_uds_instance,
+                                   BLOCKING_ROUTINE_B_ID,
+                                   uds_check_async_routine,
+                                   &blocking_routine_b);
+UDS_REGISTER_ASYNC_ROUTINE_HANDLER(&fixture_uds_instance,
+                                   BLOCKING_ROUTINE_C_ID,
+                                   uds_check_async_routine,
+                                   &blocking_routine_c);
+
+static bool system_work_done;
+
+static void system_work_handler(struct k_work *work) {
+  system_work_done = true;
+}
+
+ZTEST_F(lib_uds, test_0x31_async_routines_run_on_workers) {
+  struct uds_instance_t *instance = fixture->instance;
+
+  zassert_ok(routine_control(instance, BLOCKING_ROUTINE_A_ID,
+                             UDS_ROUTINE_CONTROL__START_ROUTINE, NULL, 0));
+  assert_status(UDS_ASYNC_ROUTINE_STATE__RUNNING, 0);
+  zassert_ok(routine_control(instance, BLOCKING_ROUTINE_B_ID,
+                             UDS_ROUTINE_CONTROL__START_ROUTINE, NULL, 0));
+  zassert_ok(routine_control(instance, BLOCKING_ROUTINE_C_ID,
+                             UDS_ROUTINE_CONTROL__START_ROUTINE, NULL, 0));
+
+  k_sleep(SETTLE_TIME);
+  zassert_equal(atomic_get(&running_routines),
+                MIN(3, CONFIG_UDS_ASYNC_ROUTINE_WORKERS));
+
+  // the routines do not block the system work queue
+  struct k_work system_work;
+  k_work_init(&system_work, system_work_handler);
+  system_work_done = false;
+  k_work_submit(&system_work);
+  k_sleep(SETTLE_TIME);
+  zassert_true(system_work_done);
+
+  // a finished routine frees its worker for the waiting one
+  k_sem_give(&release_a);
+  k_sleep(SETTLE_TIME);
+  zassert_ok(routine_control(instance, BLOCKING_ROUTINE_A_ID,
+                             UDS_ROUTINE_CONTROL__REQUEST_ROUTINE_RESULTS, NULL,
+                             0));
+  assert_status(UDS_ASYNC_ROUTINE_STATE__COMPLETED, 100);
+  zassert_equal(atomic_get(&running_routines),
+                MIN(2, CONFIG_UDS_ASYNC_ROUTINE_WORKERS));
+
+  k_sem_give(&release_b);
+  k_sem_give(&release_c);
+  k_sleep(SETTLE_TIME);
+  zassert_equal(atomic_get(&running_routines), 0);
+
+  zassert_ok(routine_control(instance, BLOCKING_ROUTINE_C_ID,
+                             UDS_ROUTINE_CONTROL__REQUEST_ROUTINE_RESULTS, NULL,
+                             0));
+  assert_status(UDS_ASYNC_ROUTINE_STATE__COMPLETED, 100);
+}
+
+static K_SEM_DEFINE(wake_stoppable, 0, 1);
+static int stoppable_stop_calls;
+
+// Reports half of its work done and waits to be stopped
+static int stoppable_routine(struct uds_async_routine *routine,
+                             const uint8_t *option_record,
+                             size_t len) {
+  uds_async_routine_set_progress(routine, 50);
+
+  while (!uds_async_routine_stop_requested(routine)) {
+    k_sem_take(&wake_stoppable, K_FOREVER);
+  }
+
+  return 0;
+}
+
+static void stop_stoppable_routine(struct uds_async_routine *routine) {
+  stoppable_stop_calls++;
+  k_sem_give(&wake_stoppable);
+}
+
+UDS_ASYNC_ROUTINE_DEFINE(stoppable,
+                         stoppable_routine,
+                         stop_stoppable_routine,
+                         NULL,
+                         NULL);
+
+UDS_REGISTER_ASYNC_ROUTINE_HANDLER(&fixture_uds_instance,
+                                   STOPPABLE_ROUTINE_ID,
+                                   uds_check_async_routine,
+                                   &stoppable);
+
+ZTEST_F(lib_uds, test_0x31_async_routine_stop) {
+  struct uds_instance_t *instance = fixture->instance;
+
+  stoppable_stop_calls = 0;
+
+  zassert_ok(routine_control(instance, STOPPABLE_ROUTINE_ID,
+                             UDS_ROUTINE_CONTROL__START_ROUTINE, NULL, 0));
+  k_sleep(SETTLE_TIME);
+
+  zassert_ok(routine_control(instance, STOPPABLE_ROUTINE_ID,
+                             UDS_ROUTINE_CONTROL__REQUEST_ROUTINE_RESULTS, NULL,
+                             0));
+  assert_status(UDS_ASYNC_ROUTINE_STATE__RUNNING, 50);
+
+  // the routine stops on the worker after the response
+  zassert_ok(routine_control(instance, STOPPABLE_ROUTINE_ID,
+                             UDS_ROUTINE_CONTROL__STOP_ROUTINE, NULL, 0));
+  assert_status(UDS_ASYNC_ROUTINE_STATE__RUNNING, 50);
+  zassert_equal(stoppable_stop_calls, 1);
+
+  k_sleep(SETTLE_TIME);
+  zassert_ok(routine_control(instance, STOPPABLE_ROUTINE_ID,
+                             UDS_ROUTINE_CONTROL__REQUEST_ROUTINE_RESULTS, NULL,
+                             0));
+  assert_status(UDS_ASYNC_ROUTINE_STATE__STOPPED, 50);
+
+  // a stopped routine can not be stopped again but restarted
+  zassert_equal(routine_control(instance, STOPPABLE_ROUTINE_ID,
+                                UDS_ROUTINE_CONTROL__STOP_ROUTINE, NULL, 0),
+                UDS_NRC_RequestSequenceError);
+  zassert_ok(routine_control(instance, STOPPABLE_ROUTINE_ID,
+                             UDS_ROUTINE_CONTROL__START_ROUTINE, NULL, 0));
+  assert_status(UDS_ASYNC_ROUTINE_STATE__RUNNING, 0);
+
+  zassert_ok(routine_control(instance, STOPPABLE_ROUTINE_ID,
+                             UDS_ROUTINE_CONTROL__STOP_ROUTINE, NULL, 0));
+  k_sleep(SETTLE_TIME);
+}
+
+static uint8_t failing_option_record[2];
+
+static int failing_routine(struct uds_async_routine *routine,
+                           const uint8_t *option_record,
+                           size_t len) {
+  memcpy(failing_option_record, option_record, len);
+
+  return -EIO;
+}
+
+// Reports the error code of the routine
+static int failing_routine_results(struct uds_async_routine *routine,
+                                   uint8_t *buf,
+                                   size_t size) {
+  zassert_true(size >= 1);
+  buf[0] = -routine->result;
+
+  return 1;
+}
+
+UDS_ASYNC_ROUTINE_DEFINE(failing,
+                         failing_routine,
+                         NULL,
+                         failing_routine_results,
+                         NULL);
+
+UDS_REGISTER_ASYNC_ROUTINE_HANDLER(&fixture_uds_instance,
+                                   FAILING_ROUTINE_ID,
+                                   uds_check_async_routine,
+                                   &failing);
+
+ZTEST_F(lib_uds, test_0x31_async_routine_failure) {
+  struct uds_instance_t *instance = fixture->instance;
+
+  const uint8_t option_record[] = {0x12, 0x34};
+
+  zassert_ok(routine_control(instance, FAILING_ROUTINE_ID,
+                             UDS_ROUTINE_CONTROL__START_ROUTINE, option_record,
+                             sizeof(option_record)));
+  k_sleep(SETTLE_TIME);
+  zassert_mem_equal(failing_option_record, option_record,
+                    sizeof(option_record));
+
+  zassert_ok(routine_control(instance, FAILING_ROUTINE_ID,
+                             UDS_ROUTINE_CONTROL__REQUEST_ROUTINE_RESULTS, NULL,
+                             0));
+  const uint8_t expected[] = {UDS_ASYNC_ROUTINE_STATE__FAILED, 0, EIO};
+  zassert_equal(status_record_len, sizeof(expected));
+  zassert_mem_equal(status_record, expected, sizeof(expected));
+}
+
+UDS_ASYNC_ROUTINE_DEFINE(never_started, failing_routine, NULL, NULL, NULL);
+
+UDS_REGISTER_ASYNC_ROUTINE_HANDLER(&fixture_uds_instance,
+                                   NEVER_STARTED_ROUTINE_ID,
+                                   uds_check_async_routine,
+                                   &never_started);
+
+ZTEST_F(lib_uds, test_0x31_async_routine_sequence_errors) {
+  struct uds_instance_t *instance = fixture->instance;
+
+  const uint8_t long_option_record[CONFIG_UDS_ASYNC_ROUTINE_OPTION_RECORD_SIZE +
+                                   1] = {0};
+
+  zassert_equal(
+      routine_control(instance, NEVER_STARTED_ROUTINE_ID,
+                      UDS_ROUTINE_CONTROL__REQUEST_ROUTINE_RESULTS, NULL, 0),
+      UDS_NRC_RequestSequenceError);
+  zassert_equal(routine_control(instance, NEVER_STARTED_ROUTINE_ID,
+                                UDS_ROUTINE_CONTROL__STOP_ROUTINE, NULL, 0),
+                UDS_NRC_RequestSequenceError);
+  zassert_equal(routine_control(instance, NEVER_STARTED_ROUTINE_ID,
+                                UDS_ROUTINE_CONTROL__START_ROUTINE,
+                                long_option_record, sizeof(long_option_record)),
+                UDS_NRC_IncorrectMessageLengthOrInvalidFormat);
+  zassert_equal(atomic_get(&never_started.state),
+                UDS_ASYNC_ROUTINE_STATE__NOT_STARTED);
+
+  zassert_ok(routine_control(instance, STOPPABLE_ROUTINE_ID,
+                             UDS_ROUTINE_CONTROL__START_ROUTINE, NULL, 0));
+  zassert_equal(routine_control(instance, STOPPABLE_ROUTINE_ID,
+                                UDS_ROUTINE_CONTROL__START_ROUTINE, NULL, 0),
+                UDS_NRC_RequestSequenceError);
+
+  zassert_ok(routine_control(instance, STOPPABLE_ROUTINE_ID,
+                             UDS_ROUTINE_CONTROL__STOP_ROUTINE, NULL, 0));
+  k_sleep(SETTLE_TIME);
+}
+
+static UDSErr_t check_unlocked(const struct uds_context *const context,
+                               bool *apply_action) {
+  if (context->server->securityLevel == 0) {
+    return UDS_NRC_SecurityAccessDenied;
+  }
+
+  *apply_action = true;
+  return UDS_OK;
+}
+
+UDS_REGISTER_ASYNC_ROUTINE_HANDLER(&fixture_uds_instance,
+                                   SECURED_ROUTINE_ID,
+                                   check_unlocked,
+                                   &stoppable);
+
+ZTEST_F(lib_uds, test_0x31_async_routine_check) {
+  struct uds_instance_t *instance = fixture->instance;
+
+  stoppable_stop_calls = 0;
+
+  zassert_equal(routine_control(instance, SECURED_ROUTINE_ID,
+                                UDS_ROUTINE_CONTROL__START_ROUTINE, NULL, 0),
+                UDS_NRC_SecurityAccessDenied);
+  zassert_equal(atomic_get(&stoppable.state),
+                UDS_ASYNC_ROUTINE_STATE__NOT_STARTED);
+
+  instance->iso14229.server.securityLevel = 1;
+  zassert_ok(routine_control(instance, SECURED_ROUTINE_ID,
+                             UDS_ROUTINE_CONTROL__START_ROUTINE, NULL, 0));
+  assert_status(UDS_ASYNC_ROUTINE_STATE__RUNNING, 0);
+
+  // the check applies to every subfunction
+  instance->iso14229.server.securityLevel = 0;
+  zassert_equal(routine_control(instance, SECURED_ROUTINE_ID,
+                                UDS_ROUTINE_CONTROL__STOP_ROUTINE, NULL, 0),
+                UDS_NRC_SecurityAccessDenied);
+  zassert_equal(stoppable_stop_calls, 0);
+
+  instance->iso14229.server.securityLevel = 1;
+  zassert_ok(routine_control(instance, SECURED_ROUTINE_ID,
+                             UDS_ROUTINE_CONTROL__STOP_ROUTINE, NULL, 0));
+  k_sleep(SETTLE_TIME);
+  instance->iso14229.server.securityLevel = 0;
+}
+
+ZTEST_F(lib_uds, test_0x31_async_routine_stopped_on_session_change) {
+  struct uds_instance_t *instance = fixture->instance;
+
+  stoppable_stop_calls = 0;
+
+  // on session timeout
+  zassert_ok(routine_control(instance, STOPPABLE_ROUTINE_ID,
+                             UDS_ROUTINE_CONTROL__START_ROUTINE, NULL, 0));
+  k_sleep(SETTLE_TIME);
+
+  zassert_ok(receive_event(instance, UDS_EVT_SessionTimeout, NULL));
+  zassert_equal(stoppable_stop_calls, 1);
+
+  k_sleep(SETTLE_TIME);
+  zassert_ok(routine_control(instance, STOPPABLE_ROUTINE_ID,
+                             UDS_ROUTINE_CONTROL__REQUEST_ROUTINE_RESULTS, NULL,
+                             0));
+  assert_status(UDS_ASYNC_ROUTINE_STATE__STOPPED, 50);
+
+  // not when another non-default session is entered
+  zassert_ok(routine_control(instance, STOPPABLE_ROUTINE_ID,
+                             UDS_ROUTINE_CONTROL__START_ROUTINE, NULL, 0));
+  k_sleep(SETTLE_TIME);
+
+  UDSDiagSessCtrlArgs_t args = {
+    .type = UDS_DIAG_SESSION__EXTENDED,
+  };
+  receive_event(instance, UDS_EVT_DiagSessCtrl, &args);
+  zassert_equal(stoppable_stop_calls, 1);
+
+  // but when the default session is entered
+  args.type = UDS_DIAG_SESSION__DEFAULT;
+  zassert_ok(receive_event(instance, UDS_EVT_DiagSessCtrl, &args));
+  zassert_equal(stoppable_stop_calls, 2);
+
+  k_sleep(SETTLE_TIME);
+  zassert_ok(routine_control(instance, STOPPABLE_ROUTINE_ID,
+                             UDS_ROUTINE_CONTROL__REQUEST_ROUTINE_RESULTS, NULL,
+                             0));
+  assert_status(UDS_ASYNC_ROUTINE_STATE__STOPPED, 50);
+}
+
+#endif  // CONFIG_UDS_ASYNC_ROUTINES
@@ -0,0 +1,267 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (C) Frickly Systems GmbH
+ * SPDX-FileCopyrightText: Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "ardep/uds.h"
+#include "fixture.h"
+#include "iso14229.h"
+
+#include <string.h>
+
+#include <zephyr/drivers/flash.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/ztest.h>
+
+#ifdef CONFIG_UDS_DOWNLOAD_DIGEST_CRC32
+#include <zephyr/sys/crc.h>
+#endif
+#ifdef CONFIG_UDS_DOWNLOAD_DIGEST_SHA256
+#include <psa/crypto.h>
+#endif
+
+#define DIGEST_FLASH_BASE_ADDRESS \
+  DT_REG_ADDR(DT_CHOSEN(zephyr_flash_controller))
+#define DIGEST_STORAGE_OFFSET DT_REG_ADDR(DT_NODELABEL(storage_partition))
+#define DIGEST_STORAGE_SIZE DT_REG_SIZE(DT_NODELABEL(storage_partition))
+
+static const struct device *const digest_flash =
+    DEVICE_DT_GET(DT_CHOSEN(zephyr_flash_controller));
+
+static uint8_t image[DIGEST_STORAGE_SIZE / 2];
+
+static void expected_digest(const uint8_t *data,
+                            size_t len,
+                            uint8_t digest[UDS_DOWNLOAD_DIGEST_SIZE]) {
+#ifdef CONFIG_UDS_DOWNLOAD_DIGEST_CRC32
+  sys_put_be32(crc32_ieee(data, len), digest);
+#endif
+#ifdef CONFIG_UDS_DOWNLOAD_DIGEST_SHA256
+  size_t digest_len;
+  zassert_equal(psa_crypto_init(), PSA_SUCCESS);
+  zassert_equal(psa_hash_compute(PSA_ALG_SHA_256, data, len, digest,
+                                 UDS_DOWNLOAD_DIGEST_SIZE, &digest_len),
+                PSA_SUCCESS);
+#endif
+}
+
+static UDSErr_t request_download(struct uds_instance_t *instance,
+                                 size_t size,
+                                 uint8_t data_format_identifier) {
+  UDSRequestDownloadArgs_t args = {
+    .addr = (void *)(DIGEST_FLASH_BASE_ADDRESS + DIGEST_STORAGE_OFFSET),
+    .size = size,
+    .dataFormatIdentifier = data_format_identifier,
+  };
+
+  return receive_event(instance, UDS_EVT_RequestDownload, &args);
+}
+
+static void download(struct uds_instance_t *instance,
+                     const uint8_t *data,
+                     size_t len,
+                     size_t block_len) {
+  zassert_equal(
+      flash_erase(digest_flash, DIGEST_STORAGE_OFFSET, DIGEST_STORAGE_SIZE), 0);
+
+  zassert_equal(request_download(instance, len, 0x00), UDS_OK);
+
+  for (size_t offset = 0; offset < len; offset += block_len) {
+    UDSTransferDataArgs_t args = {
+      .data = &data[offset],
+      .len = MIN(block_len, len - offset),
+    };
+    zassert_equal(receive_event(instance, UDS_EVT_TransferData, &args), UDS_OK);
+  }
+
+  zassert_equal(receive_event(instance, UDS_EVT_RequestTransferExit, NULL),
+                UDS_OK);
+}
+
+static UDSErr_t check_programming_dependencies(struct uds_instance_t *instance,
+                                               uint8_t ctrl_type,
+                                               const uint8_t *expected,
+                                               size_t expected_len) {
+  UDSRoutineCtrlArgs_t args = {
+    .id = UDS_IO_CONTROL__CHECK_PROGRAMMING_DEPENDENCIES,
+    .ctrlType = ctrl_type,
+    .len = expected_len,
+    .optionRecord = expected,
+    .copyStatusRecord = copy,
+  };
+
+  instance->iso14229.server.sessionType = UDS_DIAG_SESSION__PROGRAMMING;
+  return receive_event(instance, UDS_EVT_RoutineCtrl, &args);
+}
+
+static void fill_image(void) {
+  for (size_t i = 0; i < sizeof(image); i++) {
+    image[i] = (uint8_t)(i * 13 + (i >> 7));
+  }
+}
+
+ZTEST_F(lib_uds, test_0x31_check_programming_dependencies_known_digest) {
+  struct uds_instance_t *instance = fixture->instance;
+
+#ifdef CONFIG_UDS_DOWNLOAD_DIGEST_CRC32
+  const uint8_t digest[] = {0x35, 0x24, 0x41, 0xC2};
+#endif
+#ifdef CONFIG_UDS_DOWNLOAD_DIGEST_SHA256
+  const uint8_t digest[] = {
+    0xBA, 0x78, 0x16, 0xBF, 0x8F, 0x01, 0xCF, 0xEA, 0x41, 0x41, 0x40,
+    0xDE, 0x5D, 0xAE, 0x22, 0x23, 0xB0, 0x03, 0x61, 0xA3, 0x96, 0x17,
+    0x7A, 0x9C, 0xB4, 0x10, 0xFF, 0x61, 0xF2, 0x00, 0x15, 0xAD,
+  };
+#endif
+
+  download(instance, (const uint8_t *)"abc", 3, 3);
+
+  zassert_equal(
+      check_programming_dependencies(
+          instance, UDS_ROUTINE_CONTROL__START_ROUTINE, NULL, 0),
+      UDS_OK);
+  assert_copy_data(digest, sizeof(digest));
+}
+
+ZTEST_F(lib_uds, test_0x31_check_programming_dependencies_multiple_blocks) {
+  struct uds_instance_t *instance = fixture->instance;
+  uint8_t digest[UDS_DOWNLOAD_DIGEST_SIZE];
+
+  fill_image();
+  expected_digest(image, sizeof(image) - 3, digest);
+
+  // the last block is not a multiple of the write block size
+  download(instance, image, sizeof(image) - 3, 120);
+
+  zassert_equal(
+      check_programming_dependencies(
+          instance, UDS_ROUTINE_CONTROL__REQUEST_ROUTINE_RESULTS, NULL, 0),
+      UDS_OK);
+  assert_copy_data(digest, sizeof(digest));
+}
+
+static void assert_check_result(uint8_t result,
+                                const uint8_t digest[UDS_DOWNLOAD_DIGEST_SIZE]) {
+  uint8_t record[1 + UDS_DOWNLOAD_DIGEST_SIZE] = {result};
+  memcpy(&record[1], digest, UDS_DOWNLOAD_DIGEST_SIZE);
+  assert_copy_data(record, sizeof(record));
+}
+
+ZTEST_F(lib_uds, test_0x31_check_programming_dependencies_correct) {
+  struct uds_instance_t *instance = fixture->instance;
+  uint8_t digest[UDS_DOWNLOAD_DIGEST_SIZE];
+
+  fill_image();
+  expected_digest(image, sizeof(image), digest);
+  download(instance, image, sizeof(image), 256);
+
+  zassert_equal(check_programming_dependencies(
+                    instance, UDS_ROUTINE_CONTROL__START_ROUTINE, digest,
+                    sizeof(digest)),
+                UDS_OK);
+  assert_check_result(UDS_CHECK_PROGRAMMING_DEPENDENCIES_CORRECT, digest);
+}
+
+ZTEST_F(lib_uds, test_0x31_check_programming_dependencies_incorrect) {
+  struct uds_instance_t *instance = fixture->instance;
+  uint8_t digest[UDS_DOWNLOAD_DIGEST_SIZE];
+  uint8_t other[UDS_DOWNLOAD_DIGEST_SIZE];
+
+  fill_image();
+  expected_digest(image, sizeof(image), digest);
+  download(instance, image, sizeof(image), 256);
+
+  memcpy(other, digest, sizeof(other));
+  other[0] ^= 0xFF;
+
+  zassert_equal(check_programming_dependencies(
+                    instance, UDS_ROUTINE_CONTROL__START_ROUTINE, other,
+                    sizeof(other)),
+                UDS_OK);
+  assert_check_result(UDS_CHECK_PROGRAMMING_DEPENDENCIES_INCORRECT, digest);
+}
+
+ZTEST_F(lib_uds, test_0x31_check_programming_dependencies_delta_download) {
+  struct uds_instance_t *instance = fixture->instance;
+  const size_t len = 300;
+  uint8_t digest[UDS_DOWNLOAD_DIGEST_SIZE];
+  static uint8_t patch[16 + 5 + 300];
+
+  fill_image();
+  expected_digest(image, len, digest);
+
+  // a patch without an old image that inserts the whole new image
+  sys_put_le32(UDS_DELTA_MAGIC, &patch[0]);
+  sys_put_le32(0, &patch[4]);
+  sys_put_le32(0, &patch[8]);
+  sys_put_le32(len, &patch[12]);
+  patch[16] = UDS_DELTA_OP_INSERT;
+  sys_put_le32(len, &patch[17]);
+  memcpy(&patch[21], image, len);
+
+  zassert_equal(
+      request_download(instance, len, UDS_DATA_FORMAT_IDENTIFIER_DELTA),
+      UDS_OK);
+  UDSTransferDataArgs_t args = {
+    .data = patch,
+    .len = sizeof(patch),
+  };
+  zassert_equal(receive_event(instance, UDS_EVT_TransferData, &args), UDS_OK);
+  zassert_equal(receive_event(instance, UDS_EVT_RequestTransferExit, NULL),
+                UDS_OK);
+
+  // the digest covers the resulting image, not the patch
+  zassert_equal(
+      check_programming_dependencies(
+          instance, UDS_ROUTINE_CONTROL__START_ROUTINE, NULL, 0),
+      UDS_OK);
+  assert_copy_data(digest, sizeof(digest));
+}
+
+ZTEST_F(lib_uds, test_0x31_check_programming_dependencies_before_exit) {
+  struct uds_instance_t *instance = fixture->instance;
+
+  download(instance, (const uint8_t *)"abc", 3, 3);
+
+  // a new download discards the digest of the previous one
+  zassert_equal(request_download(instance, 128, 0x00), UDS_OK);
+
+  zassert_equal(
+      check_programming_dependencies(
+          instance, UDS_ROUTINE_CONTROL__START_ROUTINE, NULL, 0),
+      UDS_NRC_RequestSequenceError);
+}
+
+ZTEST_F(lib_uds,
+        test_0x31_check_programming_dependencies_invalid_option_record) {
+  struct uds_instance_t *instance = fixture->instance;
+  const uint8_t expected[UDS_DOWNLOAD_DIGEST_SIZE + 1] = {0};
+
+  download(instance, (const uint8_t *)"abc", 3, 3);
+
+  zassert_equal(check_programming_dependencies(
+                    instance, UDS_ROUTINE_CONTROL__START_ROUTINE, expected,
+                    sizeof(expected)),
+                UDS_NRC_IncorrectMessageLengthOrInvalidFormat);
+}
+
+ZTEST_F(lib_uds,
+        test_0x31_check_programming_dependencies_requires_programming_session) {
+  struct uds_instance_t *instance = fixture->instance;
+
+  download(instance, (const uint8_t *)"abc", 3, 3);
+
+  UDSRoutineCtrlArgs_t args = {
+    .id = UDS_IO_CONTROL__CHECK_PROGRAMMING_DEPENDENCIES,
+    .ctrlType = UDS_ROUTINE_CONTROL__START_ROUTINE,
+    .copyStatusRecord = copy,
+  };
+
+  const unsigned int copies = copy_fake.call_count;
+  instance->iso14229.server.sessionType = UDS_DIAG_SESSION__DEFAULT;
+  zassert_equal(receive_event(instance, UDS_EVT_RoutineCtrl, &args),
+                UDS_NRC_RequestOutOfRange);
+  zassert_equal(copy_fake.call_count, copies);
+}
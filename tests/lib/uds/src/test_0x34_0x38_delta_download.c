@@ -0,0 +1,279 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (C) Frickly Systems GmbH
+ * SPDX-FileCopyrightText: Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "ardep/uds.h"
+#include "fixture.h"
+#include "iso14229.h"
+
+#include <string.h>
+
+#include <zephyr/drivers/flash.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/crc.h>
+#include <zephyr/ztest.h>
+
+#define DELTA_FLASH_BASE_ADDRESS \
+  DT_REG_ADDR(DT_CHOSEN(zephyr_flash_controller))
+#define DELTA_STORAGE_OFFSET DT_REG_ADDR(DT_NODELABEL(storage_partition))
+#define DELTA_STORAGE_SIZE DT_REG_SIZE(DT_NODELABEL(storage_partition))
+
+// the images span three sectors of the storage partition
+#define DELTA_IMAGE_MAX_SIZE (DELTA_STORAGE_SIZE / 4 * 3)
+
+static const struct device *const delta_flash =
+    DEVICE_DT_GET(DT_CHOSEN(zephyr_flash_controller));
+
+static uint8_t old_image[DELTA_IMAGE_MAX_SIZE];
+static uint8_t new_image[DELTA_IMAGE_MAX_SIZE];
+static uint8_t patch[DELTA_IMAGE_MAX_SIZE];
+static size_t patch_len;
+
+static size_t sector_size(void) {
+  struct flash_pages_info page;
+  zassert_equal(
+      flash_get_page_info_by_offs(delta_flash, DELTA_STORAGE_OFFSET, &page), 0);
+  return page.size;
+}
+
+static void patch_header(size_t old_size, size_t new_size) {
+  patch_len = 0;
+  sys_put_le32(UDS_DELTA_MAGIC, &patch[0]);
+  sys_put_le32(old_size, &patch[4]);
+  sys_put_le32(crc32_ieee(old_image, old_size), &patch[8]);
+  sys_put_le32(new_size, &patch[12]);
+  patch_len = 16;
+}
+
+// Copies old[source, source + len) to new[pos, pos + len)
+static void patch_copy(size_t pos, size_t source, size_t len) {
+  memcpy(&new_image[pos], &old_image[source], len);
+
+  patch[patch_len] = UDS_DELTA_OP_COPY;
+  sys_put_le32(len, &patch[patch_len + 1]);
+  sys_put_le32(source, &patch[patch_len + 5]);
+  patch_len += 9;
+}
+
+// Inserts len bytes of a new pattern at new[pos]
+static void patch_insert(size_t pos, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    new_image[pos + i] = (uint8_t)(0xA5 ^ (pos + i));
+  }
+
+  patch[patch_len] = UDS_DELTA_OP_INSERT;
+  sys_put_le32(len, &patch[patch_len + 1]);
+  memcpy(&patch[patch_len + 5], &new_image[pos], len);
+  patch_len += 5 + len;
+}
+
+static void write_old_image(size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    old_image[i] = (uint8_t)(i * 7 + (i >> 8));
+  }
+
+  zassert_equal(
+      flash_erase(delta_flash, DELTA_STORAGE_OFFSET, DELTA_STORAGE_SIZE), 0);
+  zassert_equal(flash_write(delta_flash, DELTA_STORAGE_OFFSET, old_image,
+                            ROUND_UP(size, 8)),
+                0);
+}
+
+static UDSErr_t request_delta_download(struct uds_instance_t *instance,
+                                       size_t new_size) {
+  UDSRequestDownloadArgs_t args = {
+    .addr = (void *)(DELTA_FLASH_BASE_ADDRESS + DELTA_STORAGE_OFFSET),
+    .size = new_size,
+    .dataFormatIdentifier = UDS_DATA_FORMAT_IDENTIFIER_DELTA,
+  };
+
+  return receive_event(instance, UDS_EVT_RequestDownload, &args);
+}
+
+// Number of ResponsePending answers of the last transfer_patch
+static size_t response_pending_count;
+
+// Sends the patch in TransferData requests of block_len bytes, requests
+// answered with ResponsePending are handled again like the server does
+static UDSErr_t transfer_patch(struct uds_instance_t *instance,
+                               size_t block_len) {
+  response_pending_count = 0;
+
+  for (size_t offset = 0; offset < patch_len; offset += block_len) {
+    UDSTransferDataArgs_t args = {
+      .data = &patch[offset],
+      .len = MIN(block_len, patch_len - offset),
+    };
+
+    UDSErr_t ret;
+    do {
+      ret = receive_event(instance, UDS_EVT_TransferData, &args);
+      if (ret == UDS_NRC_RequestCorrectlyReceived_ResponsePending) {
+        response_pending_count++;
+      }
+    } while (ret == UDS_NRC_RequestCorrectlyReceived_ResponsePending);
+
+    if (ret != UDS_OK) {
+      return ret;
+    }
+  }
+
+  return UDS_OK;
+}
+
+static void assert_new_image(size_t size) {
+  uint8_t buf[64];
+
+  for (size_t offset = 0; offset < size; offset += sizeof(buf)) {
+    const size_t len = MIN(sizeof(buf), size - offset);
+    zassert_equal(
+        flash_read(delta_flash, DELTA_STORAGE_OFFSET + offset, buf, len), 0);
+    zassert_mem_equal(buf, &new_image[offset], len, "mismatch at %zu", offset);
+  }
+}
+
+// Builds a patch that inserts, deletes and moves data within and across
+// sectors
+static size_t build_patch(void) {
+  const size_t s = sector_size();
+  const size_t old_size = 3 * s;
+  size_t pos = 0;
+
+  write_old_image(old_size);
+  memset(new_image, 0, sizeof(new_image));
+  patch_header(old_size, 0);
+
+  // changed header
+  patch_insert(pos, 16);
+  pos += 16;
+  patch_copy(pos, pos, s - pos);
+  pos = s;
+
+  // 8 bytes deleted
+  patch_copy(pos, pos + 8, s / 2);
+  pos += s / 2;
+  // 4 bytes inserted
+  patch_insert(pos, 4);
+  pos += 4;
+  patch_copy(pos, pos + 4, 2 * s - pos);
+  pos = 2 * s;
+
+  // moved within the sector, sources before the write position are still
+  // intact until the sector is written
+  patch_copy(pos, pos + 100, 200);
+  patch_copy(pos + 200, pos, 100);
+  pos += 300;
+  patch_copy(pos, pos, old_size - pos - 24);
+  pos = old_size - 24;
+
+  // the new image ends in the middle of a write block
+  patch_insert(pos, 3);
+  pos += 3;
+
+  sys_put_le32(pos, &patch[12]);
+  return pos;
+}
+
+ZTEST_F(lib_uds, test_0x34_0x38_delta_download) {
+  struct uds_instance_t *instance = fixture->instance;
+  const size_t new_size = build_patch();
+
+  zassert_equal(request_delta_download(instance, new_size), UDS_OK);
+  zassert_equal(transfer_patch(instance, 512), UDS_OK);
+  zassert_equal(receive_event(instance, UDS_EVT_RequestTransferExit, NULL),
+                UDS_OK);
+
+  assert_new_image(new_size);
+
+  TC_PRINT("delta download: %zu bytes transferred for an image of %zu bytes\n",
+           patch_len, new_size);
+}
+
+ZTEST_F(lib_uds, test_0x34_0x38_delta_download_checks_old_image_in_chunks) {
+  struct uds_instance_t *instance = fixture->instance;
+  const size_t new_size = build_patch();
+  const size_t old_size = 3 * sector_size();
+
+  // the request of the header is pending until the whole old image is
+  // checked, one chunk per call
+  zassert_equal(request_delta_download(instance, new_size), UDS_OK);
+  zassert_equal(transfer_patch(instance, 512), UDS_OK);
+  zassert_equal(
+      response_pending_count,
+      DIV_ROUND_UP(old_size, CONFIG_UDS_DELTA_DOWNLOAD_CHECK_CHUNK_SIZE) - 1);
+  zassert_equal(receive_event(instance, UDS_EVT_RequestTransferExit, NULL),
+                UDS_OK);
+
+  assert_new_image(new_size);
+}
+
+ZTEST_F(lib_uds, test_0x34_0x38_delta_download_small_blocks) {
+  struct uds_instance_t *instance = fixture->instance;
+  const size_t new_size = build_patch();
+
+  // operations split across TransferData requests
+  zassert_equal(request_delta_download(instance, new_size), UDS_OK);
+  zassert_equal(transfer_patch(instance, 3), UDS_OK);
+  zassert_equal(receive_event(instance, UDS_EVT_RequestTransferExit, NULL),
+                UDS_OK);
+
+  assert_new_image(new_size);
+}
+
+ZTEST_F(lib_uds, test_0x34_0x38_delta_download_rejects_other_old_image) {
+  struct uds_instance_t *instance = fixture->instance;
+  const size_t new_size = build_patch();
+
+  // the installed image differs from the one the patch was made for
+  sys_put_le32(~crc32_ieee(old_image, 3 * sector_size()), &patch[8]);
+
+  zassert_equal(request_delta_download(instance, new_size), UDS_OK);
+  zassert_equal(transfer_patch(instance, 512), UDS_NRC_ConditionsNotCorrect);
+  zassert_equal(receive_event(instance, UDS_EVT_RequestTransferExit, NULL),
+                UDS_NRC_RequestSequenceError);
+}
+
+ZTEST_F(lib_uds, test_0x34_0x38_delta_download_rejects_overwritten_source) {
+  struct uds_instance_t *instance = fixture->instance;
+  const size_t s = sector_size();
+
+  write_old_image(2 * s);
+  patch_header(2 * s, 2 * s);
+  patch_copy(0, 0, s);
+  // the first sector is already overwritten
+  patch_copy(s, 0, s);
+
+  zassert_equal(request_delta_download(instance, 2 * s), UDS_OK);
+  zassert_equal(transfer_patch(instance, 512),
+                UDS_NRC_GeneralProgrammingFailure);
+}
+
+ZTEST_F(lib_uds, test_0x34_0x38_delta_download_incomplete) {
+  struct uds_instance_t *instance = fixture->instance;
+  const size_t s = sector_size();
+
+  write_old_image(s);
+  patch_header(s, 2 * s);
+  patch_copy(0, 0, s);
+
+  zassert_equal(request_delta_download(instance, 2 * s), UDS_OK);
+  zassert_equal(transfer_patch(instance, 512), UDS_OK);
+  zassert_equal(receive_event(instance, UDS_EVT_RequestTransferExit, NULL),
+                UDS_NRC_GeneralProgrammingFailure);
+}
+
+ZTEST_F(lib_uds, test_0x34_0x38_delta_download_rejects_unaligned_address) {
+  struct uds_instance_t *instance = fixture->instance;
+
+  UDSRequestDownloadArgs_t args = {
+    .addr = (void *)(DELTA_FLASH_BASE_ADDRESS + DELTA_STORAGE_OFFSET + 4),
+    .size = 128,
+    .dataFormatIdentifier = UDS_DATA_FORMAT_IDENTIFIER_DELTA,
+  };
+
+  zassert_equal(receive_event(instance, UDS_EVT_RequestDownload, &args),
+                UDS_NRC_RequestOutOfRange);
+}
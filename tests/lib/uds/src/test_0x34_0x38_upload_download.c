@@ -23,6 +23,7 @@
 #define STORAGE_PARTITION_SIZE DT_REG_SIZE(STORAGE_PARTITION)
 
 #define STORAGE_BASE_ADDRESS (FLASH_BASE_ADDRESS + STORAGE_PARTITION_OFFSET)
+#define FLASH_SIZE DT_REG_SIZE(DT_CHOSEN(zephyr_flash))
 
 const struct device *const flash_controller =
     DEVICE_DT_GET_OR_NULL(DT_CHOSEN(zephyr_flash_controller));
@@ -366,6 +367,179 @@ ZTEST_F(lib_uds,
   zassert_equal(ret, UDS_OK);
 }
 
+ZTEST_F(lib_uds, test_0x34_0x38_upload_download_request_upload_block_length) {
+  struct uds_instance_t *instance = fixture->instance;
+
+  int cleanup = receive_event(instance, UDS_EVT_RequestTransferExit, NULL);
+  zassert_true(cleanup == UDS_OK || cleanup == UDS_NRC_RequestSequenceError);
+
+  UDSRequestUploadArgs_t upload_args = {
+    .addr = (void *)STORAGE_PARTITION_OFFSET,
+    .size = STORAGE_PARTITION_SIZE,
+    .dataFormatIdentifier = 0x00,
+    .maxNumberOfBlockLength = UINT16_MAX,
+  };
+
+  // the block length is only limited by the transport
+  int ret = receive_event(instance, UDS_EVT_RequestUpload, &upload_args);
+  zassert_equal(ret, UDS_OK);
+  zassert_equal(upload_args.maxNumberOfBlockLength, UDS_TP_MTU);
+
+  ret = receive_event(instance, UDS_EVT_RequestTransferExit, NULL);
+  zassert_equal(ret, UDS_OK);
+
+  upload_args.addr = (void *)STORAGE_PARTITION_OFFSET;
+  upload_args.maxNumberOfBlockLength = 64;
+
+  ret = receive_event(instance, UDS_EVT_RequestUpload, &upload_args);
+  zassert_equal(ret, UDS_OK);
+  zassert_equal(upload_args.maxNumberOfBlockLength, 64);
+
+  ret = receive_event(instance, UDS_EVT_RequestTransferExit, NULL);
+  zassert_equal(ret, UDS_OK);
+}
+
+ZTEST_F(lib_uds, test_0x34_0x38_upload_download_upload_large_block) {
+  struct uds_instance_t *instance = fixture->instance;
+
+  int cleanup = receive_event(instance, UDS_EVT_RequestTransferExit, NULL);
+  zassert_true(cleanup == UDS_OK || cleanup == UDS_NRC_RequestSequenceError);
+
+  fill_storage_with_test_pattern();
+
+  // larger than the read ahead buffers, but fits into the copied data
+  const size_t upload_size = 3001;
+  zassert_true(STORAGE_PARTITION_SIZE >= upload_size);
+
+  UDSRequestUploadArgs_t upload_args = {
+    .addr = (void *)STORAGE_PARTITION_OFFSET,
+    .size = upload_size,
+    .dataFormatIdentifier = 0x00,
+  };
+
+  int ret = receive_event(instance, UDS_EVT_RequestUpload, &upload_args);
+  zassert_equal(ret, UDS_OK);
+
+  uint8_t buffer[4];
+  UDSTransferDataArgs_t transfer_args = {
+    .data = buffer,
+    .len = sizeof(buffer),
+    .maxRespLen = 4000,
+    .copyResponse = copy,
+  };
+
+  ret = receive_event(instance, UDS_EVT_TransferData, &transfer_args);
+  zassert_equal(ret, UDS_OK);
+
+  static uint8_t expected[3001];
+  for (size_t i = 0; i < sizeof(expected); i++) {
+    expected[i] = (uint8_t)i;
+  }
+  assert_copy_data(expected, sizeof(expected));
+
+  ret = receive_event(instance, UDS_EVT_TransferData, &transfer_args);
+  zassert_equal(ret, UDS_NRC_RequestSequenceError);
+
+  ret = receive_event(instance, UDS_EVT_RequestTransferExit, NULL);
+  zassert_equal(ret, UDS_OK);
+}
+
+static size_t uploaded_bytes;
+
+static uint8_t count_copy(UDSServer_t *server, const void *data, uint16_t len) {
+  uploaded_bytes += len;
+
+  return 0;
+}
+
+// Uploads size bytes from the start of the flash, returns the transfer count
+static int upload_flash(struct uds_instance_t *instance,
+                        size_t size,
+                        uint16_t block_length) {
+  UDSRequestUploadArgs_t upload_args = {
+    .addr = (void *)0,
+    .size = size,
+    .dataFormatIdentifier = 0x00,
+    .maxNumberOfBlockLength = block_length,
+  };
+
+  int ret = receive_event(instance, UDS_EVT_RequestUpload, &upload_args);
+  zassert_equal(ret, UDS_OK);
+
+  uint8_t buffer[1];
+  UDSTransferDataArgs_t transfer_args = {
+    .data = buffer,
+    .len = sizeof(buffer),
+    .maxRespLen = upload_args.maxNumberOfBlockLength - UDS_0X36_RESP_BASE_LEN,
+    .copyResponse = copy,
+  };
+
+  int transfers = 0;
+  uploaded_bytes = 0;
+  while (uploaded_bytes < size) {
+    ret = receive_event(instance, UDS_EVT_TransferData, &transfer_args);
+    zassert_equal(ret, UDS_OK);
+    transfers++;
+  }
+  zassert_equal(uploaded_bytes, size);
+
+  ret = receive_event(instance, UDS_EVT_RequestTransferExit, NULL);
+  zassert_equal(ret, UDS_OK);
+
+  return transfers;
+}
+
+ZTEST_F(lib_uds, test_0x34_0x38_upload_download_upload_benchmark) {
+  struct uds_instance_t *instance = fixture->instance;
+  const size_t upload_size = MIN(KB(256), FLASH_SIZE);
+
+  int cleanup = receive_event(instance, UDS_EVT_RequestTransferExit, NULL);
+  zassert_true(cleanup == UDS_OK || cleanup == UDS_NRC_RequestSequenceError);
+
+  copy_fake.custom_fake = count_copy;
+
+  // blocks of 128 bytes, the previous limit
+  const int small_transfers = upload_flash(instance, upload_size, 130);
+  zassert_equal(small_transfers, DIV_ROUND_UP(upload_size, 128));
+
+#ifdef CONFIG_FLASH_SIMULATOR_STATS
+  const uint32_t *read_calls = find_stat("flash_sim_stats", "flash_read_calls");
+  const uint32_t *bytes_read = find_stat("flash_sim_stats", "bytes_read");
+  const uint32_t read_calls_before = *read_calls;
+  const uint32_t bytes_read_before = *bytes_read;
+#endif
+  const unsigned int copies_before = copy_fake.call_count;
+
+  // blocks up to the transport mtu
+  const int large_transfers = upload_flash(instance, upload_size, UDS_TP_MTU);
+  zassert_equal(large_transfers,
+                DIV_ROUND_UP(upload_size, UDS_TP_MTU - UDS_0X36_RESP_BASE_LEN));
+
+  const unsigned int copies = copy_fake.call_count - copies_before;
+
+  TC_PRINT("upload of %zu bytes: %d transfers with 128 byte blocks, %d "
+           "transfers with %d byte blocks copied in %u parts\n",
+           upload_size, small_transfers, large_transfers,
+           UDS_TP_MTU - UDS_0X36_RESP_BASE_LEN, copies);
+
+#ifdef CONFIG_UDS_UPLOAD_MEMORY_MAPPED
+  // every block is copied straight from the flash, without a staging buffer
+  zassert_equal(copies, large_transfers);
+#else
+  const int windows =
+      DIV_ROUND_UP(upload_size, CONFIG_UDS_UPLOAD_MAX_PAYLOAD_SIZE);
+
+  // a block is only split where a read ahead window ends
+  zassert_true(copies <= large_transfers + windows);
+
+#ifdef CONFIG_FLASH_SIMULATOR_STATS
+  // the flash is read once in windows, independent of the block length
+  zassert_equal(*read_calls - read_calls_before, windows);
+  zassert_equal(*bytes_read - bytes_read_before, upload_size);
+#endif
+#endif  // CONFIG_UDS_UPLOAD_MEMORY_MAPPED
+}
+
 ZTEST_F(lib_uds, test_0x34_0x38_upload_download_transfer_exit_success) {
   struct uds_instance_t *instance = fixture->instance;
 
@@ -537,3 +711,548 @@ ZTEST_F(lib_uds, test_0x34_0x38_file_transfer_deletefile) {
   ret = receive_event(instance, UDS_EVT_RequestTransferExit, NULL);
   zassert_equal(ret, UDS_NRC_RequestSequenceError);
 }
+
+static uint8_t file_pattern(size_t offset) {
+  return (uint8_t)(offset * 7 + (offset >> 8));
+}
+
+static size_t fs_free_bytes(void) {
+  struct fs_statvfs stat;
+  zassert_equal(fs_statvfs(UDS_TEST_FS_MOUNT_POINT, &stat), 0);
+
+  return stat.f_bfree * stat.f_frsize;
+}
+
+// Writes size bytes of the pattern to the file with TransferData in blocks of
+// up to block_length, 0 for the largest, and waits for gap before each
+// following request like a tester on the bus
+static void transfer_file_to_ecu(struct uds_instance_t *instance,
+                                 const char *path,
+                                 size_t size,
+                                 uint16_t block_length,
+                                 k_timeout_t gap) {
+  UDSRequestFileTransferArgs_t request = {
+    .modeOfOperation = UDS_MOOP_ADDFILE,
+    .filePathLen = (uint16_t)strlen(path),
+    .filePath = (const uint8_t *)path,
+    .dataFormatIdentifier = 0x00,
+    .fileSizeUnCompressed = size,
+    .fileSizeCompressed = size,
+    .maxNumberOfBlockLength = block_length,
+  };
+
+  int ret = receive_event(instance, UDS_EVT_RequestFileTransfer, &request);
+  zassert_equal(ret, UDS_OK);
+
+  static uint8_t block[UDS_TP_MTU];
+  const size_t block_size =
+      request.maxNumberOfBlockLength - UDS_0X36_RESP_BASE_LEN;
+
+  for (size_t offset = 0; offset < size; offset += block_size) {
+    const size_t len = MIN(block_size, size - offset);
+    for (size_t i = 0; i < len; i++) {
+      block[i] = file_pattern(offset + i);
+    }
+
+    UDSTransferDataArgs_t transfer = {
+      .data = block,
+      .len = len,
+    };
+
+    k_sleep(gap);
+    ret = receive_event(instance, UDS_EVT_TransferData, &transfer);
+    zassert_equal(ret, UDS_OK);
+  }
+
+  k_sleep(gap);
+  ret = receive_event(instance, UDS_EVT_RequestTransferExit, NULL);
+  zassert_equal(ret, UDS_OK);
+}
+
+static size_t file_read_offset;
+
+static uint8_t compare_copy(UDSServer_t *server,
+                            const void *data,
+                            uint16_t len) {
+  const uint8_t *bytes = data;
+
+  for (uint16_t i = 0; i < len; i++) {
+    zassert_equal(bytes[i], file_pattern(file_read_offset + i),
+                  "mismatch at %zu", file_read_offset + i);
+  }
+  file_read_offset += len;
+
+  return 0;
+}
+
+// Reads the file with TransferData in blocks of up to block_length, 0 for the
+// largest, and compares it with the pattern, waiting for gap before each
+// TransferData like a tester on the bus
+static void transfer_file_from_ecu(struct uds_instance_t *instance,
+                                   const char *path,
+                                   size_t size,
+                                   uint16_t block_length,
+                                   k_timeout_t gap) {
+  UDSRequestFileTransferArgs_t request = {
+    .modeOfOperation = UDS_MOOP_RDFILE,
+    .filePathLen = (uint16_t)strlen(path),
+    .filePath = (const uint8_t *)path,
+    .dataFormatIdentifier = 0x00,
+    .maxNumberOfBlockLength = block_length,
+  };
+
+  int ret = receive_event(instance, UDS_EVT_RequestFileTransfer, &request);
+  zassert_equal(ret, UDS_OK);
+
+  copy_fake.custom_fake = compare_copy;
+  file_read_offset = 0;
+
+  uint8_t buffer[1];
+  UDSTransferDataArgs_t transfer = {
+    .data = buffer,
+    .len = sizeof(buffer),
+    .maxRespLen = request.maxNumberOfBlockLength - UDS_0X36_RESP_BASE_LEN,
+    .copyResponse = copy,
+  };
+
+  while (file_read_offset < size) {
+    k_sleep(gap);
+    ret = receive_event(instance, UDS_EVT_TransferData, &transfer);
+    zassert_equal(ret, UDS_OK);
+  }
+  zassert_equal(file_read_offset, size);
+
+  ret = receive_event(instance, UDS_EVT_TransferData, &transfer);
+  zassert_equal(ret, UDS_NRC_RequestSequenceError);
+
+  ret = receive_event(instance, UDS_EVT_RequestTransferExit, NULL);
+  zassert_equal(ret, UDS_OK);
+}
+
+ZTEST_F(lib_uds, test_0x34_0x38_file_transfer_block_length) {
+  struct uds_instance_t *instance = fixture->instance;
+  const char path[] = UDS_TEST_FS_MOUNT_POINT "/block.bin";
+
+  struct fs_statvfs stat;
+  zassert_equal(fs_statvfs(UDS_TEST_FS_MOUNT_POINT, &stat), 0);
+
+  UDSRequestFileTransferArgs_t request = {
+    .modeOfOperation = UDS_MOOP_ADDFILE,
+    .filePathLen = (uint16_t)strlen(path),
+    .filePath = (const uint8_t *)path,
+    .dataFormatIdentifier = 0x00,
+    .fileSizeUnCompressed = 0,
+    .fileSizeCompressed = 0,
+    .maxNumberOfBlockLength = 0,
+  };
+
+  // whole program units of the file system per block
+  int ret = receive_event(instance, UDS_EVT_RequestFileTransfer, &request);
+  zassert_equal(ret, UDS_OK);
+  zassert_true(request.maxNumberOfBlockLength <= UDS_TP_MTU);
+  zassert_equal(
+      (request.maxNumberOfBlockLength - UDS_0X36_RESP_BASE_LEN) % stat.f_bsize,
+      0);
+
+  ret = receive_event(instance, UDS_EVT_RequestTransferExit, NULL);
+  zassert_equal(ret, UDS_OK);
+}
+
+ZTEST_F(lib_uds, test_0x34_0x38_file_transfer_write_and_read_large_file) {
+  struct uds_instance_t *instance = fixture->instance;
+  const char path[] = UDS_TEST_FS_MOUNT_POINT "/large.bin";
+  // spans both buffers several times and ends within one
+  const size_t size = 3 * CONFIG_UDS_FILE_TRANSFER_BUFFER_SIZE + 100;
+
+  transfer_file_to_ecu(instance, path, size, 0, K_NO_WAIT);
+
+  struct fs_dirent entry;
+  zassert_equal(fs_stat(path, &entry), 0);
+  zassert_equal(entry.size, size);
+
+  transfer_file_from_ecu(instance, path, size, 0, K_NO_WAIT);
+}
+
+ZTEST_F(lib_uds, test_0x34_0x38_file_transfer_write_error_is_reported) {
+  struct uds_instance_t *instance = fixture->instance;
+  const char path[] = UDS_TEST_FS_MOUNT_POINT "/full.bin";
+  // the file system runs out of space before the file is complete
+  const size_t size = fs_free_bytes() + KB(16);
+
+  UDSRequestFileTransferArgs_t request = {
+    .modeOfOperation = UDS_MOOP_ADDFILE,
+    .filePathLen = (uint16_t)strlen(path),
+    .filePath = (const uint8_t *)path,
+    .dataFormatIdentifier = 0x00,
+    .fileSizeUnCompressed = size,
+    .fileSizeCompressed = size,
+    .maxNumberOfBlockLength = 0,
+  };
+
+  int ret = receive_event(instance, UDS_EVT_RequestFileTransfer, &request);
+  zassert_equal(ret, UDS_OK);
+
+  static uint8_t block[UDS_TP_MTU];
+  const size_t block_size =
+      request.maxNumberOfBlockLength - UDS_0X36_RESP_BASE_LEN;
+  UDSTransferDataArgs_t transfer = {
+    .data = block,
+    .len = block_size,
+  };
+
+  // the error of a staged block is reported at one of the next blocks
+  size_t sent = 0;
+  do {
+    ret = receive_event(instance, UDS_EVT_TransferData, &transfer);
+    sent += block_size;
+  } while (ret == UDS_OK && sent + block_size <= size);
+
+  zassert_equal(ret, UDS_NRC_UploadDownloadNotAccepted);
+
+  ret = receive_event(instance, UDS_EVT_RequestTransferExit, NULL);
+  zassert_equal(ret, UDS_NRC_GeneralProgrammingFailure);
+}
+
+ZTEST_F(lib_uds, test_0x34_0x38_file_transfer_benchmark) {
+  struct uds_instance_t *instance = fixture->instance;
+  const char path[] = UDS_TEST_FS_MOUNT_POINT "/benchmark.bin";
+  const size_t size = MIN(KB(256), fs_free_bytes() / 2);
+  // the file system is accessed once per buffer
+  const uint32_t buffers =
+      DIV_ROUND_UP(size, CONFIG_UDS_FILE_TRANSFER_BUFFER_SIZE);
+
+#ifdef CONFIG_UDS_FILE_TRANSFER_STATS
+  const uint32_t *writes = find_stat("uds_file_transfer", "writes");
+  const uint32_t *reads = find_stat("uds_file_transfer", "reads");
+  const uint32_t *waits = find_stat("uds_file_transfer", "waits");
+  const uint32_t writes_before = *writes;
+  const uint32_t reads_before = *reads;
+  const uint32_t waits_before = *waits;
+#endif
+
+  // with blocks of at most one buffer, the work queue finishes a buffer in the
+  // gap between two requests, so TransferData never waits for the file system.
+  // Real flash or simulated flash timing may take longer than the gap.
+  const uint16_t block_length =
+      CONFIG_UDS_FILE_TRANSFER_BUFFER_SIZE + UDS_0X36_RESP_BASE_LEN;
+
+  transfer_file_to_ecu(instance, path, size, block_length, K_MSEC(1));
+
+#ifdef CONFIG_UDS_FILE_TRANSFER_STATS
+  zassert_equal(*writes - writes_before, buffers);
+#if defined(CONFIG_FLASH_SIMULATOR) && \
+    !defined(CONFIG_FLASH_SIMULATOR_SIMULATE_TIMING)
+  zassert_equal(*waits - waits_before, 0,
+                "TransferData waited for the file system");
+#endif
+#endif
+
+  transfer_file_from_ecu(instance, path, size, block_length, K_MSEC(1));
+
+#ifdef CONFIG_UDS_FILE_TRANSFER_STATS
+  zassert_equal(*reads - reads_before, buffers);
+#if defined(CONFIG_FLASH_SIMULATOR) && \
+    !defined(CONFIG_FLASH_SIMULATOR_SIMULATE_TIMING)
+  zassert_equal(*waits - waits_before, 0,
+                "TransferData waited for the file system");
+#endif
+#else
+  ARG_UNUSED(buffers);
+#endif
+}
+
+static struct flash_pages_info get_storage_sector(size_t index) {
+  struct flash_pages_info first;
+  int ret = flash_get_page_info_by_offs(flash_controller,
+                                        STORAGE_PARTITION_OFFSET, &first);
+  zassert_equal(ret, 0);
+
+  struct flash_pages_info sector;
+  ret = flash_get_page_info_by_offs(
+      flash_controller, first.start_offset + index * first.size, &sector);
+  zassert_equal(ret, 0);
+  zassert_true(sector.start_offset + sector.size <=
+               STORAGE_PARTITION_OFFSET + STORAGE_PARTITION_SIZE);
+
+  return sector;
+}
+
+static void assert_sector_is_erased(struct flash_pages_info sector,
+                                    bool erased) {
+  uint8_t buf[64];
+
+  for (size_t offset = 0; offset < sector.size; offset += sizeof(buf)) {
+    size_t len = MIN(sizeof(buf), sector.size - offset);
+    int ret = flash_read(flash_controller, sector.start_offset + offset, buf,
+                         len);
+    zassert_equal(ret, 0);
+
+    for (size_t i = 0; i < len; i++) {
+      if (buf[i] != 0xFF) {
+        zassert_false(erased, "sector at 0x%lx not erased",
+                      (long)sector.start_offset);
+        return;
+      }
+    }
+  }
+
+  zassert_true(erased, "sector at 0x%lx erased", (long)sector.start_offset);
+}
+
+ZTEST_F(lib_uds, test_0x34_0x38_erase_job_only_erases_touched_sectors) {
+  const struct flash_pages_info sector0 = get_storage_sector(0);
+  const struct flash_pages_info sector1 = get_storage_sector(1);
+  const struct flash_pages_info sector2 = get_storage_sector(2);
+
+  fill_storage_with_test_pattern();
+
+  // range of two bytes within sector 1
+  struct uds_flash_erase_job job;
+  int ret = uds_flash_erase_job_init(&job, sector1.start_offset + 1, 2);
+  zassert_equal(ret, 0);
+  zassert_equal(job.start, sector1.start_offset);
+  zassert_equal(job.end, sector1.start_offset + sector1.size);
+
+  zassert_equal(uds_flash_erase_job_step(&job), 0);
+  zassert_equal(uds_flash_erase_job_step(&job), 0);
+
+  assert_sector_is_erased(sector0, false);
+  assert_sector_is_erased(sector1, true);
+  assert_sector_is_erased(sector2, false);
+}
+
+ZTEST_F(lib_uds, test_0x34_0x38_erase_job_one_sector_per_step) {
+  const struct flash_pages_info sector0 = get_storage_sector(0);
+  const struct flash_pages_info sector1 = get_storage_sector(1);
+  const struct flash_pages_info sector2 = get_storage_sector(2);
+
+  fill_storage_with_test_pattern();
+
+  // range from the last byte of sector 0 to the first byte of sector 1
+  struct uds_flash_erase_job job;
+  int ret = uds_flash_erase_job_init(
+      &job, sector0.start_offset + sector0.size - 1, 2);
+  zassert_equal(ret, 0);
+
+  zassert_equal(uds_flash_erase_job_step(&job), 1);
+  assert_sector_is_erased(sector0, true);
+  assert_sector_is_erased(sector1, false);
+
+  zassert_equal(uds_flash_erase_job_step(&job), 0);
+  assert_sector_is_erased(sector1, true);
+  assert_sector_is_erased(sector2, false);
+}
+
+ZTEST_F(lib_uds, test_0x34_0x38_erase_job_rejects_invalid_range) {
+  struct uds_flash_erase_job job;
+
+  zassert_equal(uds_flash_erase_job_init(&job, STORAGE_PARTITION_OFFSET, 0),
+                -EINVAL);
+  zassert_equal(uds_flash_erase_job_init(&job, FLASH_SIZE - 4, 8), -EINVAL);
+  zassert_equal(uds_flash_erase_job_init(&job, STORAGE_PARTITION_OFFSET,
+                                         SIZE_MAX),
+                -EINVAL);
+}
+
+ZTEST_F(lib_uds, test_0x34_0x38_erase_job_time_scales_with_image_size) {
+  const struct flash_pages_info sector0 = get_storage_sector(0);
+  const size_t sector_count = STORAGE_PARTITION_SIZE / sector0.size;
+  struct uds_flash_erase_job job;
+  int steps;
+
+  // small image: a single sector
+  int64_t start = k_uptime_ticks();
+  zassert_equal(uds_flash_erase_job_init(&job, STORAGE_PARTITION_OFFSET, 1), 0);
+  for (steps = 1; uds_flash_erase_job_step(&job) > 0; steps++) {
+  }
+  const int64_t small_ticks = k_uptime_ticks() - start;
+  zassert_equal(steps, 1);
+
+  // large image: the whole partition
+  start = k_uptime_ticks();
+  zassert_equal(uds_flash_erase_job_init(&job, STORAGE_PARTITION_OFFSET,
+                                         STORAGE_PARTITION_SIZE),
+                0);
+  for (steps = 1; uds_flash_erase_job_step(&job) > 0; steps++) {
+  }
+  const int64_t large_ticks = k_uptime_ticks() - start;
+  zassert_equal(steps, sector_count);
+  zassert_equal(job.next - job.start, STORAGE_PARTITION_SIZE);
+
+  TC_PRINT("erase of 1 sector: %lld ticks, %zu sectors: %lld ticks\n",
+           small_ticks, sector_count, large_ticks);
+
+#ifdef CONFIG_FLASH_SIMULATOR_SIMULATE_TIMING
+  // each step waits for the erase time of one sector
+  const uint32_t erase_us = CONFIG_FLASH_SIMULATOR_MIN_ERASE_TIME_US;
+  zassert_true(small_ticks < k_us_to_ticks_ceil64(2 * erase_us));
+  zassert_true(large_ticks >= k_us_to_ticks_floor64(sector_count * erase_us));
+#endif
+}
+
+ZTEST_F(lib_uds, test_0x34_0x38_upload_download_erase_ahead) {
+  Z_TEST_SKIP_IFNDEF(CONFIG_UDS_UPLOAD_DOWNLOAD_ERASE_AHEAD);
+
+  struct uds_instance_t *instance = fixture->instance;
+  const struct flash_pages_info sector0 = get_storage_sector(0);
+  const struct flash_pages_info sector1 = get_storage_sector(1);
+
+  fill_storage_with_test_pattern();
+
+  UDSRequestDownloadArgs_t download_args = {
+    .addr = (void *)STORAGE_BASE_ADDRESS,
+    .size = STORAGE_PARTITION_SIZE,
+    .dataFormatIdentifier = 0x00,
+  };
+
+  int ret = receive_event(instance, UDS_EVT_RequestDownload, &download_args);
+  zassert_equal(ret, UDS_OK);
+
+  // nothing is erased before the first write
+  assert_sector_is_erased(sector0, false);
+
+  UDSTransferDataArgs_t transfer_args = {
+    .data = (const uint8_t[]){0xDE, 0xAD, 0xBE, 0xEF},
+    .len = 4,
+  };
+
+  ret = receive_event(instance, UDS_EVT_TransferData, &transfer_args);
+  zassert_equal(ret, UDS_OK);
+
+  uint8_t buf[4];
+  ret = flash_read(flash_controller, sector0.start_offset + 4, buf,
+                   sizeof(buf));
+  zassert_equal(ret, 0);
+  zassert_mem_equal(buf, (const uint8_t[]){0xFF, 0xFF, 0xFF, 0xFF}, 4);
+
+  ret = flash_read(flash_controller, sector0.start_offset, buf, sizeof(buf));
+  zassert_equal(ret, 0);
+  zassert_mem_equal(buf, transfer_args.data, sizeof(buf));
+
+  // the sector after the write pointer is not touched yet
+  assert_sector_is_erased(sector1, false);
+
+  ret = receive_event(instance, UDS_EVT_RequestTransferExit, NULL);
+  zassert_equal(ret, UDS_OK);
+}
+
+ZTEST_F(lib_uds, test_0x34_0x38_upload_download_erase_ahead_skips_erased) {
+  Z_TEST_SKIP_IFNDEF(CONFIG_UDS_UPLOAD_DOWNLOAD_ERASE_AHEAD);
+
+  struct uds_instance_t *instance = fixture->instance;
+  const struct flash_pages_info sector0 = get_storage_sector(0);
+
+  fill_storage_with_test_pattern();
+
+  struct uds_flash_erase_job job;
+  int ret = uds_flash_erase_job_init(&job, sector0.start_offset, 1);
+  zassert_equal(ret, 0);
+  zassert_equal(uds_flash_erase_job_step(&job), 0);
+  uds_download_use_erase_job(&job);
+
+  // a marker written after the erase is only kept if the sector is not erased
+  // again by the download
+  const uint8_t marker[4] = {0x12, 0x34, 0x56, 0x78};
+  const off_t marker_offset = sector0.start_offset + sector0.size - 4;
+  ret = flash_write(flash_controller, marker_offset, marker, sizeof(marker));
+  zassert_equal(ret, 0);
+
+  UDSRequestDownloadArgs_t download_args = {
+    .addr = (void *)STORAGE_BASE_ADDRESS,
+    .size = STORAGE_PARTITION_SIZE,
+    .dataFormatIdentifier = 0x00,
+  };
+
+  ret = receive_event(instance, UDS_EVT_RequestDownload, &download_args);
+  zassert_equal(ret, UDS_OK);
+
+  UDSTransferDataArgs_t transfer_args = {
+    .data = (const uint8_t[]){0xDE, 0xAD, 0xBE, 0xEF},
+    .len = 4,
+  };
+
+  ret = receive_event(instance, UDS_EVT_TransferData, &transfer_args);
+  zassert_equal(ret, UDS_OK);
+
+  uint8_t buf[4];
+  ret = flash_read(flash_controller, marker_offset, buf, sizeof(buf));
+  zassert_equal(ret, 0);
+  zassert_mem_equal(buf, marker, sizeof(marker));
+
+  ret = receive_event(instance, UDS_EVT_RequestTransferExit, NULL);
+  zassert_equal(ret, UDS_OK);
+}
+
+ZTEST_F(lib_uds, test_0x34_0x38_erase_ahead_ignores_other_jobs) {
+  Z_TEST_SKIP_IFNDEF(CONFIG_UDS_UPLOAD_DOWNLOAD_ERASE_AHEAD);
+
+  struct uds_instance_t *instance = fixture->instance;
+  const struct flash_pages_info sector0 = get_storage_sector(0);
+
+  // an erase job that was not handed over to the download, followed by other
+  // writes like the ones of a file system
+  struct uds_flash_erase_job job;
+  int ret = uds_flash_erase_job_init(&job, sector0.start_offset, 1);
+  zassert_equal(ret, 0);
+  zassert_equal(uds_flash_erase_job_step(&job), 0);
+
+  fill_storage_with_test_pattern();
+
+  UDSRequestDownloadArgs_t download_args = {
+    .addr = (void *)STORAGE_BASE_ADDRESS,
+    .size = STORAGE_PARTITION_SIZE,
+    .dataFormatIdentifier = 0x00,
+  };
+
+  ret = receive_event(instance, UDS_EVT_RequestDownload, &download_args);
+  zassert_equal(ret, UDS_OK);
+
+  UDSTransferDataArgs_t transfer_args = {
+    .data = (const uint8_t[]){0xDE, 0xAD, 0xBE, 0xEF},
+    .len = 4,
+  };
+
+  ret = receive_event(instance, UDS_EVT_TransferData, &transfer_args);
+  zassert_equal(ret, UDS_OK);
+
+  uint8_t buf[4];
+  ret = flash_read(flash_controller, sector0.start_offset, buf, sizeof(buf));
+  zassert_equal(ret, 0);
+  zassert_mem_equal(buf, transfer_args.data, sizeof(buf));
+
+  ret = receive_event(instance, UDS_EVT_RequestTransferExit, NULL);
+  zassert_equal(ret, UDS_OK);
+}
+
+ZTEST_F(lib_uds, test_0x34_0x38_erase_ahead_unaligned_start) {
+  Z_TEST_SKIP_IFNDEF(CONFIG_UDS_UPLOAD_DOWNLOAD_ERASE_AHEAD);
+
+  struct uds_instance_t *instance = fixture->instance;
+  const struct flash_pages_info sector0 = get_storage_sector(0);
+
+  fill_storage_with_test_pattern();
+
+  // erasing the first sector would destroy the data in front of the download
+  UDSRequestDownloadArgs_t download_args = {
+    .addr = (void *)(STORAGE_BASE_ADDRESS + 4),
+    .size = 4,
+    .dataFormatIdentifier = 0x00,
+  };
+
+  int ret = receive_event(instance, UDS_EVT_RequestDownload, &download_args);
+  zassert_equal(ret, UDS_NRC_RequestOutOfRange);
+  assert_sector_is_erased(sector0, false);
+
+  // allowed within the sectors of a handed over erase job
+  struct uds_flash_erase_job job;
+  ret = uds_flash_erase_job_init(&job, sector0.start_offset, 1);
+  zassert_equal(ret, 0);
+  zassert_equal(uds_flash_erase_job_step(&job), 0);
+  uds_download_use_erase_job(&job);
+
+  ret = receive_event(instance, UDS_EVT_RequestDownload, &download_args);
+  zassert_equal(ret, UDS_OK);
+
+  ret = receive_event(instance, UDS_EVT_RequestTransferExit, NULL);
+  zassert_equal(ret, UDS_OK);
+}
@@ -0,0 +1,116 @@
+/*
+ * SPDX-FileCopyrightText: Copyright (C) Frickly Systems GmbH
+ * SPDX-FileCopyrightText: Copyright (C) MBition GmbH
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/canbus/isotp.h>
+#include <zephyr/drivers/gpio.h>
+#include <zephyr/drivers/gpio/gpio_emul.h>
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+
+#define GEARSHIFT_POSITION 5
+
+// The server receives on 0x7E8 and responds on 0x7E0 plus its position
+#define GEARSHIFT_BASE_SERVER_RX_ID 0x7E8
+#define GEARSHIFT_BASE_SERVER_TX_ID 0x7E0
+
+#define RESPONSE_TIMEOUT K_MSEC(500)
+
+static const struct device *const can_dev =
+    DEVICE_DT_GET(DT_CHOSEN(zephyr_canbus));
+
+static const struct gpio_dt_spec gearshift_pins[] = {
+  DT_FOREACH_PROP_ELEM_SEP(DT_NODELABEL(gearshift),
+                           input_gpios,
+                           GPIO_DT_SPEC_GET_BY_IDX,
+                           (, )),
+};
+
+static const struct isotp_fc_opts fc_opts = {.bs = 0, .stmin = 0};
+
+static struct isotp_recv_ctx recv_ctx;
+static struct isotp_send_ctx send_ctx;
+
+// Sends a request to the server at a gearshift position and returns the
+// length of the response or ISOTP_RECV_TIMEOUT
+static int request(int position,
+                   const uint8_t *data,
+                   size_t len,
+                   uint8_t *response,
+                   size_t response_size) {
+  const struct isotp_msg_id server_rx_addr = {
+    .std_id = GEARSHIFT_BASE_SERVER_RX_ID + position,
+  };
+  const struct isotp_msg_id server_tx_addr = {
+    .std_id = GEARSHIFT_BASE_SERVER_TX_ID + position,
+  };
+
+  int ret = isotp_bind(&recv_ctx, can_dev, &server_tx_addr, &server_rx_addr,
+                       &fc_opts, K_NO_WAIT);
+  zassert_equal(ret, ISOTP_N_OK);
+
+  ret = isotp_send(&send_ctx, can_dev, data, len, &server_rx_addr,
+                   &server_tx_addr, NULL, NULL);
+  zassert_equal(ret, ISOTP_N_OK);
+
+  ret = isotp_recv(&recv_ctx, response, response_size, RESPONSE_TIMEOUT);
+  isotp_unbind(&recv_ctx);
+  return ret;
+}
+
+ZTEST(uds_legacy, test_tester_present_on_gearshift_address) {
+  const uint8_t data[] = {0x3E, 0x00};
+  uint8_t response[8];
+
+  int ret = request(GEARSHIFT_POSITION, data, sizeof(data), response,
+                    sizeof(response));
+  zassert_equal(ret, 2);
+  zassert_equal(response[0], 0x7E);
+  zassert_equal(response[1], 0x00);
+}
+
+ZTEST(uds_legacy, test_tester_present_suppressed_response) {
+  const uint8_t data[] = {0x3E, 0x80};
+  uint8_t response[8];
+
+  int ret = request(GEARSHIFT_POSITION, data, sizeof(data), response,
+                    sizeof(response));
+  zassert_equal(ret, ISOTP_RECV_TIMEOUT);
+}
+
+ZTEST(uds_legacy, test_tester_present_unsupported_subfunction) {
+  const uint8_t data[] = {0x3E, 0x01};
+  uint8_t response[8];
+
+  int ret = request(GEARSHIFT_POSITION, data, sizeof(data), response,
+                    sizeof(response));
+  zassert_equal(ret, 3);
+  zassert_equal(response[0], 0x7F);
+  zassert_equal(response[1], 0x3E);
+  zassert_equal(response[2], 0x12);  // SubFunctionNotSupported
+}
+
+ZTEST(uds_legacy, test_other_gearshift_positions_not_answered) {
+  const uint8_t data[] = {0x3E, 0x00};
+  uint8_t response[8];
+
+  int ret = request(0, data, sizeof(data), response, sizeof(response));
+  zassert_equal(ret, ISOTP_RECV_TIMEOUT);
+}
+
+static void *uds_legacy_setup(void) {
+  for (int i = 0; i < ARRAY_SIZE(gearshift_pins); i++) {
+    zassert_ok(gpio_emul_input_set(gearshift_pins[i].port,
+                                   gearshift_pins[i].pin,
+                                   (GEARSHIFT_POSITION >> i) & 1));
+  }
+
+  // The server reads the gearshift and binds after its start delay
+  k_sleep(K_MSEC(1500));
+  return NULL;
+}
+
+ZTEST_SUITE(uds_legacy, NULL, uds_legacy_setup, NULL, NULL, NULL);